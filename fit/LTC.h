@@ -8,6 +8,8 @@ using namespace glm;
 #include <iostream>
 using namespace std;
 
+#include "ltc_matrix.h"
+
 struct LTC {
 
 	// lobe magnitude
@@ -44,8 +46,8 @@ struct LTC {
 			mat3(m11, 0, 0,
 				0, m22, 0,
 				m13, 0, 1);
-		invM = inverse(M);
-		detM = abs(glm::determinant(M));
+		invM = ltcInverse(M);
+		detM = abs(ltcDeterminant(M));
 	}
 
 	float eval(const vec3& L) const
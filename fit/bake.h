@@ -0,0 +1,323 @@
+#ifndef _BAKE_
+#define _BAKE_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <vector>
+
+#include "ltc_eval.h"
+#include "ltc_table.h"
+#include "parallel.h"
+
+// incremental LTC baking of lightmap/probe texels lit by quad lights
+// * each light keeps its own contribution buffer, and the baked result is their sum
+// * a uniform grid over the texels bounds the region each light can affect above a threshold, with the lobe
+//   bound of each cell: glossy texels are reached from further away than diffuse ones, but only them
+// * when a light changes, its old contribution is removed and only its new footprint is evaluated
+
+struct BakeTexel
+{
+    vec3 P;          // position
+    vec3 N;          // normal
+    vec3 V;          // view direction (specular probes), ignored for diffuse
+    float roughness; // < 0 for diffuse texels
+};
+
+struct BakeLight
+{
+    vec3 points[4];
+    vec3 color;
+    bool twoSided;
+};
+
+// sparse contribution of one light
+struct LightContribution
+{
+    std::vector<int>  texels;
+    std::vector<vec3> values;
+};
+
+// upper bound of an LTC lobe relative to the clamped cosine, for the fitted structure of Minv:
+// D(w) <= |det(Minv)|/sigma_min(Minv)^3 / pi
+float ltcLobeScale(const mat3& Minv)
+{
+    // singular values of the 2x2 block, the middle one is 1
+    float a = Minv[0][0], b = Minv[2][0], c = Minv[0][2], d = Minv[2][2];
+    float s1 = a*a + b*b + c*c + d*d;
+    float s2 = sqrtf(std::max<float>(0.0f, (a*a + b*b - c*c - d*d)*(a*a + b*b - c*c - d*d) + 4.0f*(a*c + b*d)*(a*c + b*d)));
+    float sigmaMin = std::min<float>(sqrtf(std::max<float>(0.0f, 0.5f*(s1 - s2))), fabsf(Minv[1][1]));
+    sigmaMin = std::max<float>(sigmaMin, 1e-6f);
+
+    return std::max<float>(1.0f, fabsf(ltcDeterminant(Minv))/(sigmaMin*sigmaMin*sigmaMin));
+}
+
+// distances from the light center beyond which a light contributes less than threshold, for each lobe bound:
+// the integral of a lobe bounded by scale/pi over a polygon of area A at distance d is
+// bounded by scale*A/(pi d^2)
+struct LightRadius
+{
+    vec3 center;
+    float extent; // bounding sphere radius of the quad
+    float reach;  // squared distance from the sphere for a lobe bound of 1
+
+    LightRadius(const BakeLight& light, float threshold)
+    {
+        const float pi = 3.14159265f;
+        float area = length(cross(light.points[1] - light.points[0], light.points[3] - light.points[0]));
+        float power = std::max<float>(light.color.x, std::max<float>(light.color.y, light.color.z));
+
+        center = 0.25f*(light.points[0] + light.points[1] + light.points[2] + light.points[3]);
+        extent = 0.0f;
+        for (int i = 0; i < 4; ++i)
+            extent = std::max<float>(extent, length(light.points[i] - center));
+
+        reach = power*area/(pi*threshold);
+    }
+
+    float operator()(float lobeScale) const
+    {
+        return extent + sqrtf(lobeScale*reach);
+    }
+};
+
+// uniform grid over the texel positions
+struct TexelGrid
+{
+    vec3 lo, hi;
+    float cellSize;
+    int res[3];
+    std::vector<int> cellStart; // prefix sums, size numCells + 1
+    std::vector<int> cellTexels;
+    std::vector<float> cellBound; // largest bound of the texels of each cell, see bound()
+    float maxBound;
+
+    void build(const std::vector<BakeTexel>& texels, int texelsPerCell = 16)
+    {
+        lo = hi = texels.empty() ? vec3(0, 0, 0) : texels[0].P;
+        for (size_t i = 1; i < texels.size(); ++i)
+        {
+            lo = min(lo, texels[i].P);
+            hi = max(hi, texels[i].P);
+        }
+
+        vec3 extent = max(hi - lo, vec3(1e-4f, 1e-4f, 1e-4f));
+        float volume = extent.x*extent.y*extent.z;
+        float cells = std::max<float>(1.0f, (float)texels.size()/texelsPerCell);
+        cellSize = cbrtf(volume/cells);
+        for (int k = 0; k < 3; ++k)
+            res[k] = glm::clamp((int)ceilf(extent[k]/cellSize), 1, 1024);
+
+        int numCells = res[0]*res[1]*res[2];
+        cellStart.assign(numCells + 1, 0);
+        cellTexels.resize(texels.size());
+
+        for (size_t i = 0; i < texels.size(); ++i)
+            ++cellStart[cell(texels[i].P) + 1];
+        for (int c = 0; c < numCells; ++c)
+            cellStart[c + 1] += cellStart[c];
+
+        std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < texels.size(); ++i)
+            cellTexels[fill[cell(texels[i].P)]++] = (int)i;
+
+        bound(std::vector<float>(texels.size(), 1.0f));
+    }
+
+    // bounds of the cells from a bound per texel
+    void bound(const std::vector<float>& texelBound)
+    {
+        int numCells = res[0]*res[1]*res[2];
+        cellBound.assign(numCells, 0.0f);
+        maxBound = 0.0f;
+        for (int c = 0; c < numCells; ++c)
+        {
+            for (int i = cellStart[c]; i < cellStart[c + 1]; ++i)
+                cellBound[c] = std::max<float>(cellBound[c], texelBound[cellTexels[i]]);
+            maxBound = std::max<float>(maxBound, cellBound[c]);
+        }
+    }
+
+    int coord(float x, int k) const
+    {
+        return glm::clamp((int)floorf((x - lo[k])/cellSize), 0, res[k] - 1);
+    }
+
+    int cell(const vec3& P) const
+    {
+        return coord(P.x, 0) + res[0]*(coord(P.y, 1) + res[1]*coord(P.z, 2));
+    }
+
+    // texels in the cells overlapping a sphere whose radius(bound) grows with the bound of the cells
+    template<typename RADIUS>
+    void query(const vec3& center, const RADIUS& radius, std::vector<int>& result) const
+    {
+        float maxRadius = radius(maxBound);
+
+        int c0[3], c1[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            c0[k] = coord(center[k] - maxRadius, k);
+            c1[k] = coord(center[k] + maxRadius, k);
+        }
+
+        for (int z = c0[2]; z <= c1[2]; ++z)
+        for (int y = c0[1]; y <= c1[1]; ++y)
+        for (int x = c0[0]; x <= c1[0]; ++x)
+        {
+            int c = x + res[0]*(y + res[1]*z);
+            if (cellStart[c] == cellStart[c + 1])
+                continue;
+
+            // distance to the box of the cell, the last cells extend to the texels clamped into them
+            int xyz[3] = { x, y, z };
+            float d2 = 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                float b0 = lo[k] + xyz[k]*cellSize;
+                float b1 = xyz[k] == res[k] - 1 ? std::max<float>(hi[k], b0 + cellSize) : b0 + cellSize;
+                float d = std::max<float>(0.0f, std::max<float>(b0 - center[k], center[k] - b1));
+                d2 += d*d;
+            }
+
+            float r = radius(cellBound[c]);
+            if (d2 <= r*r)
+                result.insert(result.end(), cellTexels.begin() + cellStart[c], cellTexels.begin() + cellStart[c + 1]);
+        }
+    }
+};
+
+struct IncrementalBaker
+{
+    std::vector<BakeTexel> texels;
+    std::vector<BakeLight> lights;
+    std::vector<LightContribution> contributions;
+    std::vector<vec3> result;
+
+    TexelGrid grid;
+    float threshold;
+
+    // fitted table for glossy texels
+    const LTCTable* table;
+    std::vector<float> lobeScales; // bound of the lobe of each texel, see ltcLobeScale()
+
+    IncrementalBaker() : threshold(1e-3f), table(nullptr)
+    {
+    }
+
+    mat3 Minv(const BakeTexel& texel) const
+    {
+        if (texel.roughness < 0.0f || !table)
+            return mat3(1);
+
+        return table->Minv(texel.roughness, glm::clamp(dot(texel.N, texel.V), 0.0f, 1.0f));
+    }
+
+    vec3 evaluate(const BakeTexel& texel, const BakeLight& light) const
+    {
+        return light.color*LTC_Evaluate(texel.N, texel.V, texel.P, Minv(texel), light.points, light.twoSided);
+    }
+
+    // texels within the influence radius of a light, for the lobe of each texel
+    void footprint(const BakeLight& light, std::vector<int>& result) const
+    {
+        LightRadius radius(light, threshold);
+
+        std::vector<int> candidates;
+        grid.query(radius.center, radius, candidates);
+
+        for (size_t i = 0; i < candidates.size(); ++i)
+            if (distance(texels[candidates[i]].P, radius.center) <= radius(lobeScales[candidates[i]]))
+                result.push_back(candidates[i]);
+
+        std::sort(result.begin(), result.end());
+    }
+
+    // re-evaluate a set of lights over their footprints
+    // the work is split into blocks of texels of all lights, evaluated in parallel
+    void evaluateLights(const std::vector<int>& dirty)
+    {
+        parallel_for((int)dirty.size(), [&](int i)
+        {
+            LightContribution& c = contributions[dirty[i]];
+            c.texels.clear();
+            footprint(lights[dirty[i]], c.texels);
+            c.values.resize(c.texels.size());
+        });
+
+        const int blockSize = 256;
+        std::vector<ivec2> blocks; // (light, first texel)
+        for (size_t i = 0; i < dirty.size(); ++i)
+            for (size_t t = 0; t < contributions[dirty[i]].texels.size(); t += blockSize)
+                blocks.push_back(ivec2(dirty[i], (int)t));
+
+        parallel_for((int)blocks.size(), [&](int b)
+        {
+            const BakeLight& light = lights[blocks[b].x];
+            LightContribution& c = contributions[blocks[b].x];
+
+            int end = std::min<int>(blocks[b].y + blockSize, (int)c.texels.size());
+            for (int i = blocks[b].y; i < end; ++i)
+                c.values[i] = evaluate(texels[c.texels[i]], light);
+        });
+
+        for (size_t i = 0; i < dirty.size(); ++i)
+            accumulate(contributions[dirty[i]], 1.0f);
+    }
+
+    void accumulate(const LightContribution& c, float sign)
+    {
+        for (size_t i = 0; i < c.texels.size(); ++i)
+            result[c.texels[i]] += sign*c.values[i];
+    }
+
+    // full bake
+    void bake()
+    {
+        lobeScales.resize(texels.size());
+        for (size_t i = 0; i < texels.size(); ++i)
+            lobeScales[i] = ltcLobeScale(Minv(texels[i]));
+
+        grid.build(texels);
+        grid.bound(lobeScales);
+        contributions.assign(lights.size(), LightContribution());
+        result.assign(texels.size(), vec3(0, 0, 0));
+
+        std::vector<int> all(lights.size());
+        for (size_t l = 0; l < lights.size(); ++l)
+            all[l] = (int)l;
+        evaluateLights(all);
+    }
+
+    // incremental update after some lights changed:
+    // their old contributions are removed and their new footprints evaluated,
+    // at a cost proportional to the footprints rather than to the scene
+    void updateLights(const std::vector<int>& indices, const std::vector<BakeLight>& newLights)
+    {
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            accumulate(contributions[indices[i]], -1.0f);
+            lights[indices[i]] = newLights[i];
+        }
+
+        evaluateLights(indices);
+    }
+
+    void updateLight(int l, const BakeLight& light)
+    {
+        updateLights(std::vector<int>(1, l), std::vector<BakeLight>(1, light));
+    }
+
+    int addLight(const BakeLight& light)
+    {
+        lights.push_back(light);
+        contributions.push_back(LightContribution());
+
+        int l = (int)lights.size() - 1;
+        evaluateLights(std::vector<int>(1, l));
+        return l;
+    }
+};
+
+#endif
@@ -13,6 +13,27 @@ public:
 
     // sampling
     virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const = 0;
+
+    // batches of count directions in structure of arrays layout, as for the BRDF plugins (brdf_plugin.h)
+    // the defaults call eval() and sample()
+    virtual void evalBatch(const vec3& V, const float alpha, const int count,
+        const float* lx, const float* ly, const float* lz, float* value, float* pdf) const
+    {
+        for (int i = 0; i < count; ++i)
+            value[i] = eval(V, vec3(lx[i], ly[i], lz[i]), alpha, pdf[i]);
+    }
+
+    virtual void sampleBatch(const vec3& V, const float alpha, const int count,
+        const float* u1, const float* u2, float* lx, float* ly, float* lz) const
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const vec3 L = sample(V, alpha, u1[i], u2[i]);
+            lx[i] = L.x;
+            ly[i] = L.y;
+            lz[i] = L.z;
+        }
+    }
 };
 
 #endif
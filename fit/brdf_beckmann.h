@@ -6,6 +6,10 @@
 class BrdfBeckmann : public Brdf
 {
 public:
+    BrdfBeckmann(bool vndf_ = false) : vndf(vndf_)
+    {
+    }
+
     virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const
     {
         if (V.z <= 0)
@@ -33,7 +37,13 @@ public:
         const float slopey = H.y/H.z;
         float D = expf(-(slopex*slopex + slopey*slopey)/(alpha*alpha)) / (3.14159f * alpha*alpha * H.z*H.z*H.z*H.z);
 
-        pdf = fabsf(D * H.z / 4.0f / dot(V, H));
+        // the pdf of the visible normals is D G1(V) max(0, V.H)/V.z, V.H >= 0 for all L,
+        // and the back facing normals (H.z <= 0, only for L below the horizon) are never sampled
+        // (with the exact masking the sampling is normalized by, not the approximation of G2)
+        if (vndf)
+            pdf = H.z > 0.0f ? D / (1.0f + lambdaExact(alpha, V.z)) / 4.0f / V.z : 0.0f;
+        else
+            pdf = fabsf(D * H.z / 4.0f / dot(V, H));
         float res = D * G2 / 4.0f / V.z;
 
         return res;
@@ -41,6 +51,9 @@ public:
 
     virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
     {
+        if (vndf)
+            return sampleVisible(V, alpha, U1, U2);
+
         const float phi = 2.0f*3.14159f * U1;
         const float r = alpha*sqrtf(-logf(U2));
         const vec3 N = normalize(vec3(r*cosf(phi), r*sinf(phi), 1.0f));
@@ -48,7 +61,119 @@ public:
         return L;
     }
 
+    // sample the distribution of visible normals instead of the full NDF: no reflection below the horizon,
+    // which most samples of the NDF are at grazing angles
+    bool vndf;
+
 private:
+    // "Importance Sampling Microfacet-Based BSDFs using the Distribution of Visible Normals" [Heitz and d'Eon 2014],
+    // with the numerical inversion of the slope CDF of Mitsuba, which has no discontinuities
+    vec3 sampleVisible(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        const float sqrtPiInv = 0.564190f;
+
+        // view direction of the unit roughness configuration
+        const vec3 Vs = normalize(vec3(alpha*V.x, alpha*V.y, V.z));
+        const float thetaV = Vs.z < 0.99999f ? acosf(Vs.z) : 0.0f;
+        const float phiV = Vs.z < 0.99999f ? atan2f(Vs.y, Vs.x) : 0.0f;
+
+        // slopes of the visible normals for unit roughness, V in the xz plane
+        float slopeX, slopeY;
+        if (thetaV < 1e-4f)
+        {
+            const float r = sqrtf(-logf(1.0f - U1));
+            slopeX = r*cosf(2.0f*3.14159f * U2);
+            slopeY = r*sinf(2.0f*3.14159f * U2);
+        }
+        else
+        {
+            // x: Newton iterations on the CDF, safeguarded by bisection, in the erf() domain
+            const float tanThetaV = tanf(thetaV);
+            const float cotThetaV = 1.0f/tanThetaV;
+            const float u = std::max<float>(U1, 1e-6f);
+
+            float a = -1.0f;
+            float c = erff(cotThetaV);
+            const float fit = 1.0f + thetaV*(-0.876f + thetaV*(0.4265f - 0.0594f*thetaV));
+            float b = c - (1.0f + c)*powf(1.0f - u, fit);
+
+            const float normalization = 1.0f/(1.0f + c + sqrtPiInv*tanThetaV*expf(-cotThetaV*cotThetaV));
+
+            for (int it = 0; it < 10; ++it)
+            {
+                if (!(b >= a && b <= c))
+                    b = 0.5f*(a + c);
+
+                const float x = erfinv(b);
+                const float value = normalization*(1.0f + b + sqrtPiInv*tanThetaV*expf(-x*x)) - u;
+                const float derivative = normalization*(1.0f - x*tanThetaV);
+                if (fabsf(value) < 1e-5f)
+                    break;
+
+                if (value > 0.0f)
+                    c = b;
+                else
+                    a = b;
+                b -= value/derivative;
+            }
+
+            slopeX = erfinv(b);
+            slopeY = erfinv(2.0f*std::max<float>(U2, 1e-6f) - 1.0f);
+        }
+
+        // rotated to V, and back to roughness alpha
+        const float cosPhi = cosf(phiV), sinPhi = sinf(phiV);
+        const float sx = alpha*(cosPhi*slopeX - sinPhi*slopeY);
+        const float sy = alpha*(sinPhi*slopeX + cosPhi*slopeY);
+
+        const vec3 N = normalize(vec3(-sx, -sy, 1.0f));
+        const vec3 L = -V + 2.0f * N * dot(N, V);
+        return L;
+    }
+
+    // inverse error function [Giles 2010], single precision
+    static float erfinv(const float x)
+    {
+        float w = -logf((1.0f - x)*(1.0f + x));
+        float p;
+        if (w < 5.0f)
+        {
+            w = w - 2.5f;
+            p = 2.81022636e-08f;
+            p = 3.43273939e-07f + p*w;
+            p = -3.5233877e-06f + p*w;
+            p = -4.39150654e-06f + p*w;
+            p = 0.00021858087f + p*w;
+            p = -0.00125372503f + p*w;
+            p = -0.00417768164f + p*w;
+            p = 0.246640727f + p*w;
+            p = 1.50140941f + p*w;
+        }
+        else
+        {
+            w = sqrtf(w) - 3.0f;
+            p = -0.000200214257f;
+            p = 0.000100950558f + p*w;
+            p = 0.00134934322f + p*w;
+            p = -0.00367342844f + p*w;
+            p = 0.00573950773f + p*w;
+            p = -0.0076224613f + p*w;
+            p = 0.00943887047f + p*w;
+            p = 1.00167406f + p*w;
+            p = 2.83297682f + p*w;
+        }
+        return p*x;
+    }
+
+    // Smith masking of the Beckmann distribution, without approximation
+    float lambdaExact(const float alpha, const float cosTheta) const
+    {
+        if (cosTheta >= 1.0f)
+            return 0.0f;
+        const float a = 1.0f / alpha / tanf(acosf(cosTheta));
+        return 0.5f*(erff(a) - 1.0f) + 0.282095f*expf(-a*a)/a;
+    }
+
     float lambda(const float alpha, const float cosTheta) const
     {
         const float a = 1.0f / alpha / tanf(acosf(cosTheta));
@@ -0,0 +1,121 @@
+#ifndef _BRDF_COMBINED_
+#define _BRDF_COMBINED_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "brdf.h"
+#include "brdf_disneyDiffuse.h"
+#include "brdf_ggx.h"
+
+// diffuse and specular lobes of a material as one BRDF, for the single-lobe tables of fitLTC --combined
+// * f = (1 - k) f_diffuse/A_diffuse + k f_ggx/A_ggx: both lobes are normalized by their albedo A, so that k is
+//   the fraction of the reflected energy in the specular lobe, whatever the roughness and the view angle
+// * the tables are 2D arrays of (roughness, sqrt(1 - cos(theta))) slices, one per k, see combinedSliceWeight()
+// * a material of diffuse color d and specular color s (with Fresnel, from the GGX table) has
+//   k = lum(s)/(lum(s) + lum(d)), and reflects (d + s) times the integral of the fitted lobe, see ltc_combined.h
+
+// fraction of the specular lobe of a slice
+float combinedSliceWeight(int slice, int numSlices)
+{
+    return slice/float(numSlices - 1);
+}
+
+// albedos of the two lobes over the grid of the fitted cells, bilinearly interpolated in between
+struct CombinedAlbedo
+{
+    int N;
+    std::vector<float> diffuse, specular;
+
+    void init(const Brdf& disney, const Brdf& ggx, int N_, float minAlpha, int numSamples = 64)
+    {
+        N = N_;
+        diffuse.resize(N*N);
+        specular.resize(N*N);
+
+        for (int t = 0; t < N; ++t)
+        for (int a = 0; a < N; ++a)
+        {
+            // same cells as initCell() in fitLTC.cpp
+            float x = t/float(N - 1);
+            float theta = std::min<float>(1.57f, acosf(1.0f - x*x));
+            vec3 V = vec3(sinf(theta), 0, cosf(theta));
+            float roughness = a/float(N - 1);
+            float alpha = std::max<float>(roughness*roughness, minAlpha);
+
+            diffuse[a + t*N] = albedo(disney, V, alpha, numSamples);
+            specular[a + t*N] = albedo(ggx, V, alpha, numSamples);
+        }
+    }
+
+    static float albedo(const Brdf& brdf, const vec3& V, float alpha, int n)
+    {
+        double sum = 0.0;
+        for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i)
+        {
+            float pdf;
+            vec3 L = brdf.sample(V, alpha, (i + 0.5f)/n, (j + 0.5f)/n);
+            float value = brdf.eval(V, L, alpha, pdf);
+            if (pdf > 0.0f)
+                sum += value/pdf;
+        }
+
+        return std::max<float>((float)(sum/(n*n)), 1e-6f);
+    }
+
+    float lookup(const std::vector<float>& table, const vec3& V, float alpha) const
+    {
+        float a = glm::clamp(sqrtf(alpha), 0.0f, 1.0f)*(N - 1);
+        float t = glm::clamp(sqrtf(1.0f - glm::clamp(V.z, 0.0f, 1.0f)), 0.0f, 1.0f)*(N - 1);
+        int a0 = std::min<int>((int)a, N - 2), t0 = std::min<int>((int)t, N - 2);
+        float fa = a - a0, ft = t - t0;
+
+        return (table[a0 + t0*N      ]*(1.0f - fa) + table[a0 + 1 + t0*N      ]*fa)*(1.0f - ft) +
+               (table[a0 + (t0 + 1)*N]*(1.0f - fa) + table[a0 + 1 + (t0 + 1)*N]*fa)*ft;
+    }
+};
+
+class BrdfCombined : public Brdf
+{
+public:
+    const BrdfDisneyDiffuse* disney;
+    const BrdfGGX* ggx;
+    const CombinedAlbedo* albedo;
+    float k;
+
+    BrdfCombined() : disney(nullptr), ggx(nullptr), albedo(nullptr), k(0.5f)
+    {
+    }
+
+    BrdfCombined(const BrdfDisneyDiffuse& disney_, const BrdfGGX& ggx_, const CombinedAlbedo& albedo_, float k_) :
+        disney(&disney_), ggx(&ggx_), albedo(&albedo_), k(k_)
+    {
+    }
+
+    // pdf is the one of the mixture of the sampling of the lobes, with the weights k and 1 - k
+    virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const
+    {
+        float pdfDiffuse, pdfSpecular;
+        float d = disney->eval(V, L, alpha, pdfDiffuse);
+        float s = ggx->eval(V, L, alpha, pdfSpecular);
+
+        pdf = (1.0f - k)*pdfDiffuse + k*pdfSpecular;
+
+        float wd = k < 1.0f ? (1.0f - k)/albedo->lookup(albedo->diffuse, V, alpha) : 0.0f;
+        float ws = k > 0.0f ? k/albedo->lookup(albedo->specular, V, alpha) : 0.0f;
+        return wd*d + ws*s;
+    }
+
+    // U1 chooses the lobe, and is rescaled to [0, 1) for it
+    virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        if (U1 < k)
+            return ggx->sample(V, alpha, U1/k, U2);
+
+        return disney->sample(V, alpha, (U1 - k)/(1.0f - k), U2);
+    }
+};
+
+#endif
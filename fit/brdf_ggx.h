@@ -6,6 +6,10 @@
 class BrdfGGX : public Brdf
 {
 public:
+    BrdfGGX(bool vndf_ = false) : vndf(vndf_)
+    {
+    }
+
     virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const
     {
         if (V.z <= 0)
@@ -35,7 +39,12 @@ public:
         D = D*D;
         D = D/(3.14159f * alpha*alpha * H.z*H.z*H.z*H.z);
 
-        pdf = fabsf(D * H.z / 4.0f / dot(V, H));
+        // the pdf of the visible normals is D G1(V) max(0, V.H)/V.z, V.H >= 0 for all L,
+        // and the back facing normals (H.z <= 0, only for L below the horizon) are never sampled
+        if (vndf)
+            pdf = H.z > 0.0f ? D / (1.0f + LambdaV) / 4.0f / V.z : 0.0f;
+        else
+            pdf = fabsf(D * H.z / 4.0f / dot(V, H));
         float res = D * G2 / 4.0f / V.z;
 
         return res;
@@ -43,6 +52,9 @@ public:
 
     virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
     {
+        if (vndf)
+            return sampleVisible(V, alpha, U1, U2);
+
         const float phi = 2.0f*3.14159f * U1;
         const float r = alpha*sqrtf(U2/(1.0f - U2));
         const vec3 N = normalize(vec3(r*cosf(phi), r*sinf(phi), 1.0f));
@@ -50,7 +62,36 @@ public:
         return L;
     }
 
+    // sample the distribution of visible normals instead of the full NDF: no reflection below the horizon,
+    // which most samples of the NDF are at grazing angles
+    bool vndf;
+
 private:
+    // "Sampling the GGX Distribution of Visible Normals" [Heitz 2018]
+    vec3 sampleVisible(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        // view direction in the hemisphere configuration
+        const vec3 Vh = normalize(vec3(alpha*V.x, alpha*V.y, V.z));
+
+        // orthonormal basis around it
+        const float lensq = Vh.x*Vh.x + Vh.y*Vh.y;
+        const vec3 T1 = lensq > 0.0f ? vec3(-Vh.y, Vh.x, 0.0f)/sqrtf(lensq) : vec3(1, 0, 0);
+        const vec3 T2 = cross(Vh, T1);
+
+        // point on the projected hemisphere, the disk warped to the visible half
+        const float r = sqrtf(U1);
+        const float phi = 2.0f*3.14159f * U2;
+        const float t1 = r*cosf(phi);
+        const float s = 0.5f*(1.0f + Vh.z);
+        const float t2 = (1.0f - s)*sqrtf(1.0f - t1*t1) + s*r*sinf(phi);
+
+        // back to the ellipsoid configuration
+        const vec3 Nh = t1*T1 + t2*T2 + sqrtf(std::max<float>(0.0f, 1.0f - t1*t1 - t2*t2))*Vh;
+        const vec3 N = normalize(vec3(alpha*Nh.x, alpha*Nh.y, std::max<float>(0.0f, Nh.z)));
+        const vec3 L = -V + 2.0f * N * dot(N, V);
+        return L;
+    }
+
     float lambda(const float alpha, const float cosTheta) const
     {
         const float a = 1.0f / alpha / tanf(acosf(cosTheta));
@@ -0,0 +1,55 @@
+#ifndef _BRDF_PLUGIN_
+#define _BRDF_PLUGIN_
+
+#include <stdint.h>
+
+// C ABI of the BRDF plugins of fitLTC (fitLTC --brdf plugin:path), shared libraries that export
+//   const LTCBrdfPlugin* ltcBrdfPlugin(uint32_t abiVersion);
+// and return NULL for an abiVersion they do not support
+// * the functions take batches of count directions in structure of arrays layout, for one view direction V and
+//   one alpha = roughness^2, the way the error of a cell is evaluated: plugins can vectorize over the batch
+// * directions are unit vectors in the shading frame, with the normal along z
+// * the functions are called concurrently by the fitting threads, with the same context
+// see plugins/brdf_ggx_plugin.c for an example, and brdf_plugin_host.h for the loader
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTC_BRDF_PLUGIN_ABI_VERSION 1
+
+// the BRDF is invariant by rotation around the normal, which fitLTC requires: it fits V in the xz plane only
+#define LTC_BRDF_PLUGIN_ISOTROPIC 0x1u
+
+typedef struct LTCBrdfPlugin
+{
+    uint32_t abiVersion;    // LTC_BRDF_PLUGIN_ABI_VERSION
+    uint32_t flags;         // LTC_BRDF_PLUGIN_*
+    const char* name;       // results directory when several BRDFs are fitted
+    void* context;          // passed to the functions
+
+    // cosine-weighted BRDF, 0 below the horizon
+    void (*eval)(void* context, const float V[3], float alpha, int count,
+                 const float* lx, const float* ly, const float* lz, float* value);
+
+    // density of the directions of sample(), over the sphere
+    void (*pdf)(void* context, const float V[3], float alpha, int count,
+                const float* lx, const float* ly, const float* lz, float* pdf);
+
+    // directions of the uniform numbers (u1, u2) in [0, 1)^2
+    void (*sample)(void* context, const float V[3], float alpha, int count,
+                   const float* u1, const float* u2, float* lx, float* ly, float* lz);
+
+    // called before the library is unloaded, may be NULL
+    void (*release)(void* context);
+} LTCBrdfPlugin;
+
+typedef const LTCBrdfPlugin* (*LTCBrdfPluginEntry)(uint32_t abiVersion);
+
+#define LTC_BRDF_PLUGIN_ENTRY "ltcBrdfPlugin"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
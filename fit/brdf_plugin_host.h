@@ -0,0 +1,112 @@
+#ifndef _BRDF_PLUGIN_HOST_
+#define _BRDF_PLUGIN_HOST_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <dlfcn.h>
+
+#include <string>
+
+#include "brdf.h"
+#include "brdf_plugin.h"
+
+// a BRDF plugin (see brdf_plugin.h) loaded with dlopen, behind the Brdf interface
+// * evalBatch() and sampleBatch() forward the batches to the plugin, eval() and sample() are batches of one
+// * the library stays loaded as long as the BrdfPlugin
+class BrdfPlugin : public Brdf
+{
+public:
+    BrdfPlugin() : library(nullptr), plugin(nullptr)
+    {
+    }
+
+    ~BrdfPlugin()
+    {
+        unload();
+    }
+
+    // error describes why the library cannot be used
+    bool load(const std::string& path, std::string& error)
+    {
+        unload();
+
+        library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library)
+        {
+            error = dlerror();
+            return false;
+        }
+
+        LTCBrdfPluginEntry entry = (LTCBrdfPluginEntry)dlsym(library, LTC_BRDF_PLUGIN_ENTRY);
+        if (!entry)
+            error = path + " does not export " LTC_BRDF_PLUGIN_ENTRY "()";
+        else if (!(plugin = entry(LTC_BRDF_PLUGIN_ABI_VERSION)) || plugin->abiVersion != LTC_BRDF_PLUGIN_ABI_VERSION)
+            error = path + " does not support the plugin ABI version " + std::to_string(LTC_BRDF_PLUGIN_ABI_VERSION);
+        else if (!plugin->eval || !plugin->pdf || !plugin->sample)
+            error = path + " does not define eval(), pdf() and sample()";
+        else if (!(plugin->flags & LTC_BRDF_PLUGIN_ISOTROPIC))
+            error = path + " is not isotropic, the tables are fitted for isotropic BRDFs only";
+        else
+            return true;
+
+        // no release() of a plugin that was rejected
+        plugin = nullptr;
+        unload();
+        return false;
+    }
+
+    void unload()
+    {
+        if (plugin && plugin->release)
+            plugin->release(plugin->context);
+        plugin = nullptr;
+
+        if (library)
+            dlclose(library);
+        library = nullptr;
+    }
+
+    std::string name() const
+    {
+        return plugin && plugin->name ? plugin->name : "plugin";
+    }
+
+    virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const
+    {
+        float value;
+        evalBatch(V, alpha, 1, &L.x, &L.y, &L.z, &value, &pdf);
+        return value;
+    }
+
+    virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        vec3 L;
+        sampleBatch(V, alpha, 1, &U1, &U2, &L.x, &L.y, &L.z);
+        return L;
+    }
+
+    virtual void evalBatch(const vec3& V, const float alpha, const int count,
+        const float* lx, const float* ly, const float* lz, float* value, float* pdf) const
+    {
+        const float v[3] = { V.x, V.y, V.z };
+        plugin->eval(plugin->context, v, alpha, count, lx, ly, lz, value);
+        plugin->pdf(plugin->context, v, alpha, count, lx, ly, lz, pdf);
+    }
+
+    virtual void sampleBatch(const vec3& V, const float alpha, const int count,
+        const float* u1, const float* u2, float* lx, float* ly, float* lz) const
+    {
+        const float v[3] = { V.x, V.y, V.z };
+        plugin->sample(plugin->context, v, alpha, count, u1, u2, lx, ly, lz);
+    }
+
+private:
+    void* library;
+    const LTCBrdfPlugin* plugin;
+
+    BrdfPlugin(const BrdfPlugin&);
+    BrdfPlugin& operator=(const BrdfPlugin&);
+};
+
+#endif
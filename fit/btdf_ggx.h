@@ -0,0 +1,123 @@
+#ifndef _BTDF_GGX_
+#define _BTDF_GGX_
+
+#include "brdf.h"
+
+// rough dielectric transmission with a GGX distribution [Walter et al. 2007]
+// * eta = eta_L/eta_V is the relative index of refraction of the light side over the view side
+// * the transmitted lobe lives in the lower hemisphere: it is mirrored to the upper one, L = (x, y, -z),
+//   so that it can be fitted and integrated like a reflected lobe
+// * the magnitude includes the (1 - F) dielectric transmittance and the 1/eta^2 radiance scaling
+class BtdfGGX : public Brdf
+{
+public:
+    float eta;
+
+    BtdfGGX(float eta_ = 1.5f) : eta(eta_)
+    {
+    }
+
+    virtual float eval(const vec3& V, const vec3& Lmirrored, const float alpha, float& pdf) const
+    {
+        pdf = 0;
+        if (V.z <= 0 || Lmirrored.z <= 0)
+            return 0;
+
+        const vec3 L = vec3(Lmirrored.x, Lmirrored.y, -Lmirrored.z);
+
+        // generalized half vector, oriented towards the view side
+        vec3 H = -(V + eta*L);
+        float len = length(H);
+        if (len < 1e-6f)
+            return 0;
+        H /= H.z < 0 ? -len : len;
+
+        // V and L on either side of the microfacet
+        const float VdotH = dot(V, H);
+        const float LdotH = dot(L, H);
+        if (VdotH <= 0 || LdotH >= 0)
+            return 0;
+
+        // D
+        const float slopex = H.x/H.z;
+        const float slopey = H.y/H.z;
+        float D = 1.0f / (1.0f + (slopex*slopex + slopey*slopey)/alpha/alpha);
+        D = D*D;
+        D = D/(3.14159f * alpha*alpha * H.z*H.z*H.z*H.z);
+
+        // height-correlated masking-shadowing for transmission [Heitz 2014]: B(1 + LambdaV, 1 + LambdaL)
+        const float LambdaV = lambda(alpha, V.z);
+        const float LambdaL = lambda(alpha, -L.z);
+        const float G2 = expf(lgammaf(1.0f + LambdaV) + lgammaf(1.0f + LambdaL) - lgammaf(2.0f + LambdaV + LambdaL));
+
+        const float F = fresnel(VdotH);
+
+        const float denom = VdotH + eta*LdotH;
+        const float jacobian = eta*eta * -LdotH/(denom*denom);
+
+        pdf = D * H.z * jacobian;
+        float res = VdotH * -LdotH * (1.0f - F) * G2 * D / (V.z * denom*denom);
+
+        return res;
+    }
+
+    virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        const float phi = 2.0f*3.14159f * U1;
+        const float r = alpha*sqrtf(U2/(1.0f - U2));
+        const vec3 H = normalize(vec3(r*cosf(phi), r*sinf(phi), 1.0f));
+
+        // refraction through the microfacet, rejected in eval() on total internal reflection
+        const float VdotH = dot(V, H);
+        const float ratio = 1.0f/eta;
+        const float cos2t = 1.0f - ratio*ratio*(1.0f - VdotH*VdotH);
+        if (VdotH <= 0 || cos2t <= 0)
+            return vec3(0, 0, -1);
+
+        const vec3 L = -ratio*V + (ratio*VdotH - sqrtf(cos2t))*H;
+        return vec3(L.x, L.y, -L.z);
+    }
+
+private:
+    float lambda(const float alpha, const float cosTheta) const
+    {
+        const float a = 1.0f / alpha / tanf(acosf(cosTheta));
+        return (cosTheta < 1.0f) ? 0.5f * (-1.0f + sqrtf(1.0f + 1.0f/a/a)) : 0.0f;
+    }
+
+    // unpolarized dielectric Fresnel reflectance, c = cosine on the view side
+    float fresnel(const float c) const
+    {
+        const float g2 = eta*eta - 1.0f + c*c;
+        if (g2 <= 0)
+            return 1.0f;
+
+        const float g = sqrtf(g2);
+        const float A = (g - c)/(g + c);
+        const float B = (c*(g + c) - 1.0f)/(c*(g - c) + 1.0f);
+        return 0.5f*A*A*(1.0f + B*B);
+    }
+};
+
+// eta of the slices of the transmission tables, in [BTDF_ETA_MIN, BTDF_ETA_MAX]
+// * the width of the transmitted lobe grows with 1 - 1/eta, so the slices are evenly spaced in 1 - 1/eta,
+//   which keeps the interpolation between them close to linear
+// * eta = 1 is left out: an index-matched interface does not refract
+const float BTDF_ETA_MIN = 1.1f;
+const float BTDF_ETA_MAX = 2.5f;
+
+float btdfSliceCoord(float eta)
+{
+    const float x0 = 1.0f - 1.0f/BTDF_ETA_MIN;
+    const float x1 = 1.0f - 1.0f/BTDF_ETA_MAX;
+    return ((1.0f - 1.0f/eta) - x0)/(x1 - x0);
+}
+
+float btdfSliceEta(int slice, int numSlices)
+{
+    const float x0 = 1.0f - 1.0f/BTDF_ETA_MIN;
+    const float x1 = 1.0f - 1.0f/BTDF_ETA_MAX;
+    return 1.0f/(1.0f - (x0 + (x1 - x0)*slice/float(numSlices - 1)));
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <cstddef>
 
+#include "float_to_half.h"
+
 #pragma pack(push, 1)
 struct DDS_PIXELFORMAT
 {
@@ -34,14 +36,29 @@ struct DDS_HEADER
     uint32_t        dwCaps4;
     uint32_t        dwReserved2;
 };
+
+struct DDS_HEADER_DXT10
+{
+    uint32_t        dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag;
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
 #pragma pack(pop)
 
 uint32_t const DDS_MAGIC                        = 0x20534444; // "DDS "
 uint32_t const DDS_HEADER_FLAGS_TEXTURE         = 0x00001007; // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
 uint32_t const DDS_HEADER_FLAGS_PITCH           = 0x00000008;
+uint32_t const DDS_HEADER_FLAGS_MIPMAP          = 0x00020000; // DDSD_MIPMAPCOUNT
 uint32_t const DDS_SURFACE_FLAGS_TEXTURE        = 0x00001000; // DDSCAPS_TEXTURE
+uint32_t const DDS_SURFACE_FLAGS_MIPMAP         = 0x00400008; // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+uint32_t const DDS_SURFACE_FLAGS_CUBEMAP        = 0x00000008; // DDSCAPS_COMPLEX
+uint32_t const DDS_CUBEMAP_ALLFACES             = 0x0000fe00; // DDSCAPS2_CUBEMAP | all faces
 uint32_t const DDS_PF_FLAGS_FOURCC              = 0x00000004;
+uint32_t const DDS_FOURCC_DX10                  = 0x30315844; // "DX10"
 uint32_t const DDS_RESOURCE_DIMENSION_TEXTURE2D = 3;
+uint32_t const DDS_RESOURCE_MISC_TEXTURECUBE    = 0x00000004;
 
 DDS_PIXELFORMAT const DDSPF_RGBA16F = { sizeof(DDS_PIXELFORMAT), DDS_PF_FLAGS_FOURCC, 113, 0, 0, 0, 0, 0 };
 DDS_PIXELFORMAT const DDSPF_RGBA32F = { sizeof(DDS_PIXELFORMAT), DDS_PF_FLAGS_FOURCC, 116, 0, 0, 0, 0, 0 };
@@ -57,6 +74,17 @@ DDS_PIXELFORMAT const* GetDDSPixelFormat(PixelFormat format)
     return nullptr;
 }
 
+uint32_t GetDXGIFormat(PixelFormat format)
+{
+    switch (format)
+    {
+        case DDS_FORMAT_R16G16B16A16_FLOAT: return 10; // DXGI_FORMAT_R16G16B16A16_FLOAT
+        case DDS_FORMAT_R32G32B32A32_FLOAT: return 2;  // DXGI_FORMAT_R32G32B32A32_FLOAT
+    }
+
+    return 0;
+}
+
 bool SaveDDS(char const* path, PixelFormat format, unsigned texelSizeInBytes, unsigned width, unsigned height, void const* data)
 {
     FILE* f = fopen(path, "wb");
@@ -87,4 +115,144 @@ bool SaveDDS(char const* path, PixelFormat format, unsigned texelSizeInBytes, un
     fclose(f);
 
     return true;
-}
\ No newline at end of file
+}
+
+bool SaveDDS(char const* path, PixelFormat format, unsigned texelSizeInBytes, unsigned width, unsigned height,
+             unsigned mipCount, unsigned arraySize, bool cubemap, void const* data)
+{
+    uint32_t dxgiFormat = GetDXGIFormat(format);
+    if (dxgiFormat == 0 || mipCount == 0 || arraySize == 0)
+        return false;
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    fwrite(&DDS_MAGIC, sizeof(DDS_MAGIC), 1, f);
+
+    DDS_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.dwSize              = sizeof(hdr);
+    hdr.dwFlags             = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_PITCH | DDS_HEADER_FLAGS_MIPMAP;
+    hdr.dwHeight            = height;
+    hdr.dwWidth             = width;
+    hdr.dwDepth             = 1;
+    hdr.dwMipMapCount       = mipCount;
+    hdr.dwPitchOrLinearSize = width*texelSizeInBytes;
+    hdr.ddspf.dwSize        = sizeof(DDS_PIXELFORMAT);
+    hdr.ddspf.dwFlags       = DDS_PF_FLAGS_FOURCC;
+    hdr.ddspf.dwFourCC      = DDS_FOURCC_DX10;
+    hdr.dwCaps              = DDS_SURFACE_FLAGS_TEXTURE;
+    if (mipCount > 1)
+        hdr.dwCaps         |= DDS_SURFACE_FLAGS_MIPMAP;
+    if (cubemap)
+    {
+        hdr.dwCaps         |= DDS_SURFACE_FLAGS_CUBEMAP;
+        hdr.dwCaps2         = DDS_CUBEMAP_ALLFACES;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    DDS_HEADER_DXT10 hdr10;
+    memset(&hdr10, 0, sizeof(hdr10));
+    hdr10.dxgiFormat        = dxgiFormat;
+    hdr10.resourceDimension = DDS_RESOURCE_DIMENSION_TEXTURE2D;
+    hdr10.miscFlag          = cubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    hdr10.arraySize         = arraySize;
+    fwrite(&hdr10, sizeof(hdr10), 1, f);
+
+    // subresources, in order: array element (cube face), then mip level
+    size_t size = 0;
+    unsigned numSlices = arraySize*(cubemap ? 6 : 1);
+    for (unsigned mip = 0; mip < mipCount; ++mip)
+    {
+        unsigned w = width  >> mip ? width  >> mip : 1;
+        unsigned h = height >> mip ? height >> mip : 1;
+        size += w*h*texelSizeInBytes;
+    }
+    bool ok = fwrite(data, size, numSlices, f) == numSlices;
+
+    fclose(f);
+
+    return ok;
+}
+
+float* LoadDDS(char const* path, unsigned* width, unsigned* height, unsigned* arraySize)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return nullptr;
+
+    uint32_t magic = 0;
+    DDS_HEADER hdr;
+    if (fread(&magic, sizeof(magic), 1, f) != 1 || magic != DDS_MAGIC ||
+        fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.dwSize != sizeof(hdr) ||
+        !(hdr.ddspf.dwFlags & DDS_PF_FLAGS_FOURCC))
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    bool rgba32f = hdr.ddspf.dwFourCC == DDSPF_RGBA32F.dwFourCC;
+    bool rgba16f = hdr.ddspf.dwFourCC == DDSPF_RGBA16F.dwFourCC;
+    unsigned numSlices = 1;
+
+    if (hdr.ddspf.dwFourCC == DDS_FOURCC_DX10)
+    {
+        DDS_HEADER_DXT10 hdr10;
+        if (fread(&hdr10, sizeof(hdr10), 1, f) != 1 || hdr10.miscFlag != 0 || hdr.dwMipMapCount > 1)
+        {
+            fclose(f);
+            return nullptr;
+        }
+
+        rgba32f = hdr10.dxgiFormat == GetDXGIFormat(DDS_FORMAT_R32G32B32A32_FLOAT);
+        rgba16f = hdr10.dxgiFormat == GetDXGIFormat(DDS_FORMAT_R16G16B16A16_FLOAT);
+        numSlices = hdr10.arraySize ? hdr10.arraySize : 1;
+    }
+
+    // the sizes of the header are checked against the rest of the file before allocating
+    long start = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    fseek(f, start, SEEK_SET);
+
+    uint64_t numTerms64 = (uint64_t)hdr.dwWidth*hdr.dwHeight*4*numSlices;
+    uint64_t termSize = rgba32f ? sizeof(float) : sizeof(uint16_t);
+    if (!(rgba32f || rgba16f) || numTerms64 == 0 || start < 0 || end < start ||
+        numTerms64*termSize > (uint64_t)(end - start))
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    size_t numTerms = (size_t)numTerms64;
+    float* data = new float[numTerms];
+    bool ok = false;
+
+    if (rgba32f)
+    {
+        ok = fread(data, sizeof(float), numTerms, f) == numTerms;
+    }
+    else if (rgba16f)
+    {
+        uint16_t* half = new uint16_t[numTerms];
+        ok = fread(half, sizeof(uint16_t), numTerms, f) == numTerms;
+        for (size_t i = 0; ok && i < numTerms; ++i)
+            data[i] = half_to_float(half[i]);
+        delete[] half;
+    }
+
+    fclose(f);
+
+    if (!ok)
+    {
+        delete[] data;
+        return nullptr;
+    }
+
+    *width  = hdr.dwWidth;
+    *height = hdr.dwHeight;
+    if (arraySize)
+        *arraySize = numSlices;
+    return data;
+}
@@ -7,3 +7,12 @@ enum PixelFormat
 };
 
 bool SaveDDS(char const* path, PixelFormat format, unsigned texelSizeInBytes, unsigned width, unsigned height, void const* data);
+
+// mipmapped 2D texture arrays and cube map arrays (DX10 header)
+// data holds all subresources, array element (cube face) major, then mip levels
+bool SaveDDS(char const* path, PixelFormat format, unsigned texelSizeInBytes, unsigned width, unsigned height,
+             unsigned mipCount, unsigned arraySize, bool cubemap, void const* data);
+
+// loads a 2D RGBA16F/RGBA32F texture, converted to float RGBA (caller deletes[] the result)
+// 2D texture arrays (DX10 header, one mip level) are loaded slice after slice, with their size in arraySize
+float* LoadDDS(char const* path, unsigned* width, unsigned* height, unsigned* arraySize = nullptr);
@@ -0,0 +1,255 @@
+#ifndef _ENVMAP_
+#define _ENVMAP_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <vector>
+
+#include "ltc_table.h"
+#include "parallel.h"
+
+// cube map with a mip chain, D3D face order (+X, -X, +Y, -Y, +Z, -Z)
+struct Cubemap
+{
+    int size;
+    std::vector< std::vector<vec4> > levels; // [mip][(face*s + y)*s + x]
+
+    Cubemap(int size_ = 0, int mips = 1) : size(size_), levels(mips)
+    {
+        for (int m = 0; m < mips; ++m)
+            levels[m].resize(6*levelSize(m)*levelSize(m));
+    }
+
+    int mips() const
+    {
+        return (int)levels.size();
+    }
+
+    int levelSize(int mip) const
+    {
+        return std::max<int>(size >> mip, 1);
+    }
+
+    vec4& texel(int mip, int face, int x, int y)
+    {
+        int s = levelSize(mip);
+        return levels[mip][(face*s + y)*s + x];
+    }
+
+    const vec4& texel(int mip, int face, int x, int y) const
+    {
+        int s = levelSize(mip);
+        return levels[mip][(face*s + y)*s + x];
+    }
+};
+
+// direction through the center of a texel
+vec3 cubeDirection(int face, int x, int y, int size)
+{
+    float u = 2.0f*(x + 0.5f)/size - 1.0f;
+    float v = 2.0f*(y + 0.5f)/size - 1.0f;
+
+    vec3 dir;
+    switch (face)
+    {
+        case 0:  dir = vec3( 1, -v, -u); break;
+        case 1:  dir = vec3(-1, -v,  u); break;
+        case 2:  dir = vec3( u,  1,  v); break;
+        case 3:  dir = vec3( u, -1, -v); break;
+        case 4:  dir = vec3( u, -v,  1); break;
+        default: dir = vec3(-u, -v, -1); break;
+    }
+    return normalize(dir);
+}
+
+// face and [0, 1] face coordinates of a direction
+void cubeFace(const vec3& dir, int& face, float& s, float& t)
+{
+    vec3 a = abs(dir);
+    float u, v, ma;
+
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = dir.x > 0.0f ? 0 : 1;
+        ma = a.x;
+        u = dir.x > 0.0f ? -dir.z : dir.z;
+        v = -dir.y;
+    }
+    else if (a.y >= a.z)
+    {
+        face = dir.y > 0.0f ? 2 : 3;
+        ma = a.y;
+        u = dir.x;
+        v = dir.y > 0.0f ? dir.z : -dir.z;
+    }
+    else
+    {
+        face = dir.z > 0.0f ? 4 : 5;
+        ma = a.z;
+        u = dir.z > 0.0f ? dir.x : -dir.x;
+        v = -dir.y;
+    }
+
+    s = 0.5f*(u/ma + 1.0f);
+    t = 0.5f*(v/ma + 1.0f);
+}
+
+// bilinear lookup in one mip level (clamped at the face edges)
+vec4 sampleCube(const Cubemap& cube, const vec3& dir, int mip)
+{
+    int face;
+    float s, t;
+    cubeFace(dir, face, s, t);
+
+    int size = cube.levelSize(mip);
+    float x = glm::clamp(s*size - 0.5f, 0.0f, size - 1.0f);
+    float y = glm::clamp(t*size - 0.5f, 0.0f, size - 1.0f);
+    int x0 = std::min<int>((int)x, std::max<int>(size - 2, 0));
+    int y0 = std::min<int>((int)y, std::max<int>(size - 2, 0));
+    int x1 = std::min<int>(x0 + 1, size - 1);
+    int y1 = std::min<int>(y0 + 1, size - 1);
+    float fx = x - x0;
+    float fy = y - y0;
+
+    return (cube.texel(mip, face, x0, y0)*(1.0f - fx) + cube.texel(mip, face, x1, y0)*fx)*(1.0f - fy) +
+           (cube.texel(mip, face, x0, y1)*(1.0f - fx) + cube.texel(mip, face, x1, y1)*fx)*fy;
+}
+
+// trilinear lookup
+vec4 sampleCubeLod(const Cubemap& cube, const vec3& dir, float lod)
+{
+    lod = glm::clamp(lod, 0.0f, cube.mips() - 1.0f);
+    int m0 = (int)lod;
+    int m1 = std::min<int>(m0 + 1, cube.mips() - 1);
+    float f = lod - m0;
+
+    return sampleCube(cube, dir, m0)*(1.0f - f) + sampleCube(cube, dir, m1)*f;
+}
+
+// resample a latitude-longitude map (+Y up) into the top level of a cube map
+void cubeFromLatLong(Cubemap& cube, const vec4* latlong, int width, int height)
+{
+    const float pi = 3.14159265f;
+
+    parallel_for(6, [&](int face)
+    {
+        for (int y = 0; y < cube.size; ++y)
+        for (int x = 0; x < cube.size; ++x)
+        {
+            vec3 dir = cubeDirection(face, x, y, cube.size);
+
+            float u = 0.5f + atan2f(dir.x, -dir.z)/(2.0f*pi);
+            float v = acosf(glm::clamp(dir.y, -1.0f, 1.0f))/pi;
+
+            float px = u*width - 0.5f;
+            float py = glm::clamp(v*height - 0.5f, 0.0f, height - 1.0f);
+            int x0 = (int)floorf(px);
+            int y0 = std::min<int>((int)py, height - 2);
+            float fx = px - x0;
+            float fy = py - y0;
+            int x1 = (x0 + 1 + width) % width;
+            x0 = (x0 + width) % width;
+
+            cube.texel(0, face, x, y) =
+                (latlong[x0 + y0*width]*(1.0f - fx) + latlong[x1 + y0*width]*fx)*(1.0f - fy) +
+                (latlong[x0 + (y0 + 1)*width]*(1.0f - fx) + latlong[x1 + (y0 + 1)*width]*fx)*fy;
+        }
+    });
+}
+
+// 2x2 box filtered mip chain
+void buildCubeMips(Cubemap& cube)
+{
+    for (int mip = 1; mip < cube.mips(); ++mip)
+    {
+        int size = cube.levelSize(mip);
+        int prev = cube.levelSize(mip - 1);
+
+        parallel_for(6, [&](int face)
+        {
+            for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+            {
+                int x0 = std::min<int>(2*x, prev - 1), x1 = std::min<int>(2*x + 1, prev - 1);
+                int y0 = std::min<int>(2*y, prev - 1), y1 = std::min<int>(2*y + 1, prev - 1);
+
+                cube.texel(mip, face, x, y) = 0.25f*(
+                    cube.texel(mip - 1, face, x0, y0) + cube.texel(mip - 1, face, x1, y0) +
+                    cube.texel(mip - 1, face, x0, y1) + cube.texel(mip - 1, face, x1, y1));
+            }
+        });
+    }
+}
+
+// prefilter a radiance cube map with the fitted LTC lobes
+// * mip m holds roughness m/(mips - 1), with N = V = R as in the usual split-sum approximation
+// * the lobe at normal incidence is sampled exactly through its LTC (cosine samples transformed by M),
+//   with filtered importance sampling: each sample reads the source mip matching its solid angle
+// * one task per (face, mip), run in parallel
+void prefilterCubeLTC(const Cubemap& src, const LTCTable& table, Cubemap& dst, int sqrtSamples)
+{
+    const float pi = 3.14159265f;
+    const int numSamples = sqrtSamples*sqrtSamples;
+    const int mips = dst.mips();
+
+    // solid angle of a source texel at the top level
+    const float texelSolidAngle = 4.0f*pi/(6.0f*src.size*src.size);
+
+    parallel_for(6*mips, [&](int task)
+    {
+        int face = task % 6;
+        int mip  = task / 6;
+        int size = dst.levelSize(mip);
+
+        float roughness = mips > 1 ? mip/float(mips - 1) : 0.0f;
+
+        // lobe at normal incidence, in its local frame
+        mat3 M = ltcInverse(table.Minv(roughness, 1.0f));
+        float detM = fabsf(ltcDeterminant(M));
+
+        for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            vec3 R = cubeDirection(face, x, y, size);
+
+            if (mip == 0)
+            {
+                dst.texel(mip, face, x, y) = sampleCube(src, R, 0);
+                continue;
+            }
+
+            // shading frame around R
+            vec3 T1 = normalize(fabsf(R.y) < 0.999f ? cross(vec3(0, 1, 0), R) : cross(vec3(1, 0, 0), R));
+            vec3 T2 = cross(R, T1);
+
+            vec4 sum = vec4(0, 0, 0, 0);
+            for (int j = 0; j < sqrtSamples; ++j)
+            for (int i = 0; i < sqrtSamples; ++i)
+            {
+                const float U1 = (i + 0.5f)/sqrtSamples;
+                const float U2 = (j + 0.5f)/sqrtSamples;
+
+                // cosine sample, transformed into the LTC lobe
+                const float ct = sqrtf(1.0f - U1);
+                const float st = sqrtf(U1);
+                const float phi = 2.0f*pi*U2;
+                vec3 Lo = vec3(st*cosf(phi), st*sinf(phi), ct);
+                vec3 L_ = M*Lo;
+                float l = length(L_);
+                vec3 L = L_/l;
+
+                // pdf of the LTC distribution
+                float pdf = ct/pi * l*l*l/detM;
+
+                float lod = 0.5f*log2f(1.0f/(numSamples*pdf*texelSolidAngle));
+
+                sum += sampleCubeLod(src, T1*L.x + T2*L.y + R*L.z, lod);
+            }
+
+            dst.texel(mip, face, x, y) = sum/float(numSamples);
+        }
+    });
+}
+
+#endif
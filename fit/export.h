@@ -2,9 +2,9 @@
 #define _EXPORT_
 
 // export data to C
-void writeTabC(mat3 * tab, vec2 * tabMagFresnel, int N)
+void writeTabC(mat3 * tab, vec2 * tabMagFresnel, int N, const string& dir = "results")
 {
-    ofstream file("results/ltc.inc");
+    ofstream file((dir + "/ltc.inc").c_str());
 
     file << std::fixed;
     file << std::setprecision(6);
@@ -29,7 +29,7 @@ void writeTabC(mat3 * tab, vec2 * tabMagFresnel, int N)
     for (int t = 0; t < N; ++t)
     for (int a = 0; a < N; ++a)
     {
-        mat3 Minv = glm::inverse(tab[a + t*N]);
+        mat3 Minv = ltcInverse(tab[a + t*N]);
 
         file << "{";
         file << Minv[0][0] << ", " << Minv[0][1] << ", " << Minv[0][2] << ", ";
@@ -56,9 +56,9 @@ void writeTabC(mat3 * tab, vec2 * tabMagFresnel, int N)
 }
 
 // export data to MATLAB
-void writeTabMatlab(mat3 * tab, vec2 * tabMagFresnel, int N)
+void writeTabMatlab(mat3 * tab, vec2 * tabMagFresnel, int N, const string& dir = "results")
 {
-    ofstream file("results/ltc.mat");
+    ofstream file((dir + "/ltc.mat").c_str());
 
     file << "# name: tabMagnitude" << endl;
     file << "# type: matrix" << endl;
@@ -94,6 +94,80 @@ void writeTabMatlab(mat3 * tab, vec2 * tabMagFresnel, int N)
     file.close();
 }
 
+// export data to NumPy: one .npy file per array, written in one block after its header,
+// so that the arrays can be memory mapped with np.load(path, mmap_mode='r')
+// descr is the NumPy type of the elements, little endian like the targets of the fit ('<f4', '<i4')
+void writeNpy(const string& path, const char* descr, const vector<int>& shape, const void* data, size_t bytes)
+{
+    string header = string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (";
+    for (size_t i = 0; i < shape.size(); ++i)
+        header += to_string(shape[i]) + ", ";
+    header += "), }";
+
+    // version 1.0: magic string, version, header length, header padded with spaces and ended by a newline,
+    // so that the data is 64-byte aligned
+    header.append(63 - (10 + header.size())%64, ' ');
+    header += '\n';
+
+    const char magic[8] = { '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+    const unsigned char length[2] = { (unsigned char)(header.size() & 0xff), (unsigned char)(header.size() >> 8) };
+
+    ofstream file(path.c_str(), ios::binary);
+    file.write(magic, 8);
+    file.write((const char*)length, 2);
+    file.write(header.data(), header.size());
+    file.write((const char*)data, bytes);
+    file.close();
+}
+
+// export the raw tables and the statistics of the fit to NumPy, as <prefix>_<array>.npy
+// * M and Minv are [..., t, a, row, column], magnitude, fresnel, error, iterations and evaluations [..., t, a],
+//   with a leading dimension for the slices of texture arrays (numSlices > 1)
+// * sphere is [j, i], as in genSphereTab()
+// * iterations and evaluations are -1 for the cells fitted by another process (farm)
+void writeTabNpy(
+    const mat3* tab, const vec2* tabMagFresnel, const float* tabSphere,
+    const float* tabError, const int* tabIterations, const int* tabEvaluations,
+    int N, int numSlices, const string& prefix)
+{
+    const int count = std::max(numSlices, 1)*N*N;
+
+    vector<int> shape;
+    if (numSlices > 1)
+        shape.push_back(numSlices);
+    shape.push_back(N);
+    shape.push_back(N);
+
+    vector<int> shapeMatrix = shape;
+    shapeMatrix.push_back(3);
+    shapeMatrix.push_back(3);
+
+    // glm matrices are column major
+    vector<float> M(9*count), Minv(9*count), magnitude(count), fresnel(count);
+    for (int i = 0; i < count; ++i)
+    {
+        mat3 inv = ltcInverse(tab[i]);
+        for (int row = 0; row < 3; ++row)
+        for (int column = 0; column < 3; ++column)
+        {
+            M[9*i + 3*row + column] = tab[i][column][row];
+            Minv[9*i + 3*row + column] = inv[column][row];
+        }
+
+        magnitude[i] = tabMagFresnel[i][0];
+        fresnel[i] = tabMagFresnel[i][1];
+    }
+
+    writeNpy(prefix + "_M.npy", "<f4", shapeMatrix, &M[0], M.size()*sizeof(float));
+    writeNpy(prefix + "_Minv.npy", "<f4", shapeMatrix, &Minv[0], Minv.size()*sizeof(float));
+    writeNpy(prefix + "_magnitude.npy", "<f4", shape, &magnitude[0], count*sizeof(float));
+    writeNpy(prefix + "_fresnel.npy", "<f4", shape, &fresnel[0], count*sizeof(float));
+    writeNpy(prefix + "_sphere.npy", "<f4", vector<int>({ N, N }), tabSphere, N*N*sizeof(float));
+    writeNpy(prefix + "_error.npy", "<f4", shape, tabError, count*sizeof(float));
+    writeNpy(prefix + "_iterations.npy", "<i4", shape, tabIterations, count*sizeof(int));
+    writeNpy(prefix + "_evaluations.npy", "<i4", shape, tabEvaluations, count*sizeof(int));
+}
+
 // export data to DDS
 #include "dds.h"
 #include "float_to_half.h"
@@ -112,16 +186,31 @@ void writeDDS(const char* path, float* data, int N)
     delete[] half;
 }
 
-void writeDDS(vec4* data1, vec4* data2, int N)
+// 2D texture array of N*N slices
+void writeDDS(const char* path, float* data, int N, int arraySize)
+{
+    int numTerms = N*N*4*arraySize;
+
+    uint16_t* half = new uint16_t[numTerms];
+
+    for (int i = 0; i < numTerms; ++i)
+        half[i] = float_to_half_fast(data[i]);
+
+    SaveDDS(path, DDS_FORMAT_R16G16B16A16_FLOAT, sizeof(uint16_t)*4, N, N, 1, arraySize, false, (void const*)half);
+
+    delete[] half;
+}
+
+void writeDDS(vec4* data1, vec4* data2, int N, const string& dir = "results")
 {
-    writeDDS("results/ltc_1.dds", &data1[0][0], N);
-    writeDDS("results/ltc_2.dds", &data2[0][0], N);
+    writeDDS((dir + "/ltc_1.dds").c_str(), &data1[0][0], N);
+    writeDDS((dir + "/ltc_2.dds").c_str(), &data2[0][0], N);
 }
 
 // export data to Javascript
-void writeJS(vec4* data1, vec4* data2, int N)
+void writeJS(vec4* data1, vec4* data2, int N, const string& dir = "results")
 {
-    ofstream file("results/ltc.js");
+    ofstream file((dir + "/ltc.js").c_str());
 
     file << "var g_ltc_1 = [" << endl;
 
@@ -0,0 +1,650 @@
+#ifndef _FARM_
+#define _FARM_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "LTC.h"
+#include "brdf.h"
+
+// multi-process fit farm: a coordinator hands out leases of table cells to local worker processes
+//
+// * the fit of a cell is warm-started from a neighbour, which fixes the lease structure:
+//   - the row t = 0 is fitted from alpha = 1 down to 0, each cell seeded with the previous one
+//   - the column of an alpha (t = 1..N-1) is seeded with its cell at t = 0 and fitted in order
+//   so each BRDF has one row lease, then one column lease per alpha as soon as its row cell is done
+// * workers stream one result per cell and heartbeats from a separate thread
+// * a worker that disconnects or misses its heartbeats is dropped (and killed if it is ours),
+//   and its lease is re-issued from the first missing cell, seeded with the last completed one
+// * completed cells are appended to a journal, so that a coordinator crash can be resumed
+// * messages are fixed-size structs over a local SOCK_SEQPACKET socket, which keeps message boundaries
+//
+// since the seeds are the same, the merged tables are identical to the ones of the sequential fit
+
+enum FarmMessageType
+{
+    FARM_REQUEST,   // worker -> coordinator: asks for a lease
+    FARM_LEASE,     // coordinator -> worker
+    FARM_WAIT,      // coordinator -> worker: nothing available yet, ask again later
+    FARM_EXIT,      // coordinator -> worker: all done
+    FARM_RESULT,    // worker -> coordinator: one fitted cell
+    FARM_DONE,      // worker -> coordinator: lease complete
+    FARM_HEARTBEAT  // worker -> coordinator
+};
+
+struct FarmLease
+{
+    int32_t id;
+    int32_t brdf;
+    int32_t column; // 0: row t = 0 from alpha a down to 0, 1: column of alpha a from t up to N - 1
+    int32_t a, t;
+    int32_t N;
+    float seed[3];  // (m11, m22, m13) of the fit the first cell starts from
+};
+
+struct FarmCell
+{
+    int32_t brdf;
+    int32_t a, t;
+    float M[9];
+    float magnitude, fresnel;
+    float params[3]; // fitted (m11, m22, m13), seed of the next cell
+};
+
+struct FarmMessage
+{
+    int32_t type;
+    FarmLease lease;
+    FarmCell cell;
+};
+
+struct FarmOptions
+{
+    int workers;
+    int kills;            // number of workers killed on purpose during the fit
+    float timeout;        // seconds without heartbeat before a worker is dropped
+    bool resume;          // start from the cells in the journal
+    string socketPath;
+    string journalPath;
+
+    FarmOptions() : workers(4), kills(0), timeout(5.0f), resume(false),
+        socketPath("/tmp/fitLTC.sock"), journalPath("results/farm.journal")
+    {
+    }
+};
+
+// fitted tables of one BRDF
+struct FarmTables
+{
+    vector<mat3> tab;
+    vector<vec2> tabMagFresnel;
+};
+
+static bool farmSend(int fd, const FarmMessage& msg)
+{
+    return send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) == (ssize_t)sizeof(msg);
+}
+
+static bool farmRecv(int fd, FarmMessage& msg)
+{
+    return recv(fd, &msg, sizeof(msg), 0) == (ssize_t)sizeof(msg);
+}
+
+static FarmMessage farmMessage(int type)
+{
+    FarmMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    return msg;
+}
+
+static sockaddr_un farmAddress(const string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+static FarmCell farmCell(const LTC& ltc, int brdf, int a, int t)
+{
+    FarmCell cell;
+    cell.brdf = brdf;
+    cell.a = a;
+    cell.t = t;
+    for (int k = 0; k < 9; ++k)
+        cell.M[k] = ltc.M[k/3][k%3];
+
+    // kill useless coefs in matrix, as fitTab() does
+    cell.M[0*3 + 1] = 0;
+    cell.M[1*3 + 0] = 0;
+    cell.M[2*3 + 1] = 0;
+    cell.M[1*3 + 2] = 0;
+
+    cell.magnitude = ltc.magnitude;
+    cell.fresnel = ltc.fresnel;
+    cell.params[0] = ltc.m11;
+    cell.params[1] = ltc.m22;
+    cell.params[2] = ltc.m13;
+    return cell;
+}
+
+// worker process: fits leases until the coordinator is done or goes away
+// fitCell(ltc, brdf, a, t, N) fits one cell starting from the state of ltc, as in fitTab()
+template<typename FIT>
+int runFarmWorker(const string& socketPath, const vector<const Brdf*>& brdfs, int N, FIT fitCell)
+{
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un addr = farmAddress(socketPath);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        cout << "worker: could not connect to " << socketPath << endl;
+        return 1;
+    }
+
+    // heartbeats from their own thread, so that long leases are not mistaken for a dead worker
+    // (each send is one atomic message on a SOCK_SEQPACKET socket)
+    atomic<bool> running(true);
+    thread heartbeat([&]()
+    {
+        FarmMessage msg = farmMessage(FARM_HEARTBEAT);
+        while (running)
+        {
+            if (!farmSend(fd, msg))
+                break;
+            this_thread::sleep_for(chrono::milliseconds(250));
+        }
+    });
+
+    bool ok = true;
+    while (ok)
+    {
+        FarmMessage msg = farmMessage(FARM_REQUEST);
+        if (!farmSend(fd, msg) || !farmRecv(fd, msg) || msg.type == FARM_EXIT)
+            break;
+
+        if (msg.type == FARM_WAIT)
+        {
+            this_thread::sleep_for(chrono::milliseconds(50));
+            continue;
+        }
+
+        const FarmLease lease = msg.lease;
+        if (lease.N != N || lease.brdf < 0 || lease.brdf >= (int)brdfs.size())
+        {
+            cout << "worker: lease " << lease.id << " does not match this worker's setup" << endl;
+            break;
+        }
+        const Brdf& brdf = *brdfs[lease.brdf];
+
+        LTC ltc;
+        ltc.m11 = lease.seed[0];
+        ltc.m22 = lease.seed[1];
+        ltc.m13 = lease.seed[2];
+
+        // the next cell of a row or column starts from the state left by the previous one
+        int begin = lease.column ? lease.t : lease.a;
+        int end   = lease.column ? N : -1;
+        int step  = lease.column ? 1 : -1;
+
+        for (int i = begin; ok && i != end; i += step)
+        {
+            int a = lease.column ? lease.a : i;
+            int t = lease.column ? i : 0;
+            fitCell(ltc, brdf, a, t, N);
+
+            FarmMessage result = farmMessage(FARM_RESULT);
+            result.lease = lease;
+            result.cell = farmCell(ltc, lease.brdf, a, t);
+            ok = farmSend(fd, result);
+        }
+
+        FarmMessage done = farmMessage(FARM_DONE);
+        done.lease = lease;
+        ok = ok && farmSend(fd, done);
+    }
+
+    running = false;
+    shutdown(fd, SHUT_RDWR);
+    heartbeat.join();
+    close(fd);
+    return 0;
+}
+
+struct FarmCoordinator
+{
+    struct Worker
+    {
+        int fd;
+        pid_t pid;          // 0 for external workers
+        double lastSeen;
+        bool busy;
+        FarmLease lease;
+    };
+
+    struct State
+    {
+        vector<FarmCell> cells;
+        vector<char> done;
+        bool rowLeased;
+        vector<char> columnLeased;
+    };
+
+    int N;
+    FarmOptions options;
+    vector<State> states;
+    vector<Worker> workers;
+    int listenFd;
+    FILE* journal;
+    int numDone, numCells, nextId;
+    chrono::high_resolution_clock::time_point start;
+
+    FarmCoordinator(int numBrdfs, int N_, const FarmOptions& options_) :
+        N(N_), options(options_), states(numBrdfs), listenFd(-1), journal(nullptr),
+        numDone(0), numCells(numBrdfs*N_*N_), nextId(0)
+    {
+        for (size_t b = 0; b < states.size(); ++b)
+        {
+            states[b].cells.resize(N*N);
+            states[b].done.assign(N*N, 0);
+            states[b].rowLeased = false;
+            states[b].columnLeased.assign(N, 0);
+        }
+        start = chrono::high_resolution_clock::now();
+    }
+
+    double now() const
+    {
+        return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+    bool isDone(int b, int a, int t) const
+    {
+        return states[b].done[a + t*N] != 0;
+    }
+
+    const FarmCell& cell(int b, int a, int t) const
+    {
+        return states[b].cells[a + t*N];
+    }
+
+    void record(const FarmCell& c, bool write)
+    {
+        if (c.brdf < 0 || c.brdf >= (int)states.size() || c.a < 0 || c.a >= N || c.t < 0 || c.t >= N)
+            return;
+
+        // duplicates come from leases re-issued while the results of the old worker were in flight
+        if (isDone(c.brdf, c.a, c.t))
+            return;
+
+        states[c.brdf].cells[c.a + c.t*N] = c;
+        states[c.brdf].done[c.a + c.t*N] = 1;
+        ++numDone;
+
+        if (write && journal)
+        {
+            fwrite(&c, sizeof(c), 1, journal);
+            fflush(journal);
+        }
+    }
+
+    // journal: header (magic, N, number of BRDFs) followed by completed cells
+    bool openJournal()
+    {
+        const int32_t header[3] = { 0x4643544c /* LTCF */, N, (int32_t)states.size() };
+
+        if (options.resume)
+        {
+            FILE* f = fopen(options.journalPath.c_str(), "rb");
+            int32_t h[3];
+            if (f && fread(h, sizeof(h), 1, f) == 1 && memcmp(h, header, sizeof(h)) == 0)
+            {
+                FarmCell c;
+                while (fread(&c, sizeof(c), 1, f) == 1)
+                    record(c, false);
+                cout << "resuming with " << numDone << " cells from " << options.journalPath << endl;
+            }
+            if (f)
+                fclose(f);
+        }
+
+        journal = fopen(options.journalPath.c_str(), "wb");
+        if (!journal)
+            return false;
+
+        // rewrite what was resumed, so that the journal stays consistent with the state
+        fwrite(header, sizeof(header), 1, journal);
+        for (size_t b = 0; b < states.size(); ++b)
+        for (int i = 0; i < N*N; ++i)
+            if (states[b].done[i])
+                fwrite(&states[b].cells[i], sizeof(FarmCell), 1, journal);
+        fflush(journal);
+        return true;
+    }
+
+    // next lease, rows first since they gate the columns
+    // returns FARM_LEASE, FARM_WAIT, or FARM_EXIT when everything is done
+    int nextLease(FarmLease& lease)
+    {
+        if (numDone == numCells)
+            return FARM_EXIT;
+
+        memset(&lease, 0, sizeof(lease));
+        lease.N = N;
+
+        for (int b = 0; b < (int)states.size(); ++b)
+        {
+            State& s = states[b];
+            if (s.rowLeased)
+                continue;
+
+            // the row is fitted from alpha = 1 down, so the first missing cell is the highest one
+            int a = N - 1;
+            while (a >= 0 && isDone(b, a, 0))
+                --a;
+            if (a < 0)
+                continue;
+
+            lease.brdf = b;
+            lease.column = 0;
+            lease.a = a;
+            lease.t = 0;
+            if (a == N - 1)
+            {
+                lease.seed[0] = 1.0f;
+                lease.seed[1] = 1.0f;
+            }
+            else
+            {
+                lease.seed[0] = cell(b, a + 1, 0).params[0];
+                lease.seed[1] = cell(b, a + 1, 0).params[1];
+            }
+            lease.seed[2] = 0.0f;
+            lease.id = nextId++;
+
+            s.rowLeased = true;
+            return FARM_LEASE;
+        }
+
+        for (int b = 0; b < (int)states.size(); ++b)
+        for (int a = N - 1; a >= 0; --a)
+        {
+            State& s = states[b];
+            if (s.columnLeased[a] || !isDone(b, a, 0))
+                continue;
+
+            int t = 1;
+            while (t < N && isDone(b, a, t))
+                ++t;
+            if (t == N)
+                continue;
+
+            const FarmCell& prev = cell(b, a, t - 1);
+            lease.brdf = b;
+            lease.column = 1;
+            lease.a = a;
+            lease.t = t;
+            for (int k = 0; k < 3; ++k)
+                lease.seed[k] = prev.params[k];
+            lease.id = nextId++;
+
+            s.columnLeased[a] = 1;
+            return FARM_LEASE;
+        }
+
+        return FARM_WAIT;
+    }
+
+    void releaseLease(const FarmLease& lease)
+    {
+        if (lease.column)
+            states[lease.brdf].columnLeased[lease.a] = 0;
+        else
+            states[lease.brdf].rowLeased = false;
+    }
+
+    void dropWorker(size_t w, const char* reason)
+    {
+        Worker& worker = workers[w];
+        cout << "worker " << worker.pid << " " << reason;
+
+        if (worker.busy)
+        {
+            // the lease becomes available again, from its first missing cell
+            releaseLease(worker.lease);
+            cout << ", lease " << worker.lease.id << " re-issued";
+        }
+        cout << endl;
+
+        if (worker.pid > 0)
+            kill(worker.pid, SIGKILL);
+        close(worker.fd);
+        workers.erase(workers.begin() + w);
+    }
+
+    // spawns a local worker process; the child shares nothing with the coordinator but the socket path
+    template<typename FIT>
+    pid_t spawnWorker(const vector<const Brdf*>& brdfs, FIT fitCell)
+    {
+        cout.flush();
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(listenFd);
+            for (size_t w = 0; w < workers.size(); ++w)
+                close(workers[w].fd);
+            if (journal)
+                close(fileno(journal));
+
+            _exit(runFarmWorker(options.socketPath, brdfs, N, fitCell));
+        }
+        return pid;
+    }
+
+    void handle(size_t w, const FarmMessage& msg)
+    {
+        Worker& worker = workers[w];
+        worker.lastSeen = now();
+
+        switch (msg.type)
+        {
+            case FARM_REQUEST:
+            {
+                FarmMessage reply = farmMessage(FARM_WAIT);
+                reply.type = nextLease(reply.lease);
+                if (reply.type == FARM_LEASE)
+                {
+                    worker.busy = true;
+                    worker.lease = reply.lease;
+                }
+                farmSend(worker.fd, reply);
+                break;
+            }
+
+            case FARM_RESULT:
+                if (worker.busy && worker.lease.id == msg.lease.id)
+                {
+                    int before = numDone;
+                    record(msg.cell, true);
+                    if (numDone != before && (numDone*20)/numCells != (before*20)/numCells)
+                        cout << "progress: " << (100*numDone)/numCells << "% (" << now() << " s)" << endl;
+                }
+                break;
+
+            case FARM_DONE:
+                if (worker.busy && worker.lease.id == msg.lease.id)
+                {
+                    releaseLease(worker.lease);
+                    worker.busy = false;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // injected failures: kills a busy local worker each time another 1/(kills + 1) of the cells is done
+    void injectKills(int& killed)
+    {
+        if (killed >= options.kills || numDone < (killed + 1)*numCells/(options.kills + 1))
+            return;
+
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            if (workers[w].busy && workers[w].pid > 0)
+            {
+                cout << "killing worker " << workers[w].pid << " (lease " << workers[w].lease.id << ")" << endl;
+                kill(workers[w].pid, SIGKILL);
+                ++killed;
+                return;
+            }
+        }
+    }
+
+    template<typename FIT>
+    bool run(const vector<const Brdf*>& brdfs, FIT fitCell, vector<FarmTables>& tables)
+    {
+        if (!openJournal())
+        {
+            cout << "could not open " << options.journalPath << endl;
+            return false;
+        }
+
+        listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        sockaddr_un addr = farmAddress(options.socketPath);
+        unlink(options.socketPath.c_str());
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0)
+        {
+            cout << "could not listen on " << options.socketPath << endl;
+            return false;
+        }
+
+        int spawned = 0;
+        int killed = 0;
+        vector<pid_t> children;
+
+        while (numDone < numCells)
+        {
+            // keep the requested number of local workers alive (children are removed once reaped)
+            for (int local = (int)children.size(); local < options.workers; ++local)
+            {
+                children.push_back(spawnWorker(brdfs, fitCell));
+                ++spawned;
+            }
+
+            vector<pollfd> fds(1 + workers.size());
+            fds[0].fd = listenFd;
+            fds[0].events = POLLIN;
+            for (size_t w = 0; w < workers.size(); ++w)
+            {
+                fds[1 + w].fd = workers[w].fd;
+                fds[1 + w].events = POLLIN;
+            }
+
+            poll(&fds[0], fds.size(), 100);
+
+            // handle the existing workers before accepting new ones, so that the indices match
+            for (size_t w = workers.size(); w-- > 0; )
+            {
+                if (!(fds[1 + w].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+
+                FarmMessage msg;
+                if (farmRecv(workers[w].fd, msg))
+                    handle(w, msg);
+                else
+                    dropWorker(w, "disconnected");
+            }
+
+            if (fds[0].revents & POLLIN)
+            {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0)
+                {
+                    ucred cred;
+                    socklen_t len = sizeof(cred);
+                    pid_t pid = getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 ? cred.pid : 0;
+
+                    // only our children are killed on failure, external workers are just dropped
+                    bool child = false;
+                    for (size_t c = 0; c < children.size(); ++c)
+                        child = child || children[c] == pid;
+
+                    Worker worker = { fd, child ? pid : 0, now(), false, FarmLease() };
+                    workers.push_back(worker);
+                }
+            }
+
+            for (size_t w = workers.size(); w-- > 0; )
+                if (now() - workers[w].lastSeen > options.timeout)
+                    dropWorker(w, "timed out");
+
+            // reap dead children
+            pid_t pid;
+            while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0)
+            {
+                for (size_t c = 0; c < children.size(); ++c)
+                    if (children[c] == pid)
+                        children.erase(children.begin() + c--);
+            }
+
+            injectKills(killed);
+        }
+
+        // let the workers exit, then wait for them
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            farmSend(workers[w].fd, farmMessage(FARM_EXIT));
+            close(workers[w].fd);
+        }
+        workers.clear();
+        for (size_t c = 0; c < children.size(); ++c)
+            waitpid(children[c], nullptr, 0);
+
+        close(listenFd);
+        unlink(options.socketPath.c_str());
+        fclose(journal);
+
+        cout << "farm: " << numCells << " cells in " << now() << " s, ";
+        cout << spawned << " workers spawned, " << killed << " killed" << endl;
+
+        // merge
+        tables.resize(states.size());
+        for (size_t b = 0; b < states.size(); ++b)
+        {
+            tables[b].tab.resize(N*N);
+            tables[b].tabMagFresnel.resize(N*N);
+            for (int i = 0; i < N*N; ++i)
+            {
+                const FarmCell& c = states[b].cells[i];
+                for (int k = 0; k < 9; ++k)
+                    tables[b].tab[i][k/3][k%3] = c.M[k];
+                tables[b].tabMagFresnel[i] = vec2(c.magnitude, c.fresnel);
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif
@@ -4,45 +4,99 @@
 using namespace glm;
 
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <fstream>
+#include <functional>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include "LTC.h"
 #include "brdf.h"
 #include "brdf_ggx.h"
 #include "brdf_beckmann.h"
 #include "brdf_disneyDiffuse.h"
+#include "brdf_combined.h"
+#include "btdf_ggx.h"
+#include "phase_hg.h"
 
+#include "grid_refine.h"
+#include "ltc_matrix.h"
 #include "nelder_mead.h"
+#include "parallel.h"
 
 #include "export.h"
+#include "import.h"
 #include "plot.h"
+#include "refit_server.h"
+
+#ifndef _WIN32
+#include "brdf_plugin_host.h"
+#include "farm.h"
+#endif
 
 // size of precomputed table (theta, alpha)
 const int N = 64;
-// number of samples used to compute the error during fitting
+// number of eta slices of the transmission tables
+const int N_ETA = 8;
+// number of specular fraction slices of the combined diffuse and specular tables
+const int N_MIX = 8;
+// number of samples used to compute the error during fitting (default of fitLTC --samples)
 const int Nsample = 32;
+// NelderMead budget of a cell seeded from an existing table (fitLTC --warm-start)
+const int WARM_START_ITERS = 30;
+const float WARM_START_DELTA = 0.01f;
+// global refinement (fitLTC --refine): LM iterations, and finite difference steps on (log(m11), log(m22), m13)
+const int REFINE_ITERS = 4;
+const float REFINE_STEP[3] = { 0.05f, 0.05f, 0.02f };
 // minimal roughness (avoid singularities)
 const float MIN_ALPHA = 0.00001f;
 
 const float pi = acosf(-1.0f);
 
+// evaluation of the error: samples of computeError() and computeAvgTerms() in each dimension (fitLTC --samples),
+// and control variates in the fits (fitLTC --control-variates)
+// passed down to the fits of the cells rather than global, so that the studies can change them for one fit
+struct ErrorSettings
+{
+    int samples;
+    bool controlVariates;
+
+    ErrorSettings(const int samples_ = Nsample, const bool controlVariates_ = false) :
+        samples(samples_), controlVariates(controlVariates_)
+    {
+    }
+};
+
 // computes
 // * the norm (albedo) of the BRDF
 // * the average Schlick Fresnel value
 // * the average direction of the BRDF
-void computeAvgTerms(const Brdf& brdf, const vec3& V, const float alpha,
+void computeAvgTerms(const Brdf& brdf, const vec3& V, const float alpha, const ErrorSettings& settings,
     float& norm, float& fresnel, vec3& averageDir)
 {
+    const int n = settings.samples;
     norm = 0.0f;
     fresnel = 0.0f;
     averageDir = vec3(0, 0, 0);
 
-    for (int j = 0; j < Nsample; ++j)
-    for (int i = 0; i < Nsample; ++i)
+    for (int j = 0; j < n; ++j)
+    for (int i = 0; i < n; ++i)
     {
-        const float U1 = (i + 0.5f)/Nsample;
-        const float U2 = (j + 0.5f)/Nsample;
+        const float U1 = (i + 0.5f)/n;
+        const float U2 = (j + 0.5f)/n;
 
         // sample
         const vec3 L = brdf.sample(V, alpha, U1, U2);
@@ -64,8 +118,8 @@ void computeAvgTerms(const Brdf& brdf, const vec3& V, const float alpha,
         }
     }
 
-    norm    /= (float)(Nsample*Nsample);
-    fresnel /= (float)(Nsample*Nsample);
+    norm    /= (float)(n*n);
+    fresnel /= (float)(n*n);
 
     // clear y component, which should be zero with isotropic BRDFs
     averageDir.y = 0.0f;
@@ -73,58 +127,205 @@ void computeAvgTerms(const Brdf& brdf, const vec3& V, const float alpha,
     averageDir = normalize(averageDir);
 }
 
-// compute the error between the BRDF and the LTC
-// using Multiple Importance Sampling
-float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha)
+// number of samples evaluated by computeError(), and the number full evaluations would have taken
+atomic<long long> errorSamples(0);
+atomic<long long> errorSamplesFull(0);
+
+// error of the LTC for one sample of each technique, with the MIS weights of computeError(), accumulated in error
+// the BRDF and the LTC are accumulated with the same weights in f and g: their integrals are known
+// (see ErrorControlVariates)
+void accumulateError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float U1, const float U2,
+    double& error, double& f, double& g)
+{
+    // importance sample LTC
+    {
+        // sample
+        const vec3 L = ltc.sample(U1, U2);
+
+        float pdf_brdf;
+        float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
+        float eval_ltc = ltc.eval(L);
+        float pdf_ltc = eval_ltc/ltc.magnitude;
+
+        // error with MIS weight
+        double error_ = fabsf(eval_brdf - eval_ltc);
+        error_ = error_*error_*error_;
+        error += error_/(pdf_ltc + pdf_brdf);
+        f += eval_brdf/(pdf_ltc + pdf_brdf);
+        g += eval_ltc/(pdf_ltc + pdf_brdf);
+    }
+
+    // importance sample BRDF
+    {
+        // sample
+        const vec3 L = brdf.sample(V, alpha, U1, U2);
+
+        float pdf_brdf;
+        float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
+        float eval_ltc = ltc.eval(L);
+        float pdf_ltc = eval_ltc/ltc.magnitude;
+
+        // error with MIS weight
+        double error_ = fabsf(eval_brdf - eval_ltc);
+        error_ = error_*error_*error_;
+        error += error_/(pdf_ltc + pdf_brdf);
+        f += eval_brdf/(pdf_ltc + pdf_brdf);
+        g += eval_ltc/(pdf_ltc + pdf_brdf);
+    }
+}
+
+// accumulateError() of the row of samples ((i + 0.5)/n, U2), in the same order, with the BRDF evaluated and
+// sampled in batches (see Brdf::evalBatch())
+void accumulateErrorRow(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float U2, const int n,
+    double& error, double& f, double& g)
 {
-    double error = 0.0;
+    const int BATCH = 64;
+
+    // directions sampled from the LTC (0) and from the BRDF (1)
+    float u1[BATCH], u2[BATCH];
+    float lx[2][BATCH], ly[2][BATCH], lz[2][BATCH];
+    float eval_brdf[2][BATCH], pdf_brdf[2][BATCH];
 
-    for (int j = 0; j < Nsample; ++j)
-    for (int i = 0; i < Nsample; ++i)
+    for (int first = 0; first < n; first += BATCH)
     {
-        const float U1 = (i + 0.5f)/Nsample;
-        const float U2 = (j + 0.5f)/Nsample;
+        const int count = std::min<int>(BATCH, n - first);
 
-        // importance sample LTC
+        for (int i = 0; i < count; ++i)
         {
-            // sample
-            const vec3 L = ltc.sample(U1, U2);
+            u1[i] = (first + i + 0.5f)/n;
+            u2[i] = U2;
 
-            float pdf_brdf;
-            float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
-            float eval_ltc = ltc.eval(L);
+            const vec3 L = ltc.sample(u1[i], U2);
+            lx[0][i] = L.x;
+            ly[0][i] = L.y;
+            lz[0][i] = L.z;
+        }
+
+        brdf.sampleBatch(V, alpha, count, u1, u2, lx[1], ly[1], lz[1]);
+        for (int s = 0; s < 2; ++s)
+            brdf.evalBatch(V, alpha, count, lx[s], ly[s], lz[s], eval_brdf[s], pdf_brdf[s]);
+
+        for (int i = 0; i < count; ++i)
+        for (int s = 0; s < 2; ++s)
+        {
+            float eval_ltc = ltc.eval(vec3(lx[s][i], ly[s][i], lz[s][i]));
             float pdf_ltc = eval_ltc/ltc.magnitude;
 
             // error with MIS weight
-            double error_ = fabsf(eval_brdf - eval_ltc);
+            double error_ = fabsf(eval_brdf[s][i] - eval_ltc);
             error_ = error_*error_*error_;
-            error += error_/(pdf_ltc + pdf_brdf);
+            error += error_/(pdf_ltc + pdf_brdf[s][i]);
+            f += eval_brdf[s][i]/(pdf_ltc + pdf_brdf[s][i]);
+            g += eval_ltc/(pdf_ltc + pdf_brdf[s][i]);
         }
+    }
+}
 
-        // importance sample BRDF
-        {
-            // sample
-            const vec3 L = brdf.sample(V, alpha, U1, U2);
+// control variates of computeError() (fitLTC --control-variates)
+// the BRDF integrates to norm (see computeAvgTerms()) and the LTC to its magnitude, so the deviations of their
+// estimates from the same samples are known, and correlated with the deviation of the error at high roughness:
+//   error - betaF (f - norm) - betaG (g - magnitude)
+// the coefficients are fitted once per cell, by least squares on a denser grid at the first guess: fitted on the
+// samples of each evaluation they are too noisy for few samples, and make the objective less smooth
+struct ErrorControlVariates
+{
+    float norm;
+    double betaF;
+    double betaG;
+};
 
-            float pdf_brdf;
-            float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
-            float eval_ltc = ltc.eval(L);
-            float pdf_ltc = eval_ltc/ltc.magnitude;
+// error estimate with control variates, from the sums of numSamples samples
+double controlledError(const ErrorControlVariates& cv, const LTC& ltc, double error, double f, double g, int numSamples)
+{
+    double controlled = (error - cv.betaF*(f - numSamples*(double)cv.norm) - cv.betaG*(g - numSamples*(double)ltc.magnitude))/numSamples;
+    return std::max<double>(controlled, 0.0);
+}
 
-            // error with MIS weight
-            double error_ = fabsf(eval_brdf - eval_ltc);
-            error_ = error_*error_*error_;
-            error += error_/(pdf_ltc + pdf_brdf);
+ErrorControlVariates fitControlVariates(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha,
+    const ErrorSettings& settings)
+{
+    const int n = 2*settings.samples;
+
+    // moments of the samples
+    double sum[3] = { 0, 0, 0 };
+    double cross[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+    for (int j = 0; j < n; ++j)
+    for (int i = 0; i < n; ++i)
+    {
+        double x[3] = { 0, 0, 0 };
+        accumulateError(ltc, brdf, V, alpha, (i + 0.5f)/n, (j + 0.5f)/n, x[0], x[1], x[2]);
+
+        for (int k = 0; k < 3; ++k)
+        {
+            sum[k] += x[k];
+            for (int l = 0; l < 3; ++l)
+                cross[k][l] += x[k]*x[l];
         }
     }
 
-    return (float)error / (float)(Nsample*Nsample);
+    double c[3][3];
+    for (int k = 0; k < 3; ++k)
+    for (int l = 0; l < 3; ++l)
+        c[k][l] = cross[k][l]/(n*n) - sum[k]*sum[l]/((double)n*n*n*n);
+
+    // least squares: [cff cfg; cfg cgg] beta = [cef; ceg]
+    ErrorControlVariates cv;
+    cv.norm = ltc.magnitude;
+    double det = c[1][1]*c[2][2] - c[1][2]*c[1][2];
+    bool valid = det > 1e-12*c[1][1]*c[2][2] && std::isfinite(det);
+    cv.betaF = valid ? (c[0][1]*c[2][2] - c[0][2]*c[1][2])/det : 0.0;
+    cv.betaG = valid ? (c[0][2]*c[1][1] - c[0][1]*c[1][2])/det : 0.0;
+    return cv;
+}
+
+// compute the error between the BRDF and the LTC
+// using Multiple Importance Sampling
+// * the rows of samples are evaluated in interleaved chunks, each one a stratified subset of the samples
+// * all terms are positive, so the partial sum is a lower bound of the error: the evaluation stops as soon as
+//   it reaches bound, and returns a value >= bound (see NelderMead())
+// * with control variates (cv not NULL) the corrected partial sums are no bound, and all samples are evaluated
+float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const ErrorSettings& settings,
+    const float bound = FLT_MAX, const ErrorControlVariates* cv = NULL)
+{
+    const int numChunks = 8;
+    const int n = settings.samples;
+    const double limit = cv ? DBL_MAX : (double)bound*(n*n);
+
+    double error = 0.0, f = 0.0, g = 0.0;
+    int rows = 0;
+
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        for (int j = chunk; j < n; j += numChunks, ++rows)
+            accumulateErrorRow(ltc, brdf, V, alpha, (j + 0.5f)/n, n, error, f, g);
+
+        if (error >= limit)
+            break;
+    }
+
+    errorSamples     += 2*rows*n;
+    errorSamplesFull += 2*n*n;
+
+    if (cv)
+        return (float)controlledError(*cv, ltc, error, f, g, n*n);
+
+    if (error >= limit)
+        return std::max<float>(bound, (float)error / (float)(n*n));
+
+    return (float)error / (float)(n*n);
 }
 
+// statistics of the fit of one cell, exported with the tables (see writeTabNpy())
+struct FitStats
+{
+    int iterations;  // NelderMead iterations
+    int evaluations; // evaluations of the error
+};
+
 struct FitLTC
 {
-    FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_) :
-        ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_)
+    FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_, const ErrorSettings& settings_) :
+        ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_), settings(settings_), cv(NULL), evaluations(0)
     {
     }
 
@@ -149,10 +350,11 @@ struct FitLTC
         ltc.update();
     }
 
-    float operator()(const float* params)
+    float operator()(const float* params, float bound)
     {
         update(params);
-        return computeError(ltc, brdf, V, alpha);
+        evaluations++;
+        return computeError(ltc, brdf, V, alpha, settings, bound, cv);
     }
 
     const Brdf& brdf;
@@ -161,61 +363,212 @@ struct FitLTC
 
     const vec3& V;
     float alpha;
+
+    const ErrorSettings& settings;
+    const ErrorControlVariates* cv;
+    int evaluations;
 };
 
 // fit brute force
 // refine first guess by exploring parameter space
-void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float epsilon = 0.05f, const bool isotropic = false)
+// with parallel, the candidates of each iteration are evaluated concurrently (see NelderMeadParallel())
+void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const ErrorSettings& settings,
+    const float epsilon = 0.05f, const bool isotropic = false, const int maxIters = 100, FitStats* stats = NULL,
+    const bool parallel = false)
 {
     float startFit[3] = { ltc.m11, ltc.m22, ltc.m13 };
     float resultFit[3];
 
-    FitLTC fitter(ltc, brdf, isotropic, V, alpha);
+    FitLTC fitter(ltc, brdf, isotropic, V, alpha, settings);
+
+    ErrorControlVariates cv;
+    if (settings.controlVariates)
+    {
+        cv = fitControlVariates(ltc, brdf, V, alpha, settings);
+        fitter.cv = &cv;
+    }
 
     // Find best-fit LTC lobe (scale, alphax, alphay)
-    float error = NelderMead<3>(resultFit, startFit, epsilon, 1e-5f, 100, fitter);
+    int iterations;
+    if (parallel)
+    {
+        // one LTC per candidate
+        atomic<int> evaluations(0);
+        auto objective = [&](const float* params, float bound)
+        {
+            LTC candidate = ltc;
+            FitLTC candidateFitter(candidate, brdf, isotropic, V, alpha, settings);
+            candidateFitter.cv = fitter.cv;
+            evaluations++;
+            return candidateFitter(params, bound);
+        };
+
+        NelderMeadParallel<3>(resultFit, startFit, epsilon, 1e-5f, maxIters, objective, &iterations);
+        fitter.evaluations = evaluations;
+    }
+    else
+    {
+        NelderMead<3>(resultFit, startFit, epsilon, 1e-5f, maxIters, std::ref(fitter), &iterations);
+    }
 
     // Update LTC with best fitting values
     fitter.update(resultFit);
+
+    if (stats)
+    {
+        stats->iterations = iterations;
+        stats->evaluations = fitter.evaluations;
+    }
 }
 
-// fit data
-void fitTab(mat3* tab, vec2* tabMagFresnel, const int N, const Brdf& brdf)
+// averages of the BRDF for (V, alpha), and the frame in which the lobe is fitted
+// at normal incidence (isotropic) the lobe is rotationally symmetric and fitted as such
+void initLobe(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const bool isotropic,
+    const ErrorSettings& settings)
 {
-    LTC ltc;
+    vec3 averageDir;
+    computeAvgTerms(brdf, V, alpha, settings, ltc.magnitude, ltc.fresnel, averageDir);
 
-    // loop over theta and alpha
-    for (int a = N - 1; a >=     0; --a)
-    for (int t =     0; t <= N - 1; ++t)
+    // init the hemisphere in which the distribution is fitted
+    // if theta == 0 the lobe is rotationally symmetric and aligned with Z = (0 0 1)
+    if (isotropic)
     {
-        // parameterised by sqrt(1 - cos(theta))
-        float x = t/float(N - 1);
-        float ct = 1.0f - x*x;
-        float theta = std::min<float>(1.57f, acosf(ct));
-        const vec3 V = vec3(sinf(theta), 0, cosf(theta));
+        ltc.X = vec3(1, 0, 0);
+        ltc.Y = vec3(0, 1, 0);
+        ltc.Z = vec3(0, 0, 1);
 
-        // alpha = roughness^2
-        float roughness = a/float(N - 1);
-        float alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
+        ltc.m13 = 0;
+        return;
+    }
 
-        cout << "a = " << a << "\t t = " << t  << endl;
-        cout << "alpha = " << alpha << "\t theta = " << theta << endl;
-        cout << endl;
+    vec3 L = averageDir;
+    vec3 T1(L.z, 0, -L.x);
+    vec3 T2(0, 1, 0);
+    ltc.X = T1;
+    ltc.Y = T2;
+    ltc.Z = L;
+}
 
-        vec3 averageDir;
-        computeAvgTerms(brdf, V, alpha, ltc.magnitude, ltc.fresnel, averageDir);
+// direction, roughness and averages of one cell of the table, and the frame in which it is fitted
+// returns whether the lobe is fitted as isotropic
+bool initCell(LTC& ltc, const Brdf& brdf, const int a, const int t, const int N, const ErrorSettings& settings,
+    vec3& V, float& alpha)
+{
+    // parameterised by sqrt(1 - cos(theta))
+    float x = t/float(N - 1);
+    float ct = 1.0f - x*x;
+    float theta = std::min<float>(1.57f, acosf(ct));
+    V = vec3(sinf(theta), 0, cosf(theta));
+
+    // alpha = roughness^2
+    float roughness = a/float(N - 1);
+    alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
+
+    initLobe(ltc, brdf, V, alpha, t == 0, settings);
+    return t == 0;
+}
 
-        bool isotropic;
+// fit one cell of the table, starting from the current state of ltc
+// for t == 0, ltc.m11 and ltc.m22 hold the first guess (the fit of the next alpha)
+// for t > 0, the previous fit of the column is used as first guess
+void fitCell(LTC& ltc, const Brdf& brdf, const int a, const int t, const int N, const ErrorSettings& settings,
+    FitStats* stats = NULL)
+{
+    vec3 V;
+    float alpha;
 
-        // 1. first guess for the fit
-        // init the hemisphere in which the distribution is fitted
-        // if theta == 0 the lobe is rotationally symmetric and aligned with Z = (0 0 1)
-        if (t == 0)
-        {
-            ltc.X = vec3(1, 0, 0);
-            ltc.Y = vec3(0, 1, 0);
-            ltc.Z = vec3(0, 0, 1);
+    // 1. first guess for the fit
+    bool isotropic = initCell(ltc, brdf, a, t, N, settings, V, alpha);
+    ltc.update();
 
+    // 2. fit (explore parameter space and refine first guess)
+    float epsilon = 0.05f;
+    fit(ltc, brdf, V, alpha, settings, epsilon, isotropic, 100, stats);
+}
+
+// first guess of a lobe initialized by initLobe(): projection of the matrix M of a seed table on the frame of the
+// lobe, normalized by its Z term like the parametric matrix, and without the terms the fit does not use
+void seedLobe(LTC& ltc, const mat3& M, const bool isotropic, const float alpha)
+{
+    mat3 params = ltcInverse(mat3(ltc.X, ltc.Y, ltc.Z))*M;
+    params /= params[2][2];
+
+    ltc.m11 = std::max<float>(params[0][0], 1e-7f);
+    ltc.m22 = std::max<float>(params[1][1], 1e-7f);
+    ltc.m13 = isotropic ? 0.0f : params[2][0];
+    if (isotropic)
+        ltc.m22 = ltc.m11 = 0.5f*(ltc.m11 + ltc.m22);
+
+    // degenerate seed (e.g. the lowest roughness of ltc.inc, rounded to a singular matrix): lobe of width alpha
+    if (!std::isfinite(ltc.m11) || !std::isfinite(ltc.m22) || !std::isfinite(ltc.m13))
+    {
+        ltc.m11 = ltc.m22 = alpha;
+        ltc.m13 = 0.0f;
+    }
+    ltc.update();
+}
+
+// fit one cell of the table, starting from the matrix of a previously fitted table at the same (alpha, theta)
+// the seed table may have any resolution, and was possibly fitted to another BRDF:
+// the cells do not depend on each other, and only need a few iterations when the seed is close
+void warmFitCell(LTC& ltc, const Brdf& brdf, const LTCTable& seed, const int a, const int t, const int N,
+    const ErrorSettings& settings, FitStats* stats = NULL)
+{
+    vec3 V;
+    float alpha;
+    bool isotropic = initCell(ltc, brdf, a, t, N, settings, V, alpha);
+
+    // 1. first guess from the seed
+    float x = t/float(N - 1);
+    seedLobe(ltc, ltcInverse(seed.Minv(a/float(N - 1), 1.0f - x*x)), isotropic, alpha);
+
+    // 2. short refinement around the seed
+    fit(ltc, brdf, V, alpha, settings, WARM_START_DELTA, isotropic, WARM_START_ITERS, stats);
+}
+
+// copy the fit of one cell to the tables
+void storeCell(mat3* tab, vec2* tabMagFresnel, const LTC& ltc, const int i)
+{
+    tab[i] = ltc.M;
+    tabMagFresnel[i][0] = ltc.magnitude;
+    tabMagFresnel[i][1] = ltc.fresnel;
+
+    // kill useless coefs in matrix
+    tab[i][0][1] = 0;
+    tab[i][1][0] = 0;
+    tab[i][2][1] = 0;
+    tab[i][1][2] = 0;
+}
+
+// savings of the early exits in computeError(), since the counters were at (samplesBefore, samplesFullBefore)
+void printErrorSamples(const long long samplesBefore, const long long samplesFullBefore, const long long numCells)
+{
+    const long long samples = errorSamples - samplesBefore;
+    const long long samplesFull = errorSamplesFull - samplesFullBefore;
+    cout << "error samples per fit: " << samples/numCells << " (" << samplesFull/numCells << " without early exit, ";
+    cout << 100.0*(samplesFull - samples)/std::max<long long>(samplesFull, 1) << "% saved)" << endl;
+}
+
+// fit data, one N*N table per BRDF
+// 1. the row theta == 0 is fitted from alpha = 1 down, each cell starting from the fit of the previous roughness
+// 2. the columns theta > 0 are then independent: each one starts from its cell at theta == 0,
+//    and all columns of all BRDFs are fitted in parallel
+// the first guesses are the same as in a sequential loop, and so are the tables
+// the statistics of the cells are written to stats, if not NULL
+void fitTab(mat3* tab, vec2* tabMagFresnel, const int N, const vector<const Brdf*>& brdfs,
+    const ErrorSettings& settings, FitStats* stats = NULL)
+{
+    mutex output;
+    const long long samplesBefore = errorSamples;
+    const long long samplesFullBefore = errorSamplesFull;
+
+    parallel_for((int)brdfs.size(), [&](int b)
+    {
+        mat3* tabB = tab + b*N*N;
+        LTC ltc;
+
+        for (int a = N - 1; a >= 0; --a)
+        {
             if (a == N - 1) // roughness = 1
             {
                 ltc.m11 = 1.0f;
@@ -223,52 +576,285 @@ void fitTab(mat3* tab, vec2* tabMagFresnel, const int N, const Brdf& brdf)
             }
             else // init with roughness of previous fit
             {
-                ltc.m11 = tab[a + 1 + t*N][0][0];
-                ltc.m22 = tab[a + 1 + t*N][1][1];
+                ltc.m11 = tabB[a + 1][0][0];
+                ltc.m22 = tabB[a + 1][1][1];
             }
 
-            ltc.m13 = 0;
-            ltc.update();
-
-            isotropic = true;
+            fitCell(ltc, *brdfs[b], a, 0, N, settings, stats ? stats + b*N*N + a : NULL);
+            storeCell(tabB, tabMagFresnel + b*N*N, ltc, a);
         }
-        // otherwise use previous configuration as first guess
-        else
+
+        lock_guard<mutex> lock(output);
+        cout << "BRDF " << b << ": theta = 0 done" << endl;
+    });
+
+    atomic<int> columns(0);
+
+    parallel_for((int)brdfs.size()*N, [&](int task)
+    {
+        const int b = task/N;
+        const int a = N - 1 - task%N;
+        mat3* tabB = tab + b*N*N;
+
+        // state of the isotropic fit at theta == 0
+        LTC ltc;
+        ltc.m11 = tabB[a][0][0];
+        ltc.m22 = tabB[a][1][1];
+        ltc.m13 = 0;
+
+        for (int t = 1; t <= N - 1; ++t)
         {
-            vec3 L = averageDir;
-            vec3 T1(L.z, 0, -L.x);
-            vec3 T2(0, 1, 0);
-            ltc.X = T1;
-            ltc.Y = T2;
-            ltc.Z = L;
+            fitCell(ltc, *brdfs[b], a, t, N, settings, stats ? stats + b*N*N + a + t*N : NULL);
+            storeCell(tabB, tabMagFresnel + b*N*N, ltc, a + t*N);
+        }
 
-            ltc.update();
+        lock_guard<mutex> lock(output);
+        cout << "BRDF " << b << ": a = " << a << " done (" << ++columns << "/" << brdfs.size()*N << ")" << endl;
+    });
+
+    printErrorSamples(samplesBefore, samplesFullBefore, (long long)brdfs.size()*N*N);
+}
+
+void fitTab(mat3* tab, vec2* tabMagFresnel, const int N, const Brdf& brdf, const ErrorSettings& settings)
+{
+    fitTab(tab, tabMagFresnel, N, vector<const Brdf*>(1, &brdf), settings);
+}
+
+// fit data, one N*N table per BRDF, every cell seeded from the same previously fitted table
+// all cells of all BRDFs are fitted in parallel
+void warmFitTab(
+    mat3* tab, vec2* tabMagFresnel, const int N, const vector<const Brdf*>& brdfs, const LTCTable& seed,
+    const ErrorSettings& settings, FitStats* stats = NULL)
+{
+    mutex output;
+    const long long samplesBefore = errorSamples;
+    const long long samplesFullBefore = errorSamplesFull;
+
+    atomic<int> rows(0);
+
+    // one task per row of constant theta, the cells of a row have similar costs
+    parallel_for((int)brdfs.size()*N, [&](int task)
+    {
+        const int b = task/N;
+        const int t = task%N;
 
-            isotropic = false;
+        for (int a = N - 1; a >= 0; --a)
+        {
+            LTC ltc;
+            warmFitCell(ltc, *brdfs[b], seed, a, t, N, settings, stats ? stats + b*N*N + a + t*N : NULL);
+            storeCell(tab + b*N*N, tabMagFresnel + b*N*N, ltc, a + t*N);
         }
 
-        // 2. fit (explore parameter space and refine first guess)
-        float epsilon = 0.05f;
-        fit(ltc, brdf, V, alpha, epsilon, isotropic);
+        lock_guard<mutex> lock(output);
+        cout << "BRDF " << b << ": t = " << t << " done (" << ++rows << "/" << brdfs.size()*N << ")" << endl;
+    });
 
-        // copy data
-        tab[a + t*N] = ltc.M;
-        tabMagFresnel[a + t*N][0] = ltc.magnitude;
-        tabMagFresnel[a + t*N][1] = ltc.fresnel;
+    printErrorSamples(samplesBefore, samplesFullBefore, (long long)brdfs.size()*N*N);
+}
 
-        // kill useless coefs in matrix
-        tab[a+t*N][0][1] = 0;
-        tab[a+t*N][1][0] = 0;
-        tab[a+t*N][2][1] = 0;
-        tab[a+t*N][1][2] = 0;
+// cell of the global refinement: frame and averages of the cell, and its error at the start
+struct RefineCell
+{
+    LTC ltc;
+    vec3 V;
+    float alpha;
+    bool isotropic;
+    float error;
+};
 
-        cout << tab[a+t*N][0][0] << "\t " << tab[a+t*N][1][0] << "\t " << tab[a+t*N][2][0] << endl;
-        cout << tab[a+t*N][0][1] << "\t " << tab[a+t*N][1][1] << "\t " << tab[a+t*N][2][1] << endl;
-        cout << tab[a+t*N][0][2] << "\t " << tab[a+t*N][1][2] << "\t " << tab[a+t*N][2][2] << endl;
-        cout << endl;
+// LTC of a cell for the refinement parameters (log(m11), log(m22), m13)
+void refineUpdate(LTC& ltc, const RefineCell& cell, const float* q)
+{
+    ltc = cell.ltc;
+    ltc.m11 = expf(q[0]);
+    ltc.m22 = cell.isotropic ? ltc.m11 : expf(q[1]);
+    ltc.m13 = cell.isotropic ? 0.0f : q[2];
+    ltc.update();
+}
+
+// normalized inverse matrix, the terms interpolated by the shaders (see packTab())
+vec4 packedMatrix(const mat3& M)
+{
+    mat3 invM = ltcNormalizedInverse(M);
+    return vec4(invM[0][0], invM[0][2], invM[2][0], invM[2][2]);
+}
+
+// errors of an N*N table between its cells, sorted: at the centers of the squares of 4 cells of an M*M grid over
+// the same range, the matrix is interpolated bilinearly like in the shaders and compared to the BRDF
+// * with M = N, the centers of the squares of the table itself; tables of different sizes are compared with the same M
+vector<float> interpolatedErrors(const mat3* tab, const Brdf& brdf, const int N, const int M,
+    const ErrorSettings& settings)
+{
+    vector<float> errors((M - 1)*(M - 1));
+
+    parallel_for((M - 1)*(M - 1), [&](int i)
+    {
+        float x = (i/(M - 1) + 0.5f)/float(M - 1);
+        float roughness = (i%(M - 1) + 0.5f)/float(M - 1);
+
+        float fa = roughness*(N - 1), ft = x*(N - 1);
+        int a = std::min<int>((int)fa, N - 2), t = std::min<int>((int)ft, N - 2);
+        float wa = fa - a, wt = ft - t;
+
+        vec4 p = mix(mix(packedMatrix(tab[a + t*N]), packedMatrix(tab[a + 1 + t*N]), wa),
+                     mix(packedMatrix(tab[a + (t + 1)*N]), packedMatrix(tab[a + 1 + (t + 1)*N]), wa), wt);
+        mat3 invM = mat3(
+            vec3(p.x, 0, p.y),
+            vec3(  0, 1,   0),
+            vec3(p.z, 0, p.w)
+        );
+
+        float theta = std::min<float>(1.57f, acosf(1.0f - x*x));
+        vec3 V = vec3(sinf(theta), 0, cosf(theta));
+        float alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
+
+        LTC ltc;
+        vec3 averageDir;
+        computeAvgTerms(brdf, V, alpha, settings, ltc.magnitude, ltc.fresnel, averageDir);
+        ltc.invM = invM;
+        ltc.M = ltcInverse(invM);
+        ltc.detM = fabsf(ltcDeterminant(ltc.M));
+
+        errors[i] = computeError(ltc, brdf, V, alpha, settings);
+    });
+
+    std::sort(errors.begin(), errors.end());
+    return errors;
+}
+
+// smoothness of the table and its error between the cells (see interpolatedErrors()), median and 90th percentile
+void printInterpolatedError(const mat3* tab, const Brdf& brdf, const int N, const char* label,
+    const ErrorSettings& settings)
+{
+    vector<double> packed(4*N*N);
+    for (int i = 0; i < N*N; ++i)
+    {
+        vec4 p = packedMatrix(tab[i]);
+        for (int k = 0; k < 4; ++k)
+            packed[4*i + k] = p[k];
+    }
+
+    vector<float> errors = interpolatedErrors(tab, brdf, N, N, settings);
+    cout << label << ": smoothness penalty " << secondDifferencePenalty<4>(&packed[0], N, N);
+    cout << ", interpolated error median " << errors[errors.size()/2];
+    cout << ", p90 " << errors[errors.size()*9/10] << endl;
+}
+
+// global refinement of fitted tables, one N*N table per BRDF
+// the cells are fitted independently, so neighbours can land in different local minima, and the jumps
+// between them show when the table is interpolated: all the cells are refined jointly, trading error of each
+// cell (relative to its own fit) for smaller second differences of the interpolated terms, with RefineGrid()
+// * the tables are smoother, not more accurate between the cells: a refined table of N/2 cells does not replace
+//   the table of N cells (with --refine-study for GGX, 10000: 1.36x the median and 13x the 90th percentile of the
+//   interpolated error of the 64x64 table, against 1.34x and 13x without refinement)
+void refineTab(mat3* tab, vec2* tabMagFresnel, const int N, const vector<const Brdf*>& brdfs, const float weight,
+    const ErrorSettings& settings)
+{
+    for (size_t b = 0; b < brdfs.size(); ++b)
+    {
+        const Brdf& brdf = *brdfs[b];
+        mat3* tabB = tab + b*N*N;
+
+        vector<RefineCell> cells(N*N);
+        vector<float> q(3*N*N);
+
+        // parameters of the fitted cells, from their matrices
+        parallel_for(N*N, [&](int i)
+        {
+            RefineCell& cell = cells[i];
+            cell.isotropic = initCell(cell.ltc, brdf, i%N, i/N, N, settings, cell.V, cell.alpha);
+
+            mat3 params = ltcInverse(mat3(cell.ltc.X, cell.ltc.Y, cell.ltc.Z))*tabB[i];
+            params /= params[2][2];
+            q[3*i + 0] = logf(std::max<float>(params[0][0], 1e-7f));
+            q[3*i + 1] = cell.isotropic ? q[3*i + 0] : logf(std::max<float>(params[1][1], 1e-7f));
+            q[3*i + 2] = cell.isotropic ? 0.0f : params[2][0];
+
+            LTC ltc;
+            refineUpdate(ltc, cell, &q[3*i]);
+            cell.error = computeError(ltc, brdf, cell.V, cell.alpha, settings);
+        });
+
+        // the errors are normalized by the error of the fit, but not below the median error: the cells that are
+        // fitted almost exactly (low roughness) would not move otherwise, and their models would not be valid
+        vector<float> errors(N*N);
+        for (int i = 0; i < N*N; ++i)
+            errors[i] = cells[i].error;
+        std::nth_element(errors.begin(), errors.begin() + N*N/2, errors.end());
+        for (int i = 0; i < N*N; ++i)
+            cells[i].error = std::max<float>(cells[i].error, std::max<float>(errors[N*N/2], 1e-20f));
+
+        printInterpolatedError(tabB, brdf, N, "before refinement", settings);
+
+        auto objective = [&](int i, const float* params)
+        {
+            LTC ltc;
+            refineUpdate(ltc, cells[i], params);
+            return computeError(ltc, brdf, cells[i].V, cells[i].alpha, settings)/cells[i].error;
+        };
+
+        auto values = [&](int i, const float* params, float f[4])
+        {
+            LTC ltc;
+            refineUpdate(ltc, cells[i], params);
+            vec4 p = packedMatrix(ltc.M);
+            f[0] = p.x; f[1] = p.y; f[2] = p.z; f[3] = p.w;
+        };
+
+        float total = RefineGrid<3, 4>(&q[0], N, N, REFINE_STEP, weight, REFINE_ITERS, objective, values);
+
+        vector<float> relative(N*N);
+        for (int i = 0; i < N*N; ++i)
+        {
+            LTC ltc;
+            refineUpdate(ltc, cells[i], &q[3*i]);
+            storeCell(tabB, tabMagFresnel + b*N*N, ltc, i);
+            relative[i] = objective(i, &q[3*i]);
+        }
+        std::sort(relative.begin(), relative.end());
+
+        cout << "BRDF " << b << ": refined, objective " << total << ", ";
+        cout << "normalized cell error: median " << relative[N*N/2] << ", p90 " << relative[N*N*9/10] << endl;
+        printInterpolatedError(tabB, brdf, N, "after refinement", settings);
     }
 }
 
+// fitLTC --refine-study: does the refinement let a table of N/2 cells replace the table of N cells? both are fitted
+// for the first BRDF, the small one with and without refineTab(), and their errors are interpolated at the same
+// points, the centers of the squares of the N*N grid
+void refineStudy(const Brdf& brdf, const float weight, const ErrorSettings& settings)
+{
+    const int n = N/2;
+    vector<const Brdf*> brdfs(1, &brdf);
+
+    vector<mat3> small(n*n), large(N*N);
+    vector<vec2> smallMagFresnel(n*n), largeMagFresnel(N*N);
+
+    auto print = [&](const char* label, const mat3* tab, int size, vector<float>& errors)
+    {
+        errors = interpolatedErrors(tab, brdf, size, N, settings);
+        cout << size << "x" << size << " " << label << ": interpolated error median " << errors[errors.size()/2];
+        cout << ", p90 " << errors[errors.size()*9/10] << ", p99 " << errors[errors.size()*99/100] << endl;
+    };
+
+    vector<float> fitted, refined, reference;
+    fitTab(&small[0], &smallMagFresnel[0], n, brdfs, settings);
+    print("fitted", &small[0], n, fitted);
+    refineTab(&small[0], &smallMagFresnel[0], n, brdfs, weight, settings);
+    print("refined", &small[0], n, refined);
+    fitTab(&large[0], &largeMagFresnel[0], N, brdfs, settings);
+    print("fitted", &large[0], N, reference);
+
+    // the percentiles of the refined small table relative to the large table, below 1 where it is as accurate
+    const size_t ranks[] = { reference.size()/2, reference.size()*9/10, reference.size()*99/100 };
+    cout << "refined " << n << "x" << n << " / fitted " << N << "x" << N << ": median, p90, p99";
+    for (size_t r : ranks)
+        cout << " " << refined[r]/std::max<float>(reference[r], 1e-20f);
+    cout << " (" << fitted[ranks[0]]/std::max<float>(reference[ranks[0]], 1e-20f) << ", ";
+    cout << fitted[ranks[1]]/std::max<float>(reference[ranks[1]], 1e-20f) << ", ";
+    cout << fitted[ranks[2]]/std::max<float>(reference[ranks[2]], 1e-20f) << " without refinement)" << endl;
+}
+
 float sqr(float x)
 {
     return x*x;
@@ -343,20 +929,17 @@ void packTab(
     const float* tabSphere,
     int N)
 {
+    // inverses normalized by the middle element, in one batch
+    LTCMatrices M, invM;
+    M.resize(N*N);
     for (int i = 0; i < N*N; ++i)
-    {
-        const mat3& m = tab[i];
-
-        mat3 invM = inverse(m);
-
-        // normalize by the middle element
-        invM /= invM[1][1];
+        M.set(i, tab[i]);
+    ltcNormalizedInverse(M, invM);
 
+    for (int i = 0; i < N*N; ++i)
+    {
         // store the variable terms
-        tex1[i].x = invM[0][0];
-        tex1[i].y = invM[0][2];
-        tex1[i].z = invM[2][0];
-        tex1[i].w = invM[2][2];
+        tex1[i] = invM.packed(i);
         tex2[i].x = tabMagFresnel[i][0];
         tex2[i].y = tabMagFresnel[i][1];
         tex2[i].z = 0.0f; // unused
@@ -364,20 +947,53 @@ void packTab(
     }
 }
 
-int main(int argc, char* argv[])
+// errors of the cells of fitted tables, one N*N table per BRDF, and export to NumPy with the statistics of the fit
+void exportNpy(
+    const mat3* tab, const vec2* tabMagFresnel, const float* tabSphere, const FitStats* stats,
+    const vector<const Brdf*>& brdfs, int N, const ErrorSettings& settings, const string& prefix)
 {
-    // BRDF to fit
-    BrdfGGX brdf;
-    //BrdfBeckmann brdf;
-    //BrdfDisneyDiffuse brdf;
+    const int count = (int)brdfs.size()*N*N;
 
-    // allocate data
-    mat3*  tab = new mat3[N*N];
-    vec2*  tabMagFresnel = new vec2[N*N];
-    float* tabSphere = new float[N*N];
+    vector<float> errors(count);
+    parallel_for(count, [&](int i)
+    {
+        const int c = i%(N*N);
+
+        LTC ltc;
+        vec3 V;
+        float alpha;
+        initCell(ltc, *brdfs[i/(N*N)], c%N, c/N, N, settings, V, alpha);
+        ltc.M = tab[i];
+        ltc.invM = ltcInverse(ltc.M);
+        ltc.detM = fabsf(ltcDeterminant(ltc.M));
+
+        errors[i] = computeError(ltc, *brdfs[i/(N*N)], V, alpha, settings);
+    });
+
+    vector<int> iterations(count), evaluations(count);
+    long long totalIterations = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        iterations[i] = stats[i].iterations;
+        evaluations[i] = stats[i].evaluations;
+        totalIterations += iterations[i];
+    }
 
-    // fit
-    fitTab(tab, tabMagFresnel, N, brdf);
+    writeTabNpy(tab, tabMagFresnel, tabSphere, &errors[0], &iterations[0], &evaluations[0], N,
+        brdfs.size() > 1 ? (int)brdfs.size() : 0, prefix);
+
+    std::sort(errors.begin(), errors.end());
+    cout << prefix << "_*.npy: error median " << errors[count/2] << ", p90 " << errors[count*9/10];
+    if (iterations[0] >= 0)
+        cout << ", " << double(totalIterations)/count << " iterations per cell";
+    cout << endl;
+}
+
+// packs and exports the fitted tables of one BRDF
+void exportTables(mat3* tab, vec2* tabMagFresnel, const FitStats* stats, const Brdf& brdf, int N,
+    const ErrorSettings& settings, const string& dir)
+{
+    float* tabSphere = new float[N*N];
 
     // projected solid angle of a spherical cap, clipped to the horizon
     genSphereTab(tabSphere, N);
@@ -387,21 +1003,597 @@ int main(int argc, char* argv[])
     vec4* tex2 = new vec4[N*N];
     packTab(tex1, tex2, tab, tabMagFresnel, tabSphere, N);
 
-    // export to C, MATLAB and DDS
-    writeTabMatlab(tab, tabMagFresnel, N);
-    writeTabC(tab, tabMagFresnel, N);
-    writeDDS(tex1, tex2, N);
-    writeJS(tex1, tex2, N);
+    // export to C, MATLAB, NumPy and DDS
+    writeTabMatlab(tab, tabMagFresnel, N, dir);
+    exportNpy(tab, tabMagFresnel, tabSphere, stats, vector<const Brdf*>(1, &brdf), N, settings, dir + "/ltc");
+    writeTabC(tab, tabMagFresnel, N, dir);
+    writeDDS(tex1, tex2, N, dir);
+    writeJS(tex1, tex2, N, dir);
 
-    // spherical plots
-    // make_spherical_plots(brdf, tab, N);
+    delete[] tabSphere;
+    delete[] tex1;
+    delete[] tex2;
+}
+
+// packs and exports the transmission tables, one slice per eta, as 2D texture arrays
+void exportBtdfTables(
+    mat3* tab, vec2* tabMagFresnel, const FitStats* stats, const vector<const Brdf*>& slices, int N, int numSlices,
+    const ErrorSettings& settings, const string& dir)
+{
+    float* tabSphere = new float[N*N];
+    genSphereTab(tabSphere, N);
+
+    vec4* tex1 = new vec4[numSlices*N*N];
+    vec4* tex2 = new vec4[numSlices*N*N];
+    for (int k = 0; k < numSlices; ++k)
+    {
+        // the Schlick average does not apply to transmission, the magnitude includes (1 - F)
+        for (int i = 0; i < N*N; ++i)
+            tabMagFresnel[k*N*N + i][1] = 0.0f;
+
+        packTab(tex1 + k*N*N, tex2 + k*N*N, tab + k*N*N, tabMagFresnel + k*N*N, tabSphere, N);
+    }
+
+    writeDDS((dir + "/btdf_1.dds").c_str(), &tex1[0][0], N, numSlices);
+    writeDDS((dir + "/btdf_2.dds").c_str(), &tex2[0][0], N, numSlices);
+    exportNpy(tab, tabMagFresnel, tabSphere, stats, slices, N, settings, dir + "/btdf");
 
-    // delete data
-    delete[] tab;
-    delete[] tabMagFresnel;
     delete[] tabSphere;
     delete[] tex1;
     delete[] tex2;
+}
+
+// packs and exports the combined diffuse and specular tables, one slice per fraction of the specular lobe, as 2D
+// texture arrays (see brdf_combined.h)
+// the magnitude and Fresnel columns are the ones of GGX in every slice, for the specular color of the materials:
+// the combined lobes are normalized
+void exportCombinedTables(
+    mat3* tab, vec2* tabMagFresnel, const FitStats* stats, const vector<const Brdf*>& slices, const Brdf& ggx, int N,
+    int numSlices, const ErrorSettings& settings, const string& dir)
+{
+    float* tabSphere = new float[N*N];
+    genSphereTab(tabSphere, N);
+
+    vector<vec2> magFresnel(N*N);
+    parallel_for(N*N, [&](int i)
+    {
+        LTC ltc;
+        vec3 V;
+        float alpha;
+        initCell(ltc, ggx, i%N, i/N, N, settings, V, alpha);
+        magFresnel[i] = vec2(ltc.magnitude, ltc.fresnel);
+    });
+
+    vec4* tex1 = new vec4[numSlices*N*N];
+    vec4* tex2 = new vec4[numSlices*N*N];
+    for (int k = 0; k < numSlices; ++k)
+    {
+        std::copy(magFresnel.begin(), magFresnel.end(), tabMagFresnel + k*N*N);
+        packTab(tex1 + k*N*N, tex2 + k*N*N, tab + k*N*N, tabMagFresnel + k*N*N, tabSphere, N);
+    }
+
+    writeDDS((dir + "/combined_1.dds").c_str(), &tex1[0][0], N, numSlices);
+    writeDDS((dir + "/combined_2.dds").c_str(), &tex2[0][0], N, numSlices);
+    exportNpy(tab, tabMagFresnel, tabSphere, stats, slices, N, settings, dir + "/combined");
+
+    delete[] tabSphere;
+    delete[] tex1;
+    delete[] tex2;
+}
+
+// packs and exports the table of the Henyey-Greenstein phase function (see phase_hg.h)
+void exportPhaseTables(mat3* tab, vec2* tabMagFresnel, const FitStats* stats, const Brdf& phase, int N,
+    const ErrorSettings& settings, const string& dir)
+{
+    float* tabSphere = new float[N*N];
+    genSphereTab(tabSphere, N);
+
+    // no Fresnel term in a medium
+    for (int i = 0; i < N*N; ++i)
+        tabMagFresnel[i][1] = 0.0f;
+
+    vec4* tex1 = new vec4[N*N];
+    vec4* tex2 = new vec4[N*N];
+    packTab(tex1, tex2, tab, tabMagFresnel, tabSphere, N);
+
+    writeDDS((dir + "/phase_1.dds").c_str(), &tex1[0][0], N);
+    writeDDS((dir + "/phase_2.dds").c_str(), &tex2[0][0], N);
+    exportNpy(tab, tabMagFresnel, tabSphere, stats, vector<const Brdf*>(1, &phase), N, settings, dir + "/phase");
+
+    delete[] tabSphere;
+    delete[] tex1;
+    delete[] tex2;
+}
+
+// fitLTC --cv-study: noise of computeError() against its samples without and with control variates, and its effect on
+// the fits, for a few cells
+// * noise: relative standard deviation of the estimates over random rotations of the grid of samples, at a perturbed
+//   fit like the vertices NelderMead evaluates
+// * fits: evaluations, and error of the result measured with 64x64 samples, relative to the fit with 32x32 samples
+//   without control variates (geometric mean over the cells)
+// * the fits run with their own settings, the samples of the default ones come from fitLTC --samples
+void controlVariateStudy(const Brdf& brdf, const ErrorSettings& defaults)
+{
+    const int roughnesses[] = { 8, 24, 40, 56 };
+    const int thetas[] = { 10, 40, 60 };
+    const int grids[] = { 8, 16, 32, 64 };
+    const int numCells = 12;
+    const int numRotations = 64;
+    const int defaultNsample = defaults.samples;
+    const ErrorSettings fitSettings(defaultNsample, false);
+    const ErrorSettings measureSettings(64, false);
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    LTC starts[numCells];
+    double varianceRatio[4] = { 0, 0, 0, 0 };
+
+    cout << "relative standard deviation of the error, without / with control variates" << endl;
+    cout << "   a   t";
+    for (int n : grids)
+        cout << "    Nsample = " << setw(2) << n << "  ";
+    cout << endl;
+
+    for (int c = 0; c < numCells; ++c)
+    {
+        const int a = roughnesses[c/3];
+        const int t = thetas[c%3];
+
+        // fit at the default settings, starting from the fit at theta = 0
+        LTC ltc;
+        float roughness = a/float(N - 1);
+        ltc.m11 = ltc.m22 = std::max<float>(roughness*roughness, MIN_ALPHA);
+        fitCell(ltc, brdf, a, 0, N, fitSettings);
+        ltc.m13 = 0.0f;
+        starts[c] = ltc;
+        fitCell(ltc, brdf, a, t, N, fitSettings);
+
+        LTC probe = ltc;
+        vec3 V;
+        float alpha;
+        initCell(probe, brdf, a, t, N, fitSettings, V, alpha);
+
+        ErrorControlVariates cv = fitControlVariates(ltc, brdf, V, alpha, fitSettings);
+        LTC vertex = ltc;
+        vertex.m11 *= 1.05f;
+        vertex.m13 += 0.02f;
+        vertex.update();
+
+        cout << setw(4) << a << setw(4) << t;
+        for (int k = 0; k < 4; ++k)
+        {
+            const int n = grids[k];
+
+            double sum[2] = { 0, 0 }, sum2[2] = { 0, 0 };
+            for (int r = 0; r < numRotations; ++r)
+            {
+                const float o1 = u(rng), o2 = u(rng);
+
+                double error = 0.0, f = 0.0, g = 0.0;
+                for (int j = 0; j < n; ++j)
+                for (int i = 0; i < n; ++i)
+                    accumulateError(vertex, brdf, V, alpha, fmodf((i + 0.5f)/n + o1, 1.0f), fmodf((j + 0.5f)/n + o2, 1.0f),
+                        error, f, g);
+
+                double estimates[2] = { error/(n*n), controlledError(cv, vertex, error, f, g, n*n) };
+                for (int m = 0; m < 2; ++m)
+                {
+                    sum[m] += estimates[m];
+                    sum2[m] += estimates[m]*estimates[m];
+                }
+            }
+
+            double deviation[2];
+            for (int m = 0; m < 2; ++m)
+            {
+                double mean = sum[m]/numRotations;
+                deviation[m] = sqrt(std::max<double>(0.0, sum2[m]/numRotations - mean*mean))/mean;
+            }
+            varianceRatio[k] += log(deviation[1]*deviation[1]/(deviation[0]*deviation[0]))/numCells;
+
+            cout << "  " << fixed << setprecision(4) << deviation[0] << " / " << deviation[1];
+        }
+        cout << endl;
+    }
+
+    cout << "samples with control variates for the same variance:";
+    for (int k = 0; k < 4; ++k)
+        cout << "  " << setprecision(0) << 100.0*exp(varianceRatio[k]) << "%";
+    cout << endl << endl;
+
+    // fits
+    float reference[numCells];
+    cout << "fits: evaluations and error relative to Nsample = " << defaultNsample << " without control variates" << endl;
+    for (int n : { defaultNsample, 16, 8 })
+    for (int controlled = 0; controlled < 2; ++controlled)
+    {
+        double evaluations = 0.0, ratio = 0.0;
+        for (int c = 0; c < numCells; ++c)
+        {
+            const int a = roughnesses[c/3];
+            const int t = thetas[c%3];
+
+            LTC ltc = starts[c];
+            FitStats stats;
+            fitCell(ltc, brdf, a, t, N, ErrorSettings(n, controlled != 0), &stats);
+
+            LTC probe = ltc;
+            vec3 V;
+            float alpha;
+            initCell(probe, brdf, a, t, N, measureSettings, V, alpha);
+            float error = computeError(ltc, brdf, V, alpha, measureSettings);
+            if (n == defaultNsample && !controlled)
+                reference[c] = error;
+
+            evaluations += stats.evaluations/double(numCells);
+            ratio += log(error/reference[c])/numCells;
+        }
+
+        cout << "  Nsample = " << setw(2) << n << (controlled ? ", control variates:    " : ", no control variates: ");
+        cout << setprecision(1) << evaluations << " evaluations, error x" << setprecision(3) << exp(ratio) << endl;
+    }
+}
+
+// interactive refit of single cells (fitLTC --serve, see refit_server.h)
+// the averages and the frame of a lobe only depend on the BRDF, alpha and theta, and are kept for the next requests
+int serveRefits(const vector<const Brdf*>& brdfs, const vector<string>& names, const LTCTable* seed,
+    const ErrorSettings& settings)
+{
+    map<vector<float>, LTC> lobes;
+
+    auto refit = [&](const RefitRequest& request, RefitResult& result)
+    {
+        const Brdf& brdf = *brdfs[request.brdf];
+        const vec3 V = vec3(sinf(request.theta), 0, cosf(request.theta));
+        const float alpha = std::max<float>(request.alpha, MIN_ALPHA);
+        const bool isotropic = request.theta == 0.0f;
+
+        LTC& ltc = result.ltc;
+        vector<float> key = { (float)request.brdf, alpha, request.theta };
+        auto lobe = lobes.find(key);
+        if (lobe == lobes.end())
+        {
+            initLobe(ltc, brdf, V, alpha, isotropic, settings);
+            lobes[key] = ltc;
+        }
+        else
+            ltc = lobe->second;
+
+        // first guess
+        if (request.hasGuess)
+        {
+            ltc.m11 = request.guess[0];
+            ltc.m22 = isotropic ? request.guess[0] : request.guess[1];
+            ltc.m13 = isotropic ? 0.0f : request.guess[2];
+            ltc.update();
+        }
+        else if (seed)
+            seedLobe(ltc, ltcInverse(seed->Minv(sqrtf(alpha), V.z)), isotropic, alpha);
+        else
+        {
+            ltc.m11 = ltc.m22 = alpha;
+            ltc.m13 = 0.0f;
+            ltc.update();
+        }
+
+        FitStats stats;
+        fit(ltc, brdf, V, alpha, settings, request.epsilon, isotropic, request.iterations, &stats, true);
+
+        result.params[0] = ltc.m11;
+        result.params[1] = ltc.m22;
+        result.params[2] = ltc.m13;
+        result.error = computeError(ltc, brdf, V, alpha, settings);
+        result.iterations = stats.iterations;
+        result.evaluations = stats.evaluations;
+    };
+
+    return runRefitServer(cin, cout, names, brdfs, refit);
+}
+
+// usage: fitLTC [options]
+//   --brdf ggx|beckmann|disney[,...]  BRDFs to fit (default ggx), written to results/ or results/<brdf>/ if several
+//   --brdf plugin:path[,...]          BRDF of a shared library (see brdf_plugin.h, Linux), in the list with the others
+//   --warm-start path                 seed every cell from a previous table (ltc.inc, ltc.mat, ltc_1.dds or ltc.js,
+//                                     any resolution) and refine it with a short fit, instead of fitting from scratch
+//   --vndf                            sample the visible normals of GGX and Beckmann in computeAvgTerms() and
+//                                     computeError(), fewer wasted samples at grazing angles (see ltcBench vndf)
+//   --samples n                       computeError() with n x n samples of each technique (default 32)
+//   --control-variates                computeError() with control variates (see ErrorControlVariates)
+//   --cv-study                        print the noise of computeError() with and without control variates against
+//                                     the number of samples, and the resulting fits, for the first BRDF, and exit
+//   --refine weight                   refine the fitted table globally, with a smoothness penalty of this weight
+//                                     (see refineTab(), 10000 trades about 1% of error for half the penalty), for
+//                                     smoother tables, not smaller ones
+//   --refine-study                    fit the first BRDF at half the resolution with and without --refine (weight
+//                                     10000 by default) and at full resolution, print their interpolated errors at
+//                                     the same points, and exit
+//   --btdf                            fit the GGX transmission tables instead, one slice per eta,
+//                                     written to results/btdf_1.dds and results/btdf_2.dds
+//   --phase                           fit the Henyey-Greenstein phase function table instead, over (g, theta),
+//                                     written to results/phase_1.dds and results/phase_2.dds
+//   --combined                        fit single lobes of Disney diffuse and GGX instead, one slice per fraction of
+//                                     the specular lobe (see brdf_combined.h), for shading with one evaluation per
+//                                     light, written to results/combined_1.dds and results/combined_2.dds
+//   --serve                           refit single cells of the --brdf BRDFs on request, JSON lines on stdin and
+//                                     stdout (see refit_server.h), seeded from the --warm-start table if any
+//                                     (--btdf, --phase, --combined and --serve exclude each other)
+//   --farm N                          fit with N local worker processes (Linux)
+//   --kill K                          farm: kill K workers during the fit, to test the recovery
+//   --resume                          farm: resume from the cells in results/farm.journal
+//   --socket path                     farm: coordinator socket (default /tmp/fitLTC.sock)
+//   --worker path                     run as a worker of the coordinator listening on path,
+//                                     with the same --brdf, --btdf, --phase or --combined, --vndf, --samples and
+//                                     --control-variates options
+int main(int argc, char* argv[])
+{
+    // BRDFs to fit
+    BrdfGGX ggx;
+    BrdfBeckmann beckmann;
+    BrdfDisneyDiffuse disney;
+    PhaseHG phase;
+
+    string brdfList = "ggx";
+    string warmStart;
+    float refineWeight = 0.0f;
+    bool btdf = false;
+    bool fitPhase = false;
+    bool combined = false;
+    ErrorSettings settings;
+    bool cvStudy = false;
+    bool refineStudyMode = false;
+    bool serve = false;
+    int farmWorkers = 0;
+    string workerSocket;
+#ifndef _WIN32
+    FarmOptions farm;
+#endif
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--brdf" && hasValue)
+            brdfList = argv[++i];
+        else if (arg == "--btdf")
+            btdf = true;
+        else if (arg == "--phase")
+            fitPhase = true;
+        else if (arg == "--combined")
+            combined = true;
+        else if (arg == "--vndf")
+            ggx.vndf = beckmann.vndf = true;
+        else if (arg == "--samples" && hasValue)
+            settings.samples = std::max<int>(1, atoi(argv[++i]));
+        else if (arg == "--control-variates")
+            settings.controlVariates = true;
+        else if (arg == "--cv-study")
+            cvStudy = true;
+        else if (arg == "--refine-study")
+            refineStudyMode = true;
+        else if (arg == "--serve")
+            serve = true;
+        else if (arg == "--warm-start" && hasValue)
+            warmStart = argv[++i];
+        else if (arg == "--refine" && hasValue)
+            refineWeight = (float)atof(argv[++i]);
+#ifndef _WIN32
+        else if (arg == "--farm" && hasValue)
+            farmWorkers = farm.workers = atoi(argv[++i]);
+        else if (arg == "--kill" && hasValue)
+            farm.kills = atoi(argv[++i]);
+        else if (arg == "--resume")
+            farm.resume = true;
+        else if (arg == "--socket" && hasValue)
+            farm.socketPath = argv[++i];
+        else if (arg == "--worker" && hasValue)
+            workerSocket = argv[++i];
+#endif
+        else
+        {
+            cout << "unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    // each mode replaces the BRDFs and the layout of the tables of the others
+    if ((int)btdf + (int)fitPhase + (int)combined + (int)serve > 1)
+    {
+        cout << "--btdf, --phase, --combined and --serve cannot be combined" << endl;
+        return 1;
+    }
+
+    vector<const Brdf*> brdfs;
+    vector<string> names;
+#ifndef _WIN32
+    vector<unique_ptr<BrdfPlugin>> plugins;
+#endif
+    stringstream list(brdfList);
+    for (string name; getline(list, name, ','); )
+    {
+        if (name == "ggx")
+            brdfs.push_back(&ggx);
+        else if (name == "beckmann")
+            brdfs.push_back(&beckmann);
+        else if (name == "disney")
+            brdfs.push_back(&disney);
+#ifndef _WIN32
+        else if (name.compare(0, 7, "plugin:") == 0)
+        {
+            string error;
+            plugins.push_back(unique_ptr<BrdfPlugin>(new BrdfPlugin()));
+            if (!plugins.back()->load(name.substr(7), error))
+            {
+                cout << "cannot load the BRDF plugin: " << error << endl;
+                return 1;
+            }
+
+            // stdout is the channel of the responses of --serve
+            (serve ? cerr : cout) << "BRDF plugin " << plugins.back()->name() << " from " << name.substr(7) << endl;
+            brdfs.push_back(plugins.back().get());
+            names.push_back(plugins.back()->name());
+            continue;
+        }
+#endif
+        else
+        {
+            cout << "unknown BRDF " << name << endl;
+            return 1;
+        }
+        names.push_back(name);
+    }
+
+    if (serve)
+    {
+        LTCTable seed;
+        if (!warmStart.empty() && !importTable(warmStart, seed))
+        {
+            cerr << "cannot import " << warmStart << endl;
+            return 1;
+        }
+
+        return serveRefits(brdfs, names, warmStart.empty() ? NULL : &seed, settings);
+    }
+
+    // transmission: each eta is fitted as its own BRDF
+    vector<BtdfGGX> btdfSlices(btdf ? N_ETA : 0);
+    if (btdf)
+    {
+        brdfs.clear();
+        for (int k = 0; k < N_ETA; ++k)
+        {
+            btdfSlices[k].eta = btdfSliceEta(k, N_ETA);
+            brdfs.push_back(&btdfSlices[k]);
+        }
+    }
+
+    // diffuse and specular in one lobe: each fraction of the specular lobe is fitted as its own BRDF
+    CombinedAlbedo albedo;
+    vector<BrdfCombined> combinedSlices;
+    if (combined)
+    {
+        albedo.init(disney, ggx, N, MIN_ALPHA);
+
+        brdfs.clear();
+        for (int k = 0; k < N_MIX; ++k)
+            combinedSlices.push_back(BrdfCombined(disney, ggx, albedo, combinedSliceWeight(k, N_MIX)));
+        for (int k = 0; k < N_MIX; ++k)
+            brdfs.push_back(&combinedSlices[k]);
+    }
+
+    if (fitPhase)
+        brdfs.assign(1, &phase);
+
+    if (cvStudy)
+    {
+        controlVariateStudy(*brdfs[0], settings);
+        return 0;
+    }
+
+    if (refineStudyMode)
+    {
+        refineStudy(*brdfs[0], refineWeight > 0.0f ? refineWeight : 10000.0f, settings);
+        return 0;
+    }
+
+#ifndef _WIN32
+    // the statistics of the cells stay in the workers
+    auto fitFarmCell = [&settings](LTC& ltc, const Brdf& brdf, const int a, const int t, const int N)
+    {
+        fitCell(ltc, brdf, a, t, N, settings);
+    };
+
+    if (!workerSocket.empty())
+        return runFarmWorker(workerSocket, brdfs, N, fitFarmCell);
+#endif
+
+    LTCTable seed;
+    if (!warmStart.empty())
+    {
+        if (farmWorkers > 0)
+        {
+            cout << "--warm-start is not supported by the farm" << endl;
+            return 1;
+        }
+        if (!importTable(warmStart, seed))
+        {
+            cout << "cannot import " << warmStart << endl;
+            return 1;
+        }
+        cout << "warm start from " << warmStart << " (" << seed.size << "x" << seed.size << ")" << endl;
+    }
+
+    // allocate data
+    vector<mat3> tab(brdfs.size()*N*N);
+    vector<vec2> tabMagFresnel(brdfs.size()*N*N);
+    FitStats unknown = { -1, -1 };
+    vector<FitStats> stats(brdfs.size()*N*N, unknown);
+
+    // fit
+    if (farmWorkers > 0)
+    {
+#ifndef _WIN32
+        FarmCoordinator coordinator((int)brdfs.size(), N, farm);
+        vector<FarmTables> tables;
+        if (!coordinator.run(brdfs, fitFarmCell, tables))
+            return 1;
+
+        for (size_t b = 0; b < brdfs.size(); ++b)
+        {
+            std::copy(tables[b].tab.begin(), tables[b].tab.end(), tab.begin() + b*N*N);
+            std::copy(tables[b].tabMagFresnel.begin(), tables[b].tabMagFresnel.end(), tabMagFresnel.begin() + b*N*N);
+        }
+#endif
+    }
+    else if (!warmStart.empty())
+    {
+        warmFitTab(&tab[0], &tabMagFresnel[0], N, brdfs, seed, settings, &stats[0]);
+    }
+    else
+    {
+        fitTab(&tab[0], &tabMagFresnel[0], N, brdfs, settings, &stats[0]);
+    }
+
+    if (refineWeight > 0.0f)
+        refineTab(&tab[0], &tabMagFresnel[0], N, brdfs, refineWeight, settings);
+
+    if (btdf)
+    {
+        exportBtdfTables(&tab[0], &tabMagFresnel[0], &stats[0], brdfs, N, N_ETA, settings, "results");
+        return 0;
+    }
+
+    if (combined)
+    {
+        exportCombinedTables(&tab[0], &tabMagFresnel[0], &stats[0], brdfs, ggx, N, N_MIX, settings, "results");
+        return 0;
+    }
+
+    if (fitPhase)
+    {
+        exportPhaseTables(&tab[0], &tabMagFresnel[0], &stats[0], phase, N, settings, "results");
+        return 0;
+    }
+
+    for (size_t b = 0; b < brdfs.size(); ++b)
+    {
+        string dir = "results";
+        if (brdfs.size() > 1)
+        {
+            dir += "/" + names[b];
+#ifdef _WIN32
+            _mkdir(dir.c_str());
+#else
+            mkdir(dir.c_str(), 0755);
+#endif
+        }
+
+        exportTables(&tab[b*N*N], &tabMagFresnel[b*N*N], &stats[b*N*N], *brdfs[b], N, settings, dir);
+    }
+
+    // spherical plots
+    // make_spherical_plots(brdf, tab, N);
 
     return 0;
 }
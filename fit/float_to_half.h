@@ -26,7 +26,7 @@ union FP16
     };
 };
 
-static uint16_t float_to_half_fast(float x)
+inline uint16_t float_to_half_fast(float x)
 {
     FP32 f;
     f.f = x;
@@ -66,4 +66,27 @@ static uint16_t float_to_half_fast(float x)
 
     o.Sign = f.Sign;
     return o.u;
-}
\ No newline at end of file
+}
+
+inline float half_to_float(uint16_t h)
+{
+    static const FP32 magic = { 113 << 23 };
+    static const uint32_t shifted_exp = 0x7c00 << 13; // exponent mask after shift
+
+    FP32 o;
+    o.u = (h & 0x7fff) << 13;     // exponent/mantissa bits
+    uint32_t exp = shifted_exp & o.u; // just the exponent
+    o.u += (127 - 15) << 23;      // exponent adjust
+
+    // handle exponent special cases
+    if (exp == shifted_exp) // Inf/NaN?
+        o.u += (128 - 16) << 23; // extra exp adjust
+    else if (exp == 0) // Zero/Denormal?
+    {
+        o.u += 1 << 23; // extra exp adjust
+        o.f -= magic.f; // renormalize
+    }
+
+    o.u |= (h & 0x8000) << 16; // sign bit
+    return o.f;
+}
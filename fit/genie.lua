@@ -1,26 +1,71 @@
 solution "fitLTC"
    configurations { "Debug", "Release" }
 
+   includedirs {
+      "../external/CImg",
+      "../external/glm"
+   }
+
+   defines { 
+      "cimg_display=0"
+   }
+
+   configuration "Debug"
+      targetdir "bin"
+      defines { "DEBUG" }
+      flags { "Symbols" }
+
+   configuration "Release"
+      targetdir "bin"
+      defines { "NDEBUG" }
+      flags { "Optimize" }
+
+   -- math functions without errno or floating point traps, so that the packet loops (sh_polygon.h, ltc_phase.h,
+   -- ltc_ray.h, image_output.h, ltc_matrix.h) vectorize, for the baseline ISA: no -mavx2 or -mavx512f, ltc_ray.h
+   -- compiles its AVX2 and AVX-512 traversals with target attributes and picks one at run time
+   configuration "linux"
+      buildoptions { "-fno-math-errno", "-fno-trapping-math" }
+      buildoptions_cpp { "-std=c++11" }
+      links { "pthread", "dl" }
+
+   configuration {}
+
    project "fitLTC"
       kind "ConsoleApp"
       language "C++"
       files { "**.h", "**.cpp", "**.c" }
+      excludes { "tools/**", "plugins/**" }
+
+   -- batch conversion of IES libraries
+   project "iesConvert"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/iesConvert.cpp", "dds.cpp", "*.h" }
+
+   -- validation and benchmarks of the CPU evaluators
+   project "ltcBench"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/ltcBench.cpp", "dds.cpp", "*.h" }
 
-      includedirs {
-         "../external/CImg",
-         "../external/glm"
-      }
+   -- LTC prefiltering of environment maps
+   project "prefilterEnv"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/prefilterEnv.cpp", "dds.cpp", "*.h" }
 
-      defines { 
-         "cimg_display=0"
-      }
+   -- generation of the WebGL demo shaders from webgl/shaders/ltc/src and the shared kernels
+   project "shaderGen"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/shaderGen.cpp" }
 
-      configuration "Debug"
-         targetdir "bin"
-         defines { "DEBUG" }
-         flags { "Symbols" }
+   -- example BRDF plugin (fitLTC --brdf plugin:bin/libbrdfPluginGGX.so)
+   project "brdfPluginGGX"
+      kind "SharedLib"
+      language "C"
+      files { "plugins/brdf_ggx_plugin.c", "brdf_plugin.h" }
 
+      -- GCC vectorizes the loops over the batches, of a count known at run time, from -O3 only
       configuration "Release"
-         targetdir "bin"
-         defines { "NDEBUG" }
-         flags { "Optimize" }
+         flags { "OptimizeSpeed" }
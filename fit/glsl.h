@@ -0,0 +1,110 @@
+#ifndef _GLSL_
+#define _GLSL_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// C++ side of the kernels shared with the WebGL demos (webgl/shaders/ltc/kernels, see ltc_kernels.h)
+// the kernels are written in the subset of GLSL ES 3.00 that is also valid C++ on top of glm:
+// * float literals have an f suffix, and ints are converted explicitly (float(i), vec3(0))
+// * no swizzles, components are accessed one by one
+// * out and inout parameters are declared with OUT(T), INOUT(T), and OUT_ARRAY(T)/INOUT_ARRAY(T) for arrays
+// * textures are sampler2D and sampler2DArray parameters, read with texture() and sized with textureSize()
+// the builtins below are declared in namespace glsl, where the kernels are compiled, so that they hide
+// the std and glm overloads that would otherwise be ambiguous
+
+#define LTC_KERNELS_CPP
+
+#define OUT(T) T&
+#define INOUT(T) T&
+#define OUT_ARRAY(T) T
+#define INOUT_ARRAY(T) T
+
+namespace glsl
+{
+    inline float abs(float x)                   { return fabsf(x); }
+    inline float sign(float x)                  { return float(x > 0.0f) - float(x < 0.0f); }
+    inline float min(float a, float b)          { return a < b ? a : b; }
+    inline float max(float a, float b)          { return a > b ? a : b; }
+    inline float clamp(float x, float a, float b) { return min(max(x, a), b); }
+    inline float mix(float a, float b, float t) { return a + (b - a)*t; }
+    inline float sqrt(float x)                  { return sqrtf(x); }
+    inline float inversesqrt(float x)           { return 1.0f/sqrtf(x); }
+    inline float pow(float x, float y)          { return powf(x, y); }
+    inline float floor(float x)                 { return floorf(x); }
+    inline float fract(float x)                 { return x - floorf(x); }
+    inline float mod(float x, float y)          { return x - y*floorf(x/y); }
+    inline float sin(float x)                   { return sinf(x); }
+    inline float cos(float x)                   { return cosf(x); }
+    inline float atan(float y, float x)         { return atan2f(y, x); }
+    inline float atan(float x)                  { return atanf(x); }
+
+    inline vec3 abs(const vec3& v)                    { return glm::abs(v); }
+    inline vec3 min(const vec3& a, const vec3& b)     { return glm::min(a, b); }
+    inline vec3 max(const vec3& a, const vec3& b)     { return glm::max(a, b); }
+    inline vec3 mix(const vec3& a, const vec3& b, float t) { return glm::mix(a, b, t); }
+
+    // texture with GL_LINEAR filtering and GL_CLAMP_TO_EDGE wrapping, texel centers at (i + 0.5)/size
+    struct sampler2D
+    {
+        const vec4* texels;
+        int size;
+    };
+
+    inline sampler2D makeSampler(const std::vector<vec4>& texels, int size)
+    {
+        sampler2D s = { &texels[0], size };
+        return s;
+    }
+
+    inline vec4 texture(const sampler2D& s, const vec2& uv)
+    {
+        float x = glm::clamp(uv.x*s.size - 0.5f, 0.0f, float(s.size - 1));
+        float y = glm::clamp(uv.y*s.size - 0.5f, 0.0f, float(s.size - 1));
+
+        int x0 = std::min<int>((int)x, s.size - 2);
+        int y0 = std::min<int>((int)y, s.size - 2);
+        float fx = x - x0;
+        float fy = y - y0;
+
+        const vec4& t00 = s.texels[(x0    ) + (y0    )*s.size];
+        const vec4& t10 = s.texels[(x0 + 1) + (y0    )*s.size];
+        const vec4& t01 = s.texels[(x0    ) + (y0 + 1)*s.size];
+        const vec4& t11 = s.texels[(x0 + 1) + (y0 + 1)*s.size];
+
+        return (t00*(1.0f - fx) + t10*fx)*(1.0f - fy) +
+               (t01*(1.0f - fx) + t11*fx)*fy;
+    }
+
+    // layers of size x size texels, filtered within the nearest layer to uvw.z
+    struct sampler2DArray
+    {
+        const vec4* texels;
+        int size;
+        int layers;
+    };
+
+    inline sampler2DArray makeSampler(const std::vector<vec4>& texels, int size, int layers)
+    {
+        sampler2DArray s = { &texels[0], size, layers };
+        return s;
+    }
+
+    inline vec4 texture(const sampler2DArray& s, const vec3& uvw)
+    {
+        int layer = glm::clamp((int)floorf(uvw.z + 0.5f), 0, s.layers - 1);
+        sampler2D slice = { s.texels + layer*s.size*s.size, s.size };
+        return texture(slice, vec2(uvw.x, uvw.y));
+    }
+
+    inline ivec3 textureSize(const sampler2DArray& s, int)
+    {
+        return ivec3(s.size, s.size, s.layers);
+    }
+}
+
+#endif
@@ -0,0 +1,474 @@
+#ifndef GRID_REFINE_H
+#define GRID_REFINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "parallel.h"
+
+// Joint refinement of a W x H grid of independently fitted cells, with a smoothness penalty between neighbours:
+//   minimizes  sum_c e_c(q_c) + weight * sum ||f(q_i-1) - 2 f(q_i) + f(q_i+1)||^2
+// where the second differences run along both axes of the grid
+// * objectiveFn(cell, q) is the objective e_c of a cell with P parameters q (cell = x + y*W), best normalized
+//   so that it is 1 at the start, so that weight has the same meaning for all the cells
+// * valuesFn(cell, q, f) returns the F values that are interpolated between the cells
+//
+// Levenberg-Marquardt iterations: the objectives are replaced by quadratic models built by central differences
+// of steps step[P] (projected on convex ones), the values are linearized, and the resulting sparse normal
+// equations are solved by conjugate gradient with a block Jacobi preconditioner
+// * the steps are halved per cell and parameter until the objective at most doubles, and bound the updates
+//   (trust region): sharp objectives (e.g. narrow lobes) only move within the range where their models hold,
+//   and parameters whose objective is not defined (NaN) around the current value stay in this last range
+// the models and the evaluations of the objectives, which dominate the cost, are parallel over the cells
+// returns the final value of the total objective
+
+// eigen decomposition of a symmetric matrix (cyclic Jacobi), A is overwritten
+template<int P>
+void symmetricEigen(double A[P][P], double vectors[P][P], double values[P])
+{
+    for (int i = 0; i < P; ++i)
+    for (int j = 0; j < P; ++j)
+        vectors[i][j] = i == j ? 1.0 : 0.0;
+
+    for (int sweep = 0; sweep < 32; ++sweep)
+    {
+        double off = 0.0;
+        for (int i = 0; i < P; ++i)
+        for (int j = i + 1; j < P; ++j)
+            off += A[i][j]*A[i][j];
+        if (off < 1e-30)
+            break;
+
+        for (int p = 0; p < P; ++p)
+        for (int r = p + 1; r < P; ++r)
+        {
+            if (A[p][r] == 0.0)
+                continue;
+
+            double theta = 0.5*(A[r][r] - A[p][p])/A[p][r];
+            double t = (theta >= 0.0 ? 1.0 : -1.0)/(fabs(theta) + sqrt(theta*theta + 1.0));
+            double c = 1.0/sqrt(t*t + 1.0);
+            double s = t*c;
+
+            for (int k = 0; k < P; ++k)
+            {
+                double akp = A[k][p], akr = A[k][r];
+                A[k][p] = c*akp - s*akr;
+                A[k][r] = s*akp + c*akr;
+            }
+            for (int k = 0; k < P; ++k)
+            {
+                double apk = A[p][k], ark = A[r][k];
+                A[p][k] = c*apk - s*ark;
+                A[r][k] = s*apk + c*ark;
+            }
+            for (int k = 0; k < P; ++k)
+            {
+                double vkp = vectors[k][p], vkr = vectors[k][r];
+                vectors[k][p] = c*vkp - s*vkr;
+                vectors[k][r] = s*vkp + c*vkr;
+            }
+        }
+    }
+
+    for (int i = 0; i < P; ++i)
+        values[i] = A[i][i];
+}
+
+// inverse of a small matrix (Gauss-Jordan with partial pivoting), returns false if it is singular
+template<int P>
+bool invertBlock(const double A[P][P], double inv[P][P])
+{
+    double M[P][2*P];
+    for (int i = 0; i < P; ++i)
+    for (int j = 0; j < P; ++j)
+    {
+        M[i][j] = A[i][j];
+        M[i][P + j] = i == j ? 1.0 : 0.0;
+    }
+
+    for (int c = 0; c < P; ++c)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < P; ++r)
+            if (fabs(M[r][c]) > fabs(M[pivot][c]))
+                pivot = r;
+        if (M[pivot][c] == 0.0)
+            return false;
+        for (int j = 0; j < 2*P; ++j)
+            std::swap(M[c][j], M[pivot][j]);
+
+        double inv = 1.0/M[c][c];
+        for (int j = 0; j < 2*P; ++j)
+            M[c][j] *= inv;
+
+        for (int r = 0; r < P; ++r)
+        {
+            if (r == c)
+                continue;
+            double f = M[r][c];
+            for (int j = 0; j < 2*P; ++j)
+                M[r][j] -= f*M[c][j];
+        }
+    }
+
+    for (int i = 0; i < P; ++i)
+    for (int j = 0; j < P; ++j)
+        inv[i][j] = M[i][P + j];
+    return true;
+}
+
+// out = sum over both axes of L^T L u, for the second differences L of the F values u of the grid
+template<int F>
+void secondDifferenceNormal(const double* u, int W, int H, double* out)
+{
+    std::fill(out, out + W*H*F, 0.0);
+
+    // second difference centered on cell c, along the axis of stride
+    auto diff = [&](int c, int stride, int k)
+    {
+        return u[(c - stride)*F + k] - 2.0*u[c*F + k] + u[(c + stride)*F + k];
+    };
+
+    for (int y = 0; y < H; ++y)
+    for (int x = 0; x < W; ++x)
+    {
+        const int c = x + y*W;
+        for (int k = 0; k < F; ++k)
+        {
+            double sum = 0.0;
+            if (x >= 2)
+                sum += diff(c - 1, 1, k);
+            if (x >= 1 && x <= W - 2)
+                sum -= 2.0*diff(c, 1, k);
+            if (x <= W - 3)
+                sum += diff(c + 1, 1, k);
+            if (y >= 2)
+                sum += diff(c - W, W, k);
+            if (y >= 1 && y <= H - 2)
+                sum -= 2.0*diff(c, W, k);
+            if (y <= H - 3)
+                sum += diff(c + W, W, k);
+            out[c*F + k] = sum;
+        }
+    }
+}
+
+// sum of the squared second differences of the F values u of the grid
+template<int F>
+double secondDifferencePenalty(const double* u, int W, int H)
+{
+    double sum = 0.0;
+    for (int y = 0; y < H; ++y)
+    for (int x = 0; x < W; ++x)
+    {
+        const int c = x + y*W;
+        for (int k = 0; k < F; ++k)
+        {
+            if (x >= 1 && x <= W - 2)
+            {
+                double d = u[(c - 1)*F + k] - 2.0*u[c*F + k] + u[(c + 1)*F + k];
+                sum += d*d;
+            }
+            if (y >= 1 && y <= H - 2)
+            {
+                double d = u[(c - W)*F + k] - 2.0*u[c*F + k] + u[(c + W)*F + k];
+                sum += d*d;
+            }
+        }
+    }
+    return sum;
+}
+
+template<int P, int F, typename OBJECTIVE, typename VALUES>
+float RefineGrid(
+    float* q, int W, int H, const float step[P], float weight, int iterations,
+    OBJECTIVE objectiveFn, VALUES valuesFn)
+{
+    const int n = W*H;
+
+    // current state: objectives and values of the cells
+    std::vector<double> e(n), f(n*F);
+    auto evaluateValues = [&](const float* params, std::vector<double>& f_)
+    {
+        for (int c = 0; c < n; ++c)
+        {
+            float values[F];
+            valuesFn(c, params + c*P, values);
+            for (int k = 0; k < F; ++k)
+                f_[c*F + k] = values[k];
+        }
+    };
+    auto evaluateTotal = [&](const std::vector<double>& e_, const std::vector<double>& f_)
+    {
+        double total = 0.0;
+        for (int c = 0; c < n; ++c)
+            total += e_[c];
+        return total + weight*secondDifferencePenalty<F>(&f_[0], W, H);
+    };
+
+    parallel_for(n, [&](int c)
+    {
+        e[c] = objectiveFn(c, q + c*P);
+    });
+    evaluateValues(q, f);
+    double total = evaluateTotal(e, f);
+    double mu = 1e-2;
+
+    // per cell: steps, gradient and convex Hessian of the objective, Jacobian of the values
+    std::vector<float> h(n*P);
+    std::vector<double> g(n*P), Hc(n*P*P), J(n*F*P);
+
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        parallel_for(n, [&](int c)
+        {
+            const float* q0 = q + c*P;
+            const double e0 = e[c];
+            float* hc = &h[c*P];
+
+            float qp[P];
+            double ePlus[P], eMinus[P];
+            for (int i = 0; i < P; ++i)
+            {
+                hc[i] = 2.0f*step[i];
+                for (int halving = 0; halving < 10; ++halving)
+                {
+                    hc[i] *= 0.5f;
+                    std::copy(q0, q0 + P, qp);
+                    qp[i] = q0[i] + hc[i];
+                    ePlus[i] = objectiveFn(c, qp);
+                    qp[i] = q0[i] - hc[i];
+                    eMinus[i] = objectiveFn(c, qp);
+                    if (ePlus[i] <= 2.0*e0 && eMinus[i] <= 2.0*e0)
+                        break;
+                }
+
+                // the objective may not be defined around q (e.g. NaN): the parameter stays in the last step
+                if (!(ePlus[i] <= 2.0*e0 && eMinus[i] <= 2.0*e0))
+                    ePlus[i] = eMinus[i] = e0;
+            }
+
+            double A[P][P];
+            for (int i = 0; i < P; ++i)
+            {
+                g[c*P + i] = (ePlus[i] - eMinus[i])/(2.0*hc[i]);
+                A[i][i] = (ePlus[i] - 2.0*e0 + eMinus[i])/(hc[i]*hc[i]);
+            }
+
+            // mixed terms, skipped for the parameters the objective does not depend on
+            for (int i = 0; i < P; ++i)
+            for (int j = i + 1; j < P; ++j)
+            {
+                bool usedI = ePlus[i] != e0 || eMinus[i] != e0;
+                bool usedJ = ePlus[j] != e0 || eMinus[j] != e0;
+                if (!usedI || !usedJ)
+                {
+                    A[i][j] = A[j][i] = 0.0;
+                    continue;
+                }
+
+                double corners[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    std::copy(q0, q0 + P, qp);
+                    qp[i] += (k & 1) ? -hc[i] : hc[i];
+                    qp[j] += (k & 2) ? -hc[j] : hc[j];
+                    corners[k] = objectiveFn(c, qp);
+                }
+                A[i][j] = A[j][i] = (corners[0] - corners[1] - corners[2] + corners[3])/(4.0*hc[i]*hc[j]);
+                if (!std::isfinite(A[i][j]))
+                    A[i][j] = A[j][i] = 0.0;
+            }
+
+            // projection on the closest convex model
+            double vectors[P][P], values[P];
+            symmetricEigen<P>(A, vectors, values);
+            for (int i = 0; i < P; ++i)
+            for (int j = 0; j < P; ++j)
+            {
+                double sum = 0.0;
+                for (int k = 0; k < P; ++k)
+                    sum += vectors[i][k]*std::max<double>(values[k], 0.0)*vectors[j][k];
+                Hc[(c*P + i)*P + j] = sum;
+            }
+
+            // Jacobian of the values
+            for (int i = 0; i < P; ++i)
+            {
+                float fPlus[F], fMinus[F];
+                std::copy(q0, q0 + P, qp);
+                qp[i] = q0[i] + hc[i];
+                valuesFn(c, qp, fPlus);
+                qp[i] = q0[i] - hc[i];
+                valuesFn(c, qp, fMinus);
+
+                for (int k = 0; k < F; ++k)
+                    J[(c*F + k)*P + i] = (fPlus[k] - fMinus[k])/(2.0*hc[i]);
+            }
+        });
+
+        // right-hand side: -(g + 2 weight J^T L^T L f)
+        std::vector<double> b(n*P), Lf(n*F);
+        secondDifferenceNormal<F>(&f[0], W, H, &Lf[0]);
+        for (int c = 0; c < n; ++c)
+        for (int i = 0; i < P; ++i)
+        {
+            double sum = g[c*P + i];
+            for (int k = 0; k < F; ++k)
+                sum += 2.0*weight*J[(c*F + k)*P + i]*Lf[c*F + k];
+            b[c*P + i] = -sum;
+        }
+
+        // diagonal of L^T L: number of second differences through each cell, weighted by their coefficients
+        std::vector<double> diagL(n);
+        for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+        {
+            double d = 0.0;
+            d += (x >= 2) + (x <= W - 3) + 4.0*(x >= 1 && x <= W - 2);
+            d += (y >= 2) + (y <= H - 3) + 4.0*(y >= 1 && y <= H - 2);
+            diagL[x + y*W] = d;
+        }
+
+        // damped steps until the total objective decreases
+        bool accepted = false;
+        for (int attempt = 0; attempt < 8 && !accepted; ++attempt)
+        {
+            // damped data term: H + mu (diag(H) + eps)
+            auto dataBlock = [&](int c, int i, int j)
+            {
+                double h = Hc[(c*P + i)*P + j];
+                return i == j ? h + mu*(h + 1e-6) : h;
+            };
+
+            // y = A x
+            std::vector<double> u(n*F), Lu(n*F);
+            auto apply = [&](const std::vector<double>& x, std::vector<double>& y)
+            {
+                for (int c = 0; c < n; ++c)
+                for (int k = 0; k < F; ++k)
+                {
+                    double sum = 0.0;
+                    for (int i = 0; i < P; ++i)
+                        sum += J[(c*F + k)*P + i]*x[c*P + i];
+                    u[c*F + k] = sum;
+                }
+                secondDifferenceNormal<F>(&u[0], W, H, &Lu[0]);
+
+                for (int c = 0; c < n; ++c)
+                for (int i = 0; i < P; ++i)
+                {
+                    double sum = 0.0;
+                    for (int j = 0; j < P; ++j)
+                        sum += dataBlock(c, i, j)*x[c*P + j];
+                    for (int k = 0; k < F; ++k)
+                        sum += 2.0*weight*J[(c*F + k)*P + i]*Lu[c*F + k];
+                    y[c*P + i] = sum;
+                }
+            };
+
+            // block Jacobi preconditioner
+            std::vector<double> precond(n*P*P);
+            for (int c = 0; c < n; ++c)
+            {
+                double block[P][P], inv[P][P];
+                for (int i = 0; i < P; ++i)
+                for (int j = 0; j < P; ++j)
+                {
+                    double sum = dataBlock(c, i, j);
+                    for (int k = 0; k < F; ++k)
+                        sum += 2.0*weight*diagL[c]*J[(c*F + k)*P + i]*J[(c*F + k)*P + j];
+                    block[i][j] = sum;
+                }
+                if (!invertBlock<P>(block, inv))
+                    for (int i = 0; i < P; ++i)
+                    for (int j = 0; j < P; ++j)
+                        inv[i][j] = i == j ? 1.0 : 0.0;
+                for (int i = 0; i < P; ++i)
+                for (int j = 0; j < P; ++j)
+                    precond[(c*P + i)*P + j] = inv[i][j];
+            }
+            auto precondition = [&](const std::vector<double>& r, std::vector<double>& z)
+            {
+                for (int c = 0; c < n; ++c)
+                for (int i = 0; i < P; ++i)
+                {
+                    double sum = 0.0;
+                    for (int j = 0; j < P; ++j)
+                        sum += precond[(c*P + i)*P + j]*r[c*P + j];
+                    z[c*P + i] = sum;
+                }
+            };
+            auto dotProduct = [&](const std::vector<double>& x, const std::vector<double>& y)
+            {
+                double sum = 0.0;
+                for (int i = 0; i < n*P; ++i)
+                    sum += x[i]*y[i];
+                return sum;
+            };
+
+            // preconditioned conjugate gradient, from delta = 0
+            std::vector<double> delta(n*P, 0.0), r = b, z(n*P), d(n*P), Ad(n*P);
+            precondition(r, z);
+            d = z;
+            double rz = dotProduct(r, z);
+            const double tolerance = 1e-12*dotProduct(b, b);
+            for (int k = 0; k < 4*n*P && dotProduct(r, r) > tolerance; ++k)
+            {
+                apply(d, Ad);
+                double alpha = rz/dotProduct(d, Ad);
+                for (int i = 0; i < n*P; ++i)
+                {
+                    delta[i] += alpha*d[i];
+                    r[i] -= alpha*Ad[i];
+                }
+
+                precondition(r, z);
+                double rzNext = dotProduct(r, z);
+                for (int i = 0; i < n*P; ++i)
+                    d[i] = z[i] + rzNext/rz*d[i];
+                rz = rzNext;
+            }
+
+            // trust region
+            std::vector<float> qNext(q, q + n*P);
+            for (int i = 0; i < n*P; ++i)
+                qNext[i] += (float)std::max<double>(-h[i], std::min<double>(delta[i], h[i]));
+
+            // the cells that leave the range of their models anyway (their objective more than doubles, along
+            // directions that were not sampled) keep their parameters
+            std::vector<double> eNext(n), fNext(n*F);
+            parallel_for(n, [&](int c)
+            {
+                eNext[c] = objectiveFn(c, &qNext[c*P]);
+                if (!(eNext[c] <= 2.0*e[c]))
+                {
+                    std::copy(q + c*P, q + (c + 1)*P, &qNext[c*P]);
+                    eNext[c] = e[c];
+                }
+            });
+            evaluateValues(&qNext[0], fNext);
+            double totalNext = evaluateTotal(eNext, fNext);
+            if (totalNext < total)
+            {
+                std::copy(qNext.begin(), qNext.end(), q);
+                e.swap(eNext);
+                f.swap(fNext);
+                total = totalNext;
+                mu = std::max<double>(mu*0.3, 1e-6);
+                accepted = true;
+            }
+            else
+                mu *= 10.0;
+        }
+
+        if (!accepted)
+            break;
+    }
+
+    return (float)total;
+}
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef _IES_
+#define _IES_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "ltc_eval.h"
+
+// IESNA LM-63 photometric data (type C), see
+// http://lumen.iee.put.poznan.pl/kw/iesna.txt
+struct IESData
+{
+    std::vector<float> vertical;   // degrees, 0 = nadir
+    std::vector<float> horizontal; // degrees
+    std::vector<float> candela;    // [h*vertical.size() + v]
+
+    float width, length, height;   // luminous opening, meters
+};
+
+bool parseIES(std::istream& in, IESData& ies)
+{
+    std::string line;
+
+    // skip header and keywords
+    while (std::getline(in, line))
+        if (line.compare(0, 5, "TILT=") == 0)
+            break;
+
+    if (line.compare(0, 5, "TILT=") != 0)
+        return false;
+
+    if (line.compare(0, 12, "TILT=INCLUDE") == 0)
+    {
+        // lamp-to-luminaire geometry, pairs, angles and factors
+        int geometry, pairs;
+        in >> geometry >> pairs;
+        for (int i = 0; i < 2*pairs; ++i)
+        {
+            float dummy;
+            in >> dummy;
+        }
+    }
+    else if (line.compare(0, 9, "TILT=NONE") != 0)
+    {
+        // external tilt files are not supported
+        return false;
+    }
+
+    int numLamps, numVertical, numHorizontal, photometricType, unitsType;
+    float lumens, multiplier;
+    float ballastFactor, futureUse, inputWatts;
+
+    in >> numLamps >> lumens >> multiplier >> numVertical >> numHorizontal >> photometricType >> unitsType;
+    in >> ies.width >> ies.length >> ies.height;
+    in >> ballastFactor >> futureUse >> inputWatts;
+
+    if (!in || numVertical <= 0 || numHorizontal <= 0 || photometricType != 1)
+        return false;
+
+    // feet to meters
+    if (unitsType == 1)
+    {
+        ies.width  *= 0.3048f;
+        ies.length *= 0.3048f;
+        ies.height *= 0.3048f;
+    }
+
+    ies.vertical.resize(numVertical);
+    ies.horizontal.resize(numHorizontal);
+    ies.candela.resize(numVertical*numHorizontal);
+
+    for (int i = 0; i < numVertical; ++i)
+        in >> ies.vertical[i];
+    for (int i = 0; i < numHorizontal; ++i)
+        in >> ies.horizontal[i];
+    for (int i = 0; i < numVertical*numHorizontal; ++i)
+    {
+        in >> ies.candela[i];
+        ies.candela[i] *= multiplier*ballastFactor;
+    }
+
+    return !in.fail();
+}
+
+// piecewise linear lookup in a sorted angle array
+static void findInterval(const std::vector<float>& angles, float x, int& i, float& f)
+{
+    if (angles.size() == 1 || x <= angles.front())
+    {
+        i = 0;
+        f = 0.0f;
+        return;
+    }
+    if (x >= angles.back())
+    {
+        i = (int)angles.size() - 2;
+        f = 1.0f;
+        return;
+    }
+
+    i = int(std::upper_bound(angles.begin(), angles.end(), x) - angles.begin()) - 1;
+    f = (x - angles[i])/(angles[i + 1] - angles[i]);
+}
+
+// intensity in candela for a vertical (from nadir) and horizontal angle in degrees
+float candela(const IESData& ies, float v, float h)
+{
+    if (v < ies.vertical.front() || v > ies.vertical.back())
+        return 0.0f;
+
+    // horizontal symmetries
+    float hmax = ies.horizontal.back();
+    h = fmodf(h, 360.0f);
+    if (h < 0.0f)
+        h += 360.0f;
+    if (hmax <= 180.0f && h > 180.0f) // bilateral
+        h = 360.0f - h;
+    if (hmax <=  90.0f && h >  90.0f) // quadrant
+        h = 180.0f - h;
+
+    int iv, ih;
+    float fv, fh;
+    findInterval(ies.vertical, v, iv, fv);
+    findInterval(ies.horizontal, h, ih, fh);
+
+    int nv = (int)ies.vertical.size();
+    int iv1 = std::min<int>(iv + 1, nv - 1);
+    int ih1 = std::min<int>(ih + 1, (int)ies.horizontal.size() - 1);
+
+    float c0 = mix(ies.candela[ih *nv + iv], ies.candela[ih *nv + iv1], fv);
+    float c1 = mix(ies.candela[ih1*nv + iv], ies.candela[ih1*nv + iv1], fv);
+    return mix(c0, c1, fh);
+}
+
+// IES profile prefiltered for LTC evaluation
+// stores the equivalent radiance of the luminous opening, I/|cos(vertical)|,
+// in a latitude-longitude map (x = horizontal, y = vertical),
+// blurred with increasing angular radius at each level
+struct IESProfile
+{
+    static const int width  = 64;
+    static const int height = 32;
+    static const int levels = 6;
+
+    std::vector<float> data; // [level][y][x]
+
+    // angular radius of the blur of a level
+    static float radius(float level)
+    {
+        const float pi = 3.14159265f;
+        return (pi/height)*exp2f(level);
+    }
+
+    static vec3 direction(int x, int y)
+    {
+        const float pi = 3.14159265f;
+        float v = pi*(y + 0.5f)/height;
+        float h = 2.0f*pi*(x + 0.5f)/width;
+        return vec3(sinf(v)*cosf(h), sinf(v)*sinf(h), cosf(v));
+    }
+
+    float texel(int level, int x, int y) const
+    {
+        x = (x + width) % width;
+        y = glm::clamp(y, 0, height - 1);
+        return data[(level*height + y)*width + x];
+    }
+
+    // bilinear lookup of an emission direction in the luminaire frame (z = nadir)
+    float lookup(int level, const vec3& w) const
+    {
+        const float pi = 3.14159265f;
+        float v = acosf(glm::clamp(w.z, -1.0f, 1.0f));
+        float h = atan2f(w.y, w.x);
+        if (h < 0.0f)
+            h += 2.0f*pi;
+
+        float x = h/(2.0f*pi)*width - 0.5f;
+        float y = v/pi*height - 0.5f;
+        int x0 = (int)floorf(x);
+        int y0 = (int)floorf(y);
+        float fx = x - x0;
+        float fy = y - y0;
+
+        return mix(mix(texel(level, x0, y0    ), texel(level, x0 + 1, y0    ), fx),
+                   mix(texel(level, x0, y0 + 1), texel(level, x0 + 1, y0 + 1), fx), fy);
+    }
+
+    // trilinear lookup, blurred over (at least) the given angular radius
+    float eval(const vec3& w, float blurRadius) const
+    {
+        float level = glm::clamp(log2f(std::max<float>(blurRadius, 1e-6f)/radius(0.0f)), 0.0f, levels - 1.0f);
+        int l0 = std::min<int>((int)level, levels - 2);
+        return mix(lookup(l0, w), lookup(l0 + 1, w), level - l0);
+    }
+};
+
+void prefilterIES(const IESData& ies, IESProfile& profile)
+{
+    const int W = IESProfile::width;
+    const int H = IESProfile::height;
+    const float pi = 3.14159265f;
+
+    profile.data.assign(IESProfile::levels*W*H, 0.0f);
+
+    // level 0: point sampled radiance
+    std::vector<vec3> dirs(W*H);
+    std::vector<float> solidAngle(W*H);
+    for (int y = 0; y < H; ++y)
+    for (int x = 0; x < W; ++x)
+    {
+        vec3 w = IESProfile::direction(x, y);
+        float v = acosf(w.z)*180.0f/pi;
+        float h = (x + 0.5f)*360.0f/W;
+
+        dirs[x + y*W] = w;
+        solidAngle[x + y*W] = sqrtf(std::max<float>(0.0f, 1.0f - w.z*w.z));
+        profile.data[x + y*W] = candela(ies, v, h)/std::max<float>(fabsf(w.z), 0.05f);
+    }
+
+    // coarser levels: gaussian blur on the sphere
+    for (int level = 1; level < IESProfile::levels; ++level)
+    {
+        float r = IESProfile::radius((float)level);
+        float* dst = &profile.data[level*W*H];
+
+        for (int i = 0; i < W*H; ++i)
+        {
+            float sum = 0.0f;
+            float sumWeights = 0.0f;
+            for (int j = 0; j < W*H; ++j)
+            {
+                float angle = acosf(glm::clamp(dot(dirs[i], dirs[j]), -1.0f, 1.0f));
+                float weight = expf(-0.5f*angle*angle/(r*r))*solidAngle[j];
+                sum        += weight*profile.data[j];
+                sumWeights += weight;
+            }
+            dst[i] = sum/sumWeights;
+        }
+    }
+}
+
+// cache of prefiltered profiles
+// in memory, and on disk next to the source as <file>.ltcies
+static const uint32_t IES_CACHE_MAGIC   = 0x5345494c; // "LIES"
+static const uint32_t IES_CACHE_VERSION = 2;
+
+// written as is, without padding: the reserved field is 0
+struct IESCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t  sourceSize;
+    int64_t  sourceTime;   // modification time of the source, in ns
+    int32_t  width, height, levels;
+    uint32_t reserved;
+};
+
+// size and modification time of a file, in ns where the platform has them (st_mtime is in seconds, a source
+// rewritten within the same second would keep its cached profile)
+static bool statFile(const char* path, int64_t& size, int64_t& time)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    size = (int64_t)st.st_size;
+#if defined(__linux__)
+    time = (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    time = (int64_t)st.st_mtimespec.tv_sec*1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    time = (int64_t)st.st_mtime*1000000000;
+#endif
+    return true;
+}
+
+bool readIESCache(const char* path, const IESCacheHeader& expected, IESProfile& profile)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    IESCacheHeader hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+        hdr.magic == expected.magic && hdr.version == expected.version &&
+        hdr.sourceSize == expected.sourceSize && hdr.sourceTime == expected.sourceTime &&
+        hdr.width == expected.width && hdr.height == expected.height && hdr.levels == expected.levels &&
+        hdr.reserved == 0;
+
+    if (ok)
+    {
+        profile.data.resize(hdr.levels*hdr.width*hdr.height);
+        ok = fread(&profile.data[0], sizeof(float), profile.data.size(), f) == profile.data.size();
+    }
+
+    fclose(f);
+    return ok;
+}
+
+bool writeIESCache(const char* path, const IESCacheHeader& hdr, const IESProfile& profile)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+        fwrite(&profile.data[0], sizeof(float), profile.data.size(), f) == profile.data.size();
+
+    fclose(f);
+    return ok;
+}
+
+// profiles of a source in the memory cache, with the header of the source they were loaded from
+// the current profile is the last one: the ones of earlier versions of the source are kept, their pointers may
+// still be in use
+struct IESCacheEntry
+{
+    IESCacheHeader hdr;
+    std::list<IESProfile> profiles;
+};
+
+// parse and prefilter an IES file, going through the memory and disk caches
+// * a profile is reloaded when the size or the time of the source changed since it was cached
+// * thread safe, the loads are serialized
+const IESProfile* loadIES(const std::string& path, bool writeCache = true)
+{
+    static std::map<std::string, IESCacheEntry> cache;
+    static std::mutex mutex;
+
+    IESCacheHeader hdr = {};
+    hdr.magic   = IES_CACHE_MAGIC;
+    hdr.version = IES_CACHE_VERSION;
+    hdr.width   = IESProfile::width;
+    hdr.height  = IESProfile::height;
+    hdr.levels  = IESProfile::levels;
+    if (!statFile(path.c_str(), hdr.sourceSize, hdr.sourceTime))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::map<std::string, IESCacheEntry>::iterator it = cache.find(path);
+    if (it != cache.end() && it->second.hdr.sourceSize == hdr.sourceSize && it->second.hdr.sourceTime == hdr.sourceTime)
+        return &it->second.profiles.back();
+
+    IESProfile profile;
+    std::string cachePath = path + ".ltcies";
+
+    if (!readIESCache(cachePath.c_str(), hdr, profile))
+    {
+        std::ifstream file(path.c_str());
+        IESData ies;
+        if (!parseIES(file, ies))
+            return nullptr;
+
+        prefilterIES(ies, profile);
+
+        if (writeCache)
+            writeIESCache(cachePath.c_str(), hdr, profile);
+    }
+
+    IESCacheEntry& entry = cache[path];
+    entry.hdr = hdr;
+    entry.profiles.push_back(profile);
+    return &entry.profiles.back();
+}
+
+// LTC_Evaluate for a quad light with an IES profile
+// the profile is looked up once, in the average direction of the LTC-weighted light
+// (given by the vector form factor), blurred over the equivalent cap of the form factor
+// points[1] - points[0] is the luminaire's horizontal 0 axis, and the nadir of the profile
+// is the lit side of the polygon, cross(points[3] - points[0], points[1] - points[0])
+// returns the integral of the LTC lobe against the equivalent radiance of the luminaire
+float LTC_EvaluateIES(
+    const vec3& N, const vec3& V, const vec3& P, const mat3& Minv, const vec3 points[4], bool twoSided,
+    const IESProfile& profile)
+{
+    mat3 MinvFrame = LTC_ShadingFrame(N, V, Minv);
+
+    vec3 L[5];
+    L[0] = MinvFrame * (points[0] - P);
+    L[1] = MinvFrame * (points[1] - P);
+    L[2] = MinvFrame * (points[2] - P);
+    L[3] = MinvFrame * (points[3] - P);
+
+    int n;
+    ClipQuadToHorizon(L, n);
+
+    if (n == 0)
+        return 0.0f;
+
+    vec3 F = LTC_IntegratePolygon(L, n);
+    float sum = twoSided ? fabsf(F.z) : std::max<float>(0.0f, F.z);
+    if (sum == 0.0f)
+        return 0.0f;
+
+    // average direction towards the light, back from the cosine configuration to world space
+    float len = length(F);
+    vec3 dir = normalize(inverse(MinvFrame) * F);
+
+    // luminaire frame
+    vec3 X = points[1] - points[0];
+    vec3 Z = cross(points[3] - points[0], X);
+    float area = length(Z);
+    X = normalize(X);
+    Z = Z/area;
+    vec3 Y = cross(Z, X);
+
+    // emission direction in the luminaire frame
+    vec3 w = vec3(-dot(dir, X), -dot(dir, Y), -dot(dir, Z));
+
+    // spherical cap with the same form factor
+    float blurRadius = asinf(sqrtf(std::min<float>(len, 1.0f)));
+
+    return sum*profile.eval(w, blurRadius)/area;
+}
+
+#endif
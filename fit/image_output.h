@@ -0,0 +1,543 @@
+#ifndef _IMAGE_OUTPUT_
+#define _IMAGE_OUTPUT_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "float_to_half.h"
+#include "parallel.h"
+
+// output of the CPU renderers and bakers: HDR images (half float OpenEXR, PFM) and tonemapped PNG previews
+// * the input is the accumulation buffer of the demos: RGB sums and the number of samples in w, divided on output
+// * images are written in tiles, in any order and from any thread: the EXR and PFM files are uncompressed, so
+//   each tile goes straight to its place in the file, and only the 8-bit PNG preview is kept in memory
+// * the display transform is the one of ltc_blit.fs (ltc_tonemap.glsl), on packets of pixels
+
+// log2 and exp2 for the gamma of the display transform, branch-free so that the packet loops vectorize
+// (relative error below 1e-5, the result is quantized to 8 bits)
+inline float tonemapLog2(float x)
+{
+    int32_t bits;
+    memcpy(&bits, &x, 4);
+
+    // x = m 2^e with m in [1, 2), log2(m) from the series of atanh((m - 1)/(m + 1))
+    float e = (float)((bits >> 23) - 127);
+    int32_t mbits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &mbits, 4);
+
+    float t = (m - 1.0f)/(m + 1.0f);
+    float t2 = t*t;
+    return e + t*(2.8853901f + t2*(0.9617967f + t2*(0.5770780f + t2*0.4121986f)));
+}
+
+inline float tonemapExp2(float x)
+{
+    x = std::max<float>(x, -126.0f);
+
+    // 2^x = 2^i 2^f with f in [0, 1)
+    int32_t i = (int32_t)x;
+    i -= x < (float)i ? 1 : 0;
+    float f = x - (float)i;
+
+    float p = 1.0f + f*(0.6931472f + f*(0.2402265f + f*(0.0555041f + f*(0.0096181f + f*(0.0013333f + f*0.0001540f)))));
+
+    int32_t bits = (i + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, 4);
+    return p*scale;
+}
+
+// aces_fitted() and ToSRGB() of W accumulated pixels, to 8-bit RGB
+template<int W>
+void tonemapPacket(const vec4* rgba, unsigned char* rgb)
+{
+    float r[W], g[W], b[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        const vec4& c = rgba[lane];
+        float inv = c.w > 0.0f ? 1.0f/c.w : 0.0f;
+        r[lane] = c.x*inv;
+        g[lane] = c.y*inv;
+        b[lane] = c.z*inv;
+    }
+
+    for (int lane = 0; lane < W; ++lane)
+    {
+        // ACES_INPUT_MAT
+        float x = 0.59719f*r[lane] + 0.35458f*g[lane] + 0.04823f*b[lane];
+        float y = 0.07600f*r[lane] + 0.90834f*g[lane] + 0.01566f*b[lane];
+        float z = 0.02840f*r[lane] + 0.13383f*g[lane] + 0.83777f*b[lane];
+
+        // rrt_odt_fit()
+        x = (x*(x + 0.0245786f) - 0.000090537f)/(x*(0.983729f*x + 0.4329510f) + 0.238081f);
+        y = (y*(y + 0.0245786f) - 0.000090537f)/(y*(0.983729f*y + 0.4329510f) + 0.238081f);
+        z = (z*(z + 0.0245786f) - 0.000090537f)/(z*(0.983729f*z + 0.4329510f) + 0.238081f);
+
+        // ACES_OUTPUT_MAT and saturate()
+        r[lane] = glm::clamp( 1.60475f*x - 0.53108f*y - 0.07367f*z, 0.0f, 1.0f);
+        g[lane] = glm::clamp(-0.10208f*x + 1.10813f*y - 0.00605f*z, 0.0f, 1.0f);
+        b[lane] = glm::clamp(-0.00327f*x - 0.07276f*y + 1.07602f*z, 0.0f, 1.0f);
+    }
+
+    // ToSRGB(), 0 stays 0
+    float out[3][W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        const float p = 1.0f/2.2f;
+        out[0][lane] = r[lane] > 0.0f ? tonemapExp2(p*tonemapLog2(r[lane])) : 0.0f;
+        out[1][lane] = g[lane] > 0.0f ? tonemapExp2(p*tonemapLog2(g[lane])) : 0.0f;
+        out[2][lane] = b[lane] > 0.0f ? tonemapExp2(p*tonemapLog2(b[lane])) : 0.0f;
+    }
+
+    for (int lane = 0; lane < W; ++lane)
+    for (int c = 0; c < 3; ++c)
+        rgb[3*lane + c] = (unsigned char)(int)(255.0f*out[c][lane] + 0.5f);
+}
+
+// tonemapPacket() of count pixels, the last packet padded
+template<int W>
+void tonemapRow(const vec4* rgba, int count, unsigned char* rgb)
+{
+    int full = count - count % W;
+    for (int i = 0; i < full; i += W)
+        tonemapPacket<W>(rgba + i, rgb + 3*i);
+
+    if (full == count)
+        return;
+
+    vec4 in[W];
+    unsigned char out[3*W];
+    for (int lane = 0; lane < W; ++lane)
+        in[lane] = rgba[std::min<int>(full + lane, count - 1)];
+
+    tonemapPacket<W>(in, out);
+    memcpy(rgb + 3*full, out, 3*(count - full));
+}
+
+// tonemapping of a whole accumulation buffer, in blocks over the threads
+void tonemapImage(const vec4* rgba, int count, unsigned char* rgb, int threads = numThreads())
+{
+    const int blockSize = 4096;
+
+    parallel_for((count + blockSize - 1)/blockSize, [&](int block)
+    {
+        int first = block*blockSize;
+        tonemapRow<8>(rgba + first, std::min<int>(blockSize, count - first), rgb + 3*first);
+    }, threads);
+}
+
+// destination of the tiles of an image, see ImageOutput
+class ImageWriter
+{
+public:
+    virtual ~ImageWriter() {}
+
+    // tile of w x h pixels at (x, y), y down, rows of w accumulated pixels
+    // called concurrently for different tiles
+    virtual bool writeTile(int x, int y, int w, int h, const vec4* rgba) = 0;
+
+    virtual bool close() = 0;
+};
+
+// uncompressed file of a fixed layout, written at arbitrary offsets
+class TileFile
+{
+public:
+    TileFile() : file(nullptr) {}
+    ~TileFile() { close(); }
+
+    bool open(const char* path)
+    {
+        file = fopen(path, "wb");
+        return file != nullptr;
+    }
+
+    bool write(long offset, const void* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return file && fseek(file, offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+    }
+
+    bool close()
+    {
+        bool ok = !file || fclose(file) == 0;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file;
+    std::mutex mutex;
+};
+
+// scanline OpenEXR with half R, G, B channels and no compression
+// * one scanline per block: the offset table and the block headers are known when the file is opened
+// * within a block the channels are stored one after the other, in alphabetical order (B, G, R)
+class EXRWriter : public ImageWriter
+{
+public:
+    bool open(const char* path, int width, int height)
+    {
+        this->width = width;
+        if (!file.open(path))
+            return false;
+
+        std::vector<unsigned char> header;
+        auto bytes = [&](const void* data, size_t size)
+        {
+            header.insert(header.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+        };
+        auto int32 = [&](int32_t v) { bytes(&v, 4); };
+        auto attribute = [&](const char* name, const char* type, int32_t size)
+        {
+            bytes(name, strlen(name) + 1);
+            bytes(type, strlen(type) + 1);
+            int32(size);
+        };
+
+        int32(20000630); // magic number
+        int32(2);        // version 2, single part scanline file
+
+        attribute("channels", "chlist", 3*18 + 1);
+        const char* channels[3] = { "B", "G", "R" };
+        for (int c = 0; c < 3; ++c)
+        {
+            bytes(channels[c], 2);
+            int32(1);                       // HALF
+            int32(0);                       // pLinear and reserved
+            int32(1); int32(1);             // sampling
+        }
+        header.push_back(0);
+
+        attribute("compression", "compression", 1);
+        header.push_back(0);                // NO_COMPRESSION
+
+        for (int window = 0; window < 2; ++window)
+        {
+            attribute(window == 0 ? "dataWindow" : "displayWindow", "box2i", 16);
+            int32(0); int32(0); int32(width - 1); int32(height - 1);
+        }
+
+        attribute("lineOrder", "lineOrder", 1);
+        header.push_back(0);                // INCREASING_Y
+
+        const float one = 1.0f, zero = 0.0f;
+        attribute("pixelAspectRatio", "float", 4);
+        bytes(&one, 4);
+        attribute("screenWindowCenter", "v2f", 8);
+        bytes(&zero, 4); bytes(&zero, 4);
+        attribute("screenWindowWidth", "float", 4);
+        bytes(&one, 4);
+        header.push_back(0);
+
+        // offset table, then the (y, size) header of each block
+        blockSize = 8 + 3*2*width;
+        firstBlock = (long)header.size() + 8*height;
+        for (int y = 0; y < height; ++y)
+        {
+            uint64_t offset = firstBlock + (uint64_t)y*blockSize;
+            bytes(&offset, 8);
+        }
+        if (!file.write(0, &header[0], header.size()))
+            return false;
+
+        for (int y = 0; y < height; ++y)
+        {
+            int32_t block[2] = { y, 3*2*width };
+            if (!file.write(firstBlock + (long)y*blockSize, block, 8))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool writeTile(int x, int y, int w, int h, const vec4* rgba)
+    {
+        std::vector<uint16_t> row(3*w);
+        for (int j = 0; j < h; ++j)
+        {
+            for (int i = 0; i < w; ++i)
+            {
+                const vec4& c = rgba[i + j*w];
+                float inv = c.w > 0.0f ? 1.0f/c.w : 0.0f;
+                row[i        ] = float_to_half_fast(c.z*inv);
+                row[i +     w] = float_to_half_fast(c.y*inv);
+                row[i + 2*w] = float_to_half_fast(c.x*inv);
+            }
+
+            long line = firstBlock + (long)(y + j)*blockSize + 8;
+            for (int c = 0; c < 3; ++c)
+                if (!file.write(line + 2L*(c*width + x), &row[c*w], 2*w))
+                    return false;
+        }
+
+        return true;
+    }
+
+    bool close()
+    {
+        return file.close();
+    }
+
+private:
+    TileFile file;
+    int width;
+    long blockSize, firstBlock;
+};
+
+// little endian PFM, with the rows from the bottom of the image
+class PFMWriter : public ImageWriter
+{
+public:
+    bool open(const char* path, int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+
+        char header[64];
+        headerSize = snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", width, height);
+
+        return file.open(path) && file.write(0, header, headerSize);
+    }
+
+    bool writeTile(int x, int y, int w, int h, const vec4* rgba)
+    {
+        std::vector<float> row(3*w);
+        for (int j = 0; j < h; ++j)
+        {
+            for (int i = 0; i < w; ++i)
+            {
+                const vec4& c = rgba[i + j*w];
+                float inv = c.w > 0.0f ? 1.0f/c.w : 0.0f;
+                row[3*i    ] = c.x*inv;
+                row[3*i + 1] = c.y*inv;
+                row[3*i + 2] = c.z*inv;
+            }
+
+            long offset = headerSize + 12L*((long)(height - 1 - y - j)*width + x);
+            if (!file.write(offset, &row[0], 12*w))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool close()
+    {
+        return file.close();
+    }
+
+private:
+    TileFile file;
+    int width, height;
+    long headerSize;
+};
+
+// 8-bit RGB PNG of the tonemapped image, written on close() with stored (uncompressed) deflate blocks, so that
+// it needs no compression library
+class PNGWriter : public ImageWriter
+{
+public:
+    bool open(const char* path, int width, int height)
+    {
+        this->path = path;
+        this->width = width;
+        this->height = height;
+        pixels.assign(3*(size_t)width*height, 0);
+
+        // fail now rather than after the rendering
+        FILE* file = fopen(path, "wb");
+        if (!file)
+            return false;
+        fclose(file);
+        return true;
+    }
+
+    bool writeTile(int x, int y, int w, int h, const vec4* rgba)
+    {
+        for (int j = 0; j < h; ++j)
+            tonemapRow<8>(rgba + j*w, w, &pixels[3*((size_t)(y + j)*width + x)]);
+
+        return true;
+    }
+
+    bool close()
+    {
+        if (pixels.empty())
+            return true;
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        fwrite(signature, 1, 8, file);
+
+        unsigned char ihdr[13] = { 0 };
+        bigEndian(ihdr, width);
+        bigEndian(ihdr + 4, height);
+        ihdr[8] = 8;    // bit depth
+        ihdr[9] = 2;    // RGB
+        chunk(file, "IHDR", ihdr, 13);
+
+        // zlib stream of the rows, each preceded by filter 0, in IDAT chunks of one stored block
+        const size_t maxBlock = 65535;
+        std::vector<unsigned char> data;
+        data.push_back(0x78);
+        data.push_back(0x01);
+        std::vector<unsigned char> block;
+        uint32_t a = 1, b = 0;
+
+        auto flush = [&](bool last)
+        {
+            unsigned char head[5] = { (unsigned char)(last ? 1 : 0),
+                (unsigned char)(block.size() & 0xff), (unsigned char)(block.size() >> 8),
+                (unsigned char)(~block.size() & 0xff), (unsigned char)((~block.size() >> 8) & 0xff) };
+            data.insert(data.end(), head, head + 5);
+            data.insert(data.end(), block.begin(), block.end());
+            block.clear();
+
+            if (last)
+            {
+                data.resize(data.size() + 4);
+                bigEndian(&data[data.size() - 4], (b << 16) | a);
+            }
+
+            chunk(file, "IDAT", &data[0], data.size());
+            data.clear();
+        };
+
+        for (int y = 0; y < height; ++y)
+        for (int i = -1; i < 3*width; ++i)
+        {
+            unsigned char v = i < 0 ? 0 : pixels[3*(size_t)y*width + i];
+            a = (a + v) % 65521;
+            b = (b + a) % 65521;
+
+            block.push_back(v);
+            if (block.size() == maxBlock)
+                flush(false);
+        }
+        flush(true);
+
+        chunk(file, "IEND", nullptr, 0);
+
+        pixels.clear();
+        return fclose(file) == 0;
+    }
+
+private:
+    std::string path;
+    int width, height;
+    std::vector<unsigned char> pixels;
+
+    static void bigEndian(unsigned char* p, uint32_t v)
+    {
+        p[0] = v >> 24; p[1] = (v >> 16) & 0xff; p[2] = (v >> 8) & 0xff; p[3] = v & 0xff;
+    }
+
+    static void chunk(FILE* file, const char* type, const unsigned char* data, size_t size)
+    {
+        unsigned char length[4], crc[4];
+        bigEndian(length, (uint32_t)size);
+
+        uint32_t c = pngCrc(0xffffffff, (const unsigned char*)type, 4);
+        c = pngCrc(c, data, size) ^ 0xffffffff;
+        bigEndian(crc, c);
+
+        fwrite(length, 1, 4, file);
+        fwrite(type, 1, 4, file);
+        if (size)
+            fwrite(data, 1, size, file);
+        fwrite(crc, 1, 4, file);
+    }
+
+    static uint32_t pngCrc(uint32_t c, const unsigned char* data, size_t size)
+    {
+        struct Table
+        {
+            uint32_t entries[256];
+
+            Table()
+            {
+                for (uint32_t n = 0; n < 256; ++n)
+                {
+                    uint32_t t = n;
+                    for (int k = 0; k < 8; ++k)
+                        t = t & 1 ? 0xedb88320 ^ (t >> 1) : t >> 1;
+                    entries[n] = t;
+                }
+            }
+        };
+        static const Table table;
+
+        for (size_t i = 0; i < size; ++i)
+            c = table.entries[(c ^ data[i]) & 0xff] ^ (c >> 8);
+        return c;
+    }
+};
+
+// the files of one rendering or bake, written tile by tile
+// * paths left null are skipped
+// * writeTile() may be called from the rendering threads, for tiles that do not overlap
+struct ImageOutput
+{
+    EXRWriter exr;
+    PFMWriter pfm;
+    PNGWriter png;
+    std::vector<ImageWriter*> writers;
+
+    bool open(int width, int height, const char* exrPath, const char* pfmPath, const char* pngPath)
+    {
+        writers.clear();
+        if (exrPath)
+        {
+            if (!exr.open(exrPath, width, height))
+                return false;
+            writers.push_back(&exr);
+        }
+        if (pfmPath)
+        {
+            if (!pfm.open(pfmPath, width, height))
+                return false;
+            writers.push_back(&pfm);
+        }
+        if (pngPath)
+        {
+            if (!png.open(pngPath, width, height))
+                return false;
+            writers.push_back(&png);
+        }
+
+        return true;
+    }
+
+    bool writeTile(int x, int y, int w, int h, const vec4* rgba)
+    {
+        bool ok = true;
+        for (size_t i = 0; i < writers.size(); ++i)
+            ok = writers[i]->writeTile(x, y, w, h, rgba) && ok;
+        return ok;
+    }
+
+    bool close()
+    {
+        bool ok = true;
+        for (size_t i = 0; i < writers.size(); ++i)
+            ok = writers[i]->close() && ok;
+        writers.clear();
+        return ok;
+    }
+};
+
+#endif
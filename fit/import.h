@@ -0,0 +1,245 @@
+#ifndef _IMPORT_
+#define _IMPORT_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dds.h"
+#include "ltc_table.h"
+
+// import of the tables written by export.h, to seed a new fit (fitLTC --warm-start)
+// * every format is converted to the packed representation of packTab(): normalized inverse matrices in tex1,
+//   so that the table can be resampled at any resolution with LTCTable::fetch()
+// * tex2 only holds what the format stores: the magnitude for ltc.inc and ltc.mat, everything for the DDS and JS files
+
+// reads count numbers from p, skipping the separators, braces and 'f' suffixes in between
+bool readFloats(const char*& p, float* out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        while (*p && !(isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.'))
+            ++p;
+
+        char* end;
+        out[i] = strtof(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+    }
+    return true;
+}
+
+// same packing as packTab()
+void packMatrices(LTCTable& table, const std::vector<mat3>& tab, const std::vector<float>& magnitude, int N)
+{
+    table.size = N;
+    table.tex1.resize(N*N);
+    table.tex2.assign(N*N, vec4(0));
+
+    LTCMatrices M, invM;
+    M.resize(N*N);
+    for (int i = 0; i < N*N; ++i)
+        M.set(i, tab[i]);
+    ltcNormalizedInverse(M, invM);
+
+    for (int i = 0; i < N*N; ++i)
+    {
+        table.tex1[i] = invM.packed(i);
+        if (!magnitude.empty())
+            table.tex2[i].x = magnitude[i];
+    }
+}
+
+// ltc.inc, written by writeTabC()
+bool readTabC(const std::string& path, LTCTable& table)
+{
+    std::ifstream file(path.c_str());
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string text = content.str();
+
+    size_t pos = text.find("size = ");
+    if (pos == std::string::npos)
+        return false;
+
+    const int N = atoi(text.c_str() + pos + 7);
+    if (N < 2)
+        return false;
+
+    std::vector<mat3> tab(N*N);
+    std::vector<float> magnitude(N*N);
+
+    pos = text.find("tabM[size*size] = {");
+    if (pos == std::string::npos)
+        return false;
+
+    const char* p = text.c_str() + pos + 19;
+    for (int i = 0; i < N*N; ++i)
+        if (!readFloats(p, &tab[i][0][0], 9))
+            return false;
+
+    pos = text.find("tabMagnitude[size*size] = {");
+    if (pos == std::string::npos)
+        return false;
+
+    p = text.c_str() + pos + 27;
+    if (!readFloats(p, &magnitude[0], N*N))
+        return false;
+
+    packMatrices(table, tab, magnitude, N);
+    return true;
+}
+
+// ltc.mat, written by writeTabMatlab()
+bool readTabMatlab(const std::string& path, LTCTable& table)
+{
+    std::ifstream file(path.c_str());
+
+    std::vector<mat3> tab;
+    std::vector<float> magnitude;
+    int N = 0;
+    int found = 0;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 8, "# name: ") != 0)
+            continue;
+        const std::string name = line.substr(8);
+
+        // "# type" and "# ndims", then the dimensions
+        std::string type, ndims;
+        int rows, columns;
+        std::getline(file, type);
+        std::getline(file, ndims);
+        if (!(file >> rows >> columns) || rows != columns || rows < 2 || (N && rows != N))
+            return false;
+
+        if (!N)
+        {
+            N = rows;
+            tab.assign(N*N, mat3(0));
+            magnitude.assign(N*N, 0.0f);
+        }
+
+        float* dst;
+        int stride;
+        if (name == "tabMagnitude")
+        {
+            dst = &magnitude[0];
+            stride = 1;
+        }
+        else if (name.size() == 5 && name.compare(0, 3, "tab") == 0 &&
+                 name[3] >= '0' && name[3] <= '2' && name[4] >= '0' && name[4] <= '2')
+        {
+            // tab<column><row>
+            dst = &tab[0][name[3] - '0'][name[4] - '0'];
+            stride = 9;
+        }
+        else
+            return false;
+
+        for (int t = 0; t < N; ++t)
+        for (int a = 0; a < N; ++a)
+            if (!(file >> dst[(a + t*N)*stride]))
+                return false;
+
+        found++;
+    }
+
+    if (found != 10)
+        return false;
+
+    packMatrices(table, tab, magnitude, N);
+    return true;
+}
+
+// ltc.js, written by writeJS()
+bool readJS(const std::string& path, LTCTable& table)
+{
+    std::ifstream file(path.c_str());
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string text = content.str();
+
+    std::vector<float> data[2];
+    const char* names[2] = { "g_ltc_1 = [", "g_ltc_2 = [" };
+    for (int k = 0; k < 2; ++k)
+    {
+        size_t begin = text.find(names[k]);
+        size_t end = text.find("]", begin);
+        if (begin == std::string::npos || end == std::string::npos)
+            return false;
+
+        // the arrays end with a trailing comma
+        std::string values = text.substr(begin + 11, end - begin - 11);
+        const char* p = values.c_str();
+        for (float v; readFloats(p, &v, 1); )
+            data[k].push_back(v);
+    }
+
+    const int N = (int)(sqrtf(data[0].size()/4.0f) + 0.5f);
+    if (N < 2 || data[0].size() != size_t(4*N*N) || data[1].size() != size_t(4*N*N))
+        return false;
+
+    table.init((const vec4*)&data[0][0], (const vec4*)&data[1][0], N);
+    return true;
+}
+
+// ltc_1.dds, with ltc_2.dds next to it when it exists
+bool readDDS(const std::string& path, LTCTable& table)
+{
+    unsigned w, h;
+    float* data1 = LoadDDS(path.c_str(), &w, &h);
+    if (!data1 || w != h || w < 2)
+    {
+        delete[] data1;
+        return false;
+    }
+
+    std::string path2 = path;
+    size_t pos = path2.rfind("_1.dds");
+    float* data2 = nullptr;
+    unsigned w2 = 0, h2 = 0;
+    if (pos != std::string::npos)
+        data2 = LoadDDS(path2.replace(pos, 6, "_2.dds").c_str(), &w2, &h2);
+
+    table.size = w;
+    table.tex1.assign((const vec4*)data1, (const vec4*)data1 + w*h);
+    if (data2 && w2 == w && h2 == h)
+        table.tex2.assign((const vec4*)data2, (const vec4*)data2 + w*h);
+    else
+        table.tex2.assign(w*h, vec4(0));
+
+    delete[] data1;
+    delete[] data2;
+    return true;
+}
+
+// imports a table in any of the export formats, chosen by the file extension
+bool importTable(const std::string& path, LTCTable& table)
+{
+    size_t dot = path.rfind('.');
+    const std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+
+    if (ext == ".inc")
+        return readTabC(path, table);
+    if (ext == ".mat")
+        return readTabMatlab(path, table);
+    if (ext == ".js")
+        return readJS(path, table);
+    if (ext == ".dds")
+        return readDDS(path, table);
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _LTC_BTDF_
+#define _LTC_BTDF_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <vector>
+
+#include "btdf_ggx.h"
+#include "dds.h"
+#include "ltc_eval.h"
+#include "ltc_table.h"
+
+// rough dielectric transmission of polygonal lights, with the tables written by fitLTC --btdf
+// * the tables are 2D arrays of (roughness, sqrt(1 - cos(theta))) slices, one per eta, see btdfSliceEta()
+// * the transmitted lobe is fitted mirrored to the upper hemisphere, so a light seen through the surface
+//   is mirrored across the tangent plane and integrated as a reflected one
+struct LTCBtdfTable
+{
+    std::vector<LTCTable> slices;
+
+    bool load(const char* path1, const char* path2)
+    {
+        unsigned w1, h1, n1, w2, h2, n2;
+        float* data1 = LoadDDS(path1, &w1, &h1, &n1);
+        float* data2 = LoadDDS(path2, &w2, &h2, &n2);
+
+        bool ok = data1 && data2 && w1 == h1 && w1 == w2 && h1 == h2 && n1 == n2 && n1 > 1;
+        if (ok)
+        {
+            slices.resize(n1);
+            for (unsigned k = 0; k < n1; ++k)
+                slices[k].init((const vec4*)data1 + k*w1*h1, (const vec4*)data2 + k*w1*h1, w1);
+        }
+
+        delete[] data1;
+        delete[] data2;
+        return ok;
+    }
+
+    // slices around eta, and the interpolation weight of the second one
+    void slice(float eta, int& k0, int& k1, float& w) const
+    {
+        float x = glm::clamp(btdfSliceCoord(eta), 0.0f, 1.0f)*(slices.size() - 1);
+        k0 = std::min<int>((int)x, (int)slices.size() - 2);
+        k1 = k0 + 1;
+        w = x - k0;
+    }
+
+    vec4 fetch(bool tex1, float roughness, float cosTheta, float eta) const
+    {
+        int k0, k1;
+        float w;
+        slice(eta, k0, k1, w);
+
+        vec2 uv = slices[k0].uv(roughness, cosTheta);
+        vec4 t0 = slices[k0].fetch(tex1 ? slices[k0].tex1 : slices[k0].tex2, uv);
+        vec4 t1 = slices[k1].fetch(tex1 ? slices[k1].tex1 : slices[k1].tex2, uv);
+        return t0*(1.0f - w) + t1*w;
+    }
+
+    mat3 Minv(float roughness, float cosTheta, float eta) const
+    {
+        vec4 t1 = fetch(true, roughness, cosTheta, eta);
+
+        return mat3(
+            vec3(t1.x, 0, t1.y),
+            vec3(   0, 1,    0),
+            vec3(t1.z, 0, t1.w)
+        );
+    }
+
+    // transmitted energy, including (1 - F) and the 1/eta^2 radiance scaling
+    float magnitude(float roughness, float cosTheta, float eta) const
+    {
+        return fetch(false, roughness, cosTheta, eta).x;
+    }
+};
+
+// integral of the transmitted LTC lobe over a polygon on the other side of the surface
+// (V on the side of N, the light below the tangent plane at P)
+float LTC_EvaluateTransmission(
+    const vec3& N, const vec3& V, const vec3& P, const mat3& Minv, const vec3 points[4], bool twoSided)
+{
+    // mirror the polygon across the tangent plane; the winding is reversed so that
+    // the lit side of a one-sided light keeps facing the same way
+    vec3 mirrored[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        vec3 p = points[3 - i];
+        mirrored[i] = p - 2.0f*N*dot(p - P, N);
+    }
+
+    return LTC_Evaluate(N, V, P, Minv, mirrored, twoSided);
+}
+
+// shading of a polygonal light through a rough dielectric surface
+float LTC_EvaluateTransmission(
+    const vec3& N, const vec3& V, const vec3& P, float roughness, float eta,
+    const LTCBtdfTable& table, const vec3 points[4], bool twoSided)
+{
+    float ndotv = glm::clamp(dot(N, V), 0.0f, 1.0f);
+    mat3 Minv = table.Minv(roughness, ndotv, eta);
+
+    return table.magnitude(roughness, ndotv, eta)*LTC_EvaluateTransmission(N, V, P, Minv, points, twoSided);
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _LTC_COMBINED_
+#define _LTC_COMBINED_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <vector>
+
+#include "brdf_combined.h"
+#include "dds.h"
+#include "ltc_kernels.h"
+
+// shading of diffuse and specular materials with one LTC integral per light instead of two, with the tables
+// written by fitLTC --combined (see brdf_combined.h), through the kernels shared with the demos
+// (webgl/shaders/ltc/kernels/ltc_combined.glsl)
+// * the tables are 2D arrays of (roughness, sqrt(1 - cos(theta))) layers, one per fraction k of the energy in the
+//   specular lobe, see combinedSliceWeight()
+// * the specular color with Fresnel comes from the GGX magnitude and Fresnel terms in the second table, as in
+//   ltc_quad.fs, and sets k; the lobe of k is then integrated once, for the sum of both colors
+// * below a roughness (glsl::LTC_COMBINED_MIN_ROUGHNESS by default) the diffuse and GGX lobes are integrated
+//   separately, see ltcBench combined for the errors of one lobe per roughness
+
+struct LTCCombinedTable
+{
+    int size;
+    int layers;
+    std::vector<vec4> tex1;
+    std::vector<vec4> tex2;
+
+    LTCCombinedTable() : size(0), layers(0)
+    {
+    }
+
+    bool load(const char* path1, const char* path2)
+    {
+        unsigned w1, h1, n1, w2, h2, n2;
+        float* data1 = LoadDDS(path1, &w1, &h1, &n1);
+        float* data2 = LoadDDS(path2, &w2, &h2, &n2);
+
+        bool ok = data1 && data2 && w1 == h1 && w1 == w2 && h1 == h2 && n1 == n2 && n1 > 1;
+        if (ok)
+        {
+            size = w1;
+            layers = n1;
+            tex1.assign((const vec4*)data1, (const vec4*)data1 + n1*w1*h1);
+            tex2.assign((const vec4*)data2, (const vec4*)data2 + n1*w1*h1);
+        }
+
+        delete[] data1;
+        delete[] data2;
+        return ok;
+    }
+
+    // the lobes, and the GGX terms of the first layer of the second table, for the kernels
+    glsl::sampler2DArray sampler1() const
+    {
+        return glsl::makeSampler(tex1, size, layers);
+    }
+
+    glsl::sampler2D sampler2() const
+    {
+        return glsl::makeSampler(tex2, size);
+    }
+};
+
+// fraction of the energy of a material in its specular lobe, and its specular color with Fresnel
+float combinedSpecularWeight(
+    const LTCCombinedTable& table, float roughness, float cosTheta, const vec3& dcol, const vec3& scol, vec3& spec)
+{
+    vec4 t2 = glsl::texture(table.sampler2(), glsl::LTC_Coords(roughness, glm::clamp(cosTheta, 0.0f, 1.0f)));
+    return glsl::LTC_CombinedWeight(dcol, scol, t2, spec);
+}
+
+// light reflected by a material of diffuse color dcol and specular color scol, the colors of ltc_quad.fs,
+// with one integral per light from minRoughness up
+vec3 LTC_EvaluateCombined(
+    const vec3& N, const vec3& V, const vec3& P, float roughness, const vec3& dcol, const vec3& scol,
+    const LTCCombinedTable& table, const vec3 points[4], bool twoSided,
+    float minRoughness = glsl::LTC_COMBINED_MIN_ROUGHNESS)
+{
+    vec3 quad[4] = { points[0], points[1], points[2], points[3] };
+    return glsl::LTC_EvaluateCombined(N, V, P, roughness, dcol, scol, quad, twoSided, false, minRoughness,
+        table.sampler1(), table.sampler2());
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _LTC_EVAL_
+#define _LTC_EVAL_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include "ltc_kernels.h"
+
+// CPU evaluation of polygonal lights, on top of the edge integrals and clipping of the demo kernels (ltc_kernels.h)
+using glsl::IntegrateEdgeVec;
+using glsl::IntegrateEdge;
+using glsl::ClipQuadToHorizon;
+
+// rotate Minv into the (T1, T2, N) shading frame
+mat3 LTC_ShadingFrame(const vec3& N, const vec3& V, const mat3& Minv)
+{
+    // construct orthonormal basis around N
+    // (V == N has no preferred tangent, any one will do)
+    vec3 T1 = V - N*dot(V, N);
+    if (dot(T1, T1) < 1e-12f)
+        T1 = (fabsf(N.x) < 0.9f) ? vec3(1, 0, 0) : vec3(0, 1, 0);
+    T1 = normalize(T1 - N*dot(T1, N));
+    vec3 T2 = cross(N, T1);
+
+    return Minv * transpose(mat3(T1, T2, N));
+}
+
+// integrate a (clipped) polygon in the cosine configuration
+// returns the vector form factor, its z component being the integral
+vec3 LTC_IntegratePolygon(vec3 L[5], int n)
+{
+    // project onto sphere
+    for (int i = 0; i < n; ++i)
+        L[i] = normalize(L[i]);
+
+    vec3 vsum = vec3(0, 0, 0);
+    for (int i = 0; i < n; ++i)
+        vsum += IntegrateEdgeVec(L[i], L[(i + 1) % n]);
+
+    return vsum;
+}
+
+float LTC_Evaluate(
+    const vec3& N, const vec3& V, const vec3& P, const mat3& Minv, const vec3 points[4], bool twoSided)
+{
+    mat3 MinvFrame = LTC_ShadingFrame(N, V, Minv);
+
+    // polygon (allocate 5 vertices for clipping)
+    vec3 L[5];
+    L[0] = MinvFrame * (points[0] - P);
+    L[1] = MinvFrame * (points[1] - P);
+    L[2] = MinvFrame * (points[2] - P);
+    L[3] = MinvFrame * (points[3] - P);
+
+    int n;
+    ClipQuadToHorizon(L, n);
+
+    if (n == 0)
+        return 0.0f;
+
+    float sum = LTC_IntegratePolygon(L, n).z;
+
+    return twoSided ? fabsf(sum) : std::max<float>(0.0f, sum);
+}
+
+#endif
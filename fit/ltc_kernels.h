@@ -0,0 +1,24 @@
+#ifndef _LTC_KERNELS_
+#define _LTC_KERNELS_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include "glsl.h"
+
+// evaluation kernels shared with the WebGL demos, compiled from webgl/shaders/ltc/kernels in namespace glsl
+// * the demo shaders are generated from webgl/shaders/ltc/src by tools/shaderGen, which inlines the same files
+// * tables are passed as glsl::sampler2D, see makeSampler()
+
+namespace glsl
+{
+#include "../webgl/shaders/ltc/kernels/ltc_common.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_polygon.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_combined.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_disk.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_line.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_ray.glsl"
+#include "../webgl/shaders/ltc/kernels/ltc_tonemap.glsl"
+}
+
+#endif
@@ -0,0 +1,555 @@
+#ifndef _LTC_LIGHT_TREE_
+#define _LTC_LIGHT_TREE_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ltc_eval.h"
+#include "ltc_kernels.h"
+#include "ltc_lod.h"
+
+// stochastic selection among many quad, disk and sphere lights, guided by the LTC lobe
+// * the lights are organized in a binary tree, each node bounding its lights with a box, an orientation cone of
+//   their emission (one-sided lights emit on the side opposite to the area vector, see LTCLodLights) and the sums
+//   of their radiances and powers (radiance*area)
+// * the traversal picks a child with a probability proportional to its importance, from cheap bounds of the
+//   LTC integrals of its lights: the smaller of
+//     - the sum of their radiances times the clamped cosine over the cone bounding the box in the cosine
+//       configuration (the box corners transformed by Minv), as the integral of a light is its form factor there
+//     - their power times the maximum of the LTC distribution over the box, the cosine of their emission towards
+//       the shading point and 1/d^2, with D(w) = |det(Minv)|/pi cos'/|Minv w|^3 and, over the cone of directions
+//       of half-angle theta around c bounding the box, |Minv w| >= max(sigma_min, |Minv c| - sigma_max 2 sin(theta/2))
+//       (d is clamped to the size of the box, the first bound takes over for the lights close to the shading point)
+//   the importance is 0 only for the nodes whose lights are all below the horizon of the lobe or facing away, so
+//   lights that can contribute always have a non-zero probability and the estimates are unbiased
+// * the bound of a node can be non-zero when the bounds of all the lights below it are 0 (its box and cone are
+//   looser than theirs), so its importance is only its bound when one of its children has a non-zero importance:
+//   the traversal never ends at a node without a light to pick, and the importances are cached in the query for
+//   the other samples of the point
+// * the selected lights are evaluated exactly, with LTC_Evaluate(), LTC_EvaluateDisk() and spheres as the disk of
+//   their silhouette
+// * LTC_StreamLights() draws candidates for batches of shading points into reservoirs [Talbot et al. 2005], that
+//   keep one light per point for the shadow ray, with the weight of an unbiased estimate
+
+const float LTC_PI = 3.14159265f;
+
+enum LTCLightType
+{
+    LTC_LIGHT_QUAD,
+    LTC_LIGHT_DISK,   // inscribed in the quad points, as in LTC_EvaluateDisk()
+    LTC_LIGHT_SPHERE,
+};
+
+struct LTCLight
+{
+    int type;
+    vec3 points[4];   // quad and disk
+    vec3 center;
+    float radius;     // sphere
+    float radiance;
+    bool twoSided;
+};
+
+// shading point, with the LTC of its BRDF
+struct LTCShadingPoint
+{
+    vec3 N, V, P;
+    mat3 Minv;
+};
+
+// terms of the importance bounds that only depend on the shading point
+struct LTCLightQuery
+{
+    vec3 P;
+    mat3 MinvFrame;
+    float detScale;   // |det(Minv)|/pi
+    float sigmaMin, sigmaMax;
+
+    // importances of the nodes evaluated so far, -1 when not yet, filled by LTCLightTree::importance() for the
+    // samples of the point (a query is used with one tree, by one thread at a time)
+    mutable std::vector<float> importances;
+
+    LTCLightQuery(const LTCShadingPoint& point)
+    {
+        P = point.P;
+        MinvFrame = LTC_ShadingFrame(point.N, point.V, point.Minv);
+
+        ltcSingularValues(point.Minv, sigmaMin, sigmaMax);
+        sigmaMin = std::max<float>(sigmaMin, 1e-6f);
+        detScale = fabsf(ltcDeterminant(point.Minv))/LTC_PI;
+    }
+};
+
+// LTC integral of a light at a shading point, without its radiance
+float LTC_EvaluateLight(const LTCLight& light, const LTCShadingPoint& point, const glsl::sampler2D& ltc_2)
+{
+    vec3 points[4] = { light.points[0], light.points[1], light.points[2], light.points[3] };
+
+    if (light.type == LTC_LIGHT_QUAD)
+        return LTC_Evaluate(point.N, point.V, point.P, point.Minv, points, light.twoSided);
+
+    if (light.type == LTC_LIGHT_SPHERE)
+    {
+        vec3 w = light.center - point.P;
+        float d = length(w);
+
+        // inside the sphere, the lobe is covered
+        if (d <= light.radius)
+            return 1.0f;
+
+        // silhouette, the disk of the tangent circle
+        w /= d;
+        vec3 t1 = normalize(fabsf(w.x) < 0.9f ? cross(w, vec3(1, 0, 0)) : cross(w, vec3(0, 1, 0)));
+        vec3 t2 = cross(w, t1);
+        float r = light.radius*sqrtf(d*d - light.radius*light.radius)/d;
+        vec3 c = point.P + w*(d - light.radius*light.radius/d);
+
+        points[0] = c - r*t1 - r*t2;
+        points[1] = c + r*t1 - r*t2;
+        points[2] = c + r*t1 + r*t2;
+        points[3] = c - r*t1 + r*t2;
+    }
+
+    return glsl::LTC_EvaluateDisk(point.N, point.V, point.P, point.Minv, points,
+        light.twoSided || light.type == LTC_LIGHT_SPHERE, ltc_2);
+}
+
+struct LTCLightNode
+{
+    vec3 boundsMin, boundsMax;
+    vec3 axis;        // emission directions within theta of axis
+    float theta;      // pi: all directions
+    float radiance;   // sums over the lights
+    float power;
+    int parent;
+    int right;        // the left child follows its parent
+    int light;        // leaves, -1 for the interior nodes
+};
+
+struct LTCLightTree
+{
+    std::vector<LTCLight> lights;
+    std::vector<LTCLightNode> nodes;
+    std::vector<int> leaves;          // leaf of each light
+
+    void addQuad(const vec3 points[4], float radiance, bool twoSided)
+    {
+        add(LTC_LIGHT_QUAD, points, vec3(0), 0.0f, radiance, twoSided);
+    }
+
+    void addDisk(const vec3 points[4], float radiance, bool twoSided)
+    {
+        add(LTC_LIGHT_DISK, points, vec3(0), 0.0f, radiance, twoSided);
+    }
+
+    void addSphere(const vec3& center, float radius, float radiance)
+    {
+        const vec3 points[4] = { center, center, center, center };
+        add(LTC_LIGHT_SPHERE, points, center, radius, radiance, true);
+    }
+
+    // builds the tree over the lights added so far, splitting the centroids at the median of their largest extent
+    void build()
+    {
+        nodes.clear();
+        leaves.assign(lights.size(), -1);
+        if (lights.empty())
+            return;
+
+        std::vector<int> order(lights.size());
+        std::vector<vec3> centroids(lights.size());
+        for (int i = 0; i < (int)order.size(); ++i)
+        {
+            const LTCLightNode n = leaf(i);
+            order[i] = i;
+            centroids[i] = 0.5f*(n.boundsMin + n.boundsMax);
+        }
+
+        nodes.reserve(2*lights.size() - 1);
+        build(order, centroids, 0, (int)order.size(), -1);
+    }
+
+    // importance of a node at a shading point: its bound, or 0 when the importances of both its children are
+    float importance(const LTCLightQuery& query, int node) const
+    {
+        std::vector<float>& importances = query.importances;
+        if (importances.size() != nodes.size())
+            importances.assign(nodes.size(), -1.0f);
+        if (importances[node] >= 0.0f)
+            return importances[node];
+
+        // stops at the first child with a non-zero importance
+        float w = bound(query, node);
+        if (w > 0.0f && nodes[node].light < 0 &&
+            importance(query, node + 1) <= 0.0f && importance(query, nodes[node].right) <= 0.0f)
+            w = 0.0f;
+
+        importances[node] = w;
+        return w;
+    }
+
+    // bound of the sum of the LTC integrals of the lights of a node times their radiances at a shading point, it is 0
+    // only when none of them can contribute
+    float bound(const LTCLightQuery& query, int node) const
+    {
+        const LTCLightNode& n = nodes[node];
+        const vec3& P = query.P;
+
+        vec3 nearest = clamp(P, n.boundsMin, n.boundsMax);
+        vec3 toBox = nearest - P;
+        float dist2 = dot(toBox, toBox);
+
+        // cone bounding the box in the cosine configuration (none when the shading point is in the box)
+        float formFactor = 1.0f;
+        float maxCosine = 1.0f;
+        if (dist2 > 1e-12f)
+        {
+            vec3 corners[8];
+            vec3 axis = vec3(0);
+            for (int k = 0; k < 8; ++k)
+            {
+                vec3 corner = vec3(k & 1 ? n.boundsMax.x : n.boundsMin.x,
+                                   k & 2 ? n.boundsMax.y : n.boundsMin.y,
+                                   k & 4 ? n.boundsMax.z : n.boundsMin.z);
+                corners[k] = normalize(query.MinvFrame*(corner - P));
+                axis += corners[k];
+            }
+
+            float axisLength = length(axis);
+            if (axisLength > 1e-6f)
+            {
+                axis /= axisLength;
+                float cosAlpha = 1.0f;
+                for (int k = 0; k < 8; ++k)
+                    cosAlpha = std::min<float>(cosAlpha, dot(axis, corners[k]));
+                cosAlpha -= 1e-4f;
+
+                // cones of half-angle below pi/2 contain the transformed box
+                if (cosAlpha > 0.0f)
+                {
+                    // largest cosine in the cone, from the angle of its axis to the normal
+                    float cosAxis = axis.z;
+                    float sinAxis = sqrtf(std::max<float>(0.0f, 1.0f - cosAxis*cosAxis));
+                    float sinAlpha = sqrtf(std::max<float>(0.0f, 1.0f - cosAlpha*cosAlpha));
+                    maxCosine = cosAxis >= cosAlpha ? 1.0f : cosAxis*cosAlpha + sinAxis*sinAlpha;
+                    if (maxCosine <= 0.0f)
+                        return 0.0f;
+
+                    // clamped cosine over the cone, normalized by pi
+                    formFactor = std::min<float>(1.0f, 2.0f*(1.0f - cosAlpha)*maxCosine);
+                }
+            }
+        }
+
+        // cone of the box seen from P, the whole sphere from its bounding sphere
+        vec3 center = 0.5f*(n.boundsMin + n.boundsMax);
+        float boxRadius = 0.5f*length(n.boundsMax - n.boundsMin);
+        vec3 toBoxCenter = center - P;
+        float d = length(toBoxCenter);
+        float cosThetaU = -1.0f;
+        float emission = 1.0f;
+        if (d > boxRadius)
+        {
+            toBoxCenter /= d;
+            float sinThetaU = boxRadius/d;
+            cosThetaU = sqrtf(1.0f - sinThetaU*sinThetaU);
+
+            // largest cosine of the emission towards P, from the cone of the emitters
+            if (n.theta < LTC_PI)
+            {
+                float thetaW = acosf(glm::clamp(-dot(n.axis, toBoxCenter), -1.0f, 1.0f));
+                float theta = thetaW - n.theta - asinf(sinThetaU);
+                if (theta >= 0.5f*LTC_PI)
+                    return 0.0f;
+
+                emission = theta > 0.0f ? cosf(theta) : 1.0f;
+            }
+        }
+
+        // largest LTC distribution in the cone
+        float density = query.detScale*maxCosine/(query.sigmaMin*query.sigmaMin*query.sigmaMin);
+        if (d > boxRadius)
+        {
+            float chord = sqrtf(2.0f*(1.0f - cosThetaU));
+            float stretch = std::max<float>(query.sigmaMin, length(query.MinvFrame*toBoxCenter) - query.sigmaMax*chord);
+            density = query.detScale*maxCosine/(stretch*stretch*stretch);
+        }
+
+        // the distance is clamped to the size of the box, as lights close to the shading point are bounded by
+        // their form factors
+        float power = density*n.power*emission/std::max<float>(dist2, boxRadius*boxRadius);
+
+        return std::min<float>(n.radiance*formFactor, power);
+    }
+
+    // picks a light with a probability proportional to the importances along the path
+    // returns -1 when no light can contribute
+    int sample(const LTCLightQuery& query, float u, float& pdf) const
+    {
+        pdf = 0.0f;
+        if (nodes.empty() || importance(query, 0) <= 0.0f)
+            return -1;
+
+        pdf = 1.0f;
+        int node = 0;
+        while (nodes[node].light < 0)
+        {
+            const int left = node + 1;
+            const int right = nodes[node].right;
+            float wl = importance(query, left);
+            float wr = importance(query, right);
+
+            // the node has a non-zero importance, so one of its children has too
+            float p = wl/(wl + wr);
+            if (u < p)
+            {
+                node = left;
+                u = u/p;
+                pdf *= p;
+            }
+            else
+            {
+                node = right;
+                u = (u - p)/(1.0f - p);
+                pdf *= 1.0f - p;
+            }
+            u = std::min<float>(u, 0.99999994f);
+        }
+
+        return nodes[node].light;
+    }
+
+    // probability of sample() picking a light, to combine with the sampling of the BRDF
+    float pdf(const LTCLightQuery& query, int light) const
+    {
+        if (importance(query, 0) <= 0.0f)
+            return 0.0f;
+
+        float p = 1.0f;
+        for (int node = leaves[light]; nodes[node].parent >= 0; node = nodes[node].parent)
+        {
+            const int parent = nodes[node].parent;
+            const int sibling = node == parent + 1 ? nodes[parent].right : parent + 1;
+            float w = importance(query, node);
+            float ws = importance(query, sibling);
+            if (w <= 0.0f)
+                return 0.0f;
+
+            p *= w/(w + ws);
+        }
+        return p;
+    }
+
+private:
+    void add(int type, const vec3 points[4], const vec3& center, float radius, float radiance, bool twoSided)
+    {
+        LTCLight light;
+        light.type = type;
+        for (int k = 0; k < 4; ++k)
+            light.points[k] = points[k];
+        light.center = center;
+        light.radius = radius;
+        light.radiance = radiance;
+        light.twoSided = twoSided;
+        lights.push_back(light);
+    }
+
+    LTCLightNode leaf(int index) const
+    {
+        const LTCLight& light = lights[index];
+
+        LTCLightNode n;
+        n.radiance = light.radiance;
+        n.axis = vec3(0, 0, 1);
+        n.theta = LTC_PI;
+
+        if (light.type == LTC_LIGHT_SPHERE)
+        {
+            n.boundsMin = light.center - vec3(light.radius);
+            n.boundsMax = light.center + vec3(light.radius);
+            n.power = light.radiance*LTC_PI*light.radius*light.radius;
+        }
+        else
+        {
+            const vec3* p = light.points;
+            n.boundsMin = min(min(p[0], p[1]), min(p[2], p[3]));
+            n.boundsMax = max(max(p[0], p[1]), max(p[2], p[3]));
+
+            // area vector, away from the lit side
+            vec3 area = 0.5f*cross(p[2] - p[0], p[3] - p[1]);
+            float size = length(area);
+            if (light.type == LTC_LIGHT_DISK)
+                size = 0.25f*LTC_PI*length(cross(p[1] - p[2], p[1] - p[0]));
+            n.power = light.radiance*size;
+
+            if (!light.twoSided && length(area) > 0.0f)
+            {
+                n.axis = -normalize(area);
+                n.theta = 0.0f;
+            }
+        }
+
+        return n;
+    }
+
+    // smallest cone containing the cones a and b [Kulla and Conty 2017]
+    static void unionCone(const vec3& axisA, float thetaA, const vec3& axisB, float thetaB, vec3& axis, float& theta)
+    {
+        axis = axisA;
+        theta = LTC_PI;
+        if (thetaA >= LTC_PI || thetaB >= LTC_PI)
+            return;
+
+        float thetaD = acosf(glm::clamp(dot(axisA, axisB), -1.0f, 1.0f));
+        if (std::min<float>(thetaD + thetaB, LTC_PI) <= thetaA)
+        {
+            theta = thetaA;
+            return;
+        }
+        if (std::min<float>(thetaD + thetaA, LTC_PI) <= thetaB)
+        {
+            axis = axisB;
+            theta = thetaB;
+            return;
+        }
+
+        float thetaO = 0.5f*(thetaA + thetaD + thetaB);
+        vec3 ortho = axisB - axisA*dot(axisA, axisB);
+        if (thetaO >= LTC_PI || dot(ortho, ortho) < 1e-12f)
+            return;
+
+        // rotate a towards b, with some slack for the rounding
+        float thetaR = thetaO - thetaA;
+        axis = normalize(cosf(thetaR)*axisA + sinf(thetaR)*normalize(ortho));
+        theta = std::min<float>(thetaO + 1e-4f, LTC_PI);
+    }
+
+    int build(std::vector<int>& order, const std::vector<vec3>& centroids, int first, int last, int parent)
+    {
+        const int node = (int)nodes.size();
+        nodes.push_back(LTCLightNode());
+
+        if (last - first == 1)
+        {
+            LTCLightNode n = leaf(order[first]);
+            n.parent = parent;
+            n.right = -1;
+            n.light = order[first];
+            nodes[node] = n;
+            leaves[order[first]] = node;
+            return node;
+        }
+
+        // largest extent of the centroids
+        vec3 cmin = vec3(1e30f), cmax = vec3(-1e30f);
+        for (int i = first; i < last; ++i)
+        {
+            cmin = min(cmin, centroids[order[i]]);
+            cmax = max(cmax, centroids[order[i]]);
+        }
+        vec3 extent = cmax - cmin;
+        int dim = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        const int mid = (first + last)/2;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + last,
+            [&](int a, int b) { return centroids[a][dim] < centroids[b][dim]; });
+
+        build(order, centroids, first, mid, node);
+        const int right = build(order, centroids, mid, last, node);
+
+        const LTCLightNode& l = nodes[node + 1];
+        const LTCLightNode& r = nodes[right];
+
+        LTCLightNode n;
+        n.boundsMin = min(l.boundsMin, r.boundsMin);
+        n.boundsMax = max(l.boundsMax, r.boundsMax);
+        unionCone(l.axis, l.theta, r.axis, r.theta, n.axis, n.theta);
+        n.radiance = l.radiance + r.radiance;
+        n.power = l.power + r.power;
+        n.parent = parent;
+        n.right = right;
+        n.light = -1;
+        nodes[node] = n;
+
+        return node;
+    }
+};
+
+// weighted reservoir of one light among a stream of candidates
+struct LTCLightReservoir
+{
+    int light;         // -1: none yet
+    float target;      // radiance times the LTC integral of the light
+    float weightSum;
+    int count;
+
+    LTCLightReservoir() : light(-1), target(0.0f), weightSum(0.0f), count(0)
+    {
+    }
+
+    // adds a candidate of weight target/pdf, u uniform in [0, 1)
+    // (candidates that could not be drawn still count, with no light and a weight of 0)
+    void update(int candidate, float candidateTarget, float weight, float u)
+    {
+        count++;
+        if (weight <= 0.0f)
+            return;
+
+        weightSum += weight;
+        if (u*weightSum < weight)
+        {
+            light = candidate;
+            target = candidateTarget;
+        }
+    }
+
+    // adds the candidates of a reservoir of the same shading point
+    void merge(const LTCLightReservoir& other, float u)
+    {
+        int n = count + other.count;
+        update(other.light, other.target, other.weightSum, u);
+        count = n;
+    }
+
+    // weight of the unshadowed contribution of the selected light, so that target*contributionWeight() is an
+    // unbiased estimate of the sum over the lights
+    float contributionWeight() const
+    {
+        return light >= 0 && target > 0.0f ? weightSum/(count*target) : 0.0f;
+    }
+};
+
+// draws numCandidates lights from the tree for each of count shading points, and streams them into the reservoirs
+// (that are not reset, so that batches of candidates accumulate)
+// * random() returns uniform numbers in [0, 1), 2 per candidate
+template<class Random>
+void LTC_StreamLights(
+    const LTCLightTree& tree, const LTCShadingPoint* points, int count, int numCandidates,
+    const glsl::sampler2D& ltc_2, Random& random, LTCLightReservoir* reservoirs)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const LTCLightQuery query(points[i]);
+
+        for (int c = 0; c < numCandidates; ++c)
+        {
+            float pdf;
+            int light = tree.sample(query, random(), pdf);
+            float u = random();
+            if (light < 0)
+            {
+                reservoirs[i].update(-1, 0.0f, 0.0f, u);
+                continue;
+            }
+
+            float target = tree.lights[light].radiance*LTC_EvaluateLight(tree.lights[light], points[i], ltc_2);
+            reservoirs[i].update(light, target, target/pdf, u);
+        }
+    }
+}
+
+#endif
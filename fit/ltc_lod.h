@@ -0,0 +1,146 @@
+#ifndef _LTC_LOD_
+#define _LTC_LOD_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ltc_eval.h"
+#include "ltc_matrix.h"
+
+// level of detail for quad lights: lights that are small as seen through the lobe are shaded as points
+// * the point evaluation is D(w) Omega, the LTC distribution (D() of ltc_line.fs) in the direction w of the light
+//   center times the solid angle of the light, instead of clipping and integrating the polygon
+// * its relative error is second order in the angular radius r of the light; Minv magnifies angles by up to
+//   kappa = sigma_max(Minv)/sigma_min(Minv), and the lobe varies faster near the horizon of the cosine
+//   configuration (elevation z) and the light's solid angle near grazing (cosine c of the light), so
+//     error ~= LTC_LOD_ERROR_SCALE*((kappa r/z)^2 + (r/c)^2)
+// * lights entirely behind a one-sided light or below the horizon are culled, everything else falls back
+//   to LTC_Evaluate()
+
+const float LTC_LOD_ERROR_SCALE = 0.5f;
+
+// lights in structure of arrays layout, so that the point evaluations are vectorized
+struct LTCLodLights
+{
+    std::vector<float> cx, cy, cz; // center
+    std::vector<float> ax, ay, az; // area vector, pointing away from the lit side
+    std::vector<float> radius;     // bounding sphere radius
+    std::vector<char> twoSided;
+    std::vector<vec3> points;      // 4 vertices per light, for the full evaluations
+
+    int size() const
+    {
+        return (int)radius.size();
+    }
+
+    void add(const vec3 quad[4], bool twoSidedLight)
+    {
+        vec3 center = 0.25f*(quad[0] + quad[1] + quad[2] + quad[3]);
+        vec3 area = 0.5f*cross(quad[2] - quad[0], quad[3] - quad[1]);
+
+        float r = 0.0f;
+        for (int i = 0; i < 4; ++i)
+            r = std::max<float>(r, length(quad[i] - center));
+
+        cx.push_back(center.x); cy.push_back(center.y); cz.push_back(center.z);
+        ax.push_back(area.x);   ay.push_back(area.y);   az.push_back(area.z);
+        radius.push_back(r);
+        twoSided.push_back(twoSidedLight);
+        points.insert(points.end(), quad, quad + 4);
+    }
+};
+
+// extreme singular values of Minv, for the fitted structure of the matrices (see ltcLobeScale())
+void ltcSingularValues(const mat3& Minv, float& sigmaMin, float& sigmaMax)
+{
+    // singular values of the 2x2 block, the middle one is Minv[1][1]
+    float a = Minv[0][0], b = Minv[2][0], c = Minv[0][2], d = Minv[2][2];
+    float s1 = a*a + b*b + c*c + d*d;
+    float s2 = sqrtf(std::max<float>(0.0f, (a*a + b*b - c*c - d*d)*(a*a + b*b - c*c - d*d) + 4.0f*(a*c + b*d)*(a*c + b*d)));
+    float m = fabsf(Minv[1][1]);
+    sigmaMax = std::max<float>(sqrtf(0.5f*(s1 + s2)), m);
+    sigmaMin = std::min<float>(sqrtf(std::max<float>(0.0f, 0.5f*(s1 - s2))), m);
+}
+
+// ratio of the extreme singular values of Minv
+float ltcLobeCondition(const mat3& Minv)
+{
+    float sigmaMin, sigmaMax;
+    ltcSingularValues(Minv, sigmaMin, sigmaMax);
+
+    return sigmaMax/std::max<float>(sigmaMin, 1e-6f);
+}
+
+// evaluates count lights at P into result, switching each light to the point evaluation when its error estimate
+// is below maxError (relative to the light's integral)
+// returns the number of full polygon evaluations
+int LTC_EvaluateLOD(
+    const vec3& N, const vec3& V, const vec3& P, const mat3& Minv, const LTCLodLights& lights, float* result,
+    float maxError = 1e-2f)
+{
+    const float pi = 3.14159265f;
+    const int count = lights.size();
+
+    const mat3 MinvFrame = LTC_ShadingFrame(N, V, Minv);
+    const float detScale = fabsf(ltcDeterminant(Minv))/pi;
+    const float kappa = ltcLobeCondition(Minv);
+    const float errorScale = maxError/LTC_LOD_ERROR_SCALE;
+
+    const float* cx = &lights.cx[0];
+    const float* cy = &lights.cy[0];
+    const float* cz = &lights.cz[0];
+    const float* ax = &lights.ax[0];
+    const float* ay = &lights.ay[0];
+    const float* az = &lights.az[0];
+    const float* radius = &lights.radius[0];
+    const char* twoSided = &lights.twoSided[0];
+
+    // point evaluations, with the unnormalized direction c to the center, wo = MinvFrame*c and d = |c|:
+    // D(c/d) Omega = det(Minv)/pi max(0, wo.z) dot(A, c)/|wo|^4
+    // full evaluations are flagged with result < 0
+    for (int i = 0; i < count; ++i)
+    {
+        float x = cx[i] - P.x, y = cy[i] - P.y, z = cz[i] - P.z;
+        float d2 = x*x + y*y + z*z;
+
+        float wx = MinvFrame[0][0]*x + MinvFrame[1][0]*y + MinvFrame[2][0]*z;
+        float wy = MinvFrame[0][1]*x + MinvFrame[1][1]*y + MinvFrame[2][1]*z;
+        float wz = MinvFrame[0][2]*x + MinvFrame[1][2]*y + MinvFrame[2][2]*z;
+        float wo2 = wx*wx + wy*wy + wz*wz;
+
+        float facing = ax[i]*x + ay[i]*y + az[i]*z;
+        float area2 = ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i];
+        facing = twoSided[i] ? fabsf(facing) : facing;
+
+        float value = detScale*std::max<float>(0.0f, wz)*facing/(wo2*wo2);
+
+        // squared angular radius, elevation in the cosine configuration and cosine of the light
+        float r2 = radius[i]*radius[i]/d2;
+        float elevation2 = wz*wz/wo2;
+        float cosLight2 = facing*facing/(area2*d2);
+        float error = kappa*kappa*r2/elevation2 + r2/cosLight2;
+
+        // back side of a one-sided light, or below the horizon: nothing to integrate
+        bool culled = facing <= 0.0f || (wz < 0.0f && elevation2 > kappa*kappa*r2);
+
+        result[i] = culled ? 0.0f : (error <= errorScale && wz > 0.0f ? value : -1.0f);
+    }
+
+    int full = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (result[i] >= 0.0f)
+            continue;
+
+        result[i] = LTC_Evaluate(N, V, P, Minv, &lights.points[4*i], twoSided[i] != 0);
+        full++;
+    }
+
+    return full;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef _LTC_MATRIX_
+#define _LTC_MATRIX_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <vector>
+
+#include "parallel.h"
+
+// inverse, determinant and normalization of LTC matrices, one at a time or in batches
+// * the matrices of the fits and of the tables have 5 non-zero terms: the frame of a lobe is a rotation in the
+//   plane of V and the normal, and the parametric matrix only shears within that plane (see LTC::update()):
+//       | m00   0  m20 |
+//       |   0 m11    0 |      (m[column][row], as glm)
+//       | m02   0  m22 |
+//   so the inverse is the inverse of the 2x2 block and 1/m11, and the determinant m11 (m00 m22 - m20 m02)
+// * the normalized inverse is the inverse divided by its middle term, the terms of the tables (see packTab())
+// * LTCMatrices holds the terms in structure of arrays: the batches are processed in packets of W matrices
+//   without dependencies between the lanes, which compilers vectorize (see tonemapPacket())
+// the functions take any mat3 but only read the 5 terms: the others must be 0
+
+// terms of the inverse, or of the normalized inverse, of (m00, m02, m20, m22, m11), and the determinant
+template<bool NORMALIZE>
+inline void ltcInverseTerms(
+    float m00, float m02, float m20, float m22, float m11,
+    float& i00, float& i02, float& i20, float& i22, float& i11, float& det)
+{
+    float det2 = m00*m22 - m20*m02;
+    float s = NORMALIZE ? m11/det2 : 1.0f/det2;
+
+    i00 =  m22*s;
+    i02 = -m02*s;
+    i20 = -m20*s;
+    i22 =  m00*s;
+    i11 = NORMALIZE ? 1.0f : 1.0f/m11;
+    det = m11*det2;
+}
+
+inline float ltcDeterminant(const mat3& M)
+{
+    return M[1][1]*(M[0][0]*M[2][2] - M[2][0]*M[0][2]);
+}
+
+template<bool NORMALIZE>
+inline mat3 ltcInverse(const mat3& M)
+{
+    float i00, i02, i20, i22, i11, det;
+    ltcInverseTerms<NORMALIZE>(M[0][0], M[0][2], M[2][0], M[2][2], M[1][1], i00, i02, i20, i22, i11, det);
+
+    return mat3(
+        vec3(i00,   0, i02),
+        vec3(  0, i11,   0),
+        vec3(i20,   0, i22)
+    );
+}
+
+inline mat3 ltcInverse(const mat3& M)
+{
+    return ltcInverse<false>(M);
+}
+
+// inverse divided by its middle term
+inline mat3 ltcNormalizedInverse(const mat3& M)
+{
+    return ltcInverse<true>(M);
+}
+
+// batch of matrices, in structure of arrays
+struct LTCMatrices
+{
+    std::vector<float> m00, m02, m20, m22, m11;
+
+    int size() const
+    {
+        return (int)m00.size();
+    }
+
+    void resize(int count)
+    {
+        m00.resize(count);
+        m02.resize(count);
+        m20.resize(count);
+        m22.resize(count);
+        m11.resize(count);
+    }
+
+    void set(int i, const mat3& M)
+    {
+        m00[i] = M[0][0];
+        m02[i] = M[0][2];
+        m20[i] = M[2][0];
+        m22[i] = M[2][2];
+        m11[i] = M[1][1];
+    }
+
+    // normalized matrix of the terms of a table (see LTCTable::Minv())
+    void set(int i, const vec4& packed)
+    {
+        m00[i] = packed.x;
+        m02[i] = packed.y;
+        m20[i] = packed.z;
+        m22[i] = packed.w;
+        m11[i] = 1.0f;
+    }
+
+    mat3 get(int i) const
+    {
+        return mat3(
+            vec3(m00[i],      0, m02[i]),
+            vec3(     0, m11[i],      0),
+            vec3(m20[i],      0, m22[i])
+        );
+    }
+
+    // terms of a table, for a normalized matrix
+    vec4 packed(int i) const
+    {
+        return vec4(m00[i], m02[i], m20[i], m22[i]);
+    }
+};
+
+// inverses of the matrices [first, first + W) of M in Minv, and their determinants in det (if not NULL)
+template<int W, bool NORMALIZE>
+void ltcInversePacket(const LTCMatrices& M, LTCMatrices& Minv, float* det, int first)
+{
+    float m00[W], m02[W], m20[W], m22[W], m11[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        m00[lane] = M.m00[first + lane];
+        m02[lane] = M.m02[first + lane];
+        m20[lane] = M.m20[first + lane];
+        m22[lane] = M.m22[first + lane];
+        m11[lane] = M.m11[first + lane];
+    }
+
+    float i00[W], i02[W], i20[W], i22[W], i11[W], d[W];
+    for (int lane = 0; lane < W; ++lane)
+        ltcInverseTerms<NORMALIZE>(m00[lane], m02[lane], m20[lane], m22[lane], m11[lane],
+            i00[lane], i02[lane], i20[lane], i22[lane], i11[lane], d[lane]);
+
+    for (int lane = 0; lane < W; ++lane)
+    {
+        Minv.m00[first + lane] = i00[lane];
+        Minv.m02[first + lane] = i02[lane];
+        Minv.m20[first + lane] = i20[lane];
+        Minv.m22[first + lane] = i22[lane];
+        Minv.m11[first + lane] = i11[lane];
+    }
+
+    if (det)
+        for (int lane = 0; lane < W; ++lane)
+            det[first + lane] = d[lane];
+}
+
+// the matrices [first, first + count), in packets and one by one for the remainder
+template<int W, bool NORMALIZE>
+void ltcInverseRange(const LTCMatrices& M, LTCMatrices& Minv, float* det, int first, int count)
+{
+    int full = count - count % W;
+    for (int i = 0; i < full; i += W)
+        ltcInversePacket<W, NORMALIZE>(M, Minv, det, first + i);
+
+    for (int i = first + full; i < first + count; ++i)
+    {
+        float d;
+        ltcInverseTerms<NORMALIZE>(M.m00[i], M.m02[i], M.m20[i], M.m22[i], M.m11[i],
+            Minv.m00[i], Minv.m02[i], Minv.m20[i], Minv.m22[i], Minv.m11[i], d);
+        if (det)
+            det[i] = d;
+    }
+}
+
+template<bool NORMALIZE>
+void ltcInverseBatch(const LTCMatrices& M, LTCMatrices& Minv, float* det, int threads)
+{
+    const int blockSize = 4096;
+    const int count = M.size();
+    Minv.resize(count);
+
+    parallel_for((count + blockSize - 1)/blockSize, [&](int block)
+    {
+        int first = block*blockSize;
+        ltcInverseRange<8, NORMALIZE>(M, Minv, det, first, std::min<int>(blockSize, count - first));
+    }, threads);
+}
+
+// inverses of a batch, and their determinants in det[M.size()] (if not NULL)
+void ltcInverse(const LTCMatrices& M, LTCMatrices& Minv, float* det = NULL, int threads = numThreads())
+{
+    ltcInverseBatch<false>(M, Minv, det, threads);
+}
+
+// inverses divided by their middle terms, and the determinants of M in det[M.size()] (if not NULL)
+void ltcNormalizedInverse(const LTCMatrices& M, LTCMatrices& Minv, float* det = NULL, int threads = numThreads())
+{
+    ltcInverseBatch<true>(M, Minv, det, threads);
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _LTC_MOTION_
+#define _LTC_MOTION_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include "ltc_eval.h"
+
+// motion-blurred quad lights: the integral of a polygonal light averaged over the shutter interval
+// * the vertices move linearly from their position at shutter open to their position at shutter close
+// * the interval is subdivided adaptively: an interval is accepted when the vector form factor at its middle
+//   is predicted by the ends to within the tolerance, and is then integrated with Simpson's rule;
+//   lights moving little, or far from the shading point, cost 3 evaluations instead of one per time sample
+// * the shading frame only depends on the shading point, so it is computed once for all the time samples
+
+struct MotionQuadLight
+{
+    vec3 open[4];  // vertices at shutter open
+    vec3 close[4]; // vertices at shutter close
+    bool twoSided;
+};
+
+// shading point of a batched evaluation, with the LTC matrix of its (roughness, cos(theta))
+struct MotionQuery
+{
+    vec3 N, V, P;
+    mat3 Minv;
+};
+
+// maximal number of bisections of the shutter interval, 2^LTC_MOTION_MAX_DEPTH + 1 evaluations at most
+const int LTC_MOTION_MAX_DEPTH = 6;
+
+// vector form factor of the light at time t, MinvFrame from LTC_ShadingFrame()
+vec3 LTC_MotionFormFactor(const mat3& MinvFrame, const vec3& P, const MotionQuadLight& light, float t)
+{
+    vec3 L[5];
+    for (int i = 0; i < 4; ++i)
+        L[i] = MinvFrame*(mix(light.open[i], light.close[i], t) - P);
+
+    int n;
+    ClipQuadToHorizon(L, n);
+
+    if (n == 0)
+        return vec3(0, 0, 0);
+
+    return LTC_IntegratePolygon(L, n);
+}
+
+float LTC_MotionValue(const vec3& F, bool twoSided)
+{
+    return twoSided ? fabsf(F.z) : std::max<float>(0.0f, F.z);
+}
+
+// integral of the light averaged over the shutter interval
+// tolerance is on the vector form factor (the integral is in [0, 1]), evaluations returns the number of polygon integrals
+float LTC_EvaluateMotion(
+    const vec3& N, const vec3& V, const vec3& P, const mat3& Minv, const MotionQuadLight& light,
+    float tolerance = 3e-3f, int* evaluations = nullptr)
+{
+    mat3 MinvFrame = LTC_ShadingFrame(N, V, Minv);
+
+    // intervals still to be integrated: ends and middle, their form factors and the depth
+    struct Interval
+    {
+        float t0, t1;
+        vec3 F0, Fm, F1;
+        int depth;
+    };
+
+    Interval stack[LTC_MOTION_MAX_DEPTH + 1];
+    int top = 0;
+
+    stack[0].t0 = 0.0f;
+    stack[0].t1 = 1.0f;
+    stack[0].F0 = LTC_MotionFormFactor(MinvFrame, P, light, 0.0f);
+    stack[0].Fm = LTC_MotionFormFactor(MinvFrame, P, light, 0.5f);
+    stack[0].F1 = LTC_MotionFormFactor(MinvFrame, P, light, 1.0f);
+    stack[0].depth = 0;
+
+    int count = 3;
+    float sum = 0.0f;
+
+    while (top >= 0)
+    {
+        Interval I = stack[top--];
+
+        // the middle is predicted by the ends: the form factor is close to linear over the interval
+        vec3 residual = I.Fm - 0.5f*(I.F0 + I.F1);
+        if (dot(residual, residual) <= tolerance*tolerance || I.depth == LTC_MOTION_MAX_DEPTH)
+        {
+            float f0 = LTC_MotionValue(I.F0, light.twoSided);
+            float fm = LTC_MotionValue(I.Fm, light.twoSided);
+            float f1 = LTC_MotionValue(I.F1, light.twoSided);
+            sum += (I.t1 - I.t0)*(f0 + 4.0f*fm + f1)/6.0f;
+            continue;
+        }
+
+        // bisect, the halves reuse the three form factors
+        float tm = 0.5f*(I.t0 + I.t1);
+
+        Interval left, right;
+        left.t0  = I.t0; left.t1  = tm;   left.F0  = I.F0; left.F1  = I.Fm;
+        right.t0 = tm;   right.t1 = I.t1; right.F0 = I.Fm; right.F1 = I.F1;
+        left.Fm  = LTC_MotionFormFactor(MinvFrame, P, light, 0.5f*(left.t0 + left.t1));
+        right.Fm = LTC_MotionFormFactor(MinvFrame, P, light, 0.5f*(right.t0 + right.t1));
+        left.depth = right.depth = I.depth + 1;
+        count += 2;
+
+        stack[++top] = right;
+        stack[++top] = left;
+    }
+
+    if (evaluations)
+        *evaluations += count;
+
+    return sum;
+}
+
+// batched evaluation of one light over count shading points
+// returns the total number of polygon integrals
+int LTC_EvaluateMotion(
+    const MotionQuery* queries, int count, const MotionQuadLight& light, float* result, float tolerance = 3e-3f)
+{
+    int evaluations = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const MotionQuery& q = queries[i];
+        result[i] = LTC_EvaluateMotion(q.N, q.V, q.P, q.Minv, light, tolerance, &evaluations);
+    }
+    return evaluations;
+}
+
+#endif
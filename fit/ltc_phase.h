@@ -0,0 +1,251 @@
+#ifndef _LTC_PHASE_
+#define _LTC_PHASE_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ltc_eval.h"
+#include "ltc_table.h"
+#include "phase_hg.h"
+
+// single scattering of quad lights in a homogeneous medium, with the Henyey-Greenstein table written by
+// fitLTC --phase (see phase_hg.h)
+// * at a point x of a ray of direction d, the integral of the phase function p(d.w) over the light is the LTC
+//   integral of the polygon, in the frame of the normal of the light plane towards the light
+// * along a ray, that frame, cos(theta) = |d.N| and the LTC matrix are the same for all the points on one side of
+//   the light plane, so the march steps are evaluated in packets of W, one SIMD lane per step: only the vertices
+//   depend on the step, L_i = MinvFrame (q_i - o) - t MinvFrame d
+// * the packets use the clipless evaluation of the demos (the horizon-clipped sphere in the w component of the
+//   table), branch-free, and LTC_EvaluatePhase() clips to the horizon
+// * the transmittance between a step and the light is approximated by the one to the center of the light
+
+struct LTCPhaseTable
+{
+    LTCTable table;
+
+    bool load(const char* path1, const char* path2)
+    {
+        return table.load(path1, path2);
+    }
+
+    mat3 Minv(float g, float cosTheta) const
+    {
+        return table.Minv(phaseRoughness(g), cosTheta);
+    }
+
+    // fraction of the phase function on the side of the light plane
+    float magnitude(float g, float cosTheta) const
+    {
+        return table.magFresnel(phaseRoughness(g), cosTheta).x;
+    }
+};
+
+struct LTCMedium
+{
+    float sigmaS;   // scattering coefficient
+    float sigmaT;   // extinction coefficient
+    float g;        // Henyey-Greenstein asymmetry
+};
+
+struct LTCPhaseLight
+{
+    vec3 points[4];
+    float radiance;
+    bool twoSided;
+};
+
+// integral of the phase function over a quad light seen from x, for a ray of direction d
+// (one-sided lights are lit on the side where their winding is counterclockwise, as in LTC_Evaluate())
+float LTC_EvaluatePhase(
+    const vec3& d, float g, const vec3& x, const LTCPhaseTable& table, const vec3 points[4], bool twoSided)
+{
+    vec3 n = cross(points[1] - points[0], points[3] - points[0]);
+    float side = dot(points[0] - x, n);
+
+    if (side == 0.0f || (side < 0.0f && !twoSided))
+        return 0.0f;
+
+    // normal of the light plane towards the light, and the ray going towards the plane
+    vec3 N = normalize(side > 0.0f ? n : -n);
+    vec3 V = d;
+    if (dot(V, N) < 0.0f)
+    {
+        V = -V;
+        g = -g;
+    }
+
+    float cosTheta = dot(V, N);
+
+    // the whole polygon is on the side of N, its winding was accounted for above
+    return table.magnitude(g, cosTheta)*LTC_Evaluate(N, V, x, table.Minv(g, cosTheta), points, true);
+}
+
+// terms of LTC_EvaluatePhasePacket() that are constant along a ray o + t d: for both sides of the light plane,
+// the vertices in the LTC frame at t = 0 and their derivative in t, and the magnitude (0 behind a one-sided light)
+struct LTCPhaseSegment
+{
+    float planeDist, dn;
+    float ax[2][4], ay[2][4], az[2][4];
+    float bx[2], by[2], bz[2];
+    float scale[2];
+
+    void init(const vec3& o, const vec3& d, float g, const LTCPhaseTable& table, const vec3 points[4], bool twoSided)
+    {
+        vec3 n = normalize(cross(points[1] - points[0], points[3] - points[0]));
+        planeDist = dot(points[0] - o, n);
+        dn = dot(d, n);
+
+        for (int s = 0; s < 2; ++s)
+        {
+            vec3 N = s == 0 ? n : -n;
+            vec3 V = dot(d, N) < 0.0f ? -d : d;
+            float gs = dot(d, N) < 0.0f ? -g : g;
+            float cosTheta = dot(V, N);
+
+            mat3 MinvFrame = LTC_ShadingFrame(N, V, table.Minv(gs, cosTheta));
+            for (int i = 0; i < 4; ++i)
+            {
+                vec3 a = MinvFrame*(points[i] - o);
+                ax[s][i] = a.x; ay[s][i] = a.y; az[s][i] = a.z;
+            }
+
+            vec3 b = MinvFrame*d;
+            bx[s] = b.x; by[s] = b.y; bz[s] = b.z;
+
+            scale[s] = s == 0 || twoSided ? table.magnitude(gs, cosTheta) : 0.0f;
+        }
+    }
+};
+
+// LTC_EvaluatePhase() at the W points o + t[lane] d of a segment, with the clipless approximation
+template<int W>
+void LTC_EvaluatePhasePacket(const LTCPhaseSegment& seg, const float t[W], const LTCPhaseTable& table, float result[W])
+{
+    // directions to the vertices, on the side of the light plane of each step (the first one repeated after the last)
+    float vx[5][W], vy[5][W], vz[5][W];
+    float front[W];
+
+    for (int lane = 0; lane < W; ++lane)
+        front[lane] = seg.planeDist - t[lane]*seg.dn >= 0.0f ? 1.0f : 0.0f;
+
+    for (int i = 0; i < 4; ++i)
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float f = front[lane];
+        float x = f*(seg.ax[0][i] - t[lane]*seg.bx[0]) + (1.0f - f)*(seg.ax[1][i] - t[lane]*seg.bx[1]);
+        float y = f*(seg.ay[0][i] - t[lane]*seg.by[0]) + (1.0f - f)*(seg.ay[1][i] - t[lane]*seg.by[1]);
+        float z = f*(seg.az[0][i] - t[lane]*seg.bz[0]) + (1.0f - f)*(seg.az[1][i] - t[lane]*seg.bz[1]);
+        float inv = 1.0f/sqrtf(x*x + y*y + z*z);
+        vx[i][lane] = x*inv;
+        vy[i][lane] = y*inv;
+        vz[i][lane] = z*inv;
+    }
+
+    for (int lane = 0; lane < W; ++lane)
+    {
+        vx[4][lane] = vx[0][lane];
+        vy[4][lane] = vy[0][lane];
+        vz[4][lane] = vz[0][lane];
+    }
+
+    // vector form factor, as in IntegrateEdgeVec()
+    float fx[W], fy[W], fz[W];
+    for (int lane = 0; lane < W; ++lane)
+        fx[lane] = fy[lane] = fz[lane] = 0.0f;
+
+    for (int e = 0; e < 4; ++e)
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float x1 = vx[e][lane], y1 = vy[e][lane], z1 = vz[e][lane];
+        float x2 = vx[e + 1][lane], y2 = vy[e + 1][lane], z2 = vz[e + 1][lane];
+
+        float x = x1*x2 + y1*y2 + z1*z2;
+        float y = fabsf(x);
+
+        float a = 0.8543985f + (0.4965155f + 0.0145206f*y)*y;
+        float b = 3.4175940f + (4.1616724f + y)*y;
+        float v = a/b;
+        float w = 0.5f/sqrtf(std::max<float>(1.0f - x*x, 1e-7f)) - v;
+        float thetaSinTheta = x > 0.0f ? v : w;
+
+        fx[lane] += (y1*z2 - z1*y2)*thetaSinTheta;
+        fy[lane] += (z1*x2 - x1*z2)*thetaSinTheta;
+        fz[lane] += (x1*y2 - y1*x2)*thetaSinTheta;
+    }
+
+    // the winding is reversed seen from the back
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float f = front[lane];
+        float len = std::max<float>(sqrtf(fx[lane]*fx[lane] + fy[lane]*fy[lane] + fz[lane]*fz[lane]), 1e-7f);
+        float z = fz[lane]/len*(2.0f*f - 1.0f);
+
+        result[lane] = (f*seg.scale[0] + (1.0f - f)*seg.scale[1])*len*table.table.sphere(z, len);
+    }
+}
+
+// weight of the step [t0, t1] of a ray: the integral of sigma_s exp(-sigma_t t)
+float LTC_PhaseStepWeight(const LTCMedium& medium, float t0, float t1)
+{
+    float a = medium.sigmaT*(t1 - t0);
+    float w = a > 1e-4f ? (1.0f - expf(-a))/medium.sigmaT : t1 - t0;
+
+    return medium.sigmaS*expf(-medium.sigmaT*t0)*w;
+}
+
+// radiance scattered towards -d by the medium along the ray o + t d, t in [0, tMax], from count lights
+// * steps uniform steps, each evaluated at its start plus jitter in [0, 1) steps
+// * packets of W steps with the clipless evaluation, or one step at a time with LTC_EvaluatePhase() (W = 1)
+template<int W>
+float LTC_InScattering(
+    const vec3& o, const vec3& d, float tMax, const LTCMedium& medium, const LTCPhaseLight* lights, int count,
+    const LTCPhaseTable& table, int steps, float jitter)
+{
+    const float dt = tMax/steps;
+
+    std::vector<LTCPhaseSegment> segments(W > 1 ? count : 0);
+    for (int l = 0; l < (int)segments.size(); ++l)
+        segments[l].init(o, d, medium.g, table, lights[l].points, lights[l].twoSided);
+
+    float sum = 0.0f;
+
+    for (int first = 0; first < steps; first += W)
+    {
+        // the last packet is padded with steps of weight 0
+        float t[W], weight[W];
+        for (int lane = 0; lane < W; ++lane)
+        {
+            int k = std::min<int>(first + lane, steps - 1);
+            t[lane] = (k + jitter)*dt;
+            weight[lane] = first + lane < steps ? LTC_PhaseStepWeight(medium, k*dt, (k + 1)*dt) : 0.0f;
+        }
+
+        for (int l = 0; l < count; ++l)
+        {
+            const LTCPhaseLight& light = lights[l];
+            vec3 center = 0.25f*(light.points[0] + light.points[1] + light.points[2] + light.points[3]);
+            vec3 c = center - o;
+
+            float value[W];
+            if (W == 1)
+                value[0] = LTC_EvaluatePhase(d, medium.g, o + t[0]*d, table, light.points, light.twoSided);
+            else
+                LTC_EvaluatePhasePacket<W>(segments[l], t, table, value);
+
+            for (int lane = 0; lane < W; ++lane)
+            {
+                float x = c.x - t[lane]*d.x, y = c.y - t[lane]*d.y, z = c.z - t[lane]*d.z;
+                float transmittance = expf(-medium.sigmaT*sqrtf(x*x + y*y + z*z));
+                sum += weight[lane]*light.radiance*transmittance*value[lane];
+            }
+        }
+    }
+
+    return sum;
+}
+
+#endif
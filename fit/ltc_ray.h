@@ -0,0 +1,465 @@
+#ifndef _LTC_RAY_
+#define _LTC_RAY_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// intersection of packets of rays with the light shapes, for shadow rays and reference renderings
+// * the shapes and the nearest hit at t > 0 follow the kernels of the demos (ltc_ray.glsl), that are the
+//   scalar reference
+// * packets of W rays in structure of arrays layout, one SIMD lane per ray: the tests are branch-free lane loops
+//   that the compiler vectorizes (see genie.lua), for the ISA of the build, SSE2 on x86-64
+// * LTCRayBVH::intersectWidest() traces the streams with copies of the traversal compiled for AVX2 (W = 8) and
+//   AVX-512 (W = 16), chosen at run time, with GCC and clang
+// * LTCRayBVH bounds the shapes with a binary tree of boxes, traversed by whole packets: packets of coherent rays
+//   (neighbouring pixels) share most of their traversal, incoherent streams (shadow rays to random lights) are
+//   traced faster with W = 1, see ltcBench rays
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LTC_RAY_DISPATCH
+#endif
+
+enum LTCRayShapeType
+{
+    LTC_SHAPE_RECT,
+    LTC_SHAPE_DISK,       // ellipses, disks have halfx = halfy
+    LTC_SHAPE_SPHERE,
+    LTC_SHAPE_CYLINDER,
+    LTC_SHAPE_CAPSULE,
+};
+
+struct LTCRayShape
+{
+    int type;
+    vec3 center;          // rect, disk and sphere
+    vec3 dirx, diry;      // rect and disk, orthonormal
+    float halfx, halfy;
+    vec3 p1, p2;          // axis of cylinders and capsules
+    float radius;
+    bool endCaps;         // cylinders
+
+    void bounds(vec3& boundsMin, vec3& boundsMax) const
+    {
+        if (type == LTC_SHAPE_RECT || type == LTC_SHAPE_DISK)
+        {
+            vec3 extent = abs(dirx)*halfx + abs(diry)*halfy;
+            boundsMin = center - extent;
+            boundsMax = center + extent;
+        }
+        else if (type == LTC_SHAPE_SPHERE)
+        {
+            boundsMin = center - vec3(radius);
+            boundsMax = center + vec3(radius);
+        }
+        else
+        {
+            boundsMin = min(p1, p2) - vec3(radius);
+            boundsMax = max(p1, p2) + vec3(radius);
+        }
+    }
+};
+
+// W rays, with the distance and the shape of their nearest hits so far
+template<int W>
+struct LTCRayPacket
+{
+    float ox[W], oy[W], oz[W];
+    float dx[W], dy[W], dz[W];
+    float t[W];           // tMax, then the nearest hit
+    int shape[W];         // -1: no hit
+
+    // the last packet of a stream is padded with its last ray
+    void load(const vec3* origins, const vec3* dirs, int count, float tMax)
+    {
+        for (int lane = 0; lane < W; ++lane)
+        {
+            int i = std::min<int>(lane, count - 1);
+            ox[lane] = origins[i].x; oy[lane] = origins[i].y; oz[lane] = origins[i].z;
+            dx[lane] = dirs[i].x;    dy[lane] = dirs[i].y;    dz[lane] = dirs[i].z;
+            t[lane] = tMax;
+            shape[lane] = -1;
+        }
+    }
+};
+
+// keeps the hits at (0, t[lane]) of a packet
+template<int W>
+inline void ltcRayKeep(LTCRayPacket<W>& packet, const float th[W], const float valid[W], int id)
+{
+    for (int lane = 0; lane < W; ++lane)
+    {
+        int closer = (valid[lane] != 0.0f) & (th[lane] > 0.0f) & (th[lane] < packet.t[lane]);
+        packet.t[lane] = closer ? th[lane] : packet.t[lane];
+        packet.shape[lane] = closer ? id : packet.shape[lane];
+    }
+}
+
+// rectangles and ellipses
+template<int W>
+void LTC_IntersectPlanar(LTCRayPacket<W>& packet, const LTCRayShape& s, int id)
+{
+    vec3 n = cross(s.dirx, s.diry);
+    float nc = dot(n, s.center);
+    float xc = dot(s.dirx, s.center), yc = dot(s.diry, s.center);
+    float invx = 1.0f/s.halfx, invy = 1.0f/s.halfy;
+    const bool rect = s.type == LTC_SHAPE_RECT;
+
+    float th[W], valid[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float ox = packet.ox[lane], oy = packet.oy[lane], oz = packet.oz[lane];
+        float dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+
+        float t = (nc - (n.x*ox + n.y*oy + n.z*oz))/(n.x*dx + n.y*dy + n.z*dz);
+
+        // coordinates of the hit in the plane of the shape, relative to its half sizes
+        float x = (s.dirx.x*(ox + t*dx) + s.dirx.y*(oy + t*dy) + s.dirx.z*(oz + t*dz) - xc)*invx;
+        float y = (s.diry.x*(ox + t*dx) + s.diry.y*(oy + t*dy) + s.diry.z*(oz + t*dz) - yc)*invy;
+
+        bool inside = rect ? fabsf(x) <= 1.0f && fabsf(y) <= 1.0f : x*x + y*y <= 1.0f;
+        th[lane] = t;
+        valid[lane] = inside ? 1.0f : 0.0f;
+    }
+
+    ltcRayKeep<W>(packet, th, valid, id);
+}
+
+// roots t0 <= t1 of the quadratic a t^2 + b t + c, as SolveQuadratic() of ltc_ray.glsl, real when the
+// discriminant is >= 0
+inline void ltcRayQuadratic(float a, float b, float c, float& t0, float& t1, float& discriminant)
+{
+    float d = b*b - 4.0f*a*c;
+    float q = -0.5f*(b + (b < 0.0f ? -1.0f : 1.0f)*sqrtf(std::max<float>(d, 0.0f)));
+    float r0 = q/a, r1 = c/q;
+    t0 = std::min<float>(r0, r1);
+    t1 = std::max<float>(r0, r1);
+    discriminant = d;
+}
+
+template<int W>
+void LTC_IntersectSphere(LTCRayPacket<W>& packet, const vec3& center, float radius, int id)
+{
+    float th[W], valid[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float ox = packet.ox[lane] - center.x, oy = packet.oy[lane] - center.y, oz = packet.oz[lane] - center.z;
+        float dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+
+        float t0, t1, v;
+        ltcRayQuadratic(dx*dx + dy*dy + dz*dz, 2.0f*(dx*ox + dy*oy + dz*oz), ox*ox + oy*oy + oz*oz - radius*radius,
+            t0, t1, v);
+
+        th[lane] = t0 > 0.0f ? t0 : t1;
+        valid[lane] = v >= 0.0f ? 1.0f : 0.0f;
+    }
+
+    ltcRayKeep<W>(packet, th, valid, id);
+}
+
+// side of cylinders and capsules, and the end caps of closed cylinders
+template<int W>
+void LTC_IntersectCylinder(LTCRayPacket<W>& packet, const vec3& p1, const vec3& p2, float radius, bool endCaps, int id)
+{
+    float len = length(p2 - p1);
+    vec3 axis = (p2 - p1)/len;
+    float r2 = radius*radius;
+
+    float th[W], valid[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float ox = packet.ox[lane] - p1.x, oy = packet.oy[lane] - p1.y, oz = packet.oz[lane] - p1.z;
+        float dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+
+        // along the axis (s) and orthogonal to it (op + t dp)
+        float os = ox*axis.x + oy*axis.y + oz*axis.z;
+        float ds = dx*axis.x + dy*axis.y + dz*axis.z;
+        float opx = ox - axis.x*os, opy = oy - axis.y*os, opz = oz - axis.z*os;
+        float dpx = dx - axis.x*ds, dpy = dy - axis.y*ds, dpz = dz - axis.z*ds;
+
+        float t0, t1, v;
+        ltcRayQuadratic(dpx*dpx + dpy*dpy + dpz*dpz, 2.0f*(dpx*opx + dpy*opy + dpz*opz),
+            opx*opx + opy*opy + opz*opz - r2, t0, t1, v);
+
+        float s0 = os + t0*ds, s1 = os + t1*ds;
+        // (non short-circuit & and |, that keep the loop free of branches)
+        int hit0 = (v >= 0.0f) & (t0 > 0.0f) & (s0 >= 0.0f) & (s0 <= len);
+        int hit1 = (v >= 0.0f) & (t1 > 0.0f) & (s1 >= 0.0f) & (s1 <= len);
+        float t = hit0 ? t0 : t1;
+        int hit = hit0 | hit1;
+
+        // caps at s = 0 and s = len
+        int caps = (int)endCaps & (fabsf(ds) > 1e-7f);
+        float tc0 = -os/ds, tc1 = (len - os)/ds;
+        float q0x = opx + tc0*dpx, q0y = opy + tc0*dpy, q0z = opz + tc0*dpz;
+        float q1x = opx + tc1*dpx, q1y = opy + tc1*dpy, q1z = opz + tc1*dpz;
+        int cap0 = caps & (tc0 > 0.0f) & (q0x*q0x + q0y*q0y + q0z*q0z <= r2) & ((hit == 0) | (tc0 < t));
+        t = cap0 ? tc0 : t;
+        hit = hit | cap0;
+        int cap1 = caps & (tc1 > 0.0f) & (q1x*q1x + q1y*q1y + q1z*q1z <= r2) & ((hit == 0) | (tc1 < t));
+        t = cap1 ? tc1 : t;
+        hit = hit | cap1;
+
+        th[lane] = t;
+        valid[lane] = hit ? 1.0f : 0.0f;
+    }
+
+    ltcRayKeep<W>(packet, th, valid, id);
+}
+
+template<int W>
+void LTC_IntersectShape(LTCRayPacket<W>& packet, const LTCRayShape& s, int id)
+{
+    switch (s.type)
+    {
+    case LTC_SHAPE_RECT:
+    case LTC_SHAPE_DISK:
+        LTC_IntersectPlanar<W>(packet, s, id);
+        break;
+    case LTC_SHAPE_SPHERE:
+        LTC_IntersectSphere<W>(packet, s.center, s.radius, id);
+        break;
+    case LTC_SHAPE_CYLINDER:
+        LTC_IntersectCylinder<W>(packet, s.p1, s.p2, s.radius, s.endCaps, id);
+        break;
+    case LTC_SHAPE_CAPSULE:
+        LTC_IntersectCylinder<W>(packet, s.p1, s.p2, s.radius, false, id);
+        LTC_IntersectSphere<W>(packet, s.p1, s.radius, id);
+        LTC_IntersectSphere<W>(packet, s.p2, s.radius, id);
+        break;
+    }
+}
+
+struct LTCRayNode
+{
+    vec3 boundsMin, boundsMax;
+    int axis;             // of the split, the near child is visited first
+    int right;            // the left child follows its parent
+    int first, count;     // leaves: shapes[order[first]] ... , count = 0 for the interior nodes
+};
+
+struct LTCRayBVH
+{
+    std::vector<LTCRayShape> shapes;
+    std::vector<LTCRayNode> nodes;
+    std::vector<int> order;
+
+    static const int LEAF_SIZE = 2;
+    static const int MAX_DEPTH = 64;
+
+    void addRect(const vec3& center, const vec3& dirx, const vec3& diry, float halfx, float halfy)
+    {
+        LTCRayShape s = LTCRayShape();
+        s.type = LTC_SHAPE_RECT;
+        s.center = center; s.dirx = dirx; s.diry = diry; s.halfx = halfx; s.halfy = halfy;
+        shapes.push_back(s);
+    }
+
+    void addDisk(const vec3& center, const vec3& dirx, const vec3& diry, float halfx, float halfy)
+    {
+        addRect(center, dirx, diry, halfx, halfy);
+        shapes.back().type = LTC_SHAPE_DISK;
+    }
+
+    void addSphere(const vec3& center, float radius)
+    {
+        LTCRayShape s = LTCRayShape();
+        s.type = LTC_SHAPE_SPHERE;
+        s.center = center; s.radius = radius;
+        shapes.push_back(s);
+    }
+
+    void addCylinder(const vec3& p1, const vec3& p2, float radius, bool endCaps)
+    {
+        LTCRayShape s = LTCRayShape();
+        s.type = LTC_SHAPE_CYLINDER;
+        s.p1 = p1; s.p2 = p2; s.radius = radius; s.endCaps = endCaps;
+        shapes.push_back(s);
+    }
+
+    void addCapsule(const vec3& p1, const vec3& p2, float radius)
+    {
+        addCylinder(p1, p2, radius, false);
+        shapes.back().type = LTC_SHAPE_CAPSULE;
+    }
+
+    // builds the tree over the shapes added so far, splitting the centroids at the median of their largest extent
+    void build()
+    {
+        nodes.clear();
+        order.resize(shapes.size());
+        if (shapes.empty())
+            return;
+
+        std::vector<vec3> boundsMin(shapes.size()), boundsMax(shapes.size());
+        for (int i = 0; i < (int)shapes.size(); ++i)
+        {
+            shapes[i].bounds(boundsMin[i], boundsMax[i]);
+            order[i] = i;
+        }
+
+        nodes.reserve(2*shapes.size());
+        build(boundsMin, boundsMax, 0, (int)shapes.size(), 0);
+    }
+
+    // nearest hits of a packet, within the t[] it was loaded with
+    template<int W>
+    void intersect(LTCRayPacket<W>& packet) const
+    {
+        if (nodes.empty())
+            return;
+
+        float ix[W], iy[W], iz[W];
+        for (int lane = 0; lane < W; ++lane)
+        {
+            ix[lane] = 1.0f/packet.dx[lane];
+            iy[lane] = 1.0f/packet.dy[lane];
+            iz[lane] = 1.0f/packet.dz[lane];
+        }
+
+        int stack[MAX_DEPTH];
+        int top = 0;
+        stack[0] = 0;
+
+        while (top >= 0)
+        {
+            const int index = stack[top--];
+            const LTCRayNode& node = nodes[index];
+
+            // slab test, the packet goes on while one of its rays overlaps the box before its nearest hit
+            int any = 0;
+            for (int lane = 0; lane < W; ++lane)
+            {
+                float tx0 = (node.boundsMin.x - packet.ox[lane])*ix[lane], tx1 = (node.boundsMax.x - packet.ox[lane])*ix[lane];
+                float ty0 = (node.boundsMin.y - packet.oy[lane])*iy[lane], ty1 = (node.boundsMax.y - packet.oy[lane])*iy[lane];
+                float tz0 = (node.boundsMin.z - packet.oz[lane])*iz[lane], tz1 = (node.boundsMax.z - packet.oz[lane])*iz[lane];
+
+                float tNear = std::max<float>(std::max<float>(std::min<float>(tx0, tx1), std::min<float>(ty0, ty1)),
+                    std::max<float>(std::min<float>(tz0, tz1), 0.0f));
+                float tFar = std::min<float>(std::min<float>(std::max<float>(tx0, tx1), std::max<float>(ty0, ty1)),
+                    std::min<float>(std::max<float>(tz0, tz1), packet.t[lane]));
+                any |= tNear <= tFar ? 1 : 0;
+            }
+
+            if (!any)
+                continue;
+
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; ++i)
+                    LTC_IntersectShape<W>(packet, shapes[order[i]], order[i]);
+                continue;
+            }
+
+            // near child on top, from the direction of the first ray
+            float d = node.axis == 0 ? packet.dx[0] : (node.axis == 1 ? packet.dy[0] : packet.dz[0]);
+            int left = index + 1;
+            stack[++top] = d < 0.0f ? left : node.right;
+            stack[++top] = d < 0.0f ? node.right : left;
+        }
+    }
+
+    // nearest hits of a stream of rays within tMax, shape = -1 for the misses
+    template<int W>
+    void intersect(const vec3* origins, const vec3* dirs, int count, float tMax, float* t, int* shape) const
+    {
+        for (int first = 0; first < count; first += W)
+        {
+            LTCRayPacket<W> packet;
+            packet.load(origins + first, dirs + first, count - first, tMax);
+            intersect<W>(packet);
+
+            for (int lane = 0; lane < W && first + lane < count; ++lane)
+            {
+                t[first + lane] = packet.t[lane];
+                shape[first + lane] = packet.shape[lane];
+            }
+        }
+    }
+
+    // packet width of intersectWidest(), 16 with AVX-512, 8 otherwise
+    static int widestPacket()
+    {
+#ifdef LTC_RAY_DISPATCH
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"))
+            return 16;
+#endif
+        return 8;
+    }
+
+    // nearest hits of a stream of coherent rays, as intersect<W>(), with the widest packets of the CPU
+    void intersectWidest(const vec3* origins, const vec3* dirs, int count, float tMax, float* t, int* shape) const
+    {
+#ifdef LTC_RAY_DISPATCH
+        if (widestPacket() == 16)
+            return intersectAVX512(origins, dirs, count, tMax, t, shape);
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return intersectAVX2(origins, dirs, count, tMax, t, shape);
+#endif
+        intersect<8>(origins, dirs, count, tMax, t, shape);
+    }
+
+private:
+#ifdef LTC_RAY_DISPATCH
+    // the traversal and the tests inlined (flatten) into functions compiled for the ISA of their target
+    __attribute__((target("avx2,fma"), flatten))
+    void intersectAVX2(const vec3* origins, const vec3* dirs, int count, float tMax, float* t, int* shape) const
+    {
+        intersect<8>(origins, dirs, count, tMax, t, shape);
+    }
+
+    __attribute__((target("avx512f,avx512vl,avx2,fma"), flatten))
+    void intersectAVX512(const vec3* origins, const vec3* dirs, int count, float tMax, float* t, int* shape) const
+    {
+        intersect<16>(origins, dirs, count, tMax, t, shape);
+    }
+#endif
+
+    int build(const std::vector<vec3>& boundsMin, const std::vector<vec3>& boundsMax, int first, int last, int depth)
+    {
+        LTCRayNode node;
+        node.boundsMin = vec3(1e30f);
+        node.boundsMax = vec3(-1e30f);
+        vec3 centroidMin = vec3(1e30f), centroidMax = vec3(-1e30f);
+        for (int i = first; i < last; ++i)
+        {
+            node.boundsMin = min(node.boundsMin, boundsMin[order[i]]);
+            node.boundsMax = max(node.boundsMax, boundsMax[order[i]]);
+            vec3 c = 0.5f*(boundsMin[order[i]] + boundsMax[order[i]]);
+            centroidMin = min(centroidMin, c);
+            centroidMax = max(centroidMax, c);
+        }
+
+        vec3 extent = centroidMax - centroidMin;
+        node.axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        node.right = -1;
+        node.first = first;
+        node.count = last - first;
+
+        const int index = (int)nodes.size();
+        nodes.push_back(node);
+
+        // the stack of the traversal holds at most one node per level
+        if (last - first <= LEAF_SIZE || depth + 2 >= MAX_DEPTH)
+            return index;
+
+        const int axis = node.axis;
+        const int mid = (first + last)/2;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + last, [&](int a, int b)
+        {
+            return boundsMin[a][axis] + boundsMax[a][axis] < boundsMin[b][axis] + boundsMax[b][axis];
+        });
+
+        nodes[index].count = 0;
+        build(boundsMin, boundsMax, first, mid, depth + 1);
+        int right = build(boundsMin, boundsMax, mid, last, depth + 1);
+        nodes[index].right = right;
+
+        return index;
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef _LTC_SPECTRAL_
+#define _LTC_SPECTRAL_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include "ltc_eval.h"
+#include "ltc_table.h"
+
+// spectral evaluation of quad lights over a packet of W wavelengths
+// the LTC integrals only depend on the geometry, so they are computed once per light
+// and only the Fresnel/magnitude weighting of the shaders,
+//   spec *= scol*t2.x + (1.0 - scol)*t2.y
+// is applied per wavelength (one SIMD lane per wavelength)
+
+const float LAMBDA_MIN = 380.0f;
+const float LAMBDA_MAX = 780.0f;
+
+// hero wavelength sampling: W wavelengths evenly spaced over the visible range
+template<int W>
+void initWavelengths(float u, float lambda[W])
+{
+    for (int i = 0; i < W; ++i)
+    {
+        float x = u + float(i)/W;
+        x -= floorf(x);
+        lambda[i] = LAMBDA_MIN + x*(LAMBDA_MAX - LAMBDA_MIN);
+    }
+}
+
+// normal incidence reflectance from a complex index of refraction
+float fresnelF0(float eta, float k)
+{
+    return ((eta - 1.0f)*(eta - 1.0f) + k*k)/((eta + 1.0f)*(eta + 1.0f) + k*k);
+}
+
+struct SpectralQuadLight
+{
+    vec3 points[4];
+    bool twoSided;
+};
+
+// accumulates the radiance reflected from one light into Lo[W]
+// * Le     = emitted radiance
+// * f0     = specular reflectance at normal incidence
+// * albedo = diffuse albedo
+template<int W>
+void LTC_EvaluateSpectral(
+    const vec3& N, const vec3& V, const vec3& P, float roughness, const LTCTable& table,
+    const SpectralQuadLight& light,
+    const float Le[W], const float f0[W], const float albedo[W], float Lo[W])
+{
+    float ndotv = glm::clamp(dot(N, V), 0.0f, 1.0f);
+    mat3 Minv = table.Minv(roughness, ndotv);
+    vec2 t2   = table.magFresnel(roughness, ndotv);
+
+    // geometry, once per light
+    float spec = LTC_Evaluate(N, V, P, Minv,    light.points, light.twoSided);
+    float diff = LTC_Evaluate(N, V, P, mat3(1), light.points, light.twoSided);
+
+    // BRDF shadowing and Fresnel, per wavelength
+    for (int i = 0; i < W; ++i)
+    {
+        float s = spec*(f0[i]*t2.x + (1.0f - f0[i])*t2.y);
+        Lo[i] += Le[i]*(s + albedo[i]*diff);
+    }
+}
+
+// same for a set of lights sharing the same emission spectrum
+template<int W>
+void LTC_EvaluateSpectral(
+    const vec3& N, const vec3& V, const vec3& P, float roughness, const LTCTable& table,
+    const SpectralQuadLight* lights, int lightCount,
+    const float Le[W], const float f0[W], const float albedo[W], float Lo[W])
+{
+    float ndotv = glm::clamp(dot(N, V), 0.0f, 1.0f);
+    mat3 Minv = table.Minv(roughness, ndotv);
+    vec2 t2   = table.magFresnel(roughness, ndotv);
+
+    float spec = 0.0f;
+    float diff = 0.0f;
+    for (int l = 0; l < lightCount; ++l)
+    {
+        spec += LTC_Evaluate(N, V, P, Minv,    lights[l].points, lights[l].twoSided);
+        diff += LTC_Evaluate(N, V, P, mat3(1), lights[l].points, lights[l].twoSided);
+    }
+
+    for (int i = 0; i < W; ++i)
+    {
+        float s = spec*(f0[i]*t2.x + (1.0f - f0[i])*t2.y);
+        Lo[i] += Le[i]*(s + albedo[i]*diff);
+    }
+}
+
+// CIE 1931 colour matching functions, multi-lobe fit from
+// "Simple Analytic Approximations to the CIE XYZ Color Matching Functions", Wyman et al. 2013
+static float cieLobe(float lambda, float mu, float sigma1, float sigma2)
+{
+    float t = (lambda - mu)/(lambda < mu ? sigma1 : sigma2);
+    return expf(-0.5f*t*t);
+}
+
+vec3 cieXYZ(float lambda)
+{
+    return vec3(
+        1.056f*cieLobe(lambda, 599.8f, 37.9f, 31.0f) + 0.362f*cieLobe(lambda, 442.0f, 16.0f, 26.7f) - 0.065f*cieLobe(lambda, 501.1f, 20.4f, 26.2f),
+        0.821f*cieLobe(lambda, 568.8f, 46.9f, 40.5f) + 0.286f*cieLobe(lambda, 530.9f, 16.3f, 31.1f),
+        1.217f*cieLobe(lambda, 437.0f, 11.8f, 36.0f) + 0.681f*cieLobe(lambda, 459.0f, 26.0f, 13.8f));
+}
+
+vec3 XYZToLinearSRGB(const vec3& c)
+{
+    return vec3(
+         3.2404542f*c.x - 1.5371385f*c.y - 0.4985314f*c.z,
+        -0.9692660f*c.x + 1.8760108f*c.y + 0.0415560f*c.z,
+         0.0556434f*c.x - 0.2040259f*c.y + 1.0572252f*c.z);
+}
+
+// Monte Carlo estimate of the XYZ colour of a packet of wavelengths
+// (uniform wavelength sampling, pdf = 1/(LAMBDA_MAX - LAMBDA_MIN))
+template<int W>
+vec3 spectrumToXYZ(const float lambda[W], const float value[W])
+{
+    vec3 xyz = vec3(0, 0, 0);
+    for (int i = 0; i < W; ++i)
+        xyz += cieXYZ(lambda[i])*value[i];
+    return xyz*((LAMBDA_MAX - LAMBDA_MIN)/W);
+}
+
+#endif
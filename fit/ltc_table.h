@@ -0,0 +1,107 @@
+#ifndef _LTC_TABLE_
+#define _LTC_TABLE_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <vector>
+
+#include "dds.h"
+#include "ltc_matrix.h"
+
+// packed LTC tables, as written by packTab() and writeDDS()
+// * tex1 = inverse matrix terms, normalized by invM[1][1]
+// * tex2 = (magnitude, fresnel, unused, sphere)
+// lookups follow the WebGL demos: uv = (roughness, sqrt(1 - cos(theta)))
+struct LTCTable
+{
+    int size;
+    std::vector<vec4> tex1;
+    std::vector<vec4> tex2;
+
+    LTCTable() : size(0)
+    {
+    }
+
+    void init(const vec4* data1, const vec4* data2, int N)
+    {
+        size = N;
+        tex1.assign(data1, data1 + N*N);
+        tex2.assign(data2, data2 + N*N);
+    }
+
+    bool load(const char* path1, const char* path2)
+    {
+        unsigned w1, h1, w2, h2;
+        float* data1 = LoadDDS(path1, &w1, &h1);
+        float* data2 = LoadDDS(path2, &w2, &h2);
+
+        bool ok = data1 && data2 && w1 == h1 && w1 == w2 && h1 == h2;
+        if (ok)
+            init((const vec4*)data1, (const vec4*)data2, w1);
+
+        delete[] data1;
+        delete[] data2;
+        return ok;
+    }
+
+    // bilinear fetch, equivalent to texture() with LUT_SCALE and LUT_BIAS applied to uv
+    vec4 fetch(const std::vector<vec4>& tex, vec2 uv) const
+    {
+        float x = glm::clamp(uv.x, 0.0f, 1.0f)*(size - 1);
+        float y = glm::clamp(uv.y, 0.0f, 1.0f)*(size - 1);
+
+        int x0 = std::min<int>((int)x, size - 2);
+        int y0 = std::min<int>((int)y, size - 2);
+        float fx = x - x0;
+        float fy = y - y0;
+
+        const vec4& t00 = tex[(x0    ) + (y0    )*size];
+        const vec4& t10 = tex[(x0 + 1) + (y0    )*size];
+        const vec4& t01 = tex[(x0    ) + (y0 + 1)*size];
+        const vec4& t11 = tex[(x0 + 1) + (y0 + 1)*size];
+
+        return (t00*(1.0f - fx) + t10*fx)*(1.0f - fy) +
+               (t01*(1.0f - fx) + t11*fx)*fy;
+    }
+
+    vec2 uv(float roughness, float cosTheta) const
+    {
+        return vec2(roughness, sqrtf(1.0f - glm::clamp(cosTheta, 0.0f, 1.0f)));
+    }
+
+    mat3 Minv(float roughness, float cosTheta) const
+    {
+        vec4 t1 = fetch(tex1, uv(roughness, cosTheta));
+
+        return mat3(
+            vec3(t1.x, 0, t1.y),
+            vec3(   0, 1,    0),
+            vec3(t1.z, 0, t1.w)
+        );
+    }
+
+    // Minv of count (roughness, cos(theta)) pairs, for the runtimes that rebuild the matrices of every pixel or
+    // light per frame: ltcInverse() of the batch gives M and det(Minv)
+    void MinvBatch(const float* roughness, const float* cosTheta, int count, LTCMatrices& Minv) const
+    {
+        Minv.resize(count);
+        for (int i = 0; i < count; ++i)
+            Minv.set(i, fetch(tex1, uv(roughness[i], cosTheta[i])));
+    }
+
+    // (magnitude, fresnel)
+    vec2 magFresnel(float roughness, float cosTheta) const
+    {
+        vec4 t2 = fetch(tex2, uv(roughness, cosTheta));
+        return vec2(t2.x, t2.y);
+    }
+
+    // horizon-clipped sphere, indexed by the vector form factor
+    float sphere(float z, float len) const
+    {
+        return fetch(tex2, vec2(z*0.5f + 0.5f, len)).w;
+    }
+};
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef NELDER_MEAD_H
 #define NELDER_MEAD_H
 
+#include <cfloat>
+
+#include "parallel.h"
+
 void mov(float* r, const float* v, int dim)
 {
     for (int i = 0; i < dim; ++i)
@@ -19,19 +23,117 @@ void add(float* r, const float* v, int dim)
         r[i] += v[i];
 }
 
+// standard coefficients from Nelder-Mead
+const float NELDER_MEAD_REFLECT  = 1.0f;
+const float NELDER_MEAD_EXPAND   = 2.0f;
+const float NELDER_MEAD_CONTRACT = 0.5f;
+const float NELDER_MEAD_SHRINK   = 0.5f;
+
+// point o + scale*(o - worst) on the line from the worst point through the centroid o of the others
+template<int DIM>
+void nelderMeadPoint(float* p, const float* o, const float* worst, float scale)
+{
+    for (int i = 0; i < DIM; i++)
+        p[i] = o[i] + scale*(o[i] - worst[i]);
+}
+
+// evaluation of the candidates of NelderMeadIterate(), one after the other: a candidate is only compared against
+// the value it must beat, passed as the bound of the objective
+template<typename FUNC>
+struct NelderMeadSequential
+{
+    FUNC& objectiveFn;
+
+    // exact values f[k] of the points s[k], but for k = skip
+    template<int DIM>
+    void evaluate(float (*s)[DIM], float* f, int count, int skip)
+    {
+        for (int k = 0; k < count; k++)
+            if (k != skip)
+                f[k] = objectiveFn(s[k], FLT_MAX);
+    }
+
+    // replacement p of the worst point and its value fp, from the centroid o of the others and the lowest, next
+    // highest and highest values; false for a reduction
+    template<int DIM>
+    bool replace(const float* o, const float* worst, float flo, float fnh, float fhi, float* p, float& fp)
+    {
+        // reflection, only accepted below the next highest point
+        float r[DIM];
+        nelderMeadPoint<DIM>(r, o, worst, NELDER_MEAD_REFLECT);
+        float fr = objectiveFn(r, fnh);
+        if (fr < fnh)
+        {
+            // expansion
+            if (fr < flo)
+            {
+                nelderMeadPoint<DIM>(p, o, worst, NELDER_MEAD_EXPAND);
+                fp = objectiveFn(p, fr);
+                if (fp < fr)
+                    return true;
+            }
+
+            mov(p, r, DIM);
+            fp = fr;
+            return true;
+        }
+
+        // contraction
+        nelderMeadPoint<DIM>(p, o, worst, -NELDER_MEAD_CONTRACT);
+        fp = objectiveFn(p, fhi);
+        return fp < fhi;
+    }
+};
+
+// evaluation of the candidates of NelderMeadIterate() on several threads: the reflection, expansion and
+// contraction are evaluated speculatively at once, with exact values, and make the choices of NelderMeadSequential
+template<typename FUNC>
+struct NelderMeadSpeculative
+{
+    FUNC& objectiveFn;
+
+    template<int DIM>
+    void evaluate(float (*s)[DIM], float* f, int count, int skip)
+    {
+        parallel_for(count, [&](int k) { if (k != skip) f[k] = objectiveFn(s[k], FLT_MAX); });
+    }
+
+    template<int DIM>
+    bool replace(const float* o, const float* worst, float flo, float fnh, float fhi, float* p, float& fp)
+    {
+        float c[3][DIM];
+        const float scale[3] = { NELDER_MEAD_REFLECT, NELDER_MEAD_EXPAND, -NELDER_MEAD_CONTRACT };
+        for (int k = 0; k < 3; k++)
+            nelderMeadPoint<DIM>(c[k], o, worst, scale[k]);
+
+        float fc[3];
+        parallel_for(3, [&](int k) { fc[k] = objectiveFn(c[k], FLT_MAX); });
+
+        int accepted = -1;
+        if (fc[0] < fnh)
+            accepted = fc[0] < flo && fc[1] < fc[0] ? 1 : 0;
+        else if (fc[2] < fhi)
+            accepted = 2;
+
+        if (accepted < 0)
+            return false;
+
+        mov(p, c[accepted], DIM);
+        fp = fc[accepted];
+        return true;
+    }
+};
+
 // Downhill simplex solver:
 // http://en.wikipedia.org/wiki/Nelder%E2%80%93Mead_method#One_possible_variation_of_the_NM_algorithm
 // using the termination criterion from Numerical Recipes in C++ (3rd Ed.)
-template<int DIM, typename FUNC>
-float NelderMead(
-    float* pmin, const float* start, float delta, float tolerance, int maxIters, FUNC objectiveFn)
+// the candidates of each iteration are evaluated by CANDIDATES, NelderMeadSequential or NelderMeadSpeculative
+// the number of iterations is returned in iterations, if not NULL
+template<int DIM, typename CANDIDATES>
+float NelderMeadIterate(
+    float* pmin, const float* start, float delta, float tolerance, int maxIters, CANDIDATES& candidates,
+    int* iterations)
 {
-    // standard coefficients from Nelder-Mead
-    const float reflect  = 1.0f;
-    const float expand   = 2.0f;
-    const float contract = 0.5f;
-    const float shrink   = 0.5f;
-
     typedef float point[DIM];
     const int NB_POINTS = DIM + 1;
 
@@ -47,12 +149,12 @@ float NelderMead(
     }
 
     // evaluate function at each point on simplex
-    for (int i = 0; i < NB_POINTS; i++)
-        f[i] = objectiveFn(s[i]);
+    candidates.template evaluate<DIM>(s, f, NB_POINTS, -1);
 
     int lo = 0, hi, nh;
 
-    for (int j = 0; j < maxIters; j++)
+    int j = 0;
+    for (; j < maxIters; j++)
     {
         // find lowest, highest and next highest
         lo = hi = nh = 0;
@@ -87,45 +189,13 @@ float NelderMead(
         for (int i = 0; i < DIM; i++)
             o[i] /= DIM;
 
-        // reflection
-        point r;
-        for (int i = 0; i < DIM; i++)
-            r[i] = o[i] + reflect*(o[i] - s[hi][i]);
-
-        float fr = objectiveFn(r);
-        if (fr < f[nh])
-        {
-            if (fr < f[lo])
-            {
-                // expansion
-                point e;
-                for (int i = 0; i < DIM; i++)
-                    e[i] = o[i] + expand*(o[i] - s[hi][i]);
-
-                float fe = objectiveFn(e);
-                if (fe < fr)
-                {
-                    mov(s[hi], e, DIM);
-                    f[hi] = fe;
-                    continue;
-                }
-            }
-
-            mov(s[hi], r, DIM);
-            f[hi] = fr;
-            continue;
-        }
-
-        // contraction
-        point c;
-        for (int i = 0; i < DIM; i++)
-            c[i] = o[i] - contract*(o[i] - s[hi][i]);
-
-        float fc = objectiveFn(c);
-        if (fc < f[hi])
+        // reflection, expansion or contraction
+        point p;
+        float fp;
+        if (candidates.template replace<DIM>(o, s[hi], f[lo], f[nh], f[hi], p, fp))
         {
-            mov(s[hi], c, DIM);
-            f[hi] = fc;
+            mov(s[hi], p, DIM);
+            f[hi] = fp;
             continue;
         }
 
@@ -134,14 +204,40 @@ float NelderMead(
         {
             if (k == lo) continue;
             for (int i = 0; i < DIM; i++)
-                s[k][i] = s[lo][i] + shrink*(s[k][i] - s[lo][i]);
-            f[k] = objectiveFn(s[k]);
+                s[k][i] = s[lo][i] + NELDER_MEAD_SHRINK*(s[k][i] - s[lo][i]);
         }
+        candidates.template evaluate<DIM>(s, f, NB_POINTS, lo);
     }
 
     // return best point and its value
+    if (iterations)
+        *iterations = j;
     mov(pmin, s[lo], DIM);
     return f[lo];
 }
 
+// the objective is called as objectiveFn(point, bound): a candidate is only compared against bound,
+// so the objective may stop early and return any value >= bound once it knows the result is not below it
+// (FLT_MAX is passed when the exact value is needed)
+template<int DIM, typename FUNC>
+float NelderMead(
+    float* pmin, const float* start, float delta, float tolerance, int maxIters, FUNC objectiveFn,
+    int* iterations = NULL)
+{
+    NelderMeadSequential<FUNC> candidates = { objectiveFn };
+    return NelderMeadIterate<DIM>(pmin, start, delta, tolerance, maxIters, candidates, iterations);
+}
+
+// NelderMead() with the candidates of an iteration evaluated concurrently, for the latency of a single fit
+// * objectiveFn is called from several threads at once, and always with bound = FLT_MAX: the exact values make
+//   the same choices as NelderMead(), which returns the same point (with more evaluations)
+template<int DIM, typename FUNC>
+float NelderMeadParallel(
+    float* pmin, const float* start, float delta, float tolerance, int maxIters, FUNC objectiveFn,
+    int* iterations = NULL)
+{
+    NelderMeadSpeculative<FUNC> candidates = { objectiveFn };
+    return NelderMeadIterate<DIM>(pmin, start, delta, tolerance, maxIters, candidates, iterations);
+}
+
 #endif // NELDER_MEAD_H
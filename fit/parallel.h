@@ -0,0 +1,46 @@
+#ifndef _PARALLEL_
+#define _PARALLEL_
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// number of worker threads (one per hardware thread)
+int numThreads()
+{
+    int n = (int)std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// calls fn(i) for i in [0, count), distributing the indices dynamically over the threads
+template<typename FUNC>
+void parallel_for(int count, FUNC fn, int threads = numThreads())
+{
+    threads = std::min<int>(threads, count);
+    if (threads <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+
+    auto worker = [&]()
+    {
+        for (int i = next++; i < count; i = next++)
+            fn(i);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+        pool.push_back(std::thread(worker));
+
+    worker();
+
+    for (size_t t = 0; t < pool.size(); ++t)
+        pool[t].join();
+}
+
+#endif
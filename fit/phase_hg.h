@@ -0,0 +1,76 @@
+#ifndef _PHASE_HG_
+#define _PHASE_HG_
+
+#include <cmath>
+
+#include "brdf.h"
+
+// Henyey-Greenstein phase function [Henyey and Greenstein 1941], as a target for the LTC fit of single scattering
+// from polygonal lights
+// * seen from a point of the medium, a planar light lies in the hemisphere towards its plane: with Z the normal
+//   of the plane on the side of the light, the phase function is fitted over that hemisphere only
+// * V is the forward direction of the ray and L the direction to the light, the phase function is a function of
+//   their angle: p(V.L), peaked at L = V for g > 0
+// * only V.z >= 0 is tabulated: p_g(V.L) = p_-g((-V).L), so rays going away from the plane of the light use the
+//   cell of (-V, -g)
+// * g in [-PHASE_G_MAX, PHASE_G_MAX] takes the place of the roughness, see phaseG(), and the magnitude is the
+//   fraction of the phase function in the hemisphere
+const float PHASE_G_MAX = 0.95f;
+
+// g of the roughness coordinate r = sqrt(alpha) of the tables, from forward scattering at r = 0, where the lobe is
+// the narrowest, to back scattering at r = 1
+float phaseG(float alpha)
+{
+    return PHASE_G_MAX*(1.0f - 2.0f*sqrtf(alpha));
+}
+
+// roughness coordinate of the tables for g
+float phaseRoughness(float g)
+{
+    return 0.5f - 0.5f*g/PHASE_G_MAX;
+}
+
+float phaseHG(float cosTheta, float g)
+{
+    float denom = 1.0f + g*g - 2.0f*g*cosTheta;
+    return (1.0f - g*g)/(4.0f*3.14159265f*denom*sqrtf(denom));
+}
+
+class PhaseHG : public Brdf
+{
+public:
+    // the phase function, in the upper hemisphere
+    // pdf is the one of sample(), over the whole sphere
+    virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const
+    {
+        pdf = phaseHG(dot(V, L), phaseG(alpha));
+
+        return L.z > 0.0f ? pdf : 0.0f;
+    }
+
+    // sampling of the whole sphere, the directions below the horizon have a value of 0
+    virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
+    {
+        const float g = phaseG(alpha);
+
+        float cosTheta;
+        if (fabsf(g) < 1e-3f)
+            cosTheta = 1.0f - 2.0f*U1;
+        else
+        {
+            float s = (1.0f - g*g)/(1.0f - g + 2.0f*g*U1);
+            cosTheta = (1.0f + g*g - s*s)/(2.0f*g);
+        }
+        cosTheta = glm::clamp(cosTheta, -1.0f, 1.0f);
+        const float sinTheta = sqrtf(1.0f - cosTheta*cosTheta);
+        const float phi = 2.0f*3.14159f * U2;
+
+        // frame around V
+        const vec3 T1 = normalize(fabsf(V.z) < 0.999f ? cross(vec3(0, 0, 1), V) : vec3(1, 0, 0));
+        const vec3 T2 = cross(V, T1);
+
+        return sinTheta*cosf(phi)*T1 + sinTheta*sinf(phi)*T2 + cosTheta*V;
+    }
+};
+
+#endif
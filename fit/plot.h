@@ -101,13 +101,24 @@ public:
     const LTC* ltc;
 };
 
+// init color map texture (for linear interpolation)
+void init_color_map()
+{
+    for(int i = 0; i < 33; ++i)
+    {
+        colorMap(i, 0, 0, 0) = colorMap_data[3*i + 0];
+        colorMap(i, 0, 0, 1) = colorMap_data[3*i + 1];
+        colorMap(i, 0, 0, 2) = colorMap_data[3*i + 2];
+    }
+}
+
 // raytrace a sphere
 // evaluate the BRDF or the LTC
 // call the color map
-void spherical_plot(const BrdfOrLTC& brdforltc, const char* filename)
+// (init_color_map() must have been called)
+CImg<float> spherical_plot_image(const BrdfOrLTC& brdforltc, const int image_size = 256)
 {
     // image
-    const int image_size = 256;
     CImg<float> image(image_size, image_size, 1, 3);
 
     // camera
@@ -145,7 +156,12 @@ void spherical_plot(const BrdfOrLTC& brdforltc, const char* filename)
         image(i, j, 0, 2) = colorMap.linear_atX(value*(colorMap.width() - 1.0f), 0, 0, 2);
     }
 
-    image.save(filename);
+    return image;
+}
+
+void spherical_plot(const BrdfOrLTC& brdforltc, const char* filename)
+{
+    spherical_plot_image(brdforltc).save(filename);
 }
 
 #include <sstream>
@@ -153,13 +169,7 @@ void spherical_plot(const BrdfOrLTC& brdforltc, const char* filename)
 
 void make_spherical_plots(const Brdf& brdf, const mat3* tab, const int N)
 {
-    // init color map texture (for linear interpolation)
-    for(int i = 0; i < 33; ++i)
-    {
-        colorMap(i, 0, 0, 0) = colorMap_data[3*i + 0];
-        colorMap(i, 0, 0, 1) = colorMap_data[3*i + 1];
-        colorMap(i, 0, 0, 2) = colorMap_data[3*i + 2];
-    }
+    init_color_map();
 
     // fill LTC matrices in texture (for linear interpolation)
     CImg<float> LTC_matrices(N, N, 1, 9);
@@ -205,8 +215,8 @@ void make_spherical_plots(const Brdf& brdf, const mat3* tab, const int N)
         // init LTC
         LTC ltc;
         ltc.M = M;
-        ltc.invM = inverse(M);
-        ltc.detM = abs(glm::determinant(M));
+        ltc.invM = ltcInverse(M);
+        ltc.detM = abs(ltcDeterminant(M));
 
         // filename LTC
         std::stringstream filename_ltc;
@@ -0,0 +1,389 @@
+#ifndef _REFIT_SERVER_
+#define _REFIT_SERVER_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "LTC.h"
+#include "brdf.h"
+#include "plot.h"
+
+// interactive refit of single cells (fitLTC --serve): a long-lived process that keeps the BRDFs, the seed table
+// and the averages of the cells it has seen, for tools that look into one cell without a full fit
+//
+// * one request per line on stdin, one response per line on stdout, both JSON objects:
+//     {"id": 1, "brdf": "ggx", "alpha": 0.09, "theta": 0.8, "guess": [m11, m22, m13], "plot": 128}
+//   - brdf is one of the --brdf names, the first one by default
+//   - alpha = roughness^2 and theta, in radians, are any values, not only the ones of the table cells
+//   - guess is optional: the seed table of --warm-start is used if there is one, a lobe of width alpha otherwise
+//   - "iterations" and "epsilon" set the budget and the initial simplex size of the fit (100 and 0.05 by default,
+//     epsilon in (0, 1])
+//   - plot is the size of the spherical plots (see spherical_plot_image()), 0 or absent for none
+// * responses echo the id, with the fitted parameters, the matrix M (column major), the magnitude, the Fresnel
+//   term, the error and the time of the fit in milliseconds:
+//     {"id": 1, "ok": true, "params": [...], "M": [...], "magnitude": ..., "fresnel": ..., "error": ...,
+//      "iterations": ..., "evaluations": ..., "ms": ..., "plot": {"size": 128, "ltc": "...", "brdf": "..."}}
+//   the plots are base64 encoded 8-bit RGB rows, from top to bottom
+// * a request that cannot be served gets {"id": ..., "ok": false, "reason": "..."}
+// * the server exits at the end of the input
+
+struct RefitRequest
+{
+    string id;       // JSON text of the id, echoed as is
+    int brdf;
+    float alpha;
+    float theta;
+    bool hasGuess;
+    float guess[3];  // (m11, m22, m13)
+    int iterations;
+    float epsilon;
+    int plotSize;
+};
+
+struct RefitResult
+{
+    LTC ltc;
+    float params[3];
+    float error;
+    int iterations;
+    int evaluations;
+};
+
+// value of a field of a request: a number, a string, an array of numbers or a literal (true, false, null)
+struct JsonValue
+{
+    enum Type { NUMBER, STRING, ARRAY, LITERAL };
+
+    Type type;
+    string text;             // JSON text of the value
+    string str;              // STRING
+    vector<double> numbers;  // NUMBER (one) and ARRAY
+};
+
+// parses a JSON object of the values above, nested objects are not supported
+bool parseJsonObject(const string& line, map<string, JsonValue>& fields, string& error)
+{
+    const char* p = line.c_str();
+    auto skip = [&]() { while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p; };
+
+    auto parseString = [&](string& s) -> bool
+    {
+        if (*p != '"')
+            return false;
+        for (++p; *p && *p != '"'; ++p)
+        {
+            if (*p == '\\' && p[1])
+                ++p;
+            s += *p;
+        }
+        if (*p != '"')
+            return false;
+        ++p;
+        return true;
+    };
+
+    auto parseNumber = [&](double& x) -> bool
+    {
+        char* end;
+        x = strtod(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+        return true;
+    };
+
+    skip();
+    if (*p++ != '{')
+    {
+        error = "expected a JSON object";
+        return false;
+    }
+
+    skip();
+    if (*p == '}')
+        return true;
+
+    for (;;)
+    {
+        string key;
+        skip();
+        if (!parseString(key))
+        {
+            error = "expected a key";
+            return false;
+        }
+
+        skip();
+        if (*p++ != ':')
+        {
+            error = "expected ':' after \"" + key + "\"";
+            return false;
+        }
+
+        skip();
+        const char* start = p;
+        JsonValue value;
+        bool ok = true;
+        if (*p == '"')
+        {
+            value.type = JsonValue::STRING;
+            ok = parseString(value.str);
+        }
+        else if (*p == '[')
+        {
+            value.type = JsonValue::ARRAY;
+            ++p;
+            skip();
+            while (ok && *p != ']')
+            {
+                double x;
+                ok = parseNumber(x);
+                value.numbers.push_back(x);
+                skip();
+                if (*p == ',')
+                    ++p;
+                else
+                    ok = ok && *p == ']';
+                skip();
+            }
+            if (ok)
+                ++p;
+        }
+        else if (strncmp(p, "true", 4) == 0 || strncmp(p, "null", 4) == 0 || strncmp(p, "false", 5) == 0)
+        {
+            value.type = JsonValue::LITERAL;
+            p += *p == 'f' ? 5 : 4;
+        }
+        else
+        {
+            double x;
+            value.type = JsonValue::NUMBER;
+            ok = parseNumber(x);
+            value.numbers.push_back(x);
+        }
+
+        if (!ok)
+        {
+            error = "invalid value of \"" + key + "\"";
+            return false;
+        }
+        value.text.assign(start, p);
+        fields[key] = value;
+
+        skip();
+        if (*p == ',')
+            ++p;
+        else if (*p == '}')
+            return true;
+        else
+        {
+            error = "expected ',' or '}'";
+            return false;
+        }
+    }
+}
+
+string base64(const vector<unsigned char>& data)
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    string s;
+    s.reserve((data.size() + 2)/3*4);
+    for (size_t i = 0; i < data.size(); i += 3)
+    {
+        unsigned n = data[i] << 16;
+        if (i + 1 < data.size()) n |= data[i + 1] << 8;
+        if (i + 2 < data.size()) n |= data[i + 2];
+
+        s += digits[(n >> 18) & 63];
+        s += digits[(n >> 12) & 63];
+        s += i + 1 < data.size() ? digits[(n >> 6) & 63] : '=';
+        s += i + 2 < data.size() ? digits[n & 63] : '=';
+    }
+    return s;
+}
+
+// spherical plot as base64 encoded 8-bit RGB
+string refitPlot(const BrdfOrLTC& brdforltc, int size)
+{
+    CImg<float> image = spherical_plot_image(brdforltc, size);
+
+    vector<unsigned char> rgb(size*size*3);
+    for (int j = 0; j < size; ++j)
+    for (int i = 0; i < size; ++i)
+    for (int c = 0; c < 3; ++c)
+        rgb[3*(i + j*size) + c] = (unsigned char)glm::clamp(image(i, j, 0, c) + 0.5f, 0.0f, 255.0f);
+
+    return base64(rgb);
+}
+
+// request of a line, false with the reason if it cannot be served
+bool parseRefitRequest(const string& line, const vector<string>& names, RefitRequest& request, string& reason)
+{
+    map<string, JsonValue> fields;
+    if (!parseJsonObject(line, fields, reason))
+        return false;
+
+    request.id = fields.count("id") ? fields["id"].text : "null";
+    request.brdf = 0;
+    request.hasGuess = false;
+    request.iterations = 100;
+    request.epsilon = 0.05f;
+    request.plotSize = 0;
+
+    auto number = [&](const char* key, double& x) -> bool
+    {
+        auto it = fields.find(key);
+        if (it == fields.end())
+            return false;
+        if (it->second.type != JsonValue::NUMBER || !std::isfinite(it->second.numbers[0]))
+        {
+            reason = string("\"") + key + "\" is not a number";
+            return false;
+        }
+        x = it->second.numbers[0];
+        return true;
+    };
+
+    if (fields.count("brdf"))
+    {
+        const string& name = fields["brdf"].str;
+        request.brdf = -1;
+        for (size_t b = 0; b < names.size(); ++b)
+            if (names[b] == name)
+                request.brdf = (int)b;
+
+        if (request.brdf < 0)
+        {
+            reason = "unknown BRDF \"" + name + "\"";
+            return false;
+        }
+    }
+
+    double alpha, theta;
+    if (!number("alpha", alpha) || !number("theta", theta))
+    {
+        if (reason.empty())
+            reason = "\"alpha\" and \"theta\" are required";
+        return false;
+    }
+    if (!(alpha > 0.0 && alpha <= 1.0) || !(theta >= 0.0 && theta < 1.5707963267948966))
+    {
+        reason = "alpha must be in (0, 1] and theta in [0, pi/2)";
+        return false;
+    }
+    request.alpha = (float)alpha;
+    request.theta = (float)theta;
+
+    if (fields.count("guess"))
+    {
+        const vector<double>& g = fields["guess"].numbers;
+        if (g.size() != 3)
+        {
+            reason = "\"guess\" must be [m11, m22, m13]";
+            return false;
+        }
+        request.hasGuess = true;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (!std::isfinite(g[i]))
+            {
+                reason = "\"guess\" must be [m11, m22, m13]";
+                return false;
+            }
+            request.guess[i] = (float)g[i];
+        }
+    }
+
+    double x;
+    reason.clear();
+    if (number("iterations", x))
+        request.iterations = glm::clamp((int)x, 1, 10000);
+    if (number("epsilon", x))
+    {
+        if (!(x > 0.0 && x <= 1.0))
+        {
+            reason = "epsilon must be in (0, 1]";
+            return false;
+        }
+        request.epsilon = (float)x;
+    }
+    if (number("plot", x))
+        request.plotSize = glm::clamp((int)x, 0, 1024);
+
+    return reason.empty();
+}
+
+// serves the requests of in on out, with refit(request, result) fitting the cells
+template<typename REFIT>
+int runRefitServer(istream& in, ostream& out, const vector<string>& names, const vector<const Brdf*>& brdfs,
+    REFIT refit)
+{
+    init_color_map();
+
+    for (string line; getline(in, line); )
+    {
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+
+        auto start = chrono::high_resolution_clock::now();
+
+        RefitRequest request;
+        string reason;
+        if (!parseRefitRequest(line, names, request, reason))
+        {
+            out << "{\"id\": " << (request.id.empty() ? "null" : request.id) << ", \"ok\": false, \"reason\": \"";
+            for (char c : reason)
+                out << (c == '"' || c == '\\' ? "\\" : "") << c;
+            out << "\"}" << endl;
+            continue;
+        }
+
+        RefitResult result;
+        refit(request, result);
+        double ms = 1e3*chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+        const LTC& ltc = result.ltc;
+        ostringstream response;
+        response << setprecision(9);
+        response << "{\"id\": " << request.id << ", \"ok\": true";
+        response << ", \"brdf\": \"" << names[request.brdf] << "\"";
+        response << ", \"params\": [" << result.params[0] << ", " << result.params[1] << ", " << result.params[2] << "]";
+        response << ", \"M\": [";
+        for (int i = 0; i < 9; ++i)
+            response << (i ? ", " : "") << ltc.M[i/3][i%3];
+        response << "]";
+        response << ", \"magnitude\": " << ltc.magnitude << ", \"fresnel\": " << ltc.fresnel;
+        response << ", \"error\": " << result.error;
+        response << ", \"iterations\": " << result.iterations << ", \"evaluations\": " << result.evaluations;
+        response << ", \"ms\": " << ms;
+
+        if (request.plotSize > 0)
+        {
+            vec3 V(sinf(request.theta), 0.0f, cosf(request.theta));
+            response << ", \"plot\": {\"size\": " << request.plotSize;
+            response << ", \"ltc\": \"" << refitPlot(BrdfOrLTC(&ltc, NULL), request.plotSize) << "\"";
+            response << ", \"brdf\": \"" << refitPlot(BrdfOrLTC(NULL, brdfs[request.brdf], V, request.alpha),
+                request.plotSize) << "\"}";
+        }
+
+        response << "}";
+        out << response.str() << endl;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef _SH_POLYGON_
+#define _SH_POLYGON_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <algorithm>
+#include <cmath>
+
+// analytic spherical harmonics projection of polygonal lights, for irradiance probes [Wang and Ramamoorthi 2018]
+// * coefficients of the real SH basis of "Stupid SH Tricks" [Sloan 2008], index l*l + l + m,
+//   for ORDER = 2 to 4 bands (4 to 16 coefficients): c_lm = integral of Y_lm over the polygon, unclipped
+// * each band is a combination of 2l + 1 zonal harmonics P_l(w.x) around fixed directions w, whose integrals
+//   over the polygon are sums over its edges (Stokes' theorem on the sphere, as in IntegrateEdgeVec()):
+//     integral of P_l(w.x) = 1/(l(l + 1)) sum_e (w.n_e) integral over the arc e of P_l'(w.x)
+//   and the arc integrals of powers of w.x follow a two-term recurrence
+// * probes are processed in packets of W, one SIMD lane per probe
+
+const int SH_MAX_ORDER = 4;
+const int SH_MAX_VERTICES = 8;
+
+// real SH basis up to band ORDER - 1
+template<int ORDER>
+void evalSH(const vec3& d, float Y[ORDER*ORDER])
+{
+    const float x = d.x, y = d.y, z = d.z;
+
+    Y[0] = 0.282095f;
+    if (ORDER < 2)
+        return;
+
+    Y[1] = 0.488603f*y;
+    Y[2] = 0.488603f*z;
+    Y[3] = 0.488603f*x;
+    if (ORDER < 3)
+        return;
+
+    Y[4] = 1.092548f*x*y;
+    Y[5] = 1.092548f*y*z;
+    Y[6] = 0.315392f*(3.0f*z*z - 1.0f);
+    Y[7] = 1.092548f*x*z;
+    Y[8] = 0.546274f*(x*x - y*y);
+    if (ORDER < 4)
+        return;
+
+    Y[ 9] = 0.590044f*y*(3.0f*x*x - y*y);
+    Y[10] = 2.890611f*x*y*z;
+    Y[11] = 0.457046f*y*(5.0f*z*z - 1.0f);
+    Y[12] = 0.373176f*z*(5.0f*z*z - 3.0f);
+    Y[13] = 0.457046f*x*(5.0f*z*z - 1.0f);
+    Y[14] = 1.445306f*z*(x*x - y*y);
+    Y[15] = 0.590044f*x*(x*x - 3.0f*y*y);
+}
+
+// zonal directions shared by the bands, band l uses the first 2l + 1, and the matrices from their integrals to the
+// coefficients: by the addition theorem, integral of P_l(w_i.x) = 4pi/(2l + 1) sum_m Y_lm(w_i) c_lm
+struct SHZonalBasis
+{
+    vec3 dirs[2*SH_MAX_ORDER - 1];
+    float toSH[SH_MAX_ORDER][2*SH_MAX_ORDER - 1][2*SH_MAX_ORDER - 1]; // [l][m][i]
+
+    SHZonalBasis()
+    {
+        // chosen so that the matrices of all the bands are well conditioned
+        const vec3 d[2*SH_MAX_ORDER - 1] = {
+            vec3(-0.775875f, -0.573530f,  0.262833f),
+            vec3(-0.951533f,  0.005224f, -0.307502f),
+            vec3( 0.097750f, -0.725111f, -0.681659f),
+            vec3( 0.734564f, -0.052230f, -0.676527f),
+            vec3(-0.013373f, -0.132972f, -0.991030f),
+            vec3(-0.042281f,  0.999083f, -0.006756f),
+            vec3( 0.456613f,  0.507935f, -0.730415f),
+        };
+
+        for (int i = 0; i < 2*SH_MAX_ORDER - 1; ++i)
+            dirs[i] = normalize(d[i]);
+
+        for (int l = 1; l < SH_MAX_ORDER; ++l)
+        {
+            const int n = 2*l + 1;
+
+            // [A | I] with A[i][m] = 4pi/(2l + 1) Y_lm(w_i), reduced to [I | A^-1]
+            double M[2*SH_MAX_ORDER - 1][2*(2*SH_MAX_ORDER - 1)];
+            for (int i = 0; i < n; ++i)
+            {
+                float Y[SH_MAX_ORDER*SH_MAX_ORDER];
+                evalSH<SH_MAX_ORDER>(dirs[i], Y);
+                for (int m = 0; m < n; ++m)
+                {
+                    M[i][m] = 4.0*3.14159265358979*Y[l*l + m]/(2*l + 1);
+                    M[i][n + m] = i == m ? 1.0 : 0.0;
+                }
+            }
+
+            for (int c = 0; c < n; ++c)
+            {
+                int pivot = c;
+                for (int r = c + 1; r < n; ++r)
+                    if (fabs(M[r][c]) > fabs(M[pivot][c]))
+                        pivot = r;
+                for (int j = 0; j < 2*n; ++j)
+                    std::swap(M[c][j], M[pivot][j]);
+
+                double inv = 1.0/M[c][c];
+                for (int j = 0; j < 2*n; ++j)
+                    M[c][j] *= inv;
+
+                for (int r = 0; r < n; ++r)
+                {
+                    if (r == c)
+                        continue;
+                    double f = M[r][c];
+                    for (int j = 0; j < 2*n; ++j)
+                        M[r][j] -= f*M[c][j];
+                }
+            }
+
+            for (int m = 0; m < n; ++m)
+            for (int i = 0; i < n; ++i)
+                toSH[l][m][i] = (float)M[m][n + i];
+        }
+    }
+};
+
+const SHZonalBasis& shZonalBasis()
+{
+    static const SHZonalBasis basis;
+    return basis;
+}
+
+// projects a polygon of n <= SH_MAX_VERTICES vertices, seen from W probes, into coeffs[k][lane]
+// * the polygon is lit on the side where its winding is counterclockwise, as in LTC_Evaluate(),
+//   one-sided lights seen from the back give 0
+template<int ORDER, int W>
+void SH_ProjectPolygonPacket(
+    const float px[W], const float py[W], const float pz[W], const vec3* points, int n, bool twoSided,
+    float coeffs[ORDER*ORDER][W])
+{
+    const SHZonalBasis& basis = shZonalBasis();
+    const int NUM_DIRS = 2*ORDER - 1;
+
+    // directions to the vertices
+    float vx[SH_MAX_VERTICES][W], vy[SH_MAX_VERTICES][W], vz[SH_MAX_VERTICES][W];
+    for (int k = 0; k < n; ++k)
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float x = points[k].x - px[lane];
+        float y = points[k].y - py[lane];
+        float z = points[k].z - pz[lane];
+        float inv = 1.0f/sqrtf(x*x + y*y + z*z);
+        vx[k][lane] = x*inv;
+        vy[k][lane] = y*inv;
+        vz[k][lane] = z*inv;
+    }
+
+    // solid angle, as a fan of signed triangles [Van Oosterom and Strackee 1983]
+    float solidAngle[W];
+    for (int lane = 0; lane < W; ++lane)
+        solidAngle[lane] = 0.0f;
+
+    for (int k = 1; k + 1 < n; ++k)
+    for (int lane = 0; lane < W; ++lane)
+    {
+        vec3 a(vx[0][lane], vy[0][lane], vz[0][lane]);
+        vec3 b(vx[k][lane], vy[k][lane], vz[k][lane]);
+        vec3 c(vx[k + 1][lane], vy[k + 1][lane], vz[k + 1][lane]);
+
+        float det = dot(a, cross(b, c));
+        float div = 1.0f + dot(a, b) + dot(b, c) + dot(c, a);
+        solidAngle[lane] += 2.0f*atan2f(det, div);
+    }
+
+    // integrals of the zonal harmonics of the bands l >= 1
+    float S[SH_MAX_ORDER][2*SH_MAX_ORDER - 1][W];
+    for (int l = 1; l < ORDER; ++l)
+    for (int i = 0; i < NUM_DIRS; ++i)
+    for (int lane = 0; lane < W; ++lane)
+        S[l][i][lane] = 0.0f;
+
+    for (int e = 0; e < n; ++e)
+    {
+        const int e1 = (e + 1) % n;
+
+        for (int lane = 0; lane < W; ++lane)
+        {
+            vec3 a(vx[e][lane], vy[e][lane], vz[e][lane]);
+            vec3 b(vx[e1][lane], vy[e1][lane], vz[e1][lane]);
+
+            // arc of angle gamma in the plane of normal nrm, the tangents at a and b are cross(nrm, a) and cross(nrm, b)
+            // (degenerate edges have gamma = 0 and contribute nothing, without a branch)
+            vec3 nrm = cross(a, b);
+            float sinGamma = length(nrm);
+            float gamma = atan2f(sinGamma, dot(a, b));
+            nrm /= std::max<float>(sinGamma, 1e-7f);
+            vec3 ta = cross(nrm, a);
+            vec3 tb = cross(nrm, b);
+
+            for (int i = 0; i < NUM_DIRS; ++i)
+            {
+                const vec3& w = basis.dirs[i];
+
+                // u(s) = w.x along the arc, B_k = integral of u^k:
+                // B_k = ((k - 1)(1 - (w.n)^2) B_k-2 - [u^(k-1) u']) / k
+                float wn = dot(w, nrm);
+                float ua = dot(w, a), ub = dot(w, b);
+                float dua = dot(w, ta), dub = dot(w, tb);
+
+                float B0 = gamma;
+                float B1 = dua - dub;
+                float B2 = 0.5f*((1.0f - wn*wn)*B0 - (ub*dub - ua*dua));
+
+                // P_1' = 1, P_2' = 3u, P_3' = (15u^2 - 3)/2
+                S[1][i][lane] += wn*B0/2.0f;
+                if (ORDER > 2 && i < 5)
+                    S[2][i][lane] += wn*3.0f*B1/6.0f;
+                if (ORDER > 3)
+                    S[3][i][lane] += wn*(7.5f*B2 - 1.5f*B0)/12.0f;
+            }
+        }
+    }
+
+    // back to the SH basis, and orientation
+    for (int lane = 0; lane < W; ++lane)
+    {
+        float sign = solidAngle[lane] >= 0.0f ? 1.0f : (twoSided ? -1.0f : 0.0f);
+
+        coeffs[0][lane] = sign*0.282095f*solidAngle[lane];
+
+        for (int l = 1; l < ORDER; ++l)
+        for (int m = 0; m < 2*l + 1; ++m)
+        {
+            float c = 0.0f;
+            for (int i = 0; i < 2*l + 1; ++i)
+                c += basis.toSH[l][m][i]*S[l][i][lane];
+            coeffs[l*l + m][lane] = sign*c;
+        }
+    }
+}
+
+// projects a polygon into the SH coefficients of count probes, coeffs[probe*ORDER*ORDER + k]
+// false, with coeffs left as they are, for polygons of less than 3 or more than SH_MAX_VERTICES vertices
+template<int ORDER, int W = 8>
+bool SH_ProjectPolygon(const vec3* probes, int count, const vec3* points, int n, bool twoSided, float* coeffs)
+{
+    if (n < 3 || n > SH_MAX_VERTICES)
+        return false;
+
+    for (int first = 0; first < count; first += W)
+    {
+        // the last packet is padded with its last probe
+        float px[W], py[W], pz[W];
+        for (int lane = 0; lane < W; ++lane)
+        {
+            const vec3& p = probes[std::min<int>(first + lane, count - 1)];
+            px[lane] = p.x;
+            py[lane] = p.y;
+            pz[lane] = p.z;
+        }
+
+        float packet[ORDER*ORDER][W];
+        SH_ProjectPolygonPacket<ORDER, W>(px, py, pz, points, n, twoSided, packet);
+
+        for (int lane = 0; lane < W && first + lane < count; ++lane)
+        for (int k = 0; k < ORDER*ORDER; ++k)
+            coeffs[(first + lane)*ORDER*ORDER + k] = packet[k][lane];
+    }
+
+    return true;
+}
+
+#endif
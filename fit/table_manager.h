@@ -0,0 +1,401 @@
+#ifndef _TABLE_MANAGER_
+#define _TABLE_MANAGER_
+
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "ltc_table.h"
+
+// runtime manager of hot-reloadable LTC tables
+// * a background thread watches the two DDS files (inotify on Linux, modification time polling elsewhere),
+//   loads and validates new versions, and publishes them with an atomic pointer swap
+// * retired tables are freed with epoch-based reclamation once no reader can still hold them
+// * readers pin the current table with one store and two loads: lookups are lock-free and wait-free
+//
+// usage:
+//   LTCTableManager manager("results/ltc_1.dds", "results/ltc_2.dds");
+//   manager.start();
+//   int slot = manager.registerReader();          // once per rendering thread
+//   {
+//       LTCTableManager::Guard table(manager, slot);
+//       mat3 Minv = table->Minv(roughness, ndotv);
+//   }
+//   manager.unregisterReader(slot);               // when the thread exits
+// * threads beyond MAX_READERS get NO_SLOT, and pin the tables through a locked fallback instead
+
+// rejects tables that would break shading: bad sizes, non-finite terms or singular matrices
+bool validateTable(const LTCTable& table)
+{
+    if (table.size < 2)
+        return false;
+
+    for (size_t i = 0; i < table.tex1.size(); ++i)
+    {
+        const vec4& t1 = table.tex1[i];
+        const vec4& t2 = table.tex2[i];
+
+        for (int k = 0; k < 4; ++k)
+            if (!std::isfinite(t1[k]) || !std::isfinite(t2[k]))
+                return false;
+
+        // 2x2 block of the inverse matrix (the middle term is 1), tiny but positive at low roughness
+        if (!(t1.x*t1.w - t1.y*t1.z > 0.0f))
+            return false;
+
+        if (t2.x < 0.0f || t2.x > 2.0f)
+            return false;
+    }
+
+    return true;
+}
+
+class LTCTableManager
+{
+public:
+    static const int MAX_READERS = 64;
+    static const int NO_SLOT = -1;
+
+    LTCTableManager(const std::string& path1, const std::string& path2) :
+        path1(path1), path2(path2), current(nullptr), globalEpoch(1), overflowEpoch(IDLE), overflowReaders(0),
+        versions(0), failures(0), running(false)
+    {
+        for (int i = 0; i < MAX_READERS; ++i)
+        {
+            readers[i].epoch.store(IDLE);
+            readers[i].claimed.store(false);
+        }
+    }
+
+    ~LTCTableManager()
+    {
+        stop();
+
+        // no readers are left at this point
+        delete current.load();
+        for (size_t i = 0; i < retired.size(); ++i)
+            delete retired[i].table;
+    }
+
+    // loads the initial tables and starts watching; fails if the initial tables are not valid
+    bool start(int pollMs = 250)
+    {
+        if (!reload())
+            return false;
+
+        running = true;
+        watcher = std::thread(&LTCTableManager::watch, this, pollMs);
+        return true;
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+
+        running = false;
+        watcher.join();
+    }
+
+    // claims a free reader slot, once per thread (not on the hot path); NO_SLOT when all slots are taken
+    int registerReader()
+    {
+        for (int i = 0; i < MAX_READERS; ++i)
+        {
+            bool expected = false;
+            if (!readers[i].claimed.load() && readers[i].claimed.compare_exchange_strong(expected, true))
+                return i;
+        }
+        return NO_SLOT;
+    }
+
+    // returns the slot of a thread that does not read anymore, for the threads registered after it
+    void unregisterReader(int slot)
+    {
+        assert(slot >= NO_SLOT && slot < MAX_READERS);
+        if (slot == NO_SLOT)
+            return;
+
+        readers[slot].epoch.store(IDLE);
+        readers[slot].claimed.store(false);
+    }
+
+    // pins the current table for the duration of a lookup scope
+    // the global epoch is published before the pointer is read, so a writer that sees this slot idle
+    // or at a newer epoch than a retired table knows the reader cannot hold that table
+    // * NO_SLOT readers share one epoch under a lock: the epoch of the first one pins the tables of all
+    //   of them until the last one releases
+    const LTCTable* acquire(int slot)
+    {
+        assert(slot >= NO_SLOT && slot < MAX_READERS);
+        if (slot == NO_SLOT)
+        {
+            std::lock_guard<std::mutex> lock(overflow);
+            if (overflowReaders++ == 0)
+                overflowEpoch.store(globalEpoch.load());
+            return current.load();
+        }
+
+        readers[slot].epoch.store(globalEpoch.load());
+        return current.load();
+    }
+
+    void release(int slot)
+    {
+        assert(slot >= NO_SLOT && slot < MAX_READERS);
+        if (slot == NO_SLOT)
+        {
+            std::lock_guard<std::mutex> lock(overflow);
+            if (--overflowReaders == 0)
+                overflowEpoch.store(IDLE);
+            return;
+        }
+
+        readers[slot].epoch.store(IDLE);
+    }
+
+    struct Guard
+    {
+        LTCTableManager& manager;
+        int slot;
+        const LTCTable* table;
+
+        Guard(LTCTableManager& manager, int slot) : manager(manager), slot(slot), table(manager.acquire(slot))
+        {
+        }
+
+        ~Guard()
+        {
+            manager.release(slot);
+        }
+
+        const LTCTable* operator->() const
+        {
+            return table;
+        }
+
+        const LTCTable& operator*() const
+        {
+            return *table;
+        }
+    };
+
+    // number of tables published so far, and of rejected reloads
+    unsigned version() const
+    {
+        return versions.load();
+    }
+
+    unsigned rejected() const
+    {
+        return failures.load();
+    }
+
+    // loads, validates and publishes the tables now
+    // returns false (and keeps the current tables) if the files are missing, incomplete or invalid
+    bool reload()
+    {
+        std::lock_guard<std::mutex> lock(writer);
+
+        stamp1 = fileStamp(path1);
+        stamp2 = fileStamp(path2);
+
+        LTCTable* table = new LTCTable;
+        if (!table->load(path1.c_str(), path2.c_str()) || !validateTable(*table))
+        {
+            delete table;
+            ++failures;
+            return false;
+        }
+
+        publish(table);
+        return true;
+    }
+
+    // frees the retired tables that no reader can hold anymore
+    void reclaim()
+    {
+        std::lock_guard<std::mutex> lock(writer);
+
+        uint64_t oldest = overflowEpoch.load();
+        for (int i = 0; i < MAX_READERS; ++i)
+            oldest = std::min<uint64_t>(oldest, readers[i].epoch.load());
+
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i)
+        {
+            if (retired[i].epoch <= oldest)
+                delete retired[i].table;
+            else
+                retired[kept++] = retired[i];
+        }
+        retired.resize(kept);
+    }
+
+private:
+    static const uint64_t IDLE = ~uint64_t(0);
+
+    struct Retired
+    {
+        const LTCTable* table;
+        uint64_t epoch; // readers at this epoch or newer have seen the replacement
+    };
+
+    // one cache line per reader, so that pinning does not contend
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> claimed;
+    };
+
+    struct FileStamp
+    {
+        off_t size;
+        time_t mtime;
+
+        bool operator!=(const FileStamp& other) const
+        {
+            return size != other.size || mtime != other.mtime;
+        }
+    };
+
+    static FileStamp fileStamp(const std::string& path)
+    {
+        FileStamp stamp = { -1, 0 };
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0)
+        {
+            stamp.size  = st.st_size;
+            stamp.mtime = st.st_mtime;
+        }
+        return stamp;
+    }
+
+    void publish(const LTCTable* table)
+    {
+        const LTCTable* old = current.exchange(table);
+        uint64_t epoch = ++globalEpoch;
+
+        if (old)
+        {
+            Retired r = { old, epoch };
+            retired.push_back(r);
+        }
+        ++versions;
+    }
+
+    static std::string directory(const std::string& path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+
+    static std::string baseName(const std::string& path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    // background thread: reloads on file events (and when the file stamps change, which also covers
+    // platforms without inotify) and reclaims retired tables
+    // a failed load (e.g. a file still being written) keeps the current tables and is retried on the next change
+    void watch(int pollMs)
+    {
+#ifdef __linux__
+        // watch the directories rather than the files, so that editors and tools replacing
+        // the files by rename are followed
+        int fd = inotify_init1(IN_NONBLOCK);
+        if (fd >= 0)
+        {
+            const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+            inotify_add_watch(fd, directory(path1).c_str(), mask);
+            if (directory(path2) != directory(path1))
+                inotify_add_watch(fd, directory(path2).c_str(), mask);
+        }
+#endif
+
+        while (running)
+        {
+#ifdef __linux__
+            if (fd >= 0)
+            {
+                pollfd pfd = { fd, POLLIN, 0 };
+                bool changed = false;
+                if (poll(&pfd, 1, pollMs) > 0)
+                {
+                    alignas(inotify_event) char buffer[4096];
+                    ssize_t n;
+                    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+                    {
+                        for (char* p = buffer; p < buffer + n; )
+                        {
+                            const inotify_event* event = (const inotify_event*)p;
+                            if (event->len > 0 && (baseName(path1) == event->name || baseName(path2) == event->name))
+                                changed = true;
+                            p += sizeof(inotify_event) + event->len;
+                        }
+                    }
+                }
+
+                if (changed)
+                {
+                    // let the writer finish the second file of a pair
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    reload();
+                }
+            }
+            else
+#endif
+                std::this_thread::sleep_for(std::chrono::milliseconds(pollMs));
+
+            if (fileStamp(path1) != stamp1 || fileStamp(path2) != stamp2)
+                reload();
+
+            reclaim();
+        }
+
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    std::string path1, path2;
+    FileStamp stamp1, stamp2;
+
+    std::atomic<const LTCTable*> current;
+    std::atomic<uint64_t> globalEpoch;
+    ReaderSlot readers[MAX_READERS];
+
+    // readers without a slot
+    std::mutex overflow;
+    std::atomic<uint64_t> overflowEpoch;
+    int overflowReaders;
+
+    std::atomic<unsigned> versions;
+    std::atomic<unsigned> failures;
+
+    // writer side: reloads, retired list
+    std::mutex writer;
+    std::vector<Retired> retired;
+
+    std::atomic<bool> running;
+    std::thread watcher;
+};
+
+#endif
@@ -0,0 +1,81 @@
+// iesConvert.cpp : batch conversion of IES libraries to prefiltered LTC profiles
+//
+// usage: iesConvert <file.ies | directory> ...
+// writes <file>.ltcies next to each source, which loadIES() picks up at runtime
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <dirent.h>
+#include <ctype.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "../ies.h"
+
+static bool hasIESExtension(const std::string& name)
+{
+    if (name.size() < 4)
+        return false;
+
+    std::string ext = name.substr(name.size() - 4);
+    for (size_t i = 0; i < ext.size(); ++i)
+        ext[i] = (char)tolower(ext[i]);
+    return ext == ".ies";
+}
+
+static void listIES(const std::string& path, std::vector<std::string>& files)
+{
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+    {
+        files.push_back(path);
+        return;
+    }
+
+    while (dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        std::string child = path + "/" + name;
+        if (hasIESExtension(name))
+            files.push_back(child);
+        else if (entry->d_type == DT_DIR)
+            listIES(child, files);
+    }
+
+    closedir(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "usage: " << argv[0] << " <file.ies | directory> ..." << endl;
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+        listIES(argv[i], files);
+
+    int failed = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (loadIES(files[i]))
+            cout << "ok     " << files[i] << endl;
+        else
+        {
+            cout << "failed " << files[i] << endl;
+            ++failed;
+        }
+    }
+
+    cout << files.size() - failed << "/" << files.size() << " profiles converted" << endl;
+
+    return failed ? 1 : 0;
+}
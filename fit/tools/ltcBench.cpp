@@ -0,0 +1,2804 @@
+// ltcBench.cpp : validation and benchmarks of the CPU LTC evaluators
+//
+// usage: ltcBench <test> [ltc_1.dds ltc_2.dds]
+// the fitted tables default to results/ltc_1.dds and results/ltc_2.dds
+// (results/btdf_1.dds and results/btdf_2.dds for the btdf test, results/combined_1.dds and results/combined_2.dds
+// for the combined test, with results/ltc_1.dds and results/ltc_2.dds, results/phase_1.dds and results/phase_2.dds
+// for the phase test)
+// ltcBench plugin [path] tests the BRDF plugin at path, bin/libbrdfPluginGGX.so by default
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "../bake.h"
+#include "../brdf_beckmann.h"
+#include "../brdf_plugin_host.h"
+#include "../brdf_ggx.h"
+#include "../envmap.h"
+#include "../image_output.h"
+#include "../ltc_btdf.h"
+#include "../ltc_combined.h"
+#include "../ltc_eval.h"
+#include "../ltc_kernels.h"
+#include "../ltc_light_tree.h"
+#include "../ltc_lod.h"
+#include "../ltc_matrix.h"
+#include "../ltc_motion.h"
+#include "../ltc_phase.h"
+#include "../ltc_ray.h"
+#include "../ltc_table.h"
+#include "../ltc_spectral.h"
+#include "../refit_server.h"
+#include "../sh_polygon.h"
+#include "../table_manager.h"
+
+// keeps benchmarked results alive
+static volatile float sink;
+
+static double seconds(chrono::high_resolution_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// random quad light above a shading point at the origin, lit side facing down
+static void randomQuad(mt19937& rng, vec3 points[4])
+{
+    uniform_real_distribution<float> u(-1.0f, 1.0f);
+
+    vec3 center = vec3(4.0f*u(rng), 4.0f*u(rng), 2.0f + 1.5f*u(rng));
+    vec3 ex = vec3(1.0f + 0.5f*u(rng), 0.3f*u(rng), 0.3f*u(rng));
+    vec3 ey = vec3(0.3f*u(rng), 1.0f + 0.5f*u(rng), 0.3f*u(rng));
+
+    points[0] = center - ex - ey;
+    points[1] = center + ex - ey;
+    points[2] = center + ex + ey;
+    points[3] = center - ex + ey;
+}
+
+static vec3 randomView(mt19937& rng)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    float phi = 2.0f*3.14159f*u(rng);
+    float ct = 0.05f + 0.95f*u(rng);
+    float st = sqrtf(1.0f - ct*ct);
+    return vec3(st*cosf(phi), st*sinf(phi), ct);
+}
+
+// spectral packets against the RGB shading of the demos
+int testSpectral(const LTCTable& table)
+{
+    const int W = 8;
+    const int numPackets = 64;
+    const int numConfigs = 1000;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    float maxError = 0.0f;
+
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        SpectralQuadLight light;
+        randomQuad(rng, light.points);
+        light.twoSided = false;
+
+        vec3 N = vec3(0, 0, 1);
+        vec3 V = randomView(rng);
+        vec3 P = vec3(0, 0, 0);
+        float roughness = u(rng);
+
+        // smooth reflectance spectra
+        float a = u(rng), b = u(rng), phase = 6.28f*u(rng);
+
+        vec3 white = vec3(0, 0, 0);
+        vec3 f0XYZ = vec3(0, 0, 0);
+        vec3 albedoXYZ = vec3(0, 0, 0);
+        vec3 LoXYZ = vec3(0, 0, 0);
+
+        for (int p = 0; p < numPackets; ++p)
+        {
+            float lambda[W], Le[W], f0[W], albedo[W], ones[W], Lo[W];
+            initWavelengths<W>((p + 0.5f)/(numPackets*W), lambda);
+
+            for (int i = 0; i < W; ++i)
+            {
+                float x = (lambda[i] - LAMBDA_MIN)/(LAMBDA_MAX - LAMBDA_MIN);
+                Le[i]     = 1.0f;
+                f0[i]     = 0.02f + 0.96f*a*(0.5f + 0.5f*sinf(6.28f*x + phase));
+                albedo[i] = b*x;
+                ones[i]   = 1.0f;
+                Lo[i]     = 0.0f;
+            }
+
+            LTC_EvaluateSpectral<W>(N, V, P, roughness, table, light, Le, f0, albedo, Lo);
+
+            white     += spectrumToXYZ<W>(lambda, ones);
+            f0XYZ     += spectrumToXYZ<W>(lambda, f0);
+            albedoXYZ += spectrumToXYZ<W>(lambda, albedo);
+            LoXYZ     += spectrumToXYZ<W>(lambda, Lo);
+        }
+
+        // white balance on the equal-energy illuminant
+        vec3 whiteRGB = XYZToLinearSRGB(white);
+        vec3 spectral = XYZToLinearSRGB(LoXYZ)/whiteRGB;
+        vec3 scol     = XYZToLinearSRGB(f0XYZ)/whiteRGB;
+        vec3 dcol     = XYZToLinearSRGB(albedoXYZ)/whiteRGB;
+
+        // RGB path, as in ltc_quad.fs
+        float ndotv = glm::clamp(dot(N, V), 0.0f, 1.0f);
+        mat3 Minv = table.Minv(roughness, ndotv);
+        vec2 t2 = table.magFresnel(roughness, ndotv);
+        float spec = LTC_Evaluate(N, V, P, Minv,    light.points, light.twoSided);
+        float diff = LTC_Evaluate(N, V, P, mat3(1), light.points, light.twoSided);
+        vec3 rgb = spec*(scol*t2.x + (1.0f - scol)*t2.y) + dcol*diff;
+
+        for (int k = 0; k < 3; ++k)
+            maxError = std::max<float>(maxError, fabsf(spectral[k] - rgb[k])/std::max<float>(fabsf(rgb[k]), 1e-3f));
+    }
+
+    cout << "spectral vs RGB: max relative error = " << maxError << endl;
+
+    // throughput: one packet vs. W independent evaluations
+    const int numEvals = 200000;
+    SpectralQuadLight light;
+    randomQuad(rng, light.points);
+    light.twoSided = false;
+
+    float Le[W], f0[W], albedo[W], Lo[W];
+    for (int i = 0; i < W; ++i)
+    {
+        Le[i] = 1.0f;
+        f0[i] = 0.04f + 0.1f*i;
+        albedo[i] = 0.5f;
+        Lo[i] = 0.0f;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int e = 0; e < numEvals; ++e)
+    {
+        vec3 V = normalize(vec3(0.001f*(e % 1000), 0.0f, 1.0f));
+        LTC_EvaluateSpectral<W>(vec3(0, 0, 1), V, vec3(0, 0, 0), 0.5f, table, light, Le, f0, albedo, Lo);
+    }
+    double packet = seconds(start);
+
+    float sum = 0.0f;
+    start = chrono::high_resolution_clock::now();
+    for (int e = 0; e < numEvals; ++e)
+    {
+        vec3 V = normalize(vec3(0.001f*(e % 1000), 0.0f, 1.0f));
+        mat3 Minv = table.Minv(0.5f, V.z);
+        for (int i = 0; i < W; ++i)
+        {
+            sum += LTC_Evaluate(vec3(0, 0, 1), V, vec3(0, 0, 0), Minv,    light.points, false);
+            sum += LTC_Evaluate(vec3(0, 0, 1), V, vec3(0, 0, 0), mat3(1), light.points, false);
+        }
+    }
+    double perWavelength = seconds(start);
+
+    cout << "packet of " << W << " wavelengths: " << 1e9*packet/numEvals << " ns, ";
+    cout << "per-wavelength evaluation: " << 1e9*perWavelength/numEvals << " ns ";
+    cout << "(" << perWavelength/packet << "x)" << endl;
+    sink = sum + Lo[0];
+
+    return maxError < 1e-3f ? 0 : 1;
+}
+
+static bool copyFile(const char* from, const string& to)
+{
+    ifstream in(from, ios::binary);
+    ofstream out(to.c_str(), ios::binary);
+    out << in.rdbuf();
+    return in && out;
+}
+
+// hot reloading: readers keep shading while the table files are rewritten underneath them
+int testReload(const char* path1, const char* path2)
+{
+    const string dir = "/tmp";
+    const string copy1 = dir + "/ltcBench_1.dds";
+    const string copy2 = dir + "/ltcBench_2.dds";
+    if (!copyFile(path1, copy1) || !copyFile(path2, copy2))
+    {
+        cout << "could not copy the tables to " << dir << endl;
+        return 1;
+    }
+
+    LTCTableManager manager(copy1, copy2);
+    if (!manager.start(50))
+    {
+        cout << "could not load the initial tables" << endl;
+        return 1;
+    }
+
+    // the readers give their slots back and register again, like thread pools that are re-created, and the
+    // last one reads without a slot, through the locked fallback
+    const int numReaders = 5;
+    atomic<bool> done(false);
+    atomic<long long> lookups(0);
+    atomic<int> registrations(0), noSlot(0);
+    float sums[numReaders];
+
+    vector<thread> readers;
+    for (int r = 0; r < numReaders; ++r)
+    {
+        readers.push_back(thread([&, r]()
+        {
+            long long n = 0;
+            float sum = 0.0f;
+            while (!done)
+            {
+                int slot = r < numReaders - 1 ? manager.registerReader() : LTCTableManager::NO_SLOT;
+                registrations++;
+                noSlot += r < numReaders - 1 && slot == LTCTableManager::NO_SLOT;
+                for (int k = 0; k < 100 && !done; ++k)
+                {
+                    LTCTableManager::Guard table(manager, slot);
+                    for (int i = 0; i < 1000; ++i, ++n)
+                        sum += table->Minv(0.001f*i, 0.5f)[0][0];
+                }
+                manager.unregisterReader(slot);
+            }
+            lookups += n;
+            sums[r] = sum;
+        }));
+    }
+
+    // rewrites, then a truncated file that must be rejected, then a valid rewrite again
+    const int numRewrites = 5;
+    for (int i = 0; i < numRewrites; ++i)
+    {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        copyFile(path1, copy1);
+        copyFile(path2, copy2);
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(200));
+    ofstream(copy2.c_str(), ios::binary) << "DDS ";
+    this_thread::sleep_for(chrono::milliseconds(200));
+    unsigned rejected = manager.rejected();
+
+    copyFile(path2, copy2);
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    done = true;
+    for (size_t r = 0; r < readers.size(); ++r)
+        readers[r].join();
+    manager.stop();
+
+    cout << "versions published: " << manager.version() << ", rejected: " << rejected << ", ";
+    cout << "lookups: " << lookups << ", registrations: " << registrations << " (" << noSlot << " without a slot)";
+    cout << endl;
+    sink = sums[0];
+
+    // all the slots, then none left, then all of them again once they are given back
+    int exhausted = 0;
+    for (int round = 0; round < 3; ++round)
+    {
+        vector<int> slots;
+        for (int r = 0; r < LTCTableManager::MAX_READERS; ++r)
+            slots.push_back(manager.registerReader());
+        exhausted += std::count(slots.begin(), slots.end(), (int)LTCTableManager::NO_SLOT) == 0 &&
+            manager.registerReader() == LTCTableManager::NO_SLOT;
+        for (int slot : slots)
+            manager.unregisterReader(slot);
+    }
+    cout << "slots claimed and returned: " << exhausted << "/3 rounds" << endl;
+
+    // guarded lookups against direct ones
+    LTCTable table;
+    table.load(path1, path2);
+    int slot = manager.registerReader();
+    const int numEvals = 10000000;
+
+    auto start = chrono::high_resolution_clock::now();
+    float sum = 0.0f;
+    for (int e = 0; e < numEvals; ++e)
+        sum += table.Minv(1e-7f*e, 0.5f)[0][0];
+    double direct = seconds(start);
+
+    start = chrono::high_resolution_clock::now();
+    for (int e = 0; e < numEvals; ++e)
+    {
+        LTCTableManager::Guard guard(manager, slot);
+        sum += guard->Minv(1e-7f*e, 0.5f)[0][0];
+    }
+    double guarded = seconds(start);
+    manager.unregisterReader(slot);
+
+    start = chrono::high_resolution_clock::now();
+    for (int e = 0; e < numEvals; ++e)
+    {
+        LTCTableManager::Guard guard(manager, LTCTableManager::NO_SLOT);
+        sum += guard->Minv(1e-7f*e, 0.5f)[0][0];
+    }
+    double fallback = seconds(start);
+
+    cout << "direct lookup: " << 1e9*direct/numEvals << " ns, ";
+    cout << "guarded lookup: " << 1e9*guarded/numEvals << " ns, ";
+    cout << "without a slot: " << 1e9*fallback/numEvals << " ns" << endl;
+    sink = sum;
+
+    // headers of more texels than their files hold are rejected before any allocation
+    ifstream file(path1, ios::binary);
+    vector<char> dds((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    int oversized = 0;
+    for (uint32_t width : { 2u*table.size, 0xffffffffu })
+    {
+        vector<char> header = dds;
+        memcpy(&header[16], &width, 4);
+        ofstream(copy1.c_str(), ios::binary).write(&header[0], header.size());
+
+        unsigned w, h;
+        float* data = LoadDDS(copy1.c_str(), &w, &h);
+        oversized += data != nullptr;
+        delete[] data;
+    }
+    cout << "oversized headers loaded: " << oversized << endl;
+
+    return manager.version() >= numRewrites + 2 && rejected >= 1 && noSlot == 0 && exhausted == 3 &&
+        oversized == 0 ? 0 : 1;
+}
+
+// transmission through a rough dielectric: LTC tables against Monte Carlo integration of the BTDF
+int testBtdf(const char* path1, const char* path2)
+{
+    LTCBtdfTable table;
+    if (!table.load(path1, path2))
+    {
+        cout << "could not load " << path1 << " and " << path2 << endl;
+        return 1;
+    }
+
+    const int numConfigs = 300;
+    const int sqrtSamples = 128;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    double sumError = 0.0;
+    double sumReference = 0.0;
+    float maxError = 0.0f;
+
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        // light below the surface, lit side facing up
+        vec3 quad[4], points[4];
+        randomQuad(rng, quad);
+        for (int i = 0; i < 4; ++i)
+            points[i] = vec3(quad[3 - i].x, quad[3 - i].y, -quad[3 - i].z);
+
+        vec3 N = vec3(0, 0, 1);
+        vec3 V = randomView(rng);
+        vec3 P = vec3(0, 0, 0);
+        float roughness = 0.3f + 0.7f*u(rng);
+        float eta = BTDF_ETA_MIN + (BTDF_ETA_MAX - BTDF_ETA_MIN)*u(rng);
+
+        // reference: stratified sampling of the light area
+        BtdfGGX btdf(eta);
+        float alpha = roughness*roughness;
+        vec3 ex = points[1] - points[0];
+        vec3 ey = points[3] - points[0];
+        vec3 normal = cross(ey, ex);
+        float area = length(normal);
+        normal /= area;
+
+        double reference = 0.0;
+        for (int j = 0; j < sqrtSamples; ++j)
+        for (int i = 0; i < sqrtSamples; ++i)
+        {
+            vec3 q = points[0] + ex*((i + u(rng))/sqrtSamples) + ey*((j + u(rng))/sqrtSamples);
+            vec3 L = q - P;
+            float dist2 = dot(L, L);
+            L /= sqrtf(dist2);
+
+            float cosLight = dot(normal, -L);
+            if (cosLight <= 0.0f)
+                continue;
+
+            float pdf;
+            float f = btdf.eval(V, vec3(L.x, L.y, -L.z), alpha, pdf);
+            reference += f*cosLight/dist2;
+        }
+        reference *= area/(sqrtSamples*sqrtSamples);
+
+        float ltc = LTC_EvaluateTransmission(N, V, P, roughness, eta, table, points, false);
+
+        // errors relative to the transmitted energy: the lights cover anything from the peak to the tails of the lobe
+        float ndotv = V.z;
+        float energy = table.magnitude(roughness, ndotv, eta);
+        float error = fabsf(ltc - (float)reference);
+        sumError += error;
+        sumReference += reference;
+        maxError = std::max<float>(maxError, error/energy);
+    }
+
+    float meanError = (float)(sumError/sumReference);
+    cout << "transmission vs Monte Carlo: relative L1 error = " << meanError << ", ";
+    cout << "max error relative to the transmitted energy = " << maxError << endl;
+
+    // the fits of the transmitted lobes are looser than the reflected ones (about 9% with the same metric)
+    return meanError < 0.2f ? 0 : 1;
+}
+
+// single-lobe diffuse and specular tables: one LTC integral per light against Monte Carlo integration of the
+// material, two integrals of the diffuse and GGX layers, and the two integrals of ltc_quad.fs, per roughness
+int testCombined(const char* path1, const char* path2)
+{
+    LTCCombinedTable table;
+    if (!table.load(path1, path2))
+    {
+        cout << "could not load " << path1 << " and " << path2 << endl;
+        return 1;
+    }
+
+    LTCTable ggxTable;
+    if (!ggxTable.load("results/ltc_1.dds", "results/ltc_2.dds"))
+    {
+        cout << "could not load results/ltc_1.dds and results/ltc_2.dds" << endl;
+        return 1;
+    }
+
+    // roughness bands of 0.1 from 0.1, where one lobe is accepted within maxError
+    const int numBands = 9;
+    const int configsPerBand = 200;
+    const int numConfigs = numBands*configsPerBand;
+    const int sqrtSamples = 128;
+    const float maxError = 0.1f;
+
+    BrdfDisneyDiffuse disney;
+    BrdfGGX ggx;
+    CombinedAlbedo albedo;
+    albedo.init(disney, ggx, 64, 0.00001f, 32);
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    // luminances: one lobe, the diffuse and GGX layers, ltc_quad.fs and the reference, summed per band
+    enum { ONE_LOBE, TWO_LAYERS, LTC_QUAD, REFERENCE };
+    vector<double> sums(4*numBands, 0.0);
+    vector<vec3> quads(4*numConfigs), views(numConfigs), dcols(numConfigs), scols(numConfigs);
+    vector<float> roughness(numConfigs);
+
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        const vec3* points = &quads[4*c];
+        randomQuad(rng, &quads[4*c]);
+
+        vec3 N = vec3(0, 0, 1);
+        vec3 V = views[c] = randomView(rng);
+        vec3 P = vec3(0, 0, 0);
+        int band = c % numBands;
+        roughness[c] = 0.1f*(band + 1 + u(rng));
+        dcols[c] = vec3(u(rng), u(rng), u(rng))*0.8f;
+        scols[c] = vec3(0.02f + 0.98f*u(rng)*u(rng));
+
+        // the material: diffuse and specular lobes normalized to the colors, as in ltc_quad.fs
+        vec3 spec;
+        float k = combinedSpecularWeight(table, roughness[c], V.z, dcols[c], scols[c], spec);
+        float lum = glsl::LTC_Luminance(dcols[c] + spec);
+        BrdfCombined brdf(disney, ggx, albedo, k);
+
+        // reference: stratified sampling of the light area
+        float alpha = std::max<float>(roughness[c]*roughness[c], 0.00001f);
+        vec3 ex = points[1] - points[0];
+        vec3 ey = points[3] - points[0];
+        vec3 normal = cross(ey, ex);
+        float area = length(normal);
+        normal /= area;
+
+        double reference = 0.0;
+        for (int j = 0; j < sqrtSamples; ++j)
+        for (int i = 0; i < sqrtSamples; ++i)
+        {
+            vec3 q = points[0] + ex*((i + u(rng))/sqrtSamples) + ey*((j + u(rng))/sqrtSamples);
+            vec3 L = q - P;
+            float dist2 = dot(L, L);
+            L /= sqrtf(dist2);
+
+            float pdf;
+            reference += brdf.eval(V, L, alpha, pdf)*fabsf(dot(normal, L))/dist2;
+        }
+        reference *= lum*area/(sqrtSamples*sqrtSamples);
+
+        float oneLobe = glsl::LTC_Luminance(
+            LTC_EvaluateCombined(N, V, P, roughness[c], dcols[c], scols[c], table, points, true, 0.0f));
+        float twoLayers = glsl::LTC_Luminance(
+            LTC_EvaluateCombined(N, V, P, roughness[c], dcols[c], scols[c], table, points, true, 2.0f));
+
+        // ltc_quad.fs: GGX lobe and Lambertian diffuse
+        float ndotv = glm::clamp(V.z, 0.0f, 1.0f);
+        float specLTC = LTC_Evaluate(N, V, P, ggxTable.Minv(roughness[c], ndotv), points, true);
+        float diffLTC = LTC_Evaluate(N, V, P, mat3(1), points, true);
+        float ltcQuad = glsl::LTC_Luminance(spec*specLTC + dcols[c]*diffLTC);
+
+        sums[4*band + ONE_LOBE] += fabs(oneLobe - reference);
+        sums[4*band + TWO_LAYERS] += fabs(twoLayers - reference);
+        sums[4*band + LTC_QUAD] += fabs(ltcQuad - reference);
+        sums[4*band + REFERENCE] += reference;
+    }
+
+    // one lobe from the lowest roughness above which it stays within maxError
+    printf("luminance vs Monte Carlo, relative L1 error per roughness:\n");
+    printf("  roughness   one lobe   diffuse and GGX layers   ltc_quad.fs\n");
+    float minRoughness = 1.0f;
+    for (int band = numBands - 1; band >= 0; --band)
+    {
+        if (sums[4*band + ONE_LOBE] <= maxError*sums[4*band + REFERENCE] && minRoughness == 0.1f*(band + 2))
+            minRoughness = 0.1f*(band + 1);
+    }
+
+    double total[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (int band = 0; band < numBands; ++band)
+    {
+        const double* b = &sums[4*band];
+        float r = 0.1f*(band + 1);
+        printf("  %.1f - %.1f   %8.4f   %22.4f   %11.4f%s\n", r, r + 0.1f, b[ONE_LOBE]/b[REFERENCE],
+            b[TWO_LAYERS]/b[REFERENCE], b[LTC_QUAD]/b[REFERENCE], r < glsl::LTC_COMBINED_MIN_ROUGHNESS ? "" : "  (one lobe)");
+
+        bool combined = r >= glsl::LTC_COMBINED_MIN_ROUGHNESS;
+        total[0] += combined ? b[ONE_LOBE] : b[TWO_LAYERS];
+        total[LTC_QUAD] += b[LTC_QUAD];
+        total[REFERENCE] += b[REFERENCE];
+    }
+
+    float errorCombined = (float)(total[0]/total[REFERENCE]);
+    printf("  one lobe within %.0f%% from roughness %.1f, LTC_COMBINED_MIN_ROUGHNESS = %.2f\n", 100.0f*maxError,
+        minRoughness, glsl::LTC_COMBINED_MIN_ROUGHNESS);
+    printf("  all roughnesses: LTC_EvaluateCombined() %.4f, ltc_quad.fs %.4f\n", errorCombined,
+        total[LTC_QUAD]/total[REFERENCE]);
+
+    // throughput of one integral per light, two integrals of the layers below the threshold, and ltc_quad.fs
+    const int numEvals = 200000;
+    vec3 N = vec3(0, 0, 1), P = vec3(0, 0, 0);
+
+    double time[3];
+    for (int path = 0; path < 3; ++path)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        vec3 sum = vec3(0.0f);
+        for (int e = 0; e < numEvals; ++e)
+        {
+            int c = e % numConfigs;
+            if (path < 2)
+            {
+                sum += LTC_EvaluateCombined(N, views[c], P, roughness[c], dcols[c], scols[c], table, &quads[4*c], true,
+                    path == 0 ? 0.0f : 2.0f);
+                continue;
+            }
+
+            float ndotv = views[c].z;
+            vec2 t2 = ggxTable.magFresnel(roughness[c], ndotv);
+            float specLTC = LTC_Evaluate(N, views[c], P, ggxTable.Minv(roughness[c], ndotv), &quads[4*c], true);
+            float diffLTC = LTC_Evaluate(N, views[c], P, mat3(1), &quads[4*c], true);
+            sum += specLTC*(scols[c]*t2.x + (1.0f - scols[c])*t2.y) + dcols[c]*diffLTC;
+        }
+        time[path] = seconds(start);
+        sink = sum.x;
+    }
+
+    printf("  one lobe %.1f ns per light, diffuse and GGX layers %.1f ns, ltc_quad.fs %.1f ns\n",
+        1e9*time[0]/numEvals, 1e9*time[1]/numEvals, 1e9*time[2]/numEvals);
+
+    bool passed = errorCombined < maxError && glsl::LTC_COMBINED_MIN_ROUGHNESS >= minRoughness - 1e-3f;
+    return passed ? 0 : 1;
+}
+
+// motion-blurred lights: adaptive time integration against uniform time sampling
+int testMotion(const LTCTable& table)
+{
+    const int numConfigs = 2000;
+    const int numReference = 4096;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(-1.0f, 1.0f);
+
+    // shading points and lights moving by up to 3 units during the shutter interval
+    vector<MotionQuery> queries(numConfigs);
+    vector<MotionQuadLight> lights(numConfigs);
+    vector<double> reference(numConfigs);
+    double sumReference = 0.0;
+
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        MotionQuadLight& light = lights[c];
+        randomQuad(rng, light.open);
+        vec3 offset = vec3(3.0f*u(rng), 3.0f*u(rng), 1.0f*u(rng));
+        for (int i = 0; i < 4; ++i)
+            light.close[i] = light.open[i] + offset;
+        light.twoSided = false;
+
+        MotionQuery& q = queries[c];
+        q.N = vec3(0, 0, 1);
+        q.V = randomView(rng);
+        q.P = vec3(0, 0, 0);
+        q.Minv = table.Minv(0.5f + 0.5f*u(rng), q.V.z);
+
+        double sum = 0.0;
+        for (int k = 0; k < numReference; ++k)
+        {
+            float t = (k + 0.5f)/numReference;
+            vec3 points[4];
+            for (int i = 0; i < 4; ++i)
+                points[i] = mix(light.open[i], light.close[i], t);
+            sum += LTC_Evaluate(q.N, q.V, q.P, q.Minv, points, light.twoSided);
+        }
+        reference[c] = sum/numReference;
+        sumReference += reference[c];
+    }
+
+    // uniform time sampling (midpoints), one LTC_Evaluate per sample
+    const int uniformSamples[] = { 4, 8, 16, 32, 64 };
+    for (int K : uniformSamples)
+    {
+        vector<float> result(numConfigs);
+
+        auto start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+        {
+            const MotionQuery& q = queries[c];
+            float sum = 0.0f;
+            for (int k = 0; k < K; ++k)
+            {
+                float t = (k + 0.5f)/K;
+                vec3 points[4];
+                for (int i = 0; i < 4; ++i)
+                    points[i] = mix(lights[c].open[i], lights[c].close[i], t);
+                sum += LTC_Evaluate(q.N, q.V, q.P, q.Minv, points, lights[c].twoSided);
+            }
+            result[c] = sum/K;
+        }
+        double time = seconds(start);
+
+        double sumError = 0.0;
+        for (int c = 0; c < numConfigs; ++c)
+            sumError += fabs(result[c] - reference[c]);
+
+        cout << "uniform " << K << " samples: relative L1 error = " << sumError/sumReference << ", ";
+        cout << 1e9*time/numConfigs << " ns" << endl;
+    }
+
+    // adaptive, batched per light
+    const float tolerances[] = { 1e-2f, 3e-3f, 1e-3f, 3e-4f };
+    double defaultError = 1.0;
+    for (float tolerance : tolerances)
+    {
+        vector<float> result(numConfigs);
+        int evaluations = 0;
+
+        auto start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+            evaluations += LTC_EvaluateMotion(&queries[c], 1, lights[c], &result[c], tolerance);
+        double time = seconds(start);
+
+        double sumError = 0.0;
+        for (int c = 0; c < numConfigs; ++c)
+            sumError += fabs(result[c] - reference[c]);
+
+        if (tolerance == 3e-3f)
+            defaultError = sumError/sumReference;
+
+        cout << "adaptive, tolerance " << tolerance << ": relative L1 error = " << sumError/sumReference << ", ";
+        cout << float(evaluations)/numConfigs << " evaluations, " << 1e9*time/numConfigs << " ns" << endl;
+    }
+
+    return defaultError < 1e-3 ? 0 : 1;
+}
+
+// Monte Carlo SH projection of a quad seen from P, sampling its area with sqrtSamples^2 stratified samples
+template<int ORDER>
+static void projectSHMonteCarlo(mt19937& rng, const vec3& P, const vec3 points[4], bool twoSided,
+    int sqrtSamples, float coeffs[ORDER*ORDER])
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    vec3 ex = points[1] - points[0];
+    vec3 ey = points[3] - points[0];
+    vec3 normal = cross(ey, ex);
+    float area = length(normal);
+    normal /= area;
+
+    double sum[ORDER*ORDER] = {};
+    for (int j = 0; j < sqrtSamples; ++j)
+    for (int i = 0; i < sqrtSamples; ++i)
+    {
+        vec3 q = points[0] + ex*((i + u(rng))/sqrtSamples) + ey*((j + u(rng))/sqrtSamples);
+        vec3 L = q - P;
+        float dist2 = dot(L, L);
+        L /= sqrtf(dist2);
+
+        float cosLight = dot(normal, -L);
+        if (twoSided)
+            cosLight = fabsf(cosLight);
+        if (cosLight <= 0.0f)
+            continue;
+
+        float Y[ORDER*ORDER];
+        evalSH<ORDER>(L, Y);
+        for (int k = 0; k < ORDER*ORDER; ++k)
+            sum[k] += Y[k]*cosLight/dist2;
+    }
+
+    for (int k = 0; k < ORDER*ORDER; ++k)
+        coeffs[k] = float(sum[k]*area/(sqrtSamples*sqrtSamples));
+}
+
+// analytic SH projection of quad lights against Monte Carlo
+int testSH()
+{
+    const int ORDER = 4;
+    const int K = ORDER*ORDER;
+    const int numConfigs = 300;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(-1.0f, 1.0f);
+
+    // probes around the origin, so that some lights are seen from the back or from below
+    double sumError = 0.0, sumNorm = 0.0;
+    float maxError = 0.0f;
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        vec3 points[4];
+        randomQuad(rng, points);
+        vec3 P = vec3(2.0f*u(rng), 2.0f*u(rng), 1.5f*u(rng));
+        bool twoSided = c % 2 == 1;
+
+        float analytic[K], reference[K];
+        SH_ProjectPolygon<ORDER>(&P, 1, points, 4, twoSided, analytic);
+        projectSHMonteCarlo<ORDER>(rng, P, points, twoSided, 512, reference);
+
+        float error = 0.0f, norm = 0.0f;
+        for (int k = 0; k < K; ++k)
+        {
+            error += (analytic[k] - reference[k])*(analytic[k] - reference[k]);
+            norm += reference[k]*reference[k];
+        }
+        sumError += sqrtf(error);
+        sumNorm += sqrtf(norm);
+        maxError = std::max<float>(maxError, sqrtf(error/std::max<float>(norm, 1e-8f)));
+    }
+
+    cout << "analytic vs Monte Carlo, order " << ORDER << ": relative L2 error = " << sumError/sumNorm << ", ";
+    cout << "max = " << maxError << endl;
+
+    // throughput of a probe volume update, one light
+    const int numProbes = 4096;
+    vector<vec3> probes(numProbes);
+    for (int i = 0; i < numProbes; ++i)
+        probes[i] = vec3(4.0f*u(rng), 4.0f*u(rng), 1.5f*u(rng));
+
+    vec3 points[4];
+    randomQuad(rng, points);
+    vector<float> coeffs(numProbes*K);
+
+    const int numRuns = 20;
+    auto start = chrono::high_resolution_clock::now();
+    for (int r = 0; r < numRuns; ++r)
+        SH_ProjectPolygon<ORDER>(&probes[0], numProbes, points, 4, false, &coeffs[0]);
+    double analytic = seconds(start)/numRuns;
+
+    // Monte Carlo with 256 samples per probe
+    start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < numProbes; ++i)
+        projectSHMonteCarlo<ORDER>(rng, probes[i], points, false, 16, &coeffs[i*K]);
+    double monteCarlo = seconds(start);
+
+    cout << numProbes << " probes: analytic " << 1e3*analytic << " ms (" << 1e9*analytic/numProbes << " ns per probe), ";
+    cout << "Monte Carlo with 256 samples " << 1e3*monteCarlo << " ms" << endl;
+    sink = coeffs[0];
+
+    // polygons beyond SH_MAX_VERTICES are rejected
+    vec3 polygon[SH_MAX_VERTICES + 1];
+    for (int k = 0; k <= SH_MAX_VERTICES; ++k)
+        polygon[k] = vec3(cosf(0.7f*k), sinf(0.7f*k), 2.0f);
+    bool rejected = !SH_ProjectPolygon<ORDER>(&probes[0], 1, polygon, SH_MAX_VERTICES + 1, false, &coeffs[0]) &&
+        SH_ProjectPolygon<ORDER>(&probes[0], 1, polygon, SH_MAX_VERTICES, false, &coeffs[0]);
+    if (!rejected)
+        cout << "polygon of " << SH_MAX_VERTICES + 1 << " vertices not rejected  FAILED" << endl;
+
+    return sumError/sumNorm < 1e-2 && rejected ? 0 : 1;
+}
+
+// Monte Carlo integral of the LTC of Minv over the disk inscribed in a quad, in the shading frame of the origin
+static float diskMonteCarlo(mt19937& rng, const mat3& R, const mat3& Minv, const vec3 points[4], int numSamples)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    vec3 center = 0.5f*(points[0] + points[2]);
+    vec3 ex = 0.5f*(points[1] - points[0]);
+    vec3 ey = 0.5f*(points[3] - points[0]);
+    vec3 normal = normalize(cross(ex, ey));
+    float area = 3.14159265f*length(ex)*length(ey);
+
+    double sum = 0.0;
+    for (int k = 0; k < numSamples; ++k)
+    {
+        float r = sqrtf(u(rng));
+        float phi = 2.0f*3.14159265f*u(rng);
+        vec3 p = R*(center + r*cosf(phi)*ex + r*sinf(phi)*ey);
+        vec3 w = normalize(p);
+        sum += glsl::D(w, Minv)*fabsf(dot(w, R*normal))/dot(p, p);
+    }
+    return float(area*sum/numSamples);
+}
+
+// kernels shared with the demos against the CPU evaluators and numerical integration
+int testKernels(const LTCTable& table)
+{
+    const int numConfigs = 2000;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    glsl::sampler2D ltc_1 = glsl::makeSampler(table.tex1, table.size);
+    glsl::sampler2D ltc_2 = glsl::makeSampler(table.tex2, table.size);
+
+    vector<vec3> views(numConfigs);
+    vector<float> roughness(numConfigs);
+    vector<mat3> Minv(numConfigs);
+    vector<vec3> quads(4*numConfigs);
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        views[c] = randomView(rng);
+        roughness[c] = 0.1f + 0.9f*u(rng);
+        Minv[c] = glsl::LTC_Matrix(glsl::texture(ltc_1, glsl::LTC_Coords(roughness[c], views[c].z)));
+        randomQuad(rng, &quads[4*c]);
+    }
+
+    const vec3 N = vec3(0, 0, 1);
+    const vec3 P = vec3(0, 0, 0);
+
+    // quads: the kernel matches LTC_Evaluate(), and the clipless approximation is close to the clipped integral
+    {
+        double maxDiff = 0.0, sumClipless = 0.0, sumRef = 0.0;
+        for (int c = 0; c < numConfigs; ++c)
+        {
+            float ref = LTC_Evaluate(N, views[c], P, table.Minv(roughness[c], views[c].z), &quads[4*c], true);
+            float clipped = glsl::LTC_EvaluateQuad(N, views[c], P, Minv[c], &quads[4*c], true, false, ltc_2).x;
+            float clipless = glsl::LTC_EvaluateQuad(N, views[c], P, Minv[c], &quads[4*c], true, true, ltc_2).x;
+
+            maxDiff = std::max<double>(maxDiff, fabs(clipped - ref));
+            sumClipless += fabs(clipless - clipped);
+            sumRef += clipped;
+        }
+
+        cout << "quad: max difference to LTC_Evaluate " << maxDiff << ", ";
+        cout << "clipless relative L1 difference " << sumClipless/sumRef << endl;
+
+        if (maxDiff > 1e-4)
+            return 1;
+    }
+
+    // disks: against Monte Carlo over the ellipse
+    {
+        const int numDisks = 200;
+        double sumError = 0.0, sumRef = 0.0;
+        for (int c = 0; c < numDisks; ++c)
+        {
+            mat3 R = LTC_ShadingFrame(N, views[c], mat3(1));
+            float ref = diskMonteCarlo(rng, R, Minv[c], &quads[4*c], 1 << 16);
+            float disk = glsl::LTC_EvaluateDisk(N, views[c], P, Minv[c], &quads[4*c], true, ltc_2);
+
+            sumError += fabs(disk - ref);
+            sumRef += ref;
+        }
+
+        cout << "disk: relative L1 error to Monte Carlo " << sumError/sumRef << endl;
+    }
+
+    // cylinders: analytic line and end caps against the numerical integrals
+    {
+        const int numCylinders = 200;
+        const float radius = 0.2f;
+        double sumError = 0.0, sumRef = 0.0;
+        for (int c = 0; c < numCylinders; ++c)
+        {
+            mat3 R = LTC_ShadingFrame(N, views[c], mat3(1));
+            vec3 p1 = R*quads[4*c + 0];
+            vec3 p2 = R*quads[4*c + 2];
+
+            float ref = glsl::I_cylinder_numerical(p1, p2, radius, Minv[c]) +
+                        glsl::I_disks_numerical(p1, p2, radius, Minv[c]);
+            float line = radius*glsl::I_ltc_line(p1, p2, Minv[c]) + glsl::I_ltc_disks(p1, p2, radius, Minv[c]);
+
+            sumError += fabs(line - ref);
+            sumRef += ref;
+        }
+
+        cout << "cylinder: relative L1 error to numerical integration " << sumError/sumRef << endl;
+    }
+
+    // timings
+    {
+        auto start = chrono::high_resolution_clock::now();
+        float sum = 0.0f;
+        for (int c = 0; c < numConfigs; ++c)
+            sum += LTC_Evaluate(N, views[c], P, Minv[c], &quads[4*c], true);
+        double cpu = seconds(start);
+
+        start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+            sum += glsl::LTC_EvaluateQuad(N, views[c], P, Minv[c], &quads[4*c], true, false, ltc_2).x;
+        double quad = seconds(start);
+
+        start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+            sum += glsl::LTC_EvaluateQuad(N, views[c], P, Minv[c], &quads[4*c], true, true, ltc_2).x;
+        double clipless = seconds(start);
+
+        start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+            sum += glsl::LTC_EvaluateDisk(N, views[c], P, Minv[c], &quads[4*c], true, ltc_2);
+        double disk = seconds(start);
+
+        start = chrono::high_resolution_clock::now();
+        for (int c = 0; c < numConfigs; ++c)
+            sum += glsl::I_ltc_line(quads[4*c], quads[4*c + 2], Minv[c]);
+        double line = seconds(start);
+
+        cout << "LTC_Evaluate " << 1e9*cpu/numConfigs << " ns, quad kernel " << 1e9*quad/numConfigs << " ns, ";
+        cout << "clipless " << 1e9*clipless/numConfigs << " ns, disk " << 1e9*disk/numConfigs << " ns, ";
+        cout << "line " << 1e9*line/numConfigs << " ns" << endl;
+        sink = sum;
+    }
+
+    return 0;
+}
+
+// random small quad light around a shading point at the origin, of size in [minSize, maxSize] (log-uniform)
+static void randomSmallQuad(mt19937& rng, float minSize, float maxSize, vec3 points[4])
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    // center in the upper hemisphere, at a distance in [2, 20]
+    float phi = 2.0f*3.14159f*u(rng);
+    float ct = u(rng);
+    float st = sqrtf(1.0f - ct*ct);
+    vec3 center = (2.0f + 18.0f*u(rng))*vec3(st*cosf(phi), st*sinf(phi), ct);
+
+    // random orientation
+    vec3 n = normalize(vec3(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f));
+    vec3 t = normalize(cross(n, fabsf(n.x) < 0.9f ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+    vec3 b = cross(n, t);
+
+    float size = minSize*powf(maxSize/minSize, u(rng));
+    vec3 ex = 0.5f*size*t;
+    vec3 ey = 0.5f*size*(0.25f + 0.75f*u(rng))*b;
+
+    points[0] = center - ex - ey;
+    points[1] = center + ex - ey;
+    points[2] = center + ex + ey;
+    points[3] = center - ex + ey;
+}
+
+// LTC integral of a quad light as a sum of point evaluations over n x n sub-quads, accumulated in double precision
+// (the edge integrals of LTC_Evaluate() lose their precision to cancellations for tiny lights)
+static double pointSumLTC(const mat3& MinvFrame, const vec3 points[4], bool twoSided, int n)
+{
+    const double detScale = fabs(determinant(MinvFrame))/3.14159265358979;
+
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+    {
+        // sub-quad corners, bilinear in the quad
+        vec3 q[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            float s = float(i + (k == 1 || k == 2))/n;
+            float t = float(j + (k >= 2))/n;
+            q[k] = mix(mix(points[0], points[1], s), mix(points[3], points[2], s), t);
+        }
+
+        vec3 c = 0.25f*(q[0] + q[1] + q[2] + q[3]);
+        vec3 area = 0.5f*cross(q[2] - q[0], q[3] - q[1]);
+        vec3 wo = MinvFrame*c;
+        double wo2 = dot(wo, wo);
+
+        double facing = dot(area, c);
+        facing = twoSided ? fabs(facing) : std::max<double>(0.0, facing);
+        sum += detScale*std::max<double>(0.0, wo.z)*facing/(wo2*wo2);
+    }
+    return sum;
+}
+
+// point evaluation of small lights against a subdivided reference
+int testLOD(const LTCTable& table)
+{
+    const int numPoints = 256;
+    const int numLights = 1024;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    // a scene of lights of 1cm to 1m
+    LTCLodLights lights;
+    for (int l = 0; l < numLights; ++l)
+    {
+        vec3 points[4];
+        randomSmallQuad(rng, 0.01f, 1.0f, points);
+        lights.add(points, u(rng) < 0.5f);
+    }
+
+    const vec3 N = vec3(0, 0, 1);
+    const vec3 P = vec3(0, 0, 0);
+    vector<vec3> views(numPoints);
+    vector<mat3> Minv(numPoints);
+    vector<double> reference(numPoints*numLights);
+    vector<float> full(numPoints*numLights);
+    for (int p = 0; p < numPoints; ++p)
+    {
+        views[p] = randomView(rng);
+        Minv[p] = table.Minv(0.05f + 0.95f*u(rng), views[p].z);
+
+        mat3 MinvFrame = LTC_ShadingFrame(N, views[p], Minv[p]);
+        for (int l = 0; l < numLights; ++l)
+        {
+            reference[p*numLights + l] = pointSumLTC(MinvFrame, &lights.points[4*l], lights.twoSided[l] != 0, 16);
+            full[p*numLights + l] = LTC_Evaluate(N, views[p], P, Minv[p], &lights.points[4*l], lights.twoSided[l] != 0);
+        }
+    }
+
+    // relative errors of the lights above the precision of LTC_Evaluate()
+    {
+        vector<float> errors;
+        for (int i = 0; i < numPoints*numLights; ++i)
+            if (reference[i] > 1e-6)
+                errors.push_back(float(fabs(full[i] - reference[i])/reference[i]));
+        sort(errors.begin(), errors.end());
+
+        cout << "LTC_Evaluate: per-light relative error median " << errors[errors.size()/2];
+        cout << ", p99 " << errors[errors.size()*99/100] << endl;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    float sum = 0.0f;
+    for (int p = 0; p < numPoints; ++p)
+    for (int l = 0; l < numLights; ++l)
+        sum += LTC_Evaluate(N, views[p], P, Minv[p], &lights.points[4*l], lights.twoSided[l] != 0);
+    double timeFull = seconds(start);
+
+    cout << "LTC_Evaluate: " << 1e9*timeFull/(numPoints*numLights) << " ns per light" << endl;
+
+    const float maxErrors[] = { 1e-3f, 1e-2f, 5e-2f };
+    bool ok = true;
+    for (float maxError : maxErrors)
+    {
+        vector<float> result(numLights);
+        vector<float> errors;
+        float maxPointError = 0.0f;
+        int numFull = 0;
+        double sumError = 0.0, sumReference = 0.0;
+        for (int p = 0; p < numPoints; ++p)
+        {
+            numFull += LTC_EvaluateLOD(N, views[p], P, Minv[p], lights, &result[0], maxError);
+
+            double sumLOD = 0.0, sumRef = 0.0;
+            for (int l = 0; l < numLights; ++l)
+            {
+                double ref = reference[p*numLights + l];
+                if (ref > 1e-6)
+                {
+                    float error = float(fabs(result[l] - ref)/ref);
+                    errors.push_back(error);
+                    if (result[l] != full[p*numLights + l])
+                        maxPointError = std::max<float>(maxPointError, error);
+                }
+
+                sumLOD += result[l];
+                sumRef += ref;
+            }
+            sumError += fabs(sumLOD - sumRef);
+            sumReference += sumRef;
+        }
+        sort(errors.begin(), errors.end());
+
+        start = chrono::high_resolution_clock::now();
+        for (int p = 0; p < numPoints; ++p)
+        {
+            LTC_EvaluateLOD(N, views[p], P, Minv[p], lights, &result[0], maxError);
+            for (int l = 0; l < numLights; ++l)
+                sum += result[l];
+        }
+        double timeLOD = seconds(start);
+
+        cout << "LTC_EvaluateLOD, max error " << maxError << ": ";
+        cout << 100.0f*(numPoints*numLights - numFull)/(numPoints*numLights) << "% points or culled, ";
+        cout << "per-light relative error median " << errors[errors.size()/2] << ", p99 " << errors[errors.size()*99/100];
+        cout << ", max over the points " << maxPointError << ", relative error of the sum " << sumError/sumReference << ", ";
+        cout << 1e9*timeLOD/(numPoints*numLights) << " ns per light (" << timeFull/timeLOD << "x)" << endl;
+
+        ok = ok && maxPointError < maxError;
+    }
+    sink = sum;
+
+    return ok ? 0 : 1;
+}
+
+// many-light selection: no light that contributes is missed, pdf() matches sample(), and the variance of the
+// one-sample estimates against uniform light picking, exactly from the contributions of all the lights
+// (its mean over the points is dominated by the points next to a light, so the median is printed as well)
+int testLightTree(const LTCTable& table)
+{
+    const int numLights = 4096;
+    const int numPoints = 64;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    auto random = [&]() { return u(rng); };
+
+    glsl::sampler2D ltc_2 = glsl::makeSampler(table.tex2, table.size);
+
+    // a room of 20m x 20m, lights of 5cm to 1m under a 4m ceiling, one-sided lights mostly facing down
+    LTCLightTree tree;
+    for (int l = 0; l < numLights; ++l)
+    {
+        vec3 center = vec3(20.0f*u(rng) - 10.0f, 20.0f*u(rng) - 10.0f, 0.2f + 3.8f*u(rng));
+        float size = 0.05f*powf(20.0f, u(rng));
+        float radiance = 0.1f*powf(100.0f, u(rng));
+        int type = l % 3;
+
+        if (type == LTC_LIGHT_SPHERE)
+        {
+            tree.addSphere(center, 0.5f*size, radiance);
+            continue;
+        }
+
+        vec3 n = normalize(vec3(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) < 0.75f ? 1.0f : u(rng) - 0.5f));
+        vec3 a = normalize(cross(n, fabsf(n.x) < 0.9f ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+        vec3 b = cross(n, a);
+        vec3 ex = 0.5f*size*a, ey = 0.5f*size*(0.25f + 0.75f*u(rng))*b;
+
+        // area vector along n, lit below
+        vec3 points[4] = { center - ex - ey, center + ex - ey, center + ex + ey, center - ex + ey };
+        if (type == LTC_LIGHT_QUAD)
+            tree.addQuad(points, radiance, u(rng) < 0.25f);
+        else
+            tree.addDisk(points, radiance, u(rng) < 0.25f);
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    tree.build();
+    double timeBuild = seconds(start);
+
+    vector<LTCShadingPoint> points(numPoints);
+    for (int p = 0; p < numPoints; ++p)
+    {
+        points[p].N = vec3(0, 0, 1);
+        points[p].V = randomView(rng);
+        points[p].P = vec3(16.0f*u(rng) - 8.0f, 16.0f*u(rng) - 8.0f, 0.0f);
+        points[p].Minv = table.Minv(0.05f + 0.95f*u(rng), points[p].V.z);
+    }
+
+    bool ok = true;
+    double missed = 0.0, lost = 0.0, maxPdfSum = 0.0, maxSampleError = 0.0;
+    vector<double> varianceTree(numPoints), varianceUniform(numPoints);
+    vector<double> reference(numPoints);
+    for (int p = 0; p < numPoints; ++p)
+    {
+        const LTCLightQuery query(points[p]);
+
+        double sum = 0.0, sum2 = 0.0, sumPdf = 0.0, sumMissed = 0.0, tree2 = 0.0;
+        for (int l = 0; l < numLights; ++l)
+        {
+            double f = tree.lights[l].radiance*LTC_EvaluateLight(tree.lights[l], points[p], ltc_2);
+            double pdf = tree.pdf(query, l);
+
+            sum += f;
+            sum2 += f*f;
+            sumPdf += pdf;
+            if (pdf > 0.0)
+                tree2 += f*f/pdf;
+            else
+                sumMissed += f;
+        }
+        reference[p] = sum;
+        missed += sumMissed/sum/numPoints;
+        lost += (1.0 - sumPdf)/numPoints;
+        maxPdfSum = std::max<double>(maxPdfSum, sumPdf);
+
+        // relative variances of one sample
+        varianceTree[p] = (tree2 - sum*sum)/(sum*sum);
+        varianceUniform[p] = (numLights*sum2 - sum*sum)/(sum*sum);
+
+        for (int s = 0; s < 16; ++s)
+        {
+            float pdf;
+            int light = tree.sample(query, u(rng), pdf);
+            if (light >= 0)
+                maxSampleError = std::max<double>(maxSampleError, fabs(pdf - tree.pdf(query, light))/pdf);
+        }
+    }
+
+    double meanTree = 0.0, meanUniform = 0.0;
+    for (int p = 0; p < numPoints; ++p)
+    {
+        meanTree += varianceTree[p]/numPoints;
+        meanUniform += varianceUniform[p]/numPoints;
+    }
+    sort(varianceTree.begin(), varianceTree.end());
+    sort(varianceUniform.begin(), varianceUniform.end());
+    double medianTree = varianceTree[numPoints/2], medianUniform = varianceUniform[numPoints/2];
+
+    // (samples without a light: the pdfs of the lights sum to less than 1, sample() found no child to pick)
+    cout << numLights << " lights, " << tree.nodes.size() << " nodes built in " << 1e3*timeBuild << " ms" << endl;
+    cout << "contribution of the lights with pdf 0: " << missed << ", samples without a light " << lost;
+    cout << ", max relative difference of pdf() to sample() " << maxSampleError << endl;
+    cout << "relative standard deviation of one sample: uniform " << sqrt(meanUniform) << " (median " << sqrt(medianUniform);
+    cout << "), tree " << sqrt(meanTree) << " (median " << sqrt(medianTree) << "), ";
+    cout << meanUniform/meanTree << "x fewer samples (median " << medianUniform/medianTree << "x)" << endl;
+
+    ok = ok && missed < 1e-4 && lost < 0.01 && maxPdfSum < 1.0 + 1e-4 && maxSampleError < 1e-3;
+
+    // reservoirs, 2 batches of 4 candidates merged: mean of the estimates relative to the reference, over the points
+    {
+        const int numTrials = 256;
+        double bias = 0.0, variance = 0.0;
+        for (int p = 0; p < numPoints; ++p)
+        {
+            double sum = 0.0, sum2 = 0.0;
+            for (int t = 0; t < numTrials; ++t)
+            {
+                LTCLightReservoir a, b;
+                LTC_StreamLights(tree, &points[p], 1, 4, ltc_2, random, &a);
+                LTC_StreamLights(tree, &points[p], 1, 4, ltc_2, random, &b);
+                a.merge(b, u(rng));
+
+                double estimate = a.target*a.contributionWeight();
+                sum += estimate;
+                sum2 += estimate*estimate;
+            }
+
+            double mean = sum/numTrials;
+            bias += (mean/reference[p] - 1.0)/numPoints;
+            variance += (sum2/numTrials - mean*mean)/(numTrials - 1)/(reference[p]*reference[p])/(numPoints*numPoints);
+        }
+
+        cout << "reservoirs of 8 candidates: relative bias " << bias << " (" << fabs(bias)/sqrt(variance);
+        cout << " standard errors)" << endl;
+        ok = ok && fabs(bias) < 5.0*sqrt(variance);
+    }
+
+    // timings
+    {
+        start = chrono::high_resolution_clock::now();
+        float sum = 0.0f;
+        for (int p = 0; p < numPoints; ++p)
+        for (int l = 0; l < numLights; ++l)
+            sum += tree.lights[l].radiance*LTC_EvaluateLight(tree.lights[l], points[p], ltc_2);
+        double timeAll = seconds(start);
+
+        const int numSamples = 64;
+        start = chrono::high_resolution_clock::now();
+        for (int p = 0; p < numPoints; ++p)
+        {
+            const LTCLightQuery query(points[p]);
+            for (int s = 0; s < numSamples; ++s)
+            {
+                float pdf;
+                sum += tree.sample(query, u(rng), pdf);
+            }
+        }
+        double timeSample = seconds(start);
+
+        vector<LTCLightReservoir> reservoirs(numPoints);
+        start = chrono::high_resolution_clock::now();
+        LTC_StreamLights(tree, &points[0], numPoints, numSamples, ltc_2, random, &reservoirs[0]);
+        double timeStream = seconds(start);
+        for (int p = 0; p < numPoints; ++p)
+            sum += reservoirs[p].contributionWeight();
+
+        cout << "all the lights " << 1e6*timeAll/numPoints << " us per point, tree sample ";
+        cout << 1e9*timeSample/(numPoints*numSamples) << " ns, streamed candidate ";
+        cout << 1e9*timeStream/(numPoints*numSamples) << " ns" << endl;
+        sink = sum;
+    }
+
+    return ok ? 0 : 1;
+}
+
+// moments of the sampling estimator of the albedo (eval/pdf) used by computeAvgTerms() and computeError(),
+// and the fraction of the samples that reflect below the horizon
+struct SamplingStats
+{
+    double mean;
+    double variance;
+    double wasted;
+};
+
+static SamplingStats albedoSampling(mt19937& rng, const Brdf& brdf, const vec3& V, float alpha, int numSamples)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    double sum = 0.0, sum2 = 0.0;
+    int wasted = 0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        vec3 L = brdf.sample(V, alpha, u(rng), u(rng));
+
+        float pdf;
+        float eval = brdf.eval(V, L, alpha, pdf);
+        double weight = pdf > 0.0f ? eval/pdf : 0.0;
+        wasted += !(eval > 0.0f);
+
+        sum += weight;
+        sum2 += weight*weight;
+    }
+
+    SamplingStats stats;
+    stats.mean = sum/numSamples;
+    stats.variance = sum2/numSamples - stats.mean*stats.mean;
+    stats.wasted = double(wasted)/numSamples;
+    return stats;
+}
+
+// integral of the pdf returned by eval() over the sphere, by uniform sampling, and its standard error
+static double pdfIntegral(mt19937& rng, const Brdf& brdf, const vec3& V, float alpha, int numSamples, double& error)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    double sum = 0.0, sum2 = 0.0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float z = 2.0f*u(rng) - 1.0f;
+        float phi = 2.0f*3.14159265f*u(rng);
+        float r = sqrtf(std::max<float>(0.0f, 1.0f - z*z));
+        vec3 L = vec3(r*cosf(phi), r*sinf(phi), z);
+
+        float pdf;
+        brdf.eval(V, L, alpha, pdf);
+        sum += pdf;
+        sum2 += double(pdf)*pdf;
+    }
+
+    const double scale = 4.0*3.14159265;
+    error = scale*sqrt(std::max(0.0, sum2/numSamples - (sum/numSamples)*(sum/numSamples))/numSamples);
+    return scale*sum/numSamples;
+}
+
+// sampling of the full NDF vs. the visible normals (BrdfGGX and BrdfBeckmann with vndf, fitLTC --vndf):
+// both estimate the same albedo, and the ratio of their variances is the number of samples VNDF sampling needs
+// for the same noise
+int testVNDF()
+{
+    const int numSamples = 1 << 18;
+    const float thetas[] = { 0.0f, 45.0f, 70.0f, 80.0f, 85.0f, 88.0f };
+    const float roughnesses[] = { 0.2f, 0.5f, 0.8f };
+
+    mt19937 rng(1234);
+    bool ok = true;
+
+    for (int model = 0; model < 2; ++model)
+    {
+        BrdfGGX ggx(false), ggxVisible(true);
+        BrdfBeckmann beckmann(false), beckmannVisible(true);
+        const Brdf& ndf = model == 0 ? (const Brdf&)ggx : (const Brdf&)beckmann;
+        const Brdf& vndf = model == 0 ? (const Brdf&)ggxVisible : (const Brdf&)beckmannVisible;
+
+        cout << (model == 0 ? "GGX" : "Beckmann") << endl;
+        cout << "  theta  roughness  albedo   wasted NDF/VNDF   samples VNDF/NDF   pdf integral VNDF" << endl;
+
+        for (float theta : thetas)
+        for (float roughness : roughnesses)
+        {
+            float alpha = roughness*roughness;
+            float t = theta*3.14159265f/180.0f;
+            vec3 V = vec3(sinf(t), 0.0f, cosf(t));
+
+            SamplingStats a = albedoSampling(rng, ndf, V, alpha, numSamples);
+            SamplingStats b = albedoSampling(rng, vndf, V, alpha, numSamples);
+            double integralError;
+            double integral = pdfIntegral(rng, vndf, V, alpha, numSamples, integralError);
+
+            // same albedo within the noise of both estimates, and a normalized pdf
+            double sigma = sqrt((a.variance + b.variance)/numSamples);
+            bool agree = fabs(a.mean - b.mean) < 5.0*sigma + 1e-4;
+            bool normalized = fabs(integral - 1.0) < 5.0*integralError + 0.01;
+            ok = ok && agree && normalized;
+
+            printf("  %5.1f  %9.1f  %6.4f   %5.1f%% / %5.1f%%   %16.3f   %17.3f%s\n",
+                theta, roughness, b.mean, 100.0*a.wasted, 100.0*b.wasted, b.variance/std::max(a.variance, 1e-20),
+                integral, agree && normalized ? "" : "  FAILED");
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+// quad light of random size and orientation around center
+static void randomPhaseLight(mt19937& rng, const vec3& center, LTCPhaseLight& light)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    vec3 n = randomView(rng);
+    n = u(rng) < 0.5f ? n : -n;
+    vec3 ex = normalize(fabsf(n.x) < 0.9f ? cross(n, vec3(1, 0, 0)) : cross(n, vec3(0, 1, 0)));
+    vec3 ey = cross(n, ex);
+    ex *= 0.3f + 1.2f*u(rng);
+    ey *= 0.3f + 1.2f*u(rng);
+
+    light.points[0] = center - ex - ey;
+    light.points[1] = center + ex - ey;
+    light.points[2] = center + ex + ey;
+    light.points[3] = center - ex + ey;
+    light.radiance = 1.0f + 4.0f*u(rng);
+    light.twoSided = u(rng) < 0.5f;
+}
+
+// integral of the phase function over a quad light seen from x, with the transmittance to the light points:
+// stratified sampling of the light area
+static double phaseMonteCarlo(mt19937& rng, const vec3& d, float g, const vec3& x, const LTCPhaseLight& light,
+    float sigmaT, int sqrtSamples)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    vec3 ex = light.points[1] - light.points[0];
+    vec3 ey = light.points[3] - light.points[0];
+    vec3 normal = cross(ex, ey);
+    float area = length(normal);
+    normal /= area;
+
+    if (!light.twoSided && dot(light.points[0] - x, normal) <= 0.0f)
+        return 0.0;
+
+    double sum = 0.0;
+    for (int j = 0; j < sqrtSamples; ++j)
+    for (int i = 0; i < sqrtSamples; ++i)
+    {
+        vec3 q = light.points[0] + ex*((i + u(rng))/sqrtSamples) + ey*((j + u(rng))/sqrtSamples);
+        vec3 L = q - x;
+        float dist2 = dot(L, L);
+        float dist = sqrtf(dist2);
+        L /= dist;
+
+        sum += phaseHG(dot(d, L), g)*expf(-sigmaT*dist)*fabsf(dot(normal, L))/dist2;
+    }
+
+    return sum*area/(sqrtSamples*sqrtSamples);
+}
+
+// single scattering from quad lights (fitLTC --phase): the phase integrals at points of the medium, and the
+// in-scattered radiance along rays, against Monte Carlo integration
+int testPhase(const char* path1, const char* path2)
+{
+    LTCPhaseTable table;
+    if (!table.load(path1, path2))
+    {
+        cout << "could not load " << path1 << " and " << path2 << endl;
+        return 1;
+    }
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    uniform_real_distribution<float> s(-1.0f, 1.0f);
+
+    // phase integrals, from all the directions and both sides of the lights
+    const int numConfigs = 2000;
+    const int W = 8;
+
+    double sumReference = 0.0, sumClipped = 0.0, sumClipless = 0.0;
+
+    for (int c = 0; c < numConfigs; ++c)
+    {
+        LTCPhaseLight light;
+        randomPhaseLight(rng, vec3(3.0f*s(rng), 3.0f*s(rng), 3.0f*s(rng)), light);
+
+        vec3 d = randomView(rng)*(u(rng) < 0.5f ? 1.0f : -1.0f);
+        float g = 0.9f*s(rng);
+        vec3 x = vec3(0.0f);
+
+        double reference = phaseMonteCarlo(rng, d, g, x, light, 0.0f, 64);
+        float clipped = LTC_EvaluatePhase(d, g, x, table, light.points, light.twoSided);
+
+        float t[W], clipless[W];
+        for (int lane = 0; lane < W; ++lane)
+            t[lane] = 0.0f;
+        LTCPhaseSegment segment;
+        segment.init(x, d, g, table, light.points, light.twoSided);
+        LTC_EvaluatePhasePacket<W>(segment, t, table, clipless);
+
+        sumReference += reference;
+        sumClipped += fabs(clipped - reference);
+        sumClipless += fabs(clipless[0] - reference);
+    }
+
+    float clippedError = (float)(sumClipped/sumReference);
+    float cliplessError = (float)(sumClipless/sumReference);
+    cout << "phase integrals vs Monte Carlo: relative L1 error = " << clippedError << " clipped, ";
+    cout << cliplessError << " clipless" << endl;
+
+    // in-scattering along rays crossing a few lights, with the transmittance to the light points in the reference
+    const int numRays = 100;
+    const int numLights = 4;
+    const int steps = 32;
+    const int mcSamples = 4;
+
+    double sumRay = 0.0, errorScalar = 0.0, errorPacket = 0.0, errorMC = 0.0;
+    double timeScalar = 0.0, timePacket = 0.0, timeMC = 0.0;
+
+    for (int r = 0; r < numRays; ++r)
+    {
+        LTCPhaseLight lights[numLights];
+        for (int l = 0; l < numLights; ++l)
+            randomPhaseLight(rng, vec3(4.0f*s(rng), 4.0f*s(rng), 4.0f*s(rng)), lights[l]);
+
+        LTCMedium medium;
+        medium.sigmaS = 0.1f + 0.2f*u(rng);
+        medium.sigmaT = medium.sigmaS + 0.1f*u(rng);
+        medium.g = 0.85f*s(rng);
+
+        vec3 o = vec3(4.0f*s(rng), 4.0f*s(rng), 4.0f*s(rng));
+        vec3 d = randomView(rng)*(u(rng) < 0.5f ? 1.0f : -1.0f);
+        const float tMax = 8.0f;
+
+        // reference: stratified distances, and light area samples at each
+        const int numT = 256;
+        double reference = 0.0;
+        for (int k = 0; k < numT; ++k)
+        {
+            float t = (k + u(rng))*tMax/numT;
+            vec3 x = o + t*d;
+            for (int l = 0; l < numLights; ++l)
+                reference += LTC_PhaseStepWeight(medium, k*tMax/numT, (k + 1)*tMax/numT)*lights[l].radiance*
+                    phaseMonteCarlo(rng, d, medium.g, x, lights[l], medium.sigmaT, 16);
+        }
+
+        float jitter = u(rng);
+
+        auto start = chrono::high_resolution_clock::now();
+        float scalar = LTC_InScattering<1>(o, d, tMax, medium, lights, numLights, table, steps, jitter);
+        timeScalar += seconds(start);
+
+        start = chrono::high_resolution_clock::now();
+        float packet = LTC_InScattering<W>(o, d, tMax, medium, lights, numLights, table, steps, jitter);
+        timePacket += seconds(start);
+
+        // Monte Carlo at the same steps, with mcSamples^2 light samples per step
+        start = chrono::high_resolution_clock::now();
+        double mc = 0.0;
+        for (int k = 0; k < steps; ++k)
+        {
+            vec3 x = o + (k + jitter)*tMax/steps*d;
+            for (int l = 0; l < numLights; ++l)
+                mc += LTC_PhaseStepWeight(medium, k*tMax/steps, (k + 1)*tMax/steps)*lights[l].radiance*
+                    phaseMonteCarlo(rng, d, medium.g, x, lights[l], medium.sigmaT, mcSamples);
+        }
+        timeMC += seconds(start);
+
+        sumRay += reference;
+        errorScalar += fabs(scalar - reference);
+        errorPacket += fabs(packet - reference);
+        errorMC += fabs(mc - reference);
+    }
+
+    float scalarError = (float)(errorScalar/sumRay);
+    float packetError = (float)(errorPacket/sumRay);
+    cout << "in-scattering, " << steps << " steps and " << numLights << " lights per ray:" << endl;
+    printf("  LTC clipped, one step at a time   relative L1 error %.4f, %7.2f us per ray\n",
+        scalarError, 1e6*timeScalar/numRays);
+    printf("  LTC clipless, packets of %d steps  relative L1 error %.4f, %7.2f us per ray\n",
+        W, packetError, 1e6*timePacket/numRays);
+    printf("  Monte Carlo, %2d samples per step  relative L1 error %.4f, %7.2f us per ray\n",
+        mcSamples*mcSamples, (float)(errorMC/sumRay), 1e6*timeMC/numRays);
+
+    // about 12% for isotropic scattering, that a clamped cosine only approximates, and more for the lobes peaked
+    // behind the plane of the light, of which the tables only hold the tails
+    return clippedError < 0.2f && cliplessError < 0.2f && packetError < 0.2f ? 0 : 1;
+}
+
+// random shape of the given type around center
+static void addRandomShape(mt19937& rng, int type, const vec3& center, float size, LTCRayBVH& bvh)
+{
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    vec3 n = randomView(rng);
+    vec3 dirx = normalize(fabsf(n.x) < 0.9f ? cross(n, vec3(1, 0, 0)) : cross(n, vec3(0, 1, 0)));
+    vec3 diry = cross(n, dirx);
+    float halfx = size*(0.3f + 0.7f*u(rng));
+    float halfy = size*(0.3f + 0.7f*u(rng));
+
+    if (type == LTC_SHAPE_RECT)
+        bvh.addRect(center, dirx, diry, halfx, halfy);
+    else if (type == LTC_SHAPE_DISK)
+        bvh.addDisk(center, dirx, diry, halfx, halfy);
+    else if (type == LTC_SHAPE_SPHERE)
+        bvh.addSphere(center, halfx);
+    else if (type == LTC_SHAPE_CYLINDER)
+        bvh.addCylinder(center - n*halfy, center + n*halfy, 0.5f*halfx, u(rng) < 0.5f);
+    else
+        bvh.addCapsule(center - n*halfy, center + n*halfy, 0.5f*halfx);
+}
+
+// nearest hit of a shape with the kernels of the demos (ltc_ray.glsl)
+static bool glslIntersect(const LTCRayShape& s, const vec3& origin, const vec3& dir, float& t)
+{
+    glsl::Ray ray;
+    ray.origin = origin;
+    ray.dir = dir;
+
+    switch (s.type)
+    {
+    case LTC_SHAPE_RECT:
+        return glsl::RayRectIntersect(ray, s.center, s.dirx, s.diry, s.halfx, s.halfy, t);
+    case LTC_SHAPE_DISK:
+        return glsl::RayDiskIntersect(ray, s.center, s.dirx, s.diry, s.halfx, s.halfy, t);
+    case LTC_SHAPE_SPHERE:
+        return glsl::RaySphereIntersect(ray, s.center, s.radius, t);
+    case LTC_SHAPE_CYLINDER:
+        return glsl::RayCylinderIntersect(ray, s.p1, s.p2, s.radius, s.endCaps, t);
+    default:
+        return glsl::RayCapsuleIntersect(ray, s.p1, s.p2, s.radius, t);
+    }
+}
+
+// nearest hit over all the shapes, with the kernels of the demos
+static int glslIntersect(const LTCRayBVH& bvh, const vec3& origin, const vec3& dir, float tMax, float& t)
+{
+    int shape = -1;
+    t = tMax;
+    for (int i = 0; i < (int)bvh.shapes.size(); ++i)
+    {
+        float ti;
+        if (glslIntersect(bvh.shapes[i], origin, dir, ti) && ti < t)
+        {
+            t = ti;
+            shape = i;
+        }
+    }
+    return shape;
+}
+
+template<int W>
+static double bvhRaysPerSecond(const LTCRayBVH& bvh, const vector<vec3>& origins, const vector<vec3>& dirs,
+    vector<float>& t, vector<int>& shape)
+{
+    auto start = chrono::high_resolution_clock::now();
+    bvh.intersect<W>(&origins[0], &dirs[0], (int)origins.size(), 1e30f, &t[0], &shape[0]);
+    return origins.size()/seconds(start);
+}
+
+// with the traversal compiled for the widest packets of the CPU
+static double bvhWidestRaysPerSecond(const LTCRayBVH& bvh, const vector<vec3>& origins, const vector<vec3>& dirs,
+    vector<float>& t, vector<int>& shape)
+{
+    auto start = chrono::high_resolution_clock::now();
+    bvh.intersectWidest(&origins[0], &dirs[0], (int)origins.size(), 1e30f, &t[0], &shape[0]);
+    return origins.size()/seconds(start);
+}
+
+// packet intersection of the light shapes (ltc_ray.h) against the kernels of the demos, and the rays per second
+// of the BVH with 1, 8 and 16 rays per packet, with the ISA of the build and the widest one of the CPU
+int testRays()
+{
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    uniform_real_distribution<float> s(-1.0f, 1.0f);
+
+    const char* names[] = { "rect", "disk", "sphere", "cylinder", "capsule" };
+    const int W = 8;
+    bool ok = true;
+
+    // single shapes, rays from around them aimed near their center
+    cout << "packets vs ltc_ray.glsl:" << endl;
+    for (int type = 0; type < 5; ++type)
+    {
+        int rays = 0, hits = 0, mismatches = 0;
+        float maxError = 0.0f;
+
+        for (int c = 0; c < 2000; ++c)
+        {
+            LTCRayBVH bvh;
+            addRandomShape(rng, type, vec3(0.0f), 1.0f, bvh);
+            const LTCRayShape& shape = bvh.shapes[0];
+
+            vec3 origins[W], dirs[W];
+            for (int lane = 0; lane < W; ++lane)
+            {
+                // some of the origins inside the shape
+                origins[lane] = vec3(s(rng), s(rng), s(rng))*(lane == 0 ? 0.3f : 3.0f);
+                dirs[lane] = normalize(vec3(s(rng), s(rng), s(rng))*1.5f - origins[lane]);
+            }
+
+            LTCRayPacket<W> packet;
+            packet.load(origins, dirs, W, 1e30f);
+            LTC_IntersectShape<W>(packet, shape, 0);
+
+            for (int lane = 0; lane < W; ++lane)
+            {
+                float t;
+                bool hit = glslIntersect(shape, origins[lane], dirs[lane], t);
+                rays++;
+                hits += hit;
+                if (hit != (packet.shape[lane] == 0))
+                    mismatches++;
+                else if (hit)
+                    maxError = std::max<float>(maxError, fabsf(packet.t[lane] - t)/t);
+            }
+        }
+
+        // the hit tests only differ in the rounding of the rays grazing the boundaries
+        bool passed = mismatches <= rays/1000 && maxError < 1e-3f;
+        ok = ok && passed;
+        printf("  %-8s  %5d rays  %5.1f%% hits  %3d mismatches  max relative error of t %.2e%s\n",
+            names[type], rays, 100.0f*hits/rays, mismatches, maxError, passed ? "" : "  FAILED");
+    }
+
+    // scene of many shapes: shadow rays from points of the floor to points of the shapes, and camera rays
+    const int numShapes = 4096;
+    const int numRays = 1 << 18;
+
+    LTCRayBVH bvh;
+    for (int i = 0; i < numShapes; ++i)
+        addRandomShape(rng, i % 5, vec3(50.0f*s(rng), 2.0f + 10.0f*u(rng), 50.0f*s(rng)), 0.2f + 0.8f*u(rng), bvh);
+
+    auto start = chrono::high_resolution_clock::now();
+    bvh.build();
+    double buildTime = seconds(start);
+
+    vector<vec3> shadowOrigins(numRays), shadowDirs(numRays);
+    for (int i = 0; i < numRays; ++i)
+    {
+        shadowOrigins[i] = vec3(50.0f*s(rng), 0.0f, 50.0f*s(rng));
+        LTCRayShape target = bvh.shapes[rng() % numShapes];
+        shadowDirs[i] = normalize(target.center + target.p1 - shadowOrigins[i]);
+    }
+
+    const int width = 512;
+    vector<vec3> cameraOrigins(numRays, vec3(0.0f, 6.0f, -70.0f)), cameraDirs(numRays);
+    for (int i = 0; i < numRays; ++i)
+    {
+        // tiles of 4x2 pixels, so that the packets are coherent
+        int tile = i/8, x = (tile % (width/4))*4 + i % 4, y = (tile/(width/4))*2 + (i/4) % 2;
+        cameraDirs[i] = normalize(vec3(2.0f*x/width - 1.0f, 1.0f - 2.0f*y/(numRays/width), 1.0f));
+    }
+
+    cout << numShapes << " shapes, " << bvh.nodes.size() << " nodes built in " << 1e3*buildTime << " ms" << endl;
+    int widest = LTCRayBVH::widestPacket();
+    cout << "Mrays/s with the build ISA for W = 1, 8 and 16, and with " << (widest == 16 ? "AVX-512" : "AVX2")
+         << " for W = " << widest << " (intersectWidest())" << endl;
+    cout << "           rays   hits    W = 1    W = 8   W = 16   widest   mismatches   widest mismatches" << endl;
+
+    for (int set = 0; set < 2; ++set)
+    {
+        const vector<vec3>& origins = set == 0 ? shadowOrigins : cameraOrigins;
+        const vector<vec3>& dirs = set == 0 ? shadowDirs : cameraDirs;
+
+        vector<float> t1(numRays), t8(numRays), t16(numRays), tWidest(numRays);
+        vector<int> shape1(numRays), shape8(numRays), shape16(numRays), shapeWidest(numRays);
+        double rate1 = bvhRaysPerSecond<1>(bvh, origins, dirs, t1, shape1);
+        double rate8 = bvhRaysPerSecond<8>(bvh, origins, dirs, t8, shape8);
+        double rate16 = bvhRaysPerSecond<16>(bvh, origins, dirs, t16, shape16);
+        double rateWidest = bvhWidestRaysPerSecond(bvh, origins, dirs, tWidest, shapeWidest);
+
+        // nearest hits against all the shapes with the kernels of the demos, on a subset of the rays
+        int hits = 0, mismatches = 0, widestMismatches = 0;
+        for (int i = 0; i < numRays; ++i)
+        {
+            hits += shape8[i] >= 0;
+            if (shape1[i] != shape8[i] || shape8[i] != shape16[i])
+                mismatches++;
+            else if (i % 64 == 0)
+            {
+                float t;
+                int shape = glslIntersect(bvh, origins[i], dirs[i], 1e30f, t);
+                bool same = shape == shape8[i] || fabsf(t - t8[i]) <= 1e-4f*t;
+                mismatches += !same;
+            }
+
+            // the widest packets are compiled with FMA, that rounds differently the rays grazing the shapes
+            widestMismatches += shapeWidest[i] != shape8[i] && fabsf(tWidest[i] - t8[i]) > 1e-4f*t8[i];
+        }
+
+        bool passed = mismatches <= numRays/10000 && widestMismatches <= numRays/1000;
+        ok = ok && passed;
+        printf("  %-6s  %6d  %5.1f%%  %7.2f  %7.2f  %7.2f  %7.2f   %10d   %10d%s\n",
+            set == 0 ? "shadow" : "camera", numRays, 100.0f*hits/numRays, 1e-6*rate1, 1e-6*rate8, 1e-6*rate16,
+            1e-6*rateWidest, mismatches, widestMismatches, passed ? "" : "  FAILED");
+    }
+
+    return ok ? 0 : 1;
+}
+
+// files written by ImageOutput, read back for the image test
+static bool readFile(const char* path, vector<unsigned char>& data)
+{
+    ifstream file(path, ios::binary);
+    data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+static bool readPFM(const char* path, int width, int height, vector<vec3>& rgb)
+{
+    vector<unsigned char> data;
+    if (!readFile(path, data))
+        return false;
+
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", width, height);
+    if (data.size() != headerSize + 12*(size_t)width*height || memcmp(&data[0], header, headerSize) != 0)
+        return false;
+
+    // rows from the bottom
+    rgb.resize(width*height);
+    for (int y = 0; y < height; ++y)
+        memcpy(&rgb[(height - 1 - y)*width], &data[headerSize + 12*(size_t)y*width], 12*width);
+    return true;
+}
+
+// scanline files of half B, G, R channels without compression, as written by EXRWriter
+static bool readEXR(const char* path, int width, int height, vector<vec3>& rgb)
+{
+    vector<unsigned char> data;
+    if (!readFile(path, data) || data.size() < 8)
+        return false;
+
+    int32_t magic, version;
+    memcpy(&magic, &data[0], 4);
+    memcpy(&version, &data[4], 4);
+    if (magic != 20000630 || version != 2)
+        return false;
+
+    // attributes: name, type, size and value, up to an empty name
+    size_t p = 8;
+    while (p < data.size() && data[p] != 0)
+    {
+        p += strlen((const char*)&data[p]) + 1;
+        p += strlen((const char*)&data[p]) + 1;
+        int32_t size;
+        memcpy(&size, &data[p], 4);
+        p += 4 + size;
+    }
+    p++;
+
+    rgb.resize(width*height);
+    for (int y = 0; y < height; ++y)
+    {
+        uint64_t offset;
+        int32_t line[2];
+        memcpy(&offset, &data[p + 8*y], 8);
+        if (offset + 8 + 6*width > data.size())
+            return false;
+        memcpy(line, &data[offset], 8);
+        if (line[0] != y || line[1] != 6*width)
+            return false;
+
+        const unsigned char* pixels = &data[offset + 8];
+        for (int x = 0; x < width; ++x)
+        for (int c = 0; c < 3; ++c)
+        {
+            uint16_t h;
+            memcpy(&h, pixels + 2*(c*width + x), 2);
+            rgb[x + y*width][2 - c] = half_to_float(h);
+        }
+    }
+
+    return true;
+}
+
+// 8-bit RGB files of stored deflate blocks, as written by PNGWriter, with their checksums verified
+static bool readPNG(const char* path, int width, int height, vector<unsigned char>& rgb)
+{
+    vector<unsigned char> data;
+    if (!readFile(path, data) || data.size() < 8 || memcmp(&data[0], "\x89PNG\r\n\x1a\n", 8) != 0)
+        return false;
+
+    auto bigEndian = [&](size_t p) { return (uint32_t)data[p] << 24 | data[p + 1] << 16 | data[p + 2] << 8 | data[p + 3]; };
+
+    uint32_t crcTable[256];
+    for (uint32_t n = 0; n < 256; ++n)
+    {
+        uint32_t t = n;
+        for (int k = 0; k < 8; ++k)
+            t = t & 1 ? 0xedb88320 ^ (t >> 1) : t >> 1;
+        crcTable[n] = t;
+    }
+
+    vector<unsigned char> stream;
+    for (size_t p = 8; p + 12 <= data.size(); )
+    {
+        uint32_t length = bigEndian(p);
+        if (p + 12 + length > data.size())
+            return false;
+
+        uint32_t crc = 0xffffffff;
+        for (size_t i = p + 4; i < p + 8 + length; ++i)
+            crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        if ((crc ^ 0xffffffff) != bigEndian(p + 8 + length))
+            return false;
+
+        string type((const char*)&data[p + 4], 4);
+        if (type == "IHDR" && (bigEndian(p + 8) != (uint32_t)width || bigEndian(p + 12) != (uint32_t)height ||
+            data[p + 16] != 8 || data[p + 17] != 2))
+            return false;
+        if (type == "IDAT")
+            stream.insert(stream.end(), data.begin() + p + 8, data.begin() + p + 8 + length);
+
+        p += 12 + length;
+    }
+
+    // zlib header, stored blocks, adler32
+    vector<unsigned char> raw;
+    size_t p = 2;
+    for (bool last = false; !last; )
+    {
+        if (p + 5 > stream.size() || (stream[p] & 6) != 0)
+            return false;
+        last = stream[p] & 1;
+        size_t size = stream[p + 1] | stream[p + 2] << 8;
+        raw.insert(raw.end(), stream.begin() + p + 5, stream.begin() + p + 5 + size);
+        p += 5 + size;
+    }
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    if (p + 4 != stream.size() || ((uint32_t)stream[p] << 24 | stream[p + 1] << 16 | stream[p + 2] << 8 | stream[p + 3]) != (b << 16 | a))
+        return false;
+
+    if (raw.size() != (size_t)height*(1 + 3*width))
+        return false;
+
+    rgb.resize(3*width*height);
+    for (int y = 0; y < height; ++y)
+    {
+        if (raw[y*(1 + 3*width)] != 0)
+            return false;
+        memcpy(&rgb[3*y*width], &raw[y*(1 + 3*width) + 1], 3*width);
+    }
+    return true;
+}
+
+// tonemapping against the demo display transform, and a tiled rendering streamed to EXR, PFM and PNG files
+int testImage(const LTCTable& table)
+{
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    bool ok = true;
+
+    // packets vs ltc_tonemap.glsl on HDR values from 1e-4 to 1e3, over several samples
+    const int numPixels = 1 << 20;
+    vector<vec4> pixels(numPixels);
+    for (int i = 0; i < numPixels; ++i)
+    {
+        float samples = float(1 + i % 16);
+        pixels[i] = vec4(powf(10.0f, 7.0f*u(rng) - 4.0f), powf(10.0f, 7.0f*u(rng) - 4.0f), powf(10.0f, 7.0f*u(rng) - 4.0f), 1.0f)*samples;
+        if (i % 97 == 0)
+            pixels[i] = vec4(0.0f);
+    }
+
+    vector<unsigned char> reference(3*numPixels), packets(3*numPixels);
+    auto start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < numPixels; ++i)
+    {
+        const vec4& c = pixels[i];
+        vec3 v = c.w > 0.0f ? vec3(c.x, c.y, c.z)/c.w : vec3(0.0f);
+        v = glsl::ToSRGB(glsl::aces_fitted(v));
+        for (int k = 0; k < 3; ++k)
+            reference[3*i + k] = (unsigned char)(int)(255.0f*v[k] + 0.5f);
+    }
+    double timeScalar = seconds(start);
+
+    start = chrono::high_resolution_clock::now();
+    tonemapImage(&pixels[0], numPixels, &packets[0], 1);
+    double timePackets = seconds(start);
+
+    start = chrono::high_resolution_clock::now();
+    tonemapImage(&pixels[0], numPixels, &packets[0]);
+    double timeThreads = seconds(start);
+
+    int maxDiff = 0, diffs = 0;
+    for (int i = 0; i < 3*numPixels; ++i)
+    {
+        int d = abs((int)packets[i] - (int)reference[i]);
+        maxDiff = std::max<int>(maxDiff, d);
+        diffs += d != 0;
+    }
+
+    bool passed = maxDiff <= 1;
+    ok = ok && passed;
+    printf("tonemapping of %d pixels: %d values off by up to %d/255%s\n", numPixels, diffs, maxDiff, passed ? "" : "  FAILED");
+    printf("  ltc_tonemap.glsl %.1f Mpixels/s, packets %.1f Mpixels/s, packets on %d threads %.1f Mpixels/s\n",
+        1e-6*numPixels/timeScalar, 1e-6*numPixels/timePackets, numThreads(), 1e-6*numPixels/timeThreads);
+
+    // a floor under three quad lights, 2 samples per pixel, rendered and written in tiles
+    const int width = 1000, height = 600, tileSize = 64;
+    const vec3 eye = vec3(0.0f, -8.0f, 4.0f);
+    const vec3 forward = normalize(vec3(0.0f, 8.0f, -4.0f));
+    const vec3 right = normalize(cross(forward, vec3(0, 0, 1)));
+    const vec3 up = cross(right, forward);
+
+    vec3 lights[3][4];
+    vec3 colors[3];
+    for (int l = 0; l < 3; ++l)
+    {
+        randomQuad(rng, lights[l]);
+        colors[l] = vec3(u(rng), u(rng), u(rng))*20.0f;
+    }
+
+    const char* exrPath = "/tmp/ltcBench_image.exr";
+    const char* pfmPath = "/tmp/ltcBench_image.pfm";
+    const char* pngPath = "/tmp/ltcBench_image.png";
+
+    ImageOutput output;
+    if (!output.open(width, height, exrPath, pfmPath, pngPath))
+    {
+        cout << "could not open the images in /tmp" << endl;
+        return 1;
+    }
+
+    // the whole buffer is only kept to check the files
+    vector<vec4> image(width*height);
+    const int tilesX = (width + tileSize - 1)/tileSize, tilesY = (height + tileSize - 1)/tileSize;
+    atomic<int> failedTiles(0);
+
+    start = chrono::high_resolution_clock::now();
+    parallel_for(tilesX*tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX)*tileSize, y0 = (tile/tilesX)*tileSize;
+        int w = std::min<int>(tileSize, width - x0), h = std::min<int>(tileSize, height - y0);
+
+        vector<vec4> accum(w*h, vec4(0.0f));
+        for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+        for (int s = 0; s < 2; ++s)
+        {
+            float px = (x0 + i + 0.25f + 0.5f*s)/width*2.0f - 1.0f;
+            float py = 1.0f - (y0 + j + 0.25f + 0.5f*s)/height*2.0f;
+            vec3 dir = normalize(forward + 0.8f*px*right + 0.8f*py*float(height)/width*up);
+
+            vec3 color = vec3(0.0f);
+            if (dir.z < 0.0f)
+            {
+                vec3 P = eye - eye.z/dir.z*dir;
+                vec3 N = vec3(0, 0, 1), V = -dir;
+                mat3 Minv = table.Minv(0.3f, V.z);
+                for (int l = 0; l < 3; ++l)
+                    color += colors[l]*(0.5f*LTC_Evaluate(N, V, P, mat3(1), lights[l], false) +
+                                        0.5f*LTC_Evaluate(N, V, P, Minv, lights[l], false));
+            }
+            accum[i + j*w] += vec4(color, 1.0f);
+        }
+
+        for (int j = 0; j < h; ++j)
+            memcpy(&image[x0 + (y0 + j)*width], &accum[j*w], w*sizeof(vec4));
+        if (!output.writeTile(x0, y0, w, h, &accum[0]))
+            failedTiles++;
+    });
+    bool closed = output.close();
+    double timeRender = seconds(start);
+
+    // writing alone
+    start = chrono::high_resolution_clock::now();
+    ImageOutput rewrite;
+    bool rewritten = rewrite.open(width, height, exrPath, pfmPath, pngPath);
+    parallel_for(tilesX*tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX)*tileSize, y0 = (tile/tilesX)*tileSize;
+        int w = std::min<int>(tileSize, width - x0), h = std::min<int>(tileSize, height - y0);
+
+        vector<vec4> accum(w*h);
+        for (int j = 0; j < h; ++j)
+            memcpy(&accum[j*w], &image[x0 + (y0 + j)*width], w*sizeof(vec4));
+        if (!rewrite.writeTile(x0, y0, w, h, &accum[0]))
+            failedTiles++;
+    });
+    rewritten = rewrite.close() && rewritten;
+    double timeWrite = seconds(start);
+
+    if (failedTiles > 0 || !closed || !rewritten)
+    {
+        cout << "could not write the images in /tmp" << endl;
+        return 1;
+    }
+
+    vector<vec3> pfm, exr;
+    vector<unsigned char> png, expected(3*width*height);
+    bool read = readPFM(pfmPath, width, height, pfm) && readEXR(exrPath, width, height, exr) &&
+                readPNG(pngPath, width, height, png);
+    if (!read)
+    {
+        cout << "could not read the images back" << endl;
+        return 1;
+    }
+    tonemapImage(&image[0], width*height, &expected[0]);
+
+    int pfmErrors = 0, pngErrors = 0;
+    float exrError = 0.0f;
+    for (int i = 0; i < width*height; ++i)
+    {
+        vec3 v = vec3(image[i].x, image[i].y, image[i].z)*(1.0f/image[i].w);
+        pfmErrors += v.x != pfm[i].x || v.y != pfm[i].y || v.z != pfm[i].z;
+        for (int k = 0; k < 3; ++k)
+        {
+            exrError = std::max<float>(exrError, fabsf(exr[i][k] - v[k])/std::max<float>(v[k], 1e-3f));
+            pngErrors += png[3*i + k] != expected[3*i + k];
+        }
+    }
+
+    passed = pfmErrors == 0 && pngErrors == 0 && exrError < 1e-3f;
+    ok = ok && passed;
+    printf("%dx%d rendering in %dx%d tiles: %.1f ms, writing alone %.1f ms\n", width, height, tileSize, tileSize,
+        1e3*timeRender, 1e3*timeWrite);
+    printf("  read back: pfm %d pixels differ, exr max relative error %.2e, png %d values differ%s\n",
+        pfmErrors, exrError, pngErrors, passed ? "" : "  FAILED");
+
+    return ok ? 0 : 1;
+}
+
+// batched inverses of LTC matrices (ltc_matrix.h) against a double precision reference, and per frame rebuilds of
+// 10^6 matrices against glm::inverse() and glm::determinant()
+int testMatrices(const LTCTable& table)
+{
+    const int count = 1000000;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    // fitted matrices: frame rotated in the xz plane times the parametric matrix (see LTC::update())
+    vector<mat3> tab(count);
+    LTCMatrices M;
+    M.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        float phi = 1.57f*u(rng);
+        float m11 = 1e-3f + u(rng), m22 = 1e-3f + u(rng), m13 = 2.0f*u(rng) - 1.0f;
+        mat3 frame(vec3(cosf(phi), 0, -sinf(phi)), vec3(0, 1, 0), vec3(sinf(phi), 0, cosf(phi)));
+        tab[i] = frame*mat3(m11, 0, 0, 0, m22, 0, m13, 0, 1);
+        M.set(i, tab[i]);
+    }
+
+    // accuracy: terms relative to the largest term of the normalized inverse
+    LTCMatrices Minv;
+    vector<float> det(count);
+    ltcNormalizedInverse(M, Minv, &det[0]);
+
+    float maxError = 0.0f, maxDetError = 0.0f;
+    int scalarMismatches = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        double a = M.m00[i], b = M.m02[i], c = M.m20[i], d = M.m22[i], e = M.m11[i];
+        double det2 = a*d - c*b;
+        double ref[4] = { e*d/det2, -e*b/det2, -e*c/det2, e*a/det2 };
+        double got[4] = { Minv.m00[i], Minv.m02[i], Minv.m20[i], Minv.m22[i] };
+
+        double scale = 0.0, error = 0.0;
+        for (int k = 0; k < 4; ++k)
+        {
+            scale = std::max<double>(scale, fabs(ref[k]));
+            error = std::max<double>(error, fabs(got[k] - ref[k]));
+        }
+        maxError = std::max<float>(maxError, (float)(error/scale));
+        maxDetError = std::max<float>(maxDetError, (float)fabs(det[i]/(e*det2) - 1.0));
+
+        // the scalar functions share the terms of the batches
+        vec4 p = Minv.packed(i);
+        mat3 n = ltcNormalizedInverse(tab[i]);
+        if (n[0][0] != p.x || n[0][2] != p.y || n[2][0] != p.z || n[2][2] != p.w || ltcDeterminant(tab[i]) != det[i])
+            scalarMismatches++;
+    }
+
+    bool passed = maxError < 1e-5f && maxDetError < 1e-5f && scalarMismatches == 0;
+    printf("normalized inverses of %d matrices: max relative error %.2e, determinants %.2e, %d scalar mismatches%s\n",
+        count, maxError, maxDetError, scalarMismatches, passed ? "" : "  FAILED");
+
+    // packing of the fitted matrices (packTab())
+    const int frames = 5;
+    vector<vec4> packed(count);
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f)
+    for (int i = 0; i < count; ++i)
+    {
+        mat3 invM = inverse(tab[i]);
+        invM /= invM[1][1];
+        packed[i] = vec4(invM[0][0], invM[0][2], invM[2][0], invM[2][2]);
+    }
+    double timeGlm = seconds(start)/frames;
+    sink = packed[count/2].x;
+
+    start = chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f)
+        ltcNormalizedInverse(M, Minv, NULL, 1);
+    double timeBatch = seconds(start)/frames;
+    sink = Minv.m00[count/2];
+
+    start = chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f)
+        ltcNormalizedInverse(M, Minv);
+    double timeThreads = seconds(start)/frames;
+    sink = Minv.m00[count/2];
+
+    printf("  normalized inverses: glm %.2f ms, batch %.2f ms, batch on %d threads %.2f ms\n",
+        1e3*timeGlm, 1e3*timeBatch, numThreads(), 1e3*timeThreads);
+
+    // runtime: M and |det(Minv)| of the Minv fetched from the table for 10^6 pixels
+    vector<float> roughness(count), cosTheta(count);
+    for (int i = 0; i < count; ++i)
+    {
+        roughness[i] = u(rng);
+        cosTheta[i] = u(rng);
+    }
+
+    LTCMatrices tableMinv, tableM;
+    table.MinvBatch(&roughness[0], &cosTheta[0], count, tableMinv);
+
+    vector<mat3> Mglm(count);
+    start = chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f)
+    for (int i = 0; i < count; ++i)
+    {
+        mat3 m = tableMinv.get(i);
+        Mglm[i] = inverse(m);
+        det[i] = fabsf(determinant(m));
+    }
+    timeGlm = seconds(start)/frames;
+    sink = Mglm[count/2][0][0] + det[count/2];
+
+    start = chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f)
+        ltcInverse(tableMinv, tableM, &det[0], 1);
+    timeBatch = seconds(start)/frames;
+    sink = tableM.m00[count/2];
+
+    float maxTableError = 0.0f;
+    for (int i = 0; i < count; ++i)
+    {
+        mat3 m = tableM.get(i);
+        for (int k = 0; k < 3; ++k)
+        for (int l = 0; l < 3; ++l)
+            maxTableError = std::max<float>(maxTableError,
+                fabsf(m[k][l] - Mglm[i][k][l])/std::max<float>(1.0f, fabsf(Mglm[i][k][l])));
+    }
+
+    printf("  table rebuild of M and det(Minv): glm %.2f ms, batch %.2f ms, max difference %.2e\n",
+        1e3*timeGlm, 1e3*timeBatch, maxTableError);
+
+    return passed && maxTableError < 1e-4f ? 0 : 1;
+}
+
+// incremental baking (bake.h) on a floor of 400 x 400 texels under 50 lights, with a glossy patch
+int testBake(const LTCTable& table)
+{
+    const int res = 400;
+    const int numLights = 50;
+    const int numMoved = 5;
+    const float spacing = 0.25f;
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    // 100m x 100m, diffuse but for a patch of 10m x 10m in a corner, seen from a camera above the center
+    IncrementalBaker baker;
+    baker.table = &table;
+    baker.threshold = 1e-2f;
+    baker.texels.resize(res*res);
+    for (int j = 0; j < res; ++j)
+    for (int i = 0; i < res; ++i)
+    {
+        BakeTexel& texel = baker.texels[i + j*res];
+        texel.P = vec3((i + 0.5f)*spacing - 50.0f, (j + 0.5f)*spacing - 50.0f, 0.0f);
+        texel.N = vec3(0, 0, 1);
+        texel.V = normalize(vec3(0, 0, 5) - texel.P);
+        texel.roughness = i < 40 && j < 40 ? 0.1f + 0.3f*u(rng) : -1.0f;
+    }
+
+    auto randomLight = [&]()
+    {
+        BakeLight light;
+        vec3 center = vec3(100.0f*u(rng) - 50.0f, 100.0f*u(rng) - 50.0f, 0.5f + 2.5f*u(rng));
+        vec3 ex = vec3(0.05f + 0.2f*u(rng), 0, 0), ey = vec3(0, 0.05f + 0.2f*u(rng), 0);
+
+        // lit side facing down
+        light.points[0] = center - ex - ey;
+        light.points[1] = center + ex - ey;
+        light.points[2] = center + ex + ey;
+        light.points[3] = center - ex + ey;
+        light.color = vec3(0.5f + 4.5f*u(rng), 0.5f + 4.5f*u(rng), 0.5f + 4.5f*u(rng));
+        light.twoSided = false;
+        return light;
+    };
+
+    for (int l = 0; l < numLights; ++l)
+        baker.lights.push_back(randomLight());
+
+    auto start = chrono::high_resolution_clock::now();
+    baker.bake();
+    double timeBake = seconds(start);
+
+    // footprints against the bound of the glossiest texel for all texels
+    double footprint = 0.0, globalFootprint = 0.0;
+    for (int l = 0; l < numLights; ++l)
+    {
+        LightRadius radius(baker.lights[l], baker.threshold);
+        float r = radius(baker.grid.maxBound);
+        for (int t = 0; t < res*res; ++t)
+            globalFootprint += distance(baker.texels[t].P, radius.center) <= r;
+        footprint += baker.contributions[l].texels.size();
+    }
+
+    // incremental update against a full bake of the moved lights
+    vector<int> moved;
+    vector<BakeLight> newLights;
+    for (int m = 0; m < numMoved; ++m)
+    {
+        moved.push_back(m*numLights/numMoved);
+        newLights.push_back(randomLight());
+    }
+
+    start = chrono::high_resolution_clock::now();
+    baker.updateLights(moved, newLights);
+    double timeUpdate = seconds(start);
+
+    IncrementalBaker full;
+    full.table = &table;
+    full.threshold = baker.threshold;
+    full.texels = baker.texels;
+    full.lights = baker.lights;
+    full.bake();
+
+    float maxValue = 0.0f, maxDifference = 0.0f;
+    for (int t = 0; t < res*res; ++t)
+        for (int c = 0; c < 3; ++c)
+        {
+            maxValue = std::max<float>(maxValue, fabsf(full.result[t][c]));
+            maxDifference = std::max<float>(maxDifference, fabsf(baker.result[t][c] - full.result[t][c]));
+        }
+
+    // truncation: the contributions left out of the footprints, on every 4th texel
+    float maxTruncated = 0.0f;
+    for (int l = 0; l < numLights; ++l)
+    {
+        const vector<int>& texels = baker.contributions[l].texels;
+        for (int t = 0; t < res*res; t += 4)
+        {
+            if (std::binary_search(texels.begin(), texels.end(), t))
+                continue;
+
+            vec3 value = baker.evaluate(baker.texels[t], baker.lights[l]);
+            maxTruncated = std::max<float>(maxTruncated, std::max<float>(value.x, std::max<float>(value.y, value.z)));
+        }
+    }
+
+    bool passed = maxDifference <= 1e-5f*maxValue && maxTruncated < baker.threshold;
+    printf("%d texels, %d lights: incremental update of %d lights against a full bake, max difference %.2e (max value %.2f), "
+        "max truncated contribution %.2e (threshold %.0e)%s\n", res*res, numLights, numMoved, maxDifference, maxValue,
+        maxTruncated, baker.threshold, passed ? "" : "  FAILED");
+    printf("  texels per light: %.0f, %.0f with the bound of the glossiest texel for all texels\n",
+        footprint/numLights, globalFootprint/numLights);
+    printf("  full bake %.1f ms, update %.1f ms\n", 1e3*timeBake, 1e3*timeUpdate);
+
+    return passed ? 0 : 1;
+}
+
+// protocol of fitLTC --serve (refit_server.h): requests and responses of a scripted session, with the fit replaced
+// by a stub that echoes the parsed request
+int testServe()
+{
+    struct Exchange
+    {
+        const char* request;
+        const char* id;     // JSON text echoed in the response
+        bool ok;
+    };
+
+    const Exchange session[] =
+    {
+        { "{\"id\": 1, \"alpha\": 0.09, \"theta\": 0.8}", "1", true },
+        { "", NULL, false },
+        { "{\"id\": \"b\", \"brdf\": \"beckmann\", \"alpha\": 0.5, \"theta\": 0.1, \"guess\": [0.4, 0.6, 0.1], "
+          "\"iterations\": 20, \"epsilon\": 0.1, \"plot\": 8}", "\"b\"", true },
+        { "{\"id\": 3, \"alpha\": 0.5, \"theta\": 0.1, \"epsilon\": 0}", "3", false },
+        { "{\"id\": 4, \"alpha\": 0.5, \"theta\": 0.1, \"epsilon\": -0.05}", "4", false },
+        { "{\"id\": 5, \"alpha\": 0.5, \"theta\": 0.1, \"epsilon\": nan}", "5", false },
+        { "{\"id\": 6, \"alpha\": 2, \"theta\": 0.1}", "6", false },
+        { "{\"id\": 7, \"alpha\": 0.5}", "7", false },
+        { "{\"id\": 8, \"brdf\": \"phong\", \"alpha\": 0.5, \"theta\": 0.1}", "8", false },
+        { "{\"id\": 9, \"alpha\": 0.5, \"theta\": 0.1, \"guess\": [1, 2]}", "9", false },
+        { "{\"id\": 10, \"alpha\"", "null", false },  // not parsed, the id is unknown
+    };
+    const int numExchanges = sizeof(session)/sizeof(session[0]);
+
+    stringstream in, out;
+    for (int e = 0; e < numExchanges; ++e)
+        in << session[e].request << "\n";
+
+    BrdfGGX ggx;
+    BrdfBeckmann beckmann;
+    vector<string> names = { "ggx", "beckmann" };
+    vector<const Brdf*> brdfs = { &ggx, &beckmann };
+
+    vector<RefitRequest> served;
+    auto refit = [&](const RefitRequest& request, RefitResult& result)
+    {
+        served.push_back(request);
+        result.ltc = LTC();
+        result.params[0] = request.hasGuess ? request.guess[0] : request.alpha;
+        result.params[1] = request.hasGuess ? request.guess[1] : request.alpha;
+        result.params[2] = request.hasGuess ? request.guess[2] : 0.0f;
+        result.error = request.epsilon;
+        result.iterations = request.iterations;
+        result.evaluations = request.brdf;
+    };
+
+    runRefitServer(in, out, names, brdfs, refit);
+
+    // one response per request that is not blank, in order
+    int failures = 0, plots = 0;
+    string line;
+    for (int e = 0; e < numExchanges; ++e)
+    {
+        if (!session[e].id)
+            continue;
+
+        if (!getline(out, line))
+        {
+            printf("  no response to %s  FAILED\n", session[e].request);
+            failures++;
+            continue;
+        }
+
+        // the plots are a nested object, checked apart
+        size_t plot = line.find(", \"plot\": {");
+        string plotText = plot == string::npos ? "" : line.substr(plot);
+        if (plot != string::npos)
+            line = line.substr(0, plot) + "}";
+
+        map<string, JsonValue> fields;
+        string error;
+        bool ok = parseJsonObject(line, fields, error) && fields["id"].text == session[e].id &&
+            fields["ok"].text == (session[e].ok ? "true" : "false");
+        if (ok && session[e].ok)
+            ok = fields["params"].numbers.size() == 3 && fields["M"].numbers.size() == 9;
+        if (ok && !session[e].ok)
+            ok = fields["reason"].type == JsonValue::STRING && !fields["reason"].str.empty();
+
+        printf("  %-40.40s  %s%s\n", session[e].request, session[e].ok ? "served" : fields["reason"].str.c_str(),
+            ok ? "" : "  FAILED");
+        failures += !ok;
+
+        // 8 x 8 RGB plots of the LTC and the BRDF, in base64
+        for (const char* key : { "\"ltc\": \"", "\"brdf\": \"" })
+        {
+            size_t start = plotText.find(key);
+            size_t end = start == string::npos ? start : plotText.find('"', start + strlen(key));
+            plots += end != string::npos && end - start - strlen(key) == (8*8*3 + 2)/3*4;
+        }
+    }
+
+    if (getline(out, line))
+    {
+        printf("  extra response %s  FAILED\n", line.c_str());
+        failures++;
+    }
+
+    // the values of the requests reach the fit, and the plots are 8 x 8 RGB
+    bool parsed = served.size() == 2 && served[0].brdf == 0 && !served[0].hasGuess && served[0].iterations == 100 &&
+        served[0].epsilon == 0.05f && served[1].brdf == 1 && served[1].hasGuess && served[1].guess[1] == 0.6f &&
+        served[1].iterations == 20 && served[1].epsilon == 0.1f && served[1].plotSize == 8;
+    if (!parsed)
+        printf("  requests not parsed as sent  FAILED\n");
+    if (plots != 2)
+        printf("  %d plots of 8 x 8 pixels instead of 2  FAILED\n", plots);
+
+    bool passed = failures == 0 && parsed && plots == 2;
+    printf("%d requests, %d served, %d rejected%s\n", numExchanges - 1, (int)served.size(),
+        numExchanges - 1 - (int)served.size(), passed ? "" : "  FAILED");
+    return passed ? 0 : 1;
+}
+
+// prefilterCubeLTC() against the same lobes filtered by importance sampling GGX, at N = V = R: the samples of
+// BrdfGGX read the top level of the source, weighted by eval()/pdf and normalized
+void prefilterCubeGGX(const Cubemap& src, Cubemap& dst, int sqrtSamples)
+{
+    const int mips = dst.mips();
+    BrdfGGX ggx;
+
+    parallel_for(6*mips, [&](int task)
+    {
+        int face = task % 6;
+        int mip  = task / 6;
+        int size = dst.levelSize(mip);
+
+        float roughness = mips > 1 ? mip/float(mips - 1) : 0.0f;
+        float alpha = roughness*roughness;
+
+        for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            vec3 R = cubeDirection(face, x, y, size);
+
+            if (mip == 0)
+            {
+                dst.texel(mip, face, x, y) = sampleCube(src, R, 0);
+                continue;
+            }
+
+            vec3 T1 = normalize(fabsf(R.y) < 0.999f ? cross(vec3(0, 1, 0), R) : cross(vec3(1, 0, 0), R));
+            vec3 T2 = cross(R, T1);
+
+            vec4 sum = vec4(0, 0, 0, 0);
+            float sumWeights = 0.0f;
+            for (int j = 0; j < sqrtSamples; ++j)
+            for (int i = 0; i < sqrtSamples; ++i)
+            {
+                vec3 L = ggx.sample(vec3(0, 0, 1), alpha, (i + 0.5f)/sqrtSamples, (j + 0.5f)/sqrtSamples);
+
+                float pdf;
+                float value = ggx.eval(vec3(0, 0, 1), L, alpha, pdf);
+                if (pdf <= 0.0f || value <= 0.0f)
+                    continue;
+
+                sum += sampleCube(src, T1*L.x + T2*L.y + R*L.z, 0)*(value/pdf);
+                sumWeights += value/pdf;
+            }
+
+            dst.texel(mip, face, x, y) = sumWeights > 0.0f ? sum/sumWeights : vec4(0, 0, 0, 0);
+        }
+    });
+}
+
+// environment prefiltering: prefilterCubeLTC() at the sample count of prefilterEnv against a GGX reference of
+// 16384 samples per texel, and GGX importance sampling at the count that reaches the same error
+// * the source is a sky gradient with a checker floor and a small bright sun, the case where few samples fail
+// * errors are RMS over the texels of a mip, relative to the RMS of the reference; the noise of the reference is
+//   below 0.5% and the bias of the LTC lobes (with 1024 samples) below 1.5%, the rest is the noise of 64 samples
+int testEnv(const LTCTable& table)
+{
+    const int srcSize = 128, dstSize = 32, mips = 6;
+    const int ltcSqrtSamples = 8;   // 64, the default of prefilterEnv
+    const int refSqrtSamples = 128;
+    const float maxMipError = 0.06f, maxError = 0.04f;
+    const float pi = 3.14159265f;
+
+    Cubemap src(srcSize, 8);
+    const vec3 sun = normalize(vec3(0.3f, 0.6f, -0.5f));
+    for (int face = 0; face < 6; ++face)
+    for (int y = 0; y < srcSize; ++y)
+    for (int x = 0; x < srcSize; ++x)
+    {
+        vec3 d = cubeDirection(face, x, y, srcSize);
+        vec3 c = d.y > 0.0f ? mix(vec3(0.8f, 0.9f, 1.0f), vec3(0.2f, 0.4f, 0.9f), d.y) :
+            (int(floorf(4.0f*d.x/(0.05f - d.y)) + floorf(4.0f*d.z/(0.05f - d.y))) & 1 ? vec3(0.6f) : vec3(0.1f));
+        if (dot(d, sun) > cosf(5.0f*pi/180.0f))
+            c = vec3(20.0f, 18.0f, 15.0f);
+        src.texel(0, face, x, y) = vec4(c, 1.0f);
+    }
+    buildCubeMips(src);
+
+    auto time = [&](Cubemap& dst, function<void()> prefilter)
+    {
+        dst = Cubemap(dstSize, mips);
+        auto start = chrono::high_resolution_clock::now();
+        prefilter();
+        return seconds(start);
+    };
+
+    // relative RMS error of each mip but the top level, a copy of the source
+    auto errors = [&](const Cubemap& a, const Cubemap& ref, vector<float>& perMip)
+    {
+        perMip.assign(mips, 0.0f);
+        double sumSq = 0.0, sumRef = 0.0;
+        for (int m = 1; m < mips; ++m)
+        {
+            double mipSq = 0.0, mipRef = 0.0;
+            for (size_t i = 0; i < ref.levels[m].size(); ++i)
+            for (int c = 0; c < 3; ++c)
+            {
+                float d = a.levels[m][i][c] - ref.levels[m][i][c];
+                mipSq  += d*d;
+                mipRef += ref.levels[m][i][c]*ref.levels[m][i][c];
+            }
+            perMip[m] = (float)sqrt(mipSq/mipRef);
+            sumSq += mipSq;
+            sumRef += mipRef;
+        }
+        return (float)sqrt(sumSq/sumRef);
+    };
+
+    Cubemap reference, ltc;
+    time(reference, [&]() { prefilterCubeGGX(src, reference, refSqrtSamples); });
+    double ltcTime = time(ltc, [&]() { prefilterCubeLTC(src, table, ltc, ltcSqrtSamples); });
+
+    vector<float> ltcErrors;
+    float ltcError = errors(ltc, reference, ltcErrors);
+
+    printf("%dx%d source, %d mips of %dx%d, relative RMS error against GGX with %d samples per texel\n",
+        srcSize, srcSize, mips, dstSize, dstSize, refSqrtSamples*refSqrtSamples);
+    printf("  roughness    ");
+    for (int m = 1; m < mips; ++m)
+        printf("  %5.2f", m/float(mips - 1));
+    printf("    all  time\n  LTC, %4d    ", ltcSqrtSamples*ltcSqrtSamples);
+    for (int m = 1; m < mips; ++m)
+        printf(" %6.4f", ltcErrors[m]);
+    printf(" %6.4f  %.1f ms\n", ltcError, 1e3*ltcTime);
+
+    // GGX at growing counts, until it is as accurate as the LTC
+    int matched = 0;
+    double matchedTime = 0.0;
+    for (int sqrtSamples = 4; sqrtSamples <= 64 && !matched; sqrtSamples *= 2)
+    {
+        Cubemap ggx;
+        double ggxTime = time(ggx, [&]() { prefilterCubeGGX(src, ggx, sqrtSamples); });
+
+        vector<float> ggxErrors;
+        float ggxError = errors(ggx, reference, ggxErrors);
+        printf("  GGX, %4d    ", sqrtSamples*sqrtSamples);
+        for (int m = 1; m < mips; ++m)
+            printf(" %6.4f", ggxErrors[m]);
+        printf(" %6.4f  %.1f ms\n", ggxError, 1e3*ggxTime);
+
+        if (ggxError <= ltcError)
+        {
+            matched = sqrtSamples*sqrtSamples;
+            matchedTime = ggxTime;
+        }
+    }
+
+    bool passed = *std::max_element(ltcErrors.begin(), ltcErrors.end()) < maxMipError && ltcError < maxError;
+    if (matched)
+        printf("GGX needs %d samples per texel for the error of LTC with %d: %.1fx the time",
+            matched, ltcSqrtSamples*ltcSqrtSamples, matchedTime/ltcTime);
+    else
+        printf("GGX does not reach the error of LTC with %d samples per texel up to 4096",
+            ltcSqrtSamples*ltcSqrtSamples);
+    printf(", LTC errors below %.2f per mip and %.2f in all%s\n", maxMipError, maxError, passed ? "" : "  FAILED");
+
+    return passed ? 0 : 1;
+}
+
+// the example BRDF plugin against BrdfGGX, through the plugin ABI
+int testPlugin(const char* path)
+{
+    BrdfPlugin plugin;
+    string error;
+    if (!plugin.load(path, error))
+    {
+        cout << "cannot load " << path << ": " << error << endl;
+        return 1;
+    }
+
+    mt19937 rng(1234);
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    BrdfGGX ggx;
+
+    const int batch = 64, numBatches = 4096;
+    float maxValueError = 0.0f, maxPdfError = 0.0f, maxSampleError = 0.0f;
+    double timeVirtual = 0.0, timeBatch = 0.0;
+
+    vector<float> u1(batch), u2(batch), lx(batch), ly(batch), lz(batch), value(batch), pdf(batch);
+    for (int b = 0; b < numBatches; ++b)
+    {
+        float roughness = 0.05f + 0.95f*u(rng);
+        float alpha = roughness*roughness;
+        vec3 V = randomView(rng);
+        for (int i = 0; i < batch; ++i)
+        {
+            u1[i] = u(rng);
+            u2[i] = 0.999f*u(rng);
+        }
+
+        // samples
+        plugin.sampleBatch(V, alpha, batch, &u1[0], &u2[0], &lx[0], &ly[0], &lz[0]);
+        for (int i = 0; i < batch; ++i)
+        {
+            vec3 L = ggx.sample(V, alpha, u1[i], u2[i]);
+            maxSampleError = std::max<float>(maxSampleError, length(L - vec3(lx[i], ly[i], lz[i])));
+        }
+
+        // values and densities of the samples, and of uniform directions
+        for (int i = 0; i < batch; i += 2)
+        {
+            float z = 2.0f*u(rng) - 1.0f, phi = 6.2831853f*u(rng);
+            lx[i] = sqrtf(1.0f - z*z)*cosf(phi);
+            ly[i] = sqrtf(1.0f - z*z)*sinf(phi);
+            lz[i] = z;
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        plugin.evalBatch(V, alpha, batch, &lx[0], &ly[0], &lz[0], &value[0], &pdf[0]);
+        timeBatch += seconds(start);
+
+        float reference[batch], referencePdf[batch];
+        start = chrono::high_resolution_clock::now();
+        for (int i = 0; i < batch; ++i)
+            reference[i] = ggx.eval(V, vec3(lx[i], ly[i], lz[i]), alpha, referencePdf[i]);
+        timeVirtual += seconds(start);
+
+        for (int i = 0; i < batch; ++i)
+        {
+            maxValueError = std::max<float>(maxValueError, fabsf(value[i] - reference[i])/std::max<float>(reference[i], 1e-2f));
+            maxPdfError = std::max<float>(maxPdfError, fabsf(pdf[i] - referencePdf[i])/std::max<float>(referencePdf[i], 1e-2f));
+        }
+    }
+
+    bool passed = maxValueError < 1e-3f && maxPdfError < 1e-3f && maxSampleError < 1e-4f;
+    printf("%s vs BrdfGGX: relative error of eval %.2e, pdf %.2e, samples %.2e%s\n", plugin.name().c_str(),
+        maxValueError, maxPdfError, maxSampleError, passed ? "" : "  FAILED");
+    printf("  eval and pdf: BrdfGGX::eval() %.1f ns, batches of %d %.1f ns per direction\n",
+        1e9*timeVirtual/(numBatches*batch), batch, 1e9*timeBatch/(numBatches*batch));
+
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "usage: " << argv[0] << " <spectral|reload|btdf|combined|motion|sh|kernels|lod|lighttree|vndf|phase|rays|image|matrices|bake|env|serve|plugin> [ltc_1.dds ltc_2.dds]" << endl;
+        return 1;
+    }
+
+    // transmission tables, written by fitLTC --btdf
+    if (strcmp(argv[1], "btdf") == 0)
+        return testBtdf(argc > 3 ? argv[2] : "results/btdf_1.dds", argc > 3 ? argv[3] : "results/btdf_2.dds");
+
+    // single-lobe diffuse and specular tables, written by fitLTC --combined
+    if (strcmp(argv[1], "combined") == 0)
+        return testCombined(argc > 3 ? argv[2] : "results/combined_1.dds", argc > 3 ? argv[3] : "results/combined_2.dds");
+
+    // phase function tables, written by fitLTC --phase
+    if (strcmp(argv[1], "phase") == 0)
+        return testPhase(argc > 3 ? argv[2] : "results/phase_1.dds", argc > 3 ? argv[3] : "results/phase_2.dds");
+
+    if (strcmp(argv[1], "rays") == 0)
+        return testRays();
+
+    // example BRDF plugin, built by the brdfPluginGGX project
+    if (strcmp(argv[1], "plugin") == 0)
+        return testPlugin(argc > 2 ? argv[2] : "bin/libbrdfPluginGGX.so");
+
+    if (strcmp(argv[1], "sh") == 0)
+        return testSH();
+
+    if (strcmp(argv[1], "vndf") == 0)
+        return testVNDF();
+
+    // protocol of fitLTC --serve
+    if (strcmp(argv[1], "serve") == 0)
+        return testServe();
+
+    LTCTable table;
+    const char* path1 = argc > 3 ? argv[2] : "results/ltc_1.dds";
+    const char* path2 = argc > 3 ? argv[3] : "results/ltc_2.dds";
+    if (!table.load(path1, path2))
+    {
+        cout << "could not load " << path1 << " and " << path2 << endl;
+        return 1;
+    }
+
+    if (strcmp(argv[1], "spectral") == 0)
+        return testSpectral(table);
+    if (strcmp(argv[1], "reload") == 0)
+        return testReload(path1, path2);
+    if (strcmp(argv[1], "motion") == 0)
+        return testMotion(table);
+    if (strcmp(argv[1], "kernels") == 0)
+        return testKernels(table);
+    if (strcmp(argv[1], "lod") == 0)
+        return testLOD(table);
+    if (strcmp(argv[1], "lighttree") == 0)
+        return testLightTree(table);
+    if (strcmp(argv[1], "image") == 0)
+        return testImage(table);
+    if (strcmp(argv[1], "matrices") == 0)
+        return testMatrices(table);
+    if (strcmp(argv[1], "bake") == 0)
+        return testBake(table);
+    if (strcmp(argv[1], "env") == 0)
+        return testEnv(table);
+
+    cout << "unknown test " << argv[1] << endl;
+    return 1;
+}
@@ -0,0 +1,117 @@
+// prefilterEnv.cpp : LTC prefiltering of environment maps for glossy reflections
+//
+// usage: prefilterEnv [options] <out.dds> <latlong.dds> [<latlong.dds> ...]
+//   -size N      output cube map size (default 256)
+//   -mips N      number of roughness levels (default: full mip chain)
+//   -samples N   LTC samples per texel (default 64)
+//   -ltc a b     fitted tables (default results/ltc_1.dds results/ltc_2.dds)
+// each input is a latitude-longitude RGBA16F/32F DDS, all of them are written
+// as one RGBA16F cube map array, mip m holding roughness m/(mips - 1)
+#include <glm/glm.hpp>
+using namespace glm;
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "../envmap.h"
+#include "../float_to_half.h"
+
+int main(int argc, char* argv[])
+{
+    int size = 256;
+    int mips = 0;
+    int samples = 64;
+    const char* ltc1 = "results/ltc_1.dds";
+    const char* ltc2 = "results/ltc_2.dds";
+    vector<const char*> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+            size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-mips") == 0 && i + 1 < argc)
+            mips = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-samples") == 0 && i + 1 < argc)
+            samples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-ltc") == 0 && i + 2 < argc)
+        {
+            ltc1 = argv[++i];
+            ltc2 = argv[++i];
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (paths.size() < 2 || size <= 0)
+    {
+        cout << "usage: " << argv[0] << " [-size N] [-mips N] [-samples N] [-ltc ltc_1.dds ltc_2.dds] <out.dds> <latlong.dds> ..." << endl;
+        return 1;
+    }
+
+    int fullChain = 1;
+    while ((size >> fullChain) > 0)
+        ++fullChain;
+    if (mips <= 0 || mips > fullChain)
+        mips = fullChain;
+
+    int sqrtSamples = std::max<int>(1, (int)sqrtf((float)samples));
+
+    LTCTable table;
+    if (!table.load(ltc1, ltc2))
+    {
+        cout << "could not load " << ltc1 << " and " << ltc2 << endl;
+        return 1;
+    }
+
+    // all cubes, faces and mips, in DDS order
+    vector<uint16_t> output;
+
+    for (size_t c = 1; c < paths.size(); ++c)
+    {
+        unsigned width, height;
+        float* latlong = LoadDDS(paths[c], &width, &height);
+        if (!latlong)
+        {
+            cout << "could not load " << paths[c] << endl;
+            return 1;
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+
+        // source with a full mip chain for filtered importance sampling
+        Cubemap src(size, fullChain);
+        cubeFromLatLong(src, (const vec4*)latlong, width, height);
+        buildCubeMips(src);
+        delete[] latlong;
+
+        Cubemap dst(size, mips);
+        prefilterCubeLTC(src, table, dst, sqrtSamples);
+
+        double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        cout << paths[c] << ": " << elapsed << " s" << endl;
+
+        for (int face = 0; face < 6; ++face)
+        for (int mip = 0; mip < mips; ++mip)
+        {
+            int s = dst.levelSize(mip);
+            const vec4* texels = &dst.levels[mip][face*s*s];
+            for (int i = 0; i < s*s; ++i)
+            for (int k = 0; k < 4; ++k)
+                output.push_back(float_to_half_fast(texels[i][k]));
+        }
+    }
+
+    unsigned numCubes = (unsigned)paths.size() - 1;
+    if (!SaveDDS(paths[0], DDS_FORMAT_R16G16B16A16_FLOAT, sizeof(uint16_t)*4, size, size, mips, numCubes, true, &output[0]))
+    {
+        cout << "could not write " << paths[0] << endl;
+        return 1;
+    }
+
+    return 0;
+}
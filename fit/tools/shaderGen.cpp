@@ -0,0 +1,179 @@
+// shaderGen.cpp : generation of the WebGL demo shaders from their sources
+//
+// usage: shaderGen [--check] [--no-compile] [--validator path] [shader directory]
+// expands the #include "file" lines of <dir>/src/*.fs, with the kernels shared with the C++ code
+// (<dir>/kernels, see ltc_kernels.h), and writes the result to <dir>/*.fs, which the demos fetch
+// --check only compares, and fails when a generated shader is out of date
+//   it also compiles the generated shaders with glslangValidator (or the --validator path), with the header the
+//   demos add (see createProgram() in the .html files), and fails when one does not compile or the validator
+//   cannot be run; --no-compile skips the compilation
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/wait.h>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+static string directoryOf(const string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+static string fileName(const string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// appends the file to out with its includes expanded, paths are relative to the including file
+// each file is included once
+static bool expand(const string& path, set<string>& included, string& out)
+{
+    ifstream file(path.c_str());
+    if (!file)
+    {
+        cerr << "cannot open " << path << endl;
+        return false;
+    }
+
+    string line;
+    while (getline(file, line))
+    {
+        const string directive = "#include \"";
+        if (line.compare(0, directive.size(), directive) != 0)
+        {
+            out += line + "\n";
+            continue;
+        }
+
+        size_t end = line.find('"', directive.size());
+        if (end == string::npos)
+        {
+            cerr << path << ": malformed " << line << endl;
+            return false;
+        }
+
+        string child = directoryOf(path) + "/" + line.substr(directive.size(), end - directive.size());
+        if (included.insert(child).second && !expand(child, included, out))
+            return false;
+    }
+
+    return true;
+}
+
+// compiles a generated fragment shader, as the demos do
+static bool compile(const string& validator, const string& path, const string& source, bool& found)
+{
+    const string header = "#version 300 es\nprecision highp float;\n#line 0\n";
+    const string command = validator + " --stdin -S frag";
+
+    FILE* pipe = popen(command.c_str(), "w");
+    if (!pipe)
+        return found = false;
+
+    string text = header + source;
+    fwrite(text.data(), 1, text.size(), pipe);
+    int status = pclose(pipe);
+
+    // 127: the shell did not find the validator
+    found = status != -1 && !(WIFEXITED(status) && WEXITSTATUS(status) == 127);
+    if (found && status != 0)
+        cout << path << " does not compile" << endl;
+    return found && status == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool check = false;
+    bool compileShaders = true;
+    string validator = "glslangValidator";
+    string dir = "../webgl/shaders/ltc";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (string(argv[i]) == "--check")
+            check = true;
+        else if (string(argv[i]) == "--no-compile")
+            compileShaders = false;
+        else if (string(argv[i]) == "--validator" && i + 1 < argc)
+            validator = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            cout << "usage: " << argv[0] << " [--check] [--no-compile] [--validator path] [shader directory]" << endl;
+            return 1;
+        }
+        else
+            dir = argv[i];
+    }
+
+    DIR* src = opendir((dir + "/src").c_str());
+    if (!src)
+    {
+        cerr << "cannot open " << dir << "/src" << endl;
+        return 1;
+    }
+
+    vector<string> shaders;
+    while (dirent* entry = readdir(src))
+    {
+        string name = entry->d_name;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".fs") == 0)
+            shaders.push_back(name);
+    }
+    closedir(src);
+
+    int stale = 0, failed = 0;
+    for (size_t i = 0; i < shaders.size(); ++i)
+    {
+        const string srcPath = dir + "/src/" + shaders[i];
+        const string dstPath = dir + "/" + shaders[i];
+
+        string out = "// generated by fit/tools/shaderGen from src/" + fileName(srcPath) +
+                     " and the kernels it includes, edit those instead\n\n";
+        set<string> included;
+        if (!expand(srcPath, included, out))
+            return 1;
+
+        if (check && compileShaders)
+        {
+            bool found;
+            bool compiled = compile(validator, dstPath, out, found);
+            if (!found)
+            {
+                cerr << "cannot run " << validator << ", install it or pass --no-compile" << endl;
+                return 1;
+            }
+            failed += !compiled;
+        }
+
+        ifstream current(dstPath.c_str());
+        stringstream content;
+        content << current.rdbuf();
+        if (content.str() == out)
+            continue;
+
+        if (check)
+        {
+            cout << dstPath << " is out of date" << endl;
+            stale++;
+            continue;
+        }
+
+        ofstream file(dstPath.c_str());
+        file << out;
+        if (!file)
+        {
+            cerr << "cannot write " << dstPath << endl;
+            return 1;
+        }
+        cout << "wrote " << dstPath << endl;
+    }
+
+    return stale || failed ? 1 : 0;
+}
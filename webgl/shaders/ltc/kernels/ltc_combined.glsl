@@ -0,0 +1,67 @@
+// Combined diffuse and specular lobes
+// requires ltc_common.glsl and ltc_polygon.glsl
+// single LTC lobes of the Disney diffuse and GGX BRDFs of a material, fitted by fitLTC --combined
+// (fit/brdf_combined.h): one layer of ltc_combined per fraction k of the energy of the material in its
+// specular lobe, with the GGX magnitude and Fresnel terms of ltc_2 (the GGX table or the first layer of
+// combined_2), see fit/ltc_combined.h; the shaders declare a precision for sampler2DArray, that has no default
+
+// roughness below which the diffuse and specular lobes are integrated separately, see ltcBench combined
+const float LTC_COMBINED_MIN_ROUGHNESS = 0.6f;
+
+float LTC_Luminance(vec3 c)
+{
+    return 0.2126f*c.x + 0.7152f*c.y + 0.0722f*c.z;
+}
+
+// fraction of the energy of a material in its specular lobe, and its specular color with Fresnel from the
+// GGX terms t2
+float LTC_CombinedWeight(vec3 dcol, vec3 scol, vec4 t2, OUT(vec3) spec)
+{
+    spec = scol*t2.x + (vec3(1.0f) - scol)*t2.y;
+
+    float s = LTC_Luminance(spec);
+    float d = LTC_Luminance(dcol);
+    return s + d > 0.0f ? s/(s + d) : 0.0f;
+}
+
+// inverse LTC matrix of the lobe of the fraction k, interpolated between the layers around it
+mat3 LTC_CombinedMatrix(sampler2DArray ltc_combined, vec2 uv, float k)
+{
+    float last = float(textureSize(ltc_combined, 0).z - 1);
+    float x = clamp(k, 0.0f, 1.0f)*last;
+    float k0 = min(floor(x), last - 1.0f);
+    float w = x - k0;
+
+    vec4 t1 = texture(ltc_combined, vec3(uv.x, uv.y, k0))*(1.0f - w) +
+              texture(ltc_combined, vec3(uv.x, uv.y, k0 + 1.0f))*w;
+    return LTC_Matrix(t1);
+}
+
+// light reflected from a quad by a material of diffuse color dcol and specular color scol, as in ltc_quad.fs
+// * from minRoughness up, one integral of the lobe of the material for the sum of both colors: exact for
+//   materials of the same hue in both lobes, the ratio of their luminances otherwise
+// * below it, the sum of the lobes has two peaks that one LTC does not follow: the diffuse and GGX layers
+//   (k = 0 and 1) are integrated separately, LTC_COMBINED_MIN_ROUGHNESS by default and 0 for one integral at all
+//   roughnesses
+vec3 LTC_EvaluateCombined(
+    vec3 N, vec3 V, vec3 P, float roughness, vec3 dcol, vec3 scol, vec3 points[4], bool twoSided, bool clipless,
+    float minRoughness, sampler2DArray ltc_combined, sampler2D ltc_2)
+{
+    vec2 uv = LTC_Coords(roughness, saturate(dot(N, V)));
+
+    vec3 spec;
+    float k = LTC_CombinedWeight(dcol, scol, texture(ltc_2, uv), spec);
+
+    if (roughness < minRoughness)
+    {
+        float last = float(textureSize(ltc_combined, 0).z - 1);
+        mat3 diffMinv = LTC_Matrix(texture(ltc_combined, vec3(uv.x, uv.y, 0.0f)));
+        mat3 specMinv = LTC_Matrix(texture(ltc_combined, vec3(uv.x, uv.y, last)));
+
+        vec3 diff = LTC_EvaluateQuad(N, V, P, diffMinv, points, twoSided, clipless, ltc_2);
+        vec3 glossy = LTC_EvaluateQuad(N, V, P, specMinv, points, twoSided, clipless, ltc_2);
+        return dcol*diff + spec*glossy;
+    }
+
+    return (dcol + spec)*LTC_EvaluateQuad(N, V, P, LTC_CombinedMatrix(ltc_combined, uv, k), points, twoSided, clipless, ltc_2);
+}
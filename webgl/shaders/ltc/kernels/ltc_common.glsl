@@ -0,0 +1,95 @@
+// Kernels shared by the demos and the C++ code (fit/ltc_kernels.h)
+// written in the common subset of GLSL ES 3.00 and C++ described in fit/glsl.h
+
+#ifndef LTC_KERNELS_CPP
+#define OUT(T) out T
+#define INOUT(T) inout T
+#define OUT_ARRAY(T) out T
+#define INOUT_ARRAY(T) inout T
+#endif
+
+const float pi = 3.14159265f;
+
+const float LUT_SIZE  = 64.0f;
+const float LUT_SCALE = (LUT_SIZE - 1.0f)/LUT_SIZE;
+const float LUT_BIAS  = 0.5f/LUT_SIZE;
+
+// Matrix functions
+///////////////////
+
+vec3 mul(mat3 m, vec3 v)
+{
+    return m * v;
+}
+
+mat3 mul(mat3 m1, mat3 m2)
+{
+    return m1 * m2;
+}
+
+vec3 rotation_y(vec3 v, float a)
+{
+    vec3 r;
+    r.x =  v.x*cos(a) + v.z*sin(a);
+    r.y =  v.y;
+    r.z = -v.x*sin(a) + v.z*cos(a);
+    return r;
+}
+
+vec3 rotation_z(vec3 v, float a)
+{
+    vec3 r;
+    r.x =  v.x*cos(a) - v.y*sin(a);
+    r.y =  v.x*sin(a) + v.y*cos(a);
+    r.z =  v.z;
+    return r;
+}
+
+vec3 rotation_yz(vec3 v, float ay, float az)
+{
+    return rotation_z(rotation_y(v, ay), az);
+}
+
+mat3 mat3_from_columns(vec3 c0, vec3 c1, vec3 c2)
+{
+    mat3 m = mat3(c0, c1, c2);
+    return m;
+}
+
+float sqr(float x) { return x*x; }
+
+// Table lookups
+////////////////
+
+// texture coordinates of the fitted tables for (roughness, cos(theta))
+vec2 LTC_Coords(float roughness, float ndotv)
+{
+    vec2 uv = vec2(roughness, sqrt(1.0f - ndotv));
+    return uv*LUT_SCALE + LUT_BIAS;
+}
+
+// inverse LTC matrix from the first table
+mat3 LTC_Matrix(vec4 t1)
+{
+    return mat3(
+        vec3(t1.x, 0, t1.y),
+        vec3(   0, 1,    0),
+        vec3(t1.z, 0, t1.w)
+    );
+}
+
+// Misc. helpers
+////////////////
+
+float saturate(float v)
+{
+    return clamp(v, 0.0f, 1.0f);
+}
+
+vec3 PowVec3(vec3 v, float p)
+{
+    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
+}
+
+const float gamma = 2.2f;
+vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
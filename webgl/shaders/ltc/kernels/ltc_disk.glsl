@@ -0,0 +1,225 @@
+// Disk lights
+// requires ltc_common.glsl
+
+// An extended version of the implementation from
+// "How to solve a cubic equation, revisited"
+// http://momentsingraphics.de/?p=105
+vec3 SolveCubic(vec4 Coefficient)
+{
+    // Normalize the polynomial
+    Coefficient.x /= Coefficient.w;
+    Coefficient.y /= Coefficient.w;
+    Coefficient.z /= Coefficient.w;
+    // Divide middle coefficients by three
+    Coefficient.y /= 3.0f;
+    Coefficient.z /= 3.0f;
+
+    float A = Coefficient.w;
+    float B = Coefficient.z;
+    float C = Coefficient.y;
+    float D = Coefficient.x;
+
+    // Compute the Hessian and the discriminant
+    vec3 Delta = vec3(
+        -Coefficient.z*Coefficient.z + Coefficient.y,
+        -Coefficient.y*Coefficient.z + Coefficient.x,
+        Coefficient.z*Coefficient.x - Coefficient.y*Coefficient.y
+    );
+
+    // three real roots, the discriminant and -C_a, -C_d below are only negative by rounding (tiny or distant disks)
+    float Discriminant = max(4.0f*Delta.x*Delta.z - Delta.y*Delta.y, 0.0f);
+
+    vec2 xlc, xsc;
+
+    // Algorithm A
+    {
+        float C_a = min(Delta.x, 0.0f);
+        float D_a = -2.0f*B*Delta.x + Delta.y;
+
+        // Take the cubic root of a normalized complex number
+        float Theta = atan(sqrt(Discriminant), -D_a)/3.0f;
+
+        float x_1a = 2.0f*sqrt(-C_a)*cos(Theta);
+        float x_3a = 2.0f*sqrt(-C_a)*cos(Theta + (2.0f/3.0f)*pi);
+
+        float xl;
+        if ((x_1a + x_3a) > 2.0f*B)
+            xl = x_1a;
+        else
+            xl = x_3a;
+
+        xlc = vec2(xl - B, A);
+    }
+
+    // Algorithm D
+    {
+        float C_d = min(Delta.z, 0.0f);
+        float D_d = -D*Delta.y + 2.0f*C*Delta.z;
+
+        // Take the cubic root of a normalized complex number
+        float Theta = atan(D*sqrt(Discriminant), -D_d)/3.0f;
+
+        float x_1d = 2.0f*sqrt(-C_d)*cos(Theta);
+        float x_3d = 2.0f*sqrt(-C_d)*cos(Theta + (2.0f/3.0f)*pi);
+
+        float xs;
+        if (x_1d + x_3d < 2.0f*C)
+            xs = x_1d;
+        else
+            xs = x_3d;
+
+        xsc = vec2(-D, xs + C);
+    }
+
+    float E =  xlc.y*xsc.y;
+    float F = -xlc.x*xsc.y - xlc.y*xsc.x;
+    float G =  xlc.x*xsc.x;
+
+    vec2 xmc = vec2(C*F - B*G, -B*F + C*E);
+
+    vec3 Root = vec3(xsc.x/xsc.y, xmc.x/xmc.y, xlc.x/xlc.y);
+
+    if (Root.x < Root.y && Root.x < Root.z)
+        Root = vec3(Root.y, Root.x, Root.z);
+    else if (Root.z < Root.x && Root.z < Root.y)
+        Root = vec3(Root.x, Root.z, Root.y);
+
+    return Root;
+}
+
+// ellipse of the disk inscribed in the quad points, transformed by Minv in the shading frame:
+// center C, unit axes V1 and V2 of half-lengths E1 and E2, and normal V3 facing the shading point
+// returns false when a one-sided disk is seen from the back
+bool LTC_DiskEllipse(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided,
+    OUT(vec3) C, OUT(vec3) V1, OUT(vec3) V2, OUT(vec3) V3, OUT(float) E1, OUT(float) E2)
+{
+    // construct orthonormal basis around N
+    vec3 T1, T2;
+    T1 = normalize(V - N*dot(V, N));
+    T2 = cross(N, T1);
+
+    // rotate area light in (T1, T2, N) basis
+    mat3 R = transpose(mat3(T1, T2, N));
+
+    vec3 L_[3];
+    L_[0] = mul(R, points[0] - P);
+    L_[1] = mul(R, points[1] - P);
+    L_[2] = mul(R, points[2] - P);
+
+    // init ellipse
+    C  = 0.5f * (L_[0] + L_[2]);
+    V1 = 0.5f * (L_[1] - L_[2]);
+    V2 = 0.5f * (L_[1] - L_[0]);
+
+    C  = Minv * C;
+    V1 = Minv * V1;
+    V2 = Minv * V2;
+
+    if (!twoSided && dot(cross(V1, V2), C) < 0.0f)
+        return false;
+
+    // compute eigenvectors of ellipse
+    float a, b;
+    float d11 = dot(V1, V1);
+    float d22 = dot(V2, V2);
+    float d12 = dot(V1, V2);
+    if (abs(d12)/sqrt(d11*d22) > 0.0001f)
+    {
+        float tr = d11 + d22;
+        float det = -d12*d12 + d11*d22;
+
+        // use sqrt matrix to solve for eigenvalues
+        det = sqrt(det);
+        float u = 0.5f*sqrt(tr - 2.0f*det);
+        float v = 0.5f*sqrt(tr + 2.0f*det);
+        float e_max = sqr(u + v);
+        float e_min = sqr(u - v);
+
+        vec3 V1_, V2_;
+
+        if (d11 > d22)
+        {
+            V1_ = d12*V1 + (e_max - d11)*V2;
+            V2_ = d12*V1 + (e_min - d11)*V2;
+        }
+        else
+        {
+            V1_ = d12*V2 + (e_max - d22)*V1;
+            V2_ = d12*V2 + (e_min - d22)*V1;
+        }
+
+        a = 1.0f / e_max;
+        b = 1.0f / e_min;
+        V1 = normalize(V1_);
+        V2 = normalize(V2_);
+    }
+    else
+    {
+        a = 1.0f / dot(V1, V1);
+        b = 1.0f / dot(V2, V2);
+        V1 *= sqrt(a);
+        V2 *= sqrt(b);
+    }
+
+    V3 = cross(V1, V2);
+    if (dot(C, V3) < 0.0f)
+        V3 *= -1.0f;
+
+    E1 = inversesqrt(a);
+    E2 = inversesqrt(b);
+
+    return true;
+}
+
+// form factor of the ellipse from LTC_DiskEllipse(), clipped to the horizon with the sphere table (ltc_2.w)
+float LTC_DiskFormFactor(vec3 C, vec3 V1, vec3 V2, vec3 V3, float E1, float E2, sampler2D ltc_2)
+{
+    float L  = dot(V3, C);
+    float x0 = dot(V1, C) / L;
+    float y0 = dot(V2, C) / L;
+
+    float a = L*L/(E1*E1);
+    float b = L*L/(E2*E2);
+
+    float c0 = a*b;
+    float c1 = a*b*(1.0f + x0*x0 + y0*y0) - a - b;
+    float c2 = 1.0f - a*(1.0f + x0*x0) - b*(1.0f + y0*y0);
+    float c3 = 1.0f;
+
+    vec3 roots = SolveCubic(vec4(c0, c1, c2, c3));
+    float e1 = roots.x;
+    float e2 = roots.y;
+    float e3 = roots.z;
+
+    vec3 avgDir = vec3(a*x0/(a - e2), b*y0/(b - e2), 1.0f);
+
+    mat3 rotate = mat3_from_columns(V1, V2, V3);
+
+    avgDir = rotate*avgDir;
+    avgDir = normalize(avgDir);
+
+    float L1 = sqrt(-e2/e3);
+    float L2 = sqrt(-e2/e1);
+
+    float formFactor = L1*L2*inversesqrt((1.0f + L1*L1)*(1.0f + L2*L2));
+
+    // use tabulated horizon-clipped sphere
+    vec2 uv = vec2(avgDir.z*0.5f + 0.5f, formFactor);
+    uv = uv*LUT_SCALE + LUT_BIAS;
+    float scale = texture(ltc_2, uv).w;
+
+    return formFactor*scale;
+}
+
+// integral of the disk inscribed in the quad points against the LTC of Minv, at P
+float LTC_EvaluateDisk(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, sampler2D ltc_2)
+{
+    vec3 C, V1, V2, V3;
+    float E1, E2;
+    if (!LTC_DiskEllipse(N, V, P, Minv, points, twoSided, C, V1, V2, V3, E1, E2))
+        return 0.0f;
+
+    return LTC_DiskFormFactor(C, V1, V2, V3, E1, E2, ltc_2);
+}
@@ -0,0 +1,154 @@
+// Line and cylinder lights
+// requires ltc_common.glsl
+// the lights are segments p1 p2 in the shading frame, cylinders have radius R
+
+// code from [Frisvad2012]
+void buildOrthonormalBasis(vec3 n, OUT(vec3) b1, OUT(vec3) b2)
+{
+    if (n.z < -0.9999999f)
+    {
+        b1 = vec3( 0.0f, -1.0f, 0.0f);
+        b2 = vec3(-1.0f,  0.0f, 0.0f);
+        return;
+    }
+    float a = 1.0f / (1.0f + n.z);
+    float b = -n.x*n.y*a;
+    b1 = vec3(1.0f - n.x*n.x*a, b, -n.x);
+    b2 = vec3(b, 1.0f - n.y*n.y*a, -n.y);
+}
+
+// LTC distribution of Minv
+float D(vec3 w, mat3 Minv)
+{
+    vec3 wo = Minv * w;
+    float lo = length(wo);
+    float res = 1.0f/pi * max(0.0f, wo.z/lo) * abs(determinant(Minv)) / (lo*lo*lo);
+    return res;
+}
+
+float I_cylinder_numerical(vec3 p1, vec3 p2, float R, mat3 Minv)
+{
+    // init orthonormal basis
+    float L = length(p2 - p1);
+    vec3 wt = normalize(p2 - p1);
+    vec3 wt1, wt2;
+    buildOrthonormalBasis(wt, wt1, wt2);
+
+    // integral discretization
+    float I = 0.0f;
+    const int nSamplesphi = 20;
+    const int nSamplesl   = 100;
+    for (int i = 0; i < nSamplesphi; ++i)
+    for (int j = 0; j < nSamplesl;   ++j)
+    {
+        // normal
+        float phi = 2.0f * pi * float(i)/float(nSamplesphi);
+        vec3 wn = cos(phi)*wt1 + sin(phi)*wt2;
+
+        // position
+        float l = L * float(j)/float(nSamplesl - 1);
+        vec3 p = p1 + l*wt + R*wn;
+
+        // normalized direction
+        vec3 wp = normalize(p);
+
+        // integrate
+        I += D(wp, Minv) * max(0.0f, dot(-wp, wn)) / dot(p, p);
+    }
+
+    I *= 2.0f * pi * R * L / float(nSamplesphi*nSamplesl);
+    return I;
+}
+
+float Fpo(float d, float l)
+{
+    return l/(d*(d*d + l*l)) + atan(l/d)/(d*d);
+}
+
+float Fwt(float d, float l)
+{
+    return l*l/(d*(d*d + l*l));
+}
+
+float I_diffuse_line(vec3 p1, vec3 p2)
+{
+    // tangent
+    vec3 wt = normalize(p2 - p1);
+
+    // clamping
+    if (p1.z <= 0.0f && p2.z <= 0.0f) return 0.0f;
+    if (p1.z < 0.0f) p1 = (+p1*p2.z - p2*p1.z) / (+p2.z - p1.z);
+    if (p2.z < 0.0f) p2 = (-p1*p2.z + p2*p1.z) / (-p2.z + p1.z);
+
+    // parameterization
+    float l1 = dot(p1, wt);
+    float l2 = dot(p2, wt);
+
+    // shading point orthonormal projection on the line
+    vec3 po = p1 - l1*wt;
+
+    // distance to line
+    float d = length(po);
+
+    // integral
+    float I = (Fpo(d, l2) - Fpo(d, l1)) * po.z +
+              (Fwt(d, l2) - Fwt(d, l1)) * wt.z;
+    return I / pi;
+}
+
+float I_ltc_line(vec3 p1, vec3 p2, mat3 Minv)
+{
+    // transform to diffuse configuration
+    vec3 p1o = Minv * p1;
+    vec3 p2o = Minv * p2;
+    float I_diffuse = I_diffuse_line(p1o, p2o);
+
+    // width factor
+    vec3 ortho = normalize(cross(p1, p2));
+    float w =  1.0f / length(inverse(transpose(Minv)) * ortho);
+
+    return w * I_diffuse;
+}
+
+float I_disks_numerical(vec3 p1, vec3 p2, float R, mat3 Minv)
+{
+    // init orthonormal basis
+    vec3 wt = normalize(p2 - p1);
+    vec3 wt1, wt2;
+    buildOrthonormalBasis(wt, wt1, wt2);
+
+    // integration
+    float Idisks = 0.0f;
+    const int nSamplesphi = 20;
+    const int nSamplesr   = 200;
+    for (int i = 0; i < nSamplesphi; ++i)
+    for (int j = 0; j < nSamplesr;   ++j)
+    {
+        float phi = 2.0f * pi * float(i)/float(nSamplesphi);
+        float r = R * float(j)/float(nSamplesr - 1);
+        vec3 p, wp;
+
+        p = p1 + r * (cos(phi)*wt1 + sin(phi)*wt2);
+        wp = normalize(p);
+        Idisks += r * D(wp, Minv) * max(0.0f, dot(wp, +wt)) / dot(p, p);
+
+        p = p2 + r * (cos(phi)*wt1 + sin(phi)*wt2);
+        wp = normalize(p);
+        Idisks += r * D(wp, Minv) * max(0.0f, dot(wp, -wt)) / dot(p, p);
+    }
+
+    Idisks *= 2.0f * pi * R / float(nSamplesr*nSamplesphi);
+    return Idisks;
+}
+
+float I_ltc_disks(vec3 p1, vec3 p2, float R, mat3 Minv)
+{
+    float A = pi * R * R;
+    vec3 wt  = normalize(p2 - p1);
+    vec3 wp1 = normalize(p1);
+    vec3 wp2 = normalize(p2);
+    float Idisks = A * (
+    D(wp1, Minv) * max(0.0f, dot(+wt, wp1)) / dot(p1, p1) +
+    D(wp2, Minv) * max(0.0f, dot(-wt, wp2)) / dot(p2, p2));
+    return Idisks;
+}
@@ -0,0 +1,138 @@
+// Ray intersection with the light shapes
+// requires ltc_common.glsl
+// the functions return the nearest intersection at t > 0, the reference of the packets of fit/ltc_ray.h
+
+struct Ray
+{
+    vec3 origin;
+    vec3 dir;
+};
+
+bool RayPlaneIntersect(Ray ray, vec4 plane, OUT(float) t)
+{
+    t = -dot(plane, vec4(ray.origin, 1.0f))/dot(vec3(plane.x, plane.y, plane.z), ray.dir);
+    return t > 0.0f;
+}
+
+// roots of a t^2 + b t + c, t0 = t1 when the discriminant is 0
+bool SolveQuadratic(float a, float b, float c, OUT(float) t0, OUT(float) t1)
+{
+    float d = b*b - 4.0f*a*c;
+    if (d < 0.0f)
+        return false;
+
+    // stable form, without the cancellation of -b + sqrt(d)
+    float q = b < 0.0f ? -0.5f*(b - sqrt(d)) : -0.5f*(b + sqrt(d));
+    t0 = min(q/a, c/q);
+    t1 = max(q/a, c/q);
+    return true;
+}
+
+// rectangle of half sizes halfx and halfy along the orthonormal dirx and diry
+bool RayRectIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return abs(x) <= halfx && abs(y) <= halfy;
+}
+
+// ellipse of half axes halfx and halfy along the orthonormal dirx and diry, disks have halfx = halfy
+bool RayDiskIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return sqr(x/halfx) + sqr(y/halfy) <= 1.0f;
+}
+
+bool RaySphereIntersect(Ray ray, vec3 center, float R, OUT(float) t)
+{
+    vec3 o = ray.origin - center;
+
+    float t0, t1;
+    if (!SolveQuadratic(dot(ray.dir, ray.dir), 2.0f*dot(ray.dir, o), dot(o, o) - R*R, t0, t1))
+        return false;
+
+    t = t0 > 0.0f ? t0 : t1;
+    return t > 0.0f;
+}
+
+// cylinder of axis p1 p2 and radius R, closed by disks with endCaps
+bool RayCylinderIntersect(Ray ray, vec3 p1, vec3 p2, float R, bool endCaps, OUT(float) t)
+{
+    float len = length(p2 - p1);
+    vec3 axis = (p2 - p1)/len;
+
+    // ray along the axis (s) and orthogonal to it (op + t dp)
+    vec3 o = ray.origin - p1;
+    float os = dot(o, axis);
+    float ds = dot(ray.dir, axis);
+    vec3 op = o - axis*os;
+    vec3 dp = ray.dir - axis*ds;
+
+    bool hit = false;
+
+    float t0, t1;
+    if (SolveQuadratic(dot(dp, dp), 2.0f*dot(dp, op), dot(op, op) - R*R, t0, t1))
+    {
+        float s0 = os + t0*ds;
+        float s1 = os + t1*ds;
+        if (t0 > 0.0f && s0 >= 0.0f && s0 <= len)
+        {
+            t = t0;
+            hit = true;
+        }
+        else if (t1 > 0.0f && s1 >= 0.0f && s1 <= len)
+        {
+            t = t1;
+            hit = true;
+        }
+    }
+
+    if (endCaps && abs(ds) > 1e-7f)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            float tc = ((i == 0 ? 0.0f : len) - os)/ds;
+            vec3 q = op + tc*dp;
+            if (tc > 0.0f && dot(q, q) <= R*R && (!hit || tc < t))
+            {
+                t = tc;
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+// capsule of axis p1 p2 and radius R: the open cylinder and the spheres at both ends
+bool RayCapsuleIntersect(Ray ray, vec3 p1, vec3 p2, float R, OUT(float) t)
+{
+    bool hit = RayCylinderIntersect(ray, p1, p2, R, false, t);
+
+    float ts;
+    if (RaySphereIntersect(ray, p1, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+    if (RaySphereIntersect(ray, p2, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+
+    return hit;
+}
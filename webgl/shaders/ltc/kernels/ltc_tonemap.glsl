@@ -0,0 +1,50 @@
+// Display transform of the demos (ltc_blit.fs) and of the CPU image output (fit/image_output.h)
+// requires ltc_common.glsl
+
+// fit of the ACES reference rendering and output device transforms
+vec3 rrt_odt_fit(vec3 v)
+{
+    vec3 a = v*(          v + 0.0245786f) - 0.000090537f;
+    vec3 b = v*(0.983729f*v + 0.4329510f) + 0.238081f;
+    return a/b;
+}
+
+mat3 mat3_from_rows(vec3 c0, vec3 c1, vec3 c2)
+{
+    mat3 m = mat3(c0, c1, c2);
+    m = transpose(m);
+
+    return m;
+}
+
+vec3 saturate(vec3 v)
+{
+    return vec3(saturate(v.x), saturate(v.y), saturate(v.z));
+}
+
+vec3 aces_fitted(vec3 color)
+{
+    mat3 ACES_INPUT_MAT = mat3_from_rows(
+        vec3( 0.59719f, 0.35458f, 0.04823f),
+        vec3( 0.07600f, 0.90834f, 0.01566f),
+        vec3( 0.02840f, 0.13383f, 0.83777f));
+
+    mat3 ACES_OUTPUT_MAT = mat3_from_rows(
+        vec3( 1.60475f,-0.53108f,-0.07367f),
+        vec3(-0.10208f, 1.10813f,-0.00605f),
+        vec3(-0.00327f,-0.07276f, 1.07602f));
+
+    color = mul(ACES_INPUT_MAT, color);
+
+    // Apply RRT and ODT
+    color = rrt_odt_fit(color);
+
+    color = mul(ACES_OUTPUT_MAT, color);
+
+    // Clamp to [0, 1]
+    color = saturate(color);
+
+    return color;
+}
+
+vec3 ToSRGB(vec3 v) { return PowVec3(v, 1.0f/gamma); }
@@ -1,36 +1,121 @@
+// generated by fit/tools/shaderGen from src/ltc_blit.fs and the kernels it includes, edit those instead
 
 uniform vec2 resolution;
 
 uniform sampler2D tex;
 
-vec3 rrt_odt_fit(vec3 v)
+// Kernels shared by the demos and the C++ code (fit/ltc_kernels.h)
+// written in the common subset of GLSL ES 3.00 and C++ described in fit/glsl.h
+
+#ifndef LTC_KERNELS_CPP
+#define OUT(T) out T
+#define INOUT(T) inout T
+#define OUT_ARRAY(T) out T
+#define INOUT_ARRAY(T) inout T
+#endif
+
+const float pi = 3.14159265f;
+
+const float LUT_SIZE  = 64.0f;
+const float LUT_SCALE = (LUT_SIZE - 1.0f)/LUT_SIZE;
+const float LUT_BIAS  = 0.5f/LUT_SIZE;
+
+// Matrix functions
+///////////////////
+
+vec3 mul(mat3 m, vec3 v)
 {
-    vec3 a = v*(         v + 0.0245786) - 0.000090537;
-    vec3 b = v*(0.983729*v + 0.4329510) + 0.238081;
-    return a/b;
+    return m * v;
 }
 
-mat3 mat3_from_rows(vec3 c0, vec3 c1, vec3 c2)
+mat3 mul(mat3 m1, mat3 m2)
 {
-    mat3 m = mat3(c0, c1, c2);
-    m = transpose(m);
+    return m1 * m2;
+}
 
+vec3 rotation_y(vec3 v, float a)
+{
+    vec3 r;
+    r.x =  v.x*cos(a) + v.z*sin(a);
+    r.y =  v.y;
+    r.z = -v.x*sin(a) + v.z*cos(a);
+    return r;
+}
+
+vec3 rotation_z(vec3 v, float a)
+{
+    vec3 r;
+    r.x =  v.x*cos(a) - v.y*sin(a);
+    r.y =  v.x*sin(a) + v.y*cos(a);
+    r.z =  v.z;
+    return r;
+}
+
+vec3 rotation_yz(vec3 v, float ay, float az)
+{
+    return rotation_z(rotation_y(v, ay), az);
+}
+
+mat3 mat3_from_columns(vec3 c0, vec3 c1, vec3 c2)
+{
+    mat3 m = mat3(c0, c1, c2);
     return m;
 }
 
-vec3 mul(mat3 m, vec3 v)
+float sqr(float x) { return x*x; }
+
+// Table lookups
+////////////////
+
+// texture coordinates of the fitted tables for (roughness, cos(theta))
+vec2 LTC_Coords(float roughness, float ndotv)
 {
-    return m * v;
+    vec2 uv = vec2(roughness, sqrt(1.0f - ndotv));
+    return uv*LUT_SCALE + LUT_BIAS;
 }
 
-mat3 mul(mat3 m1, mat3 m2)
+// inverse LTC matrix from the first table
+mat3 LTC_Matrix(vec4 t1)
 {
-    return m1 * m2;
+    return mat3(
+        vec3(t1.x, 0, t1.y),
+        vec3(   0, 1,    0),
+        vec3(t1.z, 0, t1.w)
+    );
 }
 
+// Misc. helpers
+////////////////
+
 float saturate(float v)
 {
-    return clamp(v, 0.0, 1.0);
+    return clamp(v, 0.0f, 1.0f);
+}
+
+vec3 PowVec3(vec3 v, float p)
+{
+    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
+}
+
+const float gamma = 2.2f;
+vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
+// Display transform of the demos (ltc_blit.fs) and of the CPU image output (fit/image_output.h)
+// requires ltc_common.glsl
+
+// fit of the ACES reference rendering and output device transforms
+vec3 rrt_odt_fit(vec3 v)
+{
+    vec3 a = v*(          v + 0.0245786f) - 0.000090537f;
+    vec3 b = v*(0.983729f*v + 0.4329510f) + 0.238081f;
+    return a/b;
+}
+
+mat3 mat3_from_rows(vec3 c0, vec3 c1, vec3 c2)
+{
+    mat3 m = mat3(c0, c1, c2);
+    m = transpose(m);
+
+    return m;
 }
 
 vec3 saturate(vec3 v)
@@ -41,14 +126,14 @@ vec3 saturate(vec3 v)
 vec3 aces_fitted(vec3 color)
 {
     mat3 ACES_INPUT_MAT = mat3_from_rows(
-        vec3( 0.59719, 0.35458, 0.04823),
-        vec3( 0.07600, 0.90834, 0.01566),
-        vec3( 0.02840, 0.13383, 0.83777));
+        vec3( 0.59719f, 0.35458f, 0.04823f),
+        vec3( 0.07600f, 0.90834f, 0.01566f),
+        vec3( 0.02840f, 0.13383f, 0.83777f));
 
     mat3 ACES_OUTPUT_MAT = mat3_from_rows(
-        vec3( 1.60475,-0.53108,-0.07367),
-        vec3(-0.10208, 1.10813,-0.00605),
-        vec3(-0.00327,-0.07276, 1.07602));
+        vec3( 1.60475f,-0.53108f,-0.07367f),
+        vec3(-0.10208f, 1.10813f,-0.00605f),
+        vec3(-0.00327f,-0.07276f, 1.07602f));
 
     color = mul(ACES_INPUT_MAT, color);
 
@@ -63,13 +148,7 @@ vec3 aces_fitted(vec3 color)
     return color;
 }
 
-vec3 PowVec3(vec3 v, float p)
-{
-    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
-}
-
-const float gamma = 2.2;
-vec3 ToSRGB(vec3 v) { return PowVec3(v, 1.0/gamma); }
+vec3 ToSRGB(vec3 v) { return PowVec3(v, 1.0f/gamma); }
 
 out vec4 FragColor;
 
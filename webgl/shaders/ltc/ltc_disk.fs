@@ -1,3 +1,5 @@
+// generated by fit/tools/shaderGen from src/ltc_disk.fs and the kernels it includes, edit those instead
+
 // bind roughness   {label:"Roughness", default:0.25, min:0.001, max:1, step:0.001}
 // bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
 // bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
@@ -30,84 +32,24 @@ uniform mat4  view;
 uniform vec2  resolution;
 uniform int   sampleCount;
 
-const float LUT_SIZE  = 64.0;
-const float LUT_SCALE = (LUT_SIZE - 1.0)/LUT_SIZE;
-const float LUT_BIAS  = 0.5/LUT_SIZE;
-
 const int   NUM_SAMPLES = 1;
-const float pi = 3.14159265;
 const float NO_HIT = 1e9;
 
-// Tracing and intersection
-///////////////////////////
+// Kernels shared by the demos and the C++ code (fit/ltc_kernels.h)
+// written in the common subset of GLSL ES 3.00 and C++ described in fit/glsl.h
 
-struct Ray
-{
-    vec3 origin;
-    vec3 dir;
-};
+#ifndef LTC_KERNELS_CPP
+#define OUT(T) out T
+#define INOUT(T) inout T
+#define OUT_ARRAY(T) out T
+#define INOUT_ARRAY(T) inout T
+#endif
 
-struct Disk
-{
-    vec3  center;
-    vec3  dirx;
-    vec3  diry;
-    float halfx;
-    float halfy;
+const float pi = 3.14159265f;
 
-    vec4  plane;
-};
-
-float RayPlaneIntersect(Ray ray, vec4 plane)
-{
-    float t = -dot(plane, vec4(ray.origin, 1.0))/dot(plane.xyz, ray.dir);
-    return (t > 0.0) ? t : NO_HIT;
-}
-
-float sqr(float x) { return x*x; }
-
-float RayDiskIntersect(Ray ray, Disk disk)
-{
-    float t = RayPlaneIntersect(ray, disk.plane);
-    if (t != NO_HIT)
-    {
-        vec3 pos  = ray.origin + ray.dir*t;
-        vec3 lpos = pos - disk.center;
-
-        float x = dot(lpos, disk.dirx);
-        float y = dot(lpos, disk.diry);
-
-        if (sqr(x/disk.halfx) + sqr(y/disk.halfy) > 1.0)
-            t = NO_HIT;
-    }
-
-    return t;
-}
-
-// Camera functions
-///////////////////
-
-Ray GenerateCameraRay()
-{
-    Ray ray;
-
-    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
-
-    ray.dir = normalize(vec3(xy, 2.0));
-
-    float focalDistance = 2.0;
-    float ft = focalDistance/ray.dir.z;
-    vec3 pFocus = ray.dir*ft;
-
-    ray.origin = vec3(0);
-    ray.dir    = normalize(pFocus - ray.origin);
-
-    // Apply camera transform
-    ray.origin = (view*vec4(ray.origin, 1)).xyz;
-    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
-
-    return ray;
-}
+const float LUT_SIZE  = 64.0f;
+const float LUT_SCALE = (LUT_SIZE - 1.0f)/LUT_SIZE;
+const float LUT_BIAS  = 0.5f/LUT_SIZE;
 
 // Matrix functions
 ///////////////////
@@ -151,73 +93,45 @@ mat3 mat3_from_columns(vec3 c0, vec3 c1, vec3 c2)
     return m;
 }
 
-// Sample generation
-////////////////////
-
-float Halton(int index, float base)
-{
-    float result = 0.0;
-    float f = 1.0/base;
-    float i = float(index);
-    for (int x = 0; x < 8; x++)
-    {
-        if (i <= 0.0) break;
-
-        result += f*mod(i, base);
-        i = floor(i/base);
-        f = f/base;
-    }
+float sqr(float x) { return x*x; }
 
-    return result;
-}
+// Table lookups
+////////////////
 
-void Halton2D(out vec2 s[NUM_SAMPLES], int offset)
+// texture coordinates of the fitted tables for (roughness, cos(theta))
+vec2 LTC_Coords(float roughness, float ndotv)
 {
-    for (int i = 0; i < NUM_SAMPLES; i++)
-    {
-        s[i].x = Halton(i + offset, 2.0);
-        s[i].y = Halton(i + offset, 3.0);
-    }
+    vec2 uv = vec2(roughness, sqrt(1.0f - ndotv));
+    return uv*LUT_SCALE + LUT_BIAS;
 }
 
-// TODO: replace this
-float rand(vec2 co)
+// inverse LTC matrix from the first table
+mat3 LTC_Matrix(vec4 t1)
 {
-    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    return mat3(
+        vec3(t1.x, 0, t1.y),
+        vec3(   0, 1,    0),
+        vec3(t1.z, 0, t1.w)
+    );
 }
 
-// Scene helpers
+// Misc. helpers
 ////////////////
 
-Disk InitDisk(vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy)
+float saturate(float v)
 {
-    Disk disk;
-
-    disk.center = center;
-    disk.dirx   = dirx;
-    disk.diry   = diry;
-    disk.halfx  = halfx;
-    disk.halfy  = halfy;
-
-    vec3 diskNormal = cross(disk.dirx, disk.diry);
-    disk.plane = vec4(diskNormal, -dot(diskNormal, disk.center));
-
-    return disk;
+    return clamp(v, 0.0f, 1.0f);
 }
 
-void InitDiskPoints(Disk disk, out vec3 points[4])
+vec3 PowVec3(vec3 v, float p)
 {
-    vec3 ex = disk.halfx*disk.dirx;
-    vec3 ey = disk.halfy*disk.diry;
-
-    points[0] = disk.center - ex - ey;
-    points[1] = disk.center + ex - ey;
-    points[2] = disk.center + ex + ey;
-    points[3] = disk.center - ex + ey;
+    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
 }
 
-// Misc.
-////////
+const float gamma = 2.2f;
+vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
+// Disk lights
+// requires ltc_common.glsl
 
 // An extended version of the implementation from
 // "How to solve a cubic equation, revisited"
@@ -225,9 +139,12 @@ void InitDiskPoints(Disk disk, out vec3 points[4])
 vec3 SolveCubic(vec4 Coefficient)
 {
     // Normalize the polynomial
-    Coefficient.xyz /= Coefficient.w;
+    Coefficient.x /= Coefficient.w;
+    Coefficient.y /= Coefficient.w;
+    Coefficient.z /= Coefficient.w;
     // Divide middle coefficients by three
-    Coefficient.yz /= 3.0;
+    Coefficient.y /= 3.0f;
+    Coefficient.z /= 3.0f;
 
     float A = Coefficient.w;
     float B = Coefficient.z;
@@ -238,29 +155,27 @@ vec3 SolveCubic(vec4 Coefficient)
     vec3 Delta = vec3(
         -Coefficient.z*Coefficient.z + Coefficient.y,
         -Coefficient.y*Coefficient.z + Coefficient.x,
-        dot(vec2(Coefficient.z, -Coefficient.y), Coefficient.xy)
+        Coefficient.z*Coefficient.x - Coefficient.y*Coefficient.y
     );
 
-    float Discriminant = dot(vec2(4.0*Delta.x, -Delta.y), Delta.zy);
-
-    vec3 RootsA, RootsD;
+    // three real roots, the discriminant and -C_a, -C_d below are only negative by rounding (tiny or distant disks)
+    float Discriminant = max(4.0f*Delta.x*Delta.z - Delta.y*Delta.y, 0.0f);
 
     vec2 xlc, xsc;
 
     // Algorithm A
     {
-        float A_a = 1.0;
-        float C_a = Delta.x;
-        float D_a = -2.0*B*Delta.x + Delta.y;
+        float C_a = min(Delta.x, 0.0f);
+        float D_a = -2.0f*B*Delta.x + Delta.y;
 
         // Take the cubic root of a normalized complex number
-        float Theta = atan(sqrt(Discriminant), -D_a)/3.0;
+        float Theta = atan(sqrt(Discriminant), -D_a)/3.0f;
 
-        float x_1a = 2.0*sqrt(-C_a)*cos(Theta);
-        float x_3a = 2.0*sqrt(-C_a)*cos(Theta + (2.0/3.0)*pi);
+        float x_1a = 2.0f*sqrt(-C_a)*cos(Theta);
+        float x_3a = 2.0f*sqrt(-C_a)*cos(Theta + (2.0f/3.0f)*pi);
 
         float xl;
-        if ((x_1a + x_3a) > 2.0*B)
+        if ((x_1a + x_3a) > 2.0f*B)
             xl = x_1a;
         else
             xl = x_3a;
@@ -270,18 +185,17 @@ vec3 SolveCubic(vec4 Coefficient)
 
     // Algorithm D
     {
-        float A_d = D;
-        float C_d = Delta.z;
-        float D_d = -D*Delta.y + 2.0*C*Delta.z;
+        float C_d = min(Delta.z, 0.0f);
+        float D_d = -D*Delta.y + 2.0f*C*Delta.z;
 
         // Take the cubic root of a normalized complex number
-        float Theta = atan(D*sqrt(Discriminant), -D_d)/3.0;
+        float Theta = atan(D*sqrt(Discriminant), -D_d)/3.0f;
 
-        float x_1d = 2.0*sqrt(-C_d)*cos(Theta);
-        float x_3d = 2.0*sqrt(-C_d)*cos(Theta + (2.0/3.0)*pi);
+        float x_1d = 2.0f*sqrt(-C_d)*cos(Theta);
+        float x_3d = 2.0f*sqrt(-C_d)*cos(Theta + (2.0f/3.0f)*pi);
 
         float xs;
-        if (x_1d + x_3d < 2.0*C)
+        if (x_1d + x_3d < 2.0f*C)
             xs = x_1d;
         else
             xs = x_3d;
@@ -298,18 +212,19 @@ vec3 SolveCubic(vec4 Coefficient)
     vec3 Root = vec3(xsc.x/xsc.y, xmc.x/xmc.y, xlc.x/xlc.y);
 
     if (Root.x < Root.y && Root.x < Root.z)
-        Root.xyz = Root.yxz;
+        Root = vec3(Root.y, Root.x, Root.z);
     else if (Root.z < Root.x && Root.z < Root.y)
-        Root.xyz = Root.xzy;
+        Root = vec3(Root.x, Root.z, Root.y);
 
     return Root;
 }
 
-// Linearly Transformed Cosines
-///////////////////////////////
-
-vec3 LTC_Evaluate(
-    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, float u1, float u2)
+// ellipse of the disk inscribed in the quad points, transformed by Minv in the shading frame:
+// center C, unit axes V1 and V2 of half-lengths E1 and E2, and normal V3 facing the shading point
+// returns false when a one-sided disk is seen from the back
+bool LTC_DiskEllipse(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided,
+    OUT(vec3) C, OUT(vec3) V1, OUT(vec3) V2, OUT(vec3) V3, OUT(float) E1, OUT(float) E2)
 {
     // construct orthonormal basis around N
     vec3 T1, T2;
@@ -319,40 +234,37 @@ vec3 LTC_Evaluate(
     // rotate area light in (T1, T2, N) basis
     mat3 R = transpose(mat3(T1, T2, N));
 
-    // polygon (allocate 5 vertices for clipping)
     vec3 L_[3];
     L_[0] = mul(R, points[0] - P);
     L_[1] = mul(R, points[1] - P);
     L_[2] = mul(R, points[2] - P);
 
-    vec3 Lo_i = vec3(0);
-
     // init ellipse
-    vec3 C  = 0.5 * (L_[0] + L_[2]);
-    vec3 V1 = 0.5 * (L_[1] - L_[2]);
-    vec3 V2 = 0.5 * (L_[1] - L_[0]);
+    C  = 0.5f * (L_[0] + L_[2]);
+    V1 = 0.5f * (L_[1] - L_[2]);
+    V2 = 0.5f * (L_[1] - L_[0]);
 
     C  = Minv * C;
     V1 = Minv * V1;
     V2 = Minv * V2;
 
-    if(!twoSided && dot(cross(V1, V2), C) < 0.0)
-        return vec3(0.0);
+    if (!twoSided && dot(cross(V1, V2), C) < 0.0f)
+        return false;
 
     // compute eigenvectors of ellipse
     float a, b;
     float d11 = dot(V1, V1);
     float d22 = dot(V2, V2);
     float d12 = dot(V1, V2);
-    if (abs(d12)/sqrt(d11*d22) > 0.0001)
+    if (abs(d12)/sqrt(d11*d22) > 0.0001f)
     {
         float tr = d11 + d22;
         float det = -d12*d12 + d11*d22;
 
         // use sqrt matrix to solve for eigenvalues
         det = sqrt(det);
-        float u = 0.5*sqrt(tr - 2.0*det);
-        float v = 0.5*sqrt(tr + 2.0*det);
+        float u = 0.5f*sqrt(tr - 2.0f*det);
+        float v = 0.5f*sqrt(tr + 2.0f*det);
         float e_max = sqr(u + v);
         float e_min = sqr(u - v);
 
@@ -369,44 +281,50 @@ vec3 LTC_Evaluate(
             V2_ = d12*V2 + (e_min - d22)*V1;
         }
 
-        a = 1.0 / e_max;
-        b = 1.0 / e_min;
+        a = 1.0f / e_max;
+        b = 1.0f / e_min;
         V1 = normalize(V1_);
         V2 = normalize(V2_);
     }
     else
     {
-        a = 1.0 / dot(V1, V1);
-        b = 1.0 / dot(V2, V2);
+        a = 1.0f / dot(V1, V1);
+        b = 1.0f / dot(V2, V2);
         V1 *= sqrt(a);
         V2 *= sqrt(b);
     }
 
-    vec3 V3 = cross(V1, V2);
-    if (dot(C, V3) < 0.0)
-        V3 *= -1.0;
+    V3 = cross(V1, V2);
+    if (dot(C, V3) < 0.0f)
+        V3 *= -1.0f;
 
+    E1 = inversesqrt(a);
+    E2 = inversesqrt(b);
+
+    return true;
+}
+
+// form factor of the ellipse from LTC_DiskEllipse(), clipped to the horizon with the sphere table (ltc_2.w)
+float LTC_DiskFormFactor(vec3 C, vec3 V1, vec3 V2, vec3 V3, float E1, float E2, sampler2D ltc_2)
+{
     float L  = dot(V3, C);
     float x0 = dot(V1, C) / L;
     float y0 = dot(V2, C) / L;
 
-    float E1 = inversesqrt(a);
-    float E2 = inversesqrt(b);
-
-    a *= L*L;
-    b *= L*L;
+    float a = L*L/(E1*E1);
+    float b = L*L/(E2*E2);
 
     float c0 = a*b;
-    float c1 = a*b*(1.0 + x0*x0 + y0*y0) - a - b;
-    float c2 = 1.0 - a*(1.0 + x0*x0) - b*(1.0 + y0*y0);
-    float c3 = 1.0;
+    float c1 = a*b*(1.0f + x0*x0 + y0*y0) - a - b;
+    float c2 = 1.0f - a*(1.0f + x0*x0) - b*(1.0f + y0*y0);
+    float c3 = 1.0f;
 
     vec3 roots = SolveCubic(vec4(c0, c1, c2, c3));
     float e1 = roots.x;
     float e2 = roots.y;
     float e3 = roots.z;
 
-    vec3 avgDir = vec3(a*x0/(a - e2), b*y0/(b - e2), 1.0);
+    vec3 avgDir = vec3(a*x0/(a - e2), b*y0/(b - e2), 1.0f);
 
     mat3 rotate = mat3_from_columns(V1, V2, V3);
 
@@ -416,14 +334,295 @@ vec3 LTC_Evaluate(
     float L1 = sqrt(-e2/e3);
     float L2 = sqrt(-e2/e1);
 
-    float formFactor = L1*L2*inversesqrt((1.0 + L1*L1)*(1.0 + L2*L2));
+    float formFactor = L1*L2*inversesqrt((1.0f + L1*L1)*(1.0f + L2*L2));
 
     // use tabulated horizon-clipped sphere
-    vec2 uv = vec2(avgDir.z*0.5 + 0.5, formFactor);
+    vec2 uv = vec2(avgDir.z*0.5f + 0.5f, formFactor);
     uv = uv*LUT_SCALE + LUT_BIAS;
     float scale = texture(ltc_2, uv).w;
 
-    float spec = formFactor*scale;
+    return formFactor*scale;
+}
+
+// integral of the disk inscribed in the quad points against the LTC of Minv, at P
+float LTC_EvaluateDisk(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, sampler2D ltc_2)
+{
+    vec3 C, V1, V2, V3;
+    float E1, E2;
+    if (!LTC_DiskEllipse(N, V, P, Minv, points, twoSided, C, V1, V2, V3, E1, E2))
+        return 0.0f;
+
+    return LTC_DiskFormFactor(C, V1, V2, V3, E1, E2, ltc_2);
+}
+// Ray intersection with the light shapes
+// requires ltc_common.glsl
+// the functions return the nearest intersection at t > 0, the reference of the packets of fit/ltc_ray.h
+
+struct Ray
+{
+    vec3 origin;
+    vec3 dir;
+};
+
+bool RayPlaneIntersect(Ray ray, vec4 plane, OUT(float) t)
+{
+    t = -dot(plane, vec4(ray.origin, 1.0f))/dot(vec3(plane.x, plane.y, plane.z), ray.dir);
+    return t > 0.0f;
+}
+
+// roots of a t^2 + b t + c, t0 = t1 when the discriminant is 0
+bool SolveQuadratic(float a, float b, float c, OUT(float) t0, OUT(float) t1)
+{
+    float d = b*b - 4.0f*a*c;
+    if (d < 0.0f)
+        return false;
+
+    // stable form, without the cancellation of -b + sqrt(d)
+    float q = b < 0.0f ? -0.5f*(b - sqrt(d)) : -0.5f*(b + sqrt(d));
+    t0 = min(q/a, c/q);
+    t1 = max(q/a, c/q);
+    return true;
+}
+
+// rectangle of half sizes halfx and halfy along the orthonormal dirx and diry
+bool RayRectIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return abs(x) <= halfx && abs(y) <= halfy;
+}
+
+// ellipse of half axes halfx and halfy along the orthonormal dirx and diry, disks have halfx = halfy
+bool RayDiskIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return sqr(x/halfx) + sqr(y/halfy) <= 1.0f;
+}
+
+bool RaySphereIntersect(Ray ray, vec3 center, float R, OUT(float) t)
+{
+    vec3 o = ray.origin - center;
+
+    float t0, t1;
+    if (!SolveQuadratic(dot(ray.dir, ray.dir), 2.0f*dot(ray.dir, o), dot(o, o) - R*R, t0, t1))
+        return false;
+
+    t = t0 > 0.0f ? t0 : t1;
+    return t > 0.0f;
+}
+
+// cylinder of axis p1 p2 and radius R, closed by disks with endCaps
+bool RayCylinderIntersect(Ray ray, vec3 p1, vec3 p2, float R, bool endCaps, OUT(float) t)
+{
+    float len = length(p2 - p1);
+    vec3 axis = (p2 - p1)/len;
+
+    // ray along the axis (s) and orthogonal to it (op + t dp)
+    vec3 o = ray.origin - p1;
+    float os = dot(o, axis);
+    float ds = dot(ray.dir, axis);
+    vec3 op = o - axis*os;
+    vec3 dp = ray.dir - axis*ds;
+
+    bool hit = false;
+
+    float t0, t1;
+    if (SolveQuadratic(dot(dp, dp), 2.0f*dot(dp, op), dot(op, op) - R*R, t0, t1))
+    {
+        float s0 = os + t0*ds;
+        float s1 = os + t1*ds;
+        if (t0 > 0.0f && s0 >= 0.0f && s0 <= len)
+        {
+            t = t0;
+            hit = true;
+        }
+        else if (t1 > 0.0f && s1 >= 0.0f && s1 <= len)
+        {
+            t = t1;
+            hit = true;
+        }
+    }
+
+    if (endCaps && abs(ds) > 1e-7f)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            float tc = ((i == 0 ? 0.0f : len) - os)/ds;
+            vec3 q = op + tc*dp;
+            if (tc > 0.0f && dot(q, q) <= R*R && (!hit || tc < t))
+            {
+                t = tc;
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+// capsule of axis p1 p2 and radius R: the open cylinder and the spheres at both ends
+bool RayCapsuleIntersect(Ray ray, vec3 p1, vec3 p2, float R, OUT(float) t)
+{
+    bool hit = RayCylinderIntersect(ray, p1, p2, R, false, t);
+
+    float ts;
+    if (RaySphereIntersect(ray, p1, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+    if (RaySphereIntersect(ray, p2, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+
+    return hit;
+}
+
+// Tracing and intersection
+///////////////////////////
+
+struct Disk
+{
+    vec3  center;
+    vec3  dirx;
+    vec3  diry;
+    float halfx;
+    float halfy;
+
+    vec4  plane;
+};
+
+// distances to the floor and the disk, NO_HIT when they are missed
+float RayPlaneDistance(Ray ray, vec4 plane)
+{
+    float t;
+    return RayPlaneIntersect(ray, plane, t) ? t : NO_HIT;
+}
+
+float RayDiskDistance(Ray ray, Disk disk)
+{
+    float t;
+    return RayDiskIntersect(ray, disk.center, disk.dirx, disk.diry, disk.halfx, disk.halfy, t) ? t : NO_HIT;
+}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
+
+// Sample generation
+////////////////////
+
+float Halton(int index, float base)
+{
+    float result = 0.0;
+    float f = 1.0/base;
+    float i = float(index);
+    for (int x = 0; x < 8; x++)
+    {
+        if (i <= 0.0) break;
+
+        result += f*mod(i, base);
+        i = floor(i/base);
+        f = f/base;
+    }
+
+    return result;
+}
+
+void Halton2D(out vec2 s[NUM_SAMPLES], int offset)
+{
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        s[i].x = Halton(i + offset, 2.0);
+        s[i].y = Halton(i + offset, 3.0);
+    }
+}
+
+// TODO: replace this
+float rand(vec2 co)
+{
+    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+// Scene helpers
+////////////////
+
+Disk InitDisk(vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy)
+{
+    Disk disk;
+
+    disk.center = center;
+    disk.dirx   = dirx;
+    disk.diry   = diry;
+    disk.halfx  = halfx;
+    disk.halfy  = halfy;
+
+    vec3 diskNormal = cross(disk.dirx, disk.diry);
+    disk.plane = vec4(diskNormal, -dot(diskNormal, disk.center));
+
+    return disk;
+}
+
+void InitDiskPoints(Disk disk, out vec3 points[4])
+{
+    vec3 ex = disk.halfx*disk.dirx;
+    vec3 ey = disk.halfy*disk.diry;
+
+    points[0] = disk.center - ex - ey;
+    points[1] = disk.center + ex - ey;
+    points[2] = disk.center + ex + ey;
+    points[3] = disk.center - ex + ey;
+}
+
+// Linearly Transformed Cosines
+///////////////////////////////
+
+vec3 LTC_Evaluate(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, float u1, float u2)
+{
+    vec3 C, V1, V2, V3;
+    float E1, E2;
+    if (!LTC_DiskEllipse(N, V, P, Minv, points, twoSided, C, V1, V2, V3, E1, E2))
+        return vec3(0.0);
+
+    float spec = LTC_DiskFormFactor(C, V1, V2, V3, E1, E2, ltc_2);
 
     if (groundTruth)
     {
@@ -472,7 +671,7 @@ vec3 LTC_Evaluate(
             vec3 diskNormal = V3;
             disk.plane = vec4(diskNormal, -dot(diskNormal, disk.center));
 
-            float distToDisk = RayDiskIntersect(ray, disk);
+            float distToDisk = RayDiskDistance(ray, disk);
             bool  intersect  = distToDisk != NO_HIT;
 
             float cosTheta = max(dir.z, 0.0);
@@ -494,27 +693,9 @@ vec3 LTC_Evaluate(
         }
     }
 
-    Lo_i = vec3(spec, spec, spec);
-
-    return vec3(Lo_i);
-}
-
-// Misc. helpers
-////////////////
-
-float saturate(float v)
-{
-    return clamp(v, 0.0, 1.0);
-}
-
-vec3 PowVec3(vec3 v, float p)
-{
-    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
+    return vec3(spec, spec, spec);
 }
 
-const float gamma = 2.2;
-vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
-
 out vec4 FragColor;
 
 void main()
@@ -543,7 +724,7 @@ void main()
 
     Ray ray = GenerateCameraRay();
 
-    float dist = RayPlaneIntersect(ray, floorPlane);
+    float dist = RayPlaneDistance(ray, floorPlane);
 
     vec2 seq[NUM_SAMPLES];
     Halton2D(seq, sampleCount);
@@ -565,17 +746,12 @@ void main()
         vec3 V = -ray.dir;
 
         float ndotv = saturate(dot(N, V));
-        vec2 uv = vec2(roughness, sqrt(1.0 - ndotv));
-        uv = uv*LUT_SCALE + LUT_BIAS;
+        vec2 uv = LTC_Coords(roughness, ndotv);
 
         vec4 t1 = texture(ltc_1, uv);
         vec4 t2 = texture(ltc_2, uv);
 
-        mat3 Minv = mat3(
-            vec3(t1.x, 0, t1.y),
-            vec3(  0,  1,    0),
-            vec3(t1.z, 0, t1.w)
-        );
+        mat3 Minv = LTC_Matrix(t1);
 
         vec3 spec = LTC_Evaluate(N, V, pos, Minv, points, twoSided, u1, u2);
         // BRDF shadowing and Fresnel
@@ -586,7 +762,7 @@ void main()
         col = lcol*(spec + dcol*diff);
     }
 
-    float distToDisk = RayDiskIntersect(ray, disk);
+    float distToDisk = RayDiskDistance(ray, disk);
     if (distToDisk < dist)
         col = lcol;
 
@@ -1,3 +1,5 @@
+// generated by fit/tools/shaderGen from src/ltc_line.fs and the kernels it includes, edit those instead
+
 // bind roughness   {label:"Roughness", default:0.2, min:0.01, max:1, step:0.001}
 // bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
 // bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
@@ -31,14 +33,24 @@ uniform float rotz;
 uniform mat4  view;
 uniform vec2  resolution;
 
-const float LUT_SIZE  = 64.0;
-const float LUT_SCALE = (LUT_SIZE - 1.0)/LUT_SIZE;
-const float LUT_BIAS  = 0.5/LUT_SIZE;
+// Kernels shared by the demos and the C++ code (fit/ltc_kernels.h)
+// written in the common subset of GLSL ES 3.00 and C++ described in fit/glsl.h
 
-const float PI = 3.14159265;
+#ifndef LTC_KERNELS_CPP
+#define OUT(T) out T
+#define INOUT(T) inout T
+#define OUT_ARRAY(T) out T
+#define INOUT_ARRAY(T) inout T
+#endif
 
-// Math
-////////////////
+const float pi = 3.14159265f;
+
+const float LUT_SIZE  = 64.0f;
+const float LUT_SCALE = (LUT_SIZE - 1.0f)/LUT_SIZE;
+const float LUT_BIAS  = 0.5f/LUT_SIZE;
+
+// Matrix functions
+///////////////////
 
 vec3 mul(mat3 m, vec3 v)
 {
@@ -73,182 +85,78 @@ vec3 rotation_yz(vec3 v, float ay, float az)
     return rotation_z(rotation_y(v, ay), az);
 }
 
-vec3 rotation_yz_inv(vec3 v, float ay, float az)
+mat3 mat3_from_columns(vec3 c0, vec3 c1, vec3 c2)
 {
-    return rotation_y(rotation_z(v, -az), -ay);
+    mat3 m = mat3(c0, c1, c2);
+    return m;
 }
 
-// Cylinder helpers
-////////////////
-
-vec3 cylinderCenter()  {return vec3(0, 6, 32);}
-vec3 cylinderTangent() {return rotation_yz(vec3(1, 0, 0), roty * 2.0*PI, rotz * 2.0*PI);}
-vec3 cylinderP1()      {return cylinderCenter() - 0.5 * L * cylinderTangent();}
-vec3 cylinderP2()      {return cylinderCenter() + 0.5 * L * cylinderTangent();}
-
-// Camera functions
-///////////////////
+float sqr(float x) { return x*x; }
 
-struct Ray
-{
-    vec3 origin;
-    vec3 dir;
-};
+// Table lookups
+////////////////
 
-Ray GenerateCameraRay()
+// texture coordinates of the fitted tables for (roughness, cos(theta))
+vec2 LTC_Coords(float roughness, float ndotv)
 {
-    Ray ray;
-
-    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
-
-    ray.dir = normalize(vec3(xy, 2.0));
-
-    float focalDistance = 2.0;
-    float ft = focalDistance/ray.dir.z;
-    vec3 pFocus = ray.dir*ft;
-
-    ray.origin = vec3(0);
-    ray.dir    = normalize(pFocus - ray.origin);
-
-    // Apply camera transform
-    ray.origin = (view*vec4(ray.origin, 1)).xyz;
-    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
-
-    return ray;
+    vec2 uv = vec2(roughness, sqrt(1.0f - ndotv));
+    return uv*LUT_SCALE + LUT_BIAS;
 }
 
-bool RayPlaneIntersect(Ray ray, vec4 plane, out float t)
+// inverse LTC matrix from the first table
+mat3 LTC_Matrix(vec4 t1)
 {
-    t = -dot(plane, vec4(ray.origin, 1.0))/dot(plane.xyz, ray.dir);
-    return t > 0.0;
+    return mat3(
+        vec3(t1.x, 0, t1.y),
+        vec3(   0, 1,    0),
+        vec3(t1.z, 0, t1.w)
+    );
 }
 
-bool quadratic(float a, float b, float c, out float t0, out float t1) {
-
-    float d = b*b - 4.0*a*c;
-    if (d < 0.0) return false;
-    float sqrt_d = sqrt(d);
-    float q;
-    if (b < 0.0)
-        q = -0.5 * (b - sqrt_d);
-    else
-        q = -0.5 * (b + sqrt_d);
-    t0 = q / a;
-    t1 = c / q;
-    return true;
-}
+// Misc. helpers
+////////////////
 
-bool RayDisksIntersect(Ray ray, out float t)
+float saturate(float v)
 {
-    ray.origin -= cylinderCenter();
-
-    ray.origin = rotation_yz_inv(ray.origin, roty * 2.0*PI, rotz * 2.0*PI);
-    ray.dir    = rotation_yz_inv(ray.dir,    roty * 2.0*PI, rotz * 2.0*PI);
-
-    if (abs(ray.dir.x) < 1e-7) return false;
-
-    float t1, t2, height;
-    bool d1 = false, d2 = false;
-
-    t1 = (-0.5*L - ray.origin.x) / ray.dir.x;
-    if (t1 > 0.0)
-    {
-        vec3 point = ray.origin + t1*ray.dir;
-        float dist2 = point.y * point.y + point.z * point.z;
-        if (dist2 < R * R)
-            d1 = true;
-    }
-
-    t2 = (+0.5*L - ray.origin.x) / ray.dir.x;
-    if (t2 > 0.0)
-    {
-        vec3 point = ray.origin + t2*ray.dir;
-        float dist2 = point.y * point.y + point.z * point.z;
-        if (dist2 < R * R)
-            d2 = true;
-    }
-
-    if (d1 && d2)
-    {
-        t = min(t1, t2);
-        return true;
-    }
-    if (d1)
-    {
-        t = t1;
-        return true;
-    }
-    if (d2)
-    {
-        t = t2;
-        return true;
-    }
-
-    return false;
+    return clamp(v, 0.0f, 1.0f);
 }
 
-bool RayCylinderIntersect(Ray ray, out float t)
+vec3 PowVec3(vec3 v, float p)
 {
-    if (endCaps && RayDisksIntersect(ray, t))
-        return true;
-
-    ray.origin -= cylinderCenter();
-
-    ray.origin = rotation_yz_inv(ray.origin, roty * 2.0*PI, rotz * 2.0*PI);
-    ray.dir    = rotation_yz_inv(ray.dir,    roty * 2.0*PI, rotz * 2.0*PI);
-
-    float A = ray.dir.z*ray.dir.z + ray.dir.y*ray.dir.y;
-    float B = 2.0 * (ray.dir.z*ray.origin.z + ray.dir.y*ray.origin.y);
-    float C = ray.origin.z*ray.origin.z + ray.origin.y*ray.origin.y - R*R;
-
-    float t0, t1;
-    if (!quadratic(A, B, C, t0, t1))
-        return false;
-
-    if (t0 < 0.0 && t1 < 0.0)
-        return false;
-
-    t = min(t0, t1);
-    if (t0 < 0.0)
-        t = t0;
-    if (t1 < 0.0)
-        t = t1;
-
-    // intersection
-    vec3 point = ray.origin + t * ray.dir;
-
-    if (abs(point.x) > 0.5*L)
-        return false;
-
-    return true;
+    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
 }
 
+const float gamma = 2.2f;
+vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
+// Line and cylinder lights
+// requires ltc_common.glsl
+// the lights are segments p1 p2 in the shading frame, cylinders have radius R
+
 // code from [Frisvad2012]
-void buildOrthonormalBasis(
-in vec3 n, out vec3 b1, out vec3 b2)
+void buildOrthonormalBasis(vec3 n, OUT(vec3) b1, OUT(vec3) b2)
 {
-    if (n.z < -0.9999999)
+    if (n.z < -0.9999999f)
     {
-        b1 = vec3( 0.0, -1.0, 0.0);
-        b2 = vec3(-1.0,  0.0, 0.0);
+        b1 = vec3( 0.0f, -1.0f, 0.0f);
+        b2 = vec3(-1.0f,  0.0f, 0.0f);
         return;
     }
-    float a = 1.0 / (1.0 + n.z);
+    float a = 1.0f / (1.0f + n.z);
     float b = -n.x*n.y*a;
-    b1 = vec3(1.0 - n.x*n.x*a, b, -n.x);
-    b2 = vec3(b, 1.0 - n.y*n.y*a, -n.y);
+    b1 = vec3(1.0f - n.x*n.x*a, b, -n.x);
+    b2 = vec3(b, 1.0f - n.y*n.y*a, -n.y);
 }
 
-mat3 Minv;
-float D(vec3 w)
+// LTC distribution of Minv
+float D(vec3 w, mat3 Minv)
 {
     vec3 wo = Minv * w;
     float lo = length(wo);
-    float res = 1.0/PI * max(0.0, wo.z/lo) * abs(determinant(Minv)) / (lo*lo*lo);
+    float res = 1.0f/pi * max(0.0f, wo.z/lo) * abs(determinant(Minv)) / (lo*lo*lo);
     return res;
 }
 
-float I_cylinder_numerical(vec3 p1, vec3 p2, float R)
+float I_cylinder_numerical(vec3 p1, vec3 p2, float R, mat3 Minv)
 {
     // init orthonormal basis
     float L = length(p2 - p1);
@@ -257,14 +165,14 @@ float I_cylinder_numerical(vec3 p1, vec3 p2, float R)
     buildOrthonormalBasis(wt, wt1, wt2);
 
     // integral discretization
-    float I = 0.0;
+    float I = 0.0f;
     const int nSamplesphi = 20;
     const int nSamplesl   = 100;
     for (int i = 0; i < nSamplesphi; ++i)
     for (int j = 0; j < nSamplesl;   ++j)
     {
         // normal
-        float phi = 2.0 * PI * float(i)/float(nSamplesphi);
+        float phi = 2.0f * pi * float(i)/float(nSamplesphi);
         vec3 wn = cos(phi)*wt1 + sin(phi)*wt2;
 
         // position
@@ -275,10 +183,10 @@ float I_cylinder_numerical(vec3 p1, vec3 p2, float R)
         vec3 wp = normalize(p);
 
         // integrate
-        I += D(wp) * max(0.0, dot(-wp, wn)) / dot(p, p);
+        I += D(wp, Minv) * max(0.0f, dot(-wp, wn)) / dot(p, p);
     }
 
-    I *= 2.0 * PI * R * L / float(nSamplesphi*nSamplesl);
+    I *= 2.0f * pi * R * L / float(nSamplesphi*nSamplesl);
     return I;
 }
 
@@ -298,9 +206,9 @@ float I_diffuse_line(vec3 p1, vec3 p2)
     vec3 wt = normalize(p2 - p1);
 
     // clamping
-    if (p1.z <= 0.0 && p2.z <= 0.0) return 0.0;
-    if (p1.z < 0.0) p1 = (+p1*p2.z - p2*p1.z) / (+p2.z - p1.z);
-    if (p2.z < 0.0) p2 = (-p1*p2.z + p2*p1.z) / (-p2.z + p1.z);
+    if (p1.z <= 0.0f && p2.z <= 0.0f) return 0.0f;
+    if (p1.z < 0.0f) p1 = (+p1*p2.z - p2*p1.z) / (+p2.z - p1.z);
+    if (p2.z < 0.0f) p2 = (-p1*p2.z + p2*p1.z) / (-p2.z + p1.z);
 
     // parameterization
     float l1 = dot(p1, wt);
@@ -315,10 +223,10 @@ float I_diffuse_line(vec3 p1, vec3 p2)
     // integral
     float I = (Fpo(d, l2) - Fpo(d, l1)) * po.z +
               (Fwt(d, l2) - Fwt(d, l1)) * wt.z;
-    return I / PI;
+    return I / pi;
 }
 
-float I_ltc_line(vec3 p1, vec3 p2)
+float I_ltc_line(vec3 p1, vec3 p2, mat3 Minv)
 {
     // transform to diffuse configuration
     vec3 p1o = Minv * p1;
@@ -327,56 +235,226 @@ float I_ltc_line(vec3 p1, vec3 p2)
 
     // width factor
     vec3 ortho = normalize(cross(p1, p2));
-    float w =  1.0 / length(inverse(transpose(Minv)) * ortho);
+    float w =  1.0f / length(inverse(transpose(Minv)) * ortho);
 
     return w * I_diffuse;
 }
 
-float I_disks_numerical(vec3 p1, vec3 p2, float R)
+float I_disks_numerical(vec3 p1, vec3 p2, float R, mat3 Minv)
 {
     // init orthonormal basis
-    float L = length(p2 - p1);
     vec3 wt = normalize(p2 - p1);
     vec3 wt1, wt2;
     buildOrthonormalBasis(wt, wt1, wt2);
 
     // integration
-    float Idisks = 0.0;
+    float Idisks = 0.0f;
     const int nSamplesphi = 20;
     const int nSamplesr   = 200;
     for (int i = 0; i < nSamplesphi; ++i)
     for (int j = 0; j < nSamplesr;   ++j)
     {
-        float phi = 2.0 * PI * float(i)/float(nSamplesphi);
+        float phi = 2.0f * pi * float(i)/float(nSamplesphi);
         float r = R * float(j)/float(nSamplesr - 1);
         vec3 p, wp;
 
         p = p1 + r * (cos(phi)*wt1 + sin(phi)*wt2);
         wp = normalize(p);
-        Idisks += r * D(wp) * max(0.0, dot(wp, +wt)) / dot(p, p);
+        Idisks += r * D(wp, Minv) * max(0.0f, dot(wp, +wt)) / dot(p, p);
 
         p = p2 + r * (cos(phi)*wt1 + sin(phi)*wt2);
         wp = normalize(p);
-        Idisks += r * D(wp) * max(0.0, dot(wp, -wt)) / dot(p, p);
+        Idisks += r * D(wp, Minv) * max(0.0f, dot(wp, -wt)) / dot(p, p);
     }
 
-    Idisks *= 2.0 * PI * R / float(nSamplesr*nSamplesphi);
+    Idisks *= 2.0f * pi * R / float(nSamplesr*nSamplesphi);
     return Idisks;
 }
 
-float I_ltc_disks(vec3 p1, vec3 p2, float R)
+float I_ltc_disks(vec3 p1, vec3 p2, float R, mat3 Minv)
 {
-    float A = PI * R * R;
+    float A = pi * R * R;
     vec3 wt  = normalize(p2 - p1);
     vec3 wp1 = normalize(p1);
     vec3 wp2 = normalize(p2);
     float Idisks = A * (
-    D(wp1) * max(0.0, dot(+wt, wp1)) / dot(p1, p1) +
-    D(wp2) * max(0.0, dot(-wt, wp2)) / dot(p2, p2));
+    D(wp1, Minv) * max(0.0f, dot(+wt, wp1)) / dot(p1, p1) +
+    D(wp2, Minv) * max(0.0f, dot(-wt, wp2)) / dot(p2, p2));
     return Idisks;
 }
+// Ray intersection with the light shapes
+// requires ltc_common.glsl
+// the functions return the nearest intersection at t > 0, the reference of the packets of fit/ltc_ray.h
+
+struct Ray
+{
+    vec3 origin;
+    vec3 dir;
+};
+
+bool RayPlaneIntersect(Ray ray, vec4 plane, OUT(float) t)
+{
+    t = -dot(plane, vec4(ray.origin, 1.0f))/dot(vec3(plane.x, plane.y, plane.z), ray.dir);
+    return t > 0.0f;
+}
+
+// roots of a t^2 + b t + c, t0 = t1 when the discriminant is 0
+bool SolveQuadratic(float a, float b, float c, OUT(float) t0, OUT(float) t1)
+{
+    float d = b*b - 4.0f*a*c;
+    if (d < 0.0f)
+        return false;
+
+    // stable form, without the cancellation of -b + sqrt(d)
+    float q = b < 0.0f ? -0.5f*(b - sqrt(d)) : -0.5f*(b + sqrt(d));
+    t0 = min(q/a, c/q);
+    t1 = max(q/a, c/q);
+    return true;
+}
 
-vec3 LTC_Evaluate(vec3 N, vec3 V, vec3 P)
+// rectangle of half sizes halfx and halfy along the orthonormal dirx and diry
+bool RayRectIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return abs(x) <= halfx && abs(y) <= halfy;
+}
+
+// ellipse of half axes halfx and halfy along the orthonormal dirx and diry, disks have halfx = halfy
+bool RayDiskIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return sqr(x/halfx) + sqr(y/halfy) <= 1.0f;
+}
+
+bool RaySphereIntersect(Ray ray, vec3 center, float R, OUT(float) t)
+{
+    vec3 o = ray.origin - center;
+
+    float t0, t1;
+    if (!SolveQuadratic(dot(ray.dir, ray.dir), 2.0f*dot(ray.dir, o), dot(o, o) - R*R, t0, t1))
+        return false;
+
+    t = t0 > 0.0f ? t0 : t1;
+    return t > 0.0f;
+}
+
+// cylinder of axis p1 p2 and radius R, closed by disks with endCaps
+bool RayCylinderIntersect(Ray ray, vec3 p1, vec3 p2, float R, bool endCaps, OUT(float) t)
+{
+    float len = length(p2 - p1);
+    vec3 axis = (p2 - p1)/len;
+
+    // ray along the axis (s) and orthogonal to it (op + t dp)
+    vec3 o = ray.origin - p1;
+    float os = dot(o, axis);
+    float ds = dot(ray.dir, axis);
+    vec3 op = o - axis*os;
+    vec3 dp = ray.dir - axis*ds;
+
+    bool hit = false;
+
+    float t0, t1;
+    if (SolveQuadratic(dot(dp, dp), 2.0f*dot(dp, op), dot(op, op) - R*R, t0, t1))
+    {
+        float s0 = os + t0*ds;
+        float s1 = os + t1*ds;
+        if (t0 > 0.0f && s0 >= 0.0f && s0 <= len)
+        {
+            t = t0;
+            hit = true;
+        }
+        else if (t1 > 0.0f && s1 >= 0.0f && s1 <= len)
+        {
+            t = t1;
+            hit = true;
+        }
+    }
+
+    if (endCaps && abs(ds) > 1e-7f)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            float tc = ((i == 0 ? 0.0f : len) - os)/ds;
+            vec3 q = op + tc*dp;
+            if (tc > 0.0f && dot(q, q) <= R*R && (!hit || tc < t))
+            {
+                t = tc;
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+// capsule of axis p1 p2 and radius R: the open cylinder and the spheres at both ends
+bool RayCapsuleIntersect(Ray ray, vec3 p1, vec3 p2, float R, OUT(float) t)
+{
+    bool hit = RayCylinderIntersect(ray, p1, p2, R, false, t);
+
+    float ts;
+    if (RaySphereIntersect(ray, p1, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+    if (RaySphereIntersect(ray, p2, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+
+    return hit;
+}
+
+// Cylinder helpers
+////////////////
+
+vec3 cylinderCenter()  {return vec3(0, 6, 32);}
+vec3 cylinderTangent() {return rotation_yz(vec3(1, 0, 0), roty * 2.0*pi, rotz * 2.0*pi);}
+vec3 cylinderP1()      {return cylinderCenter() - 0.5 * L * cylinderTangent();}
+vec3 cylinderP2()      {return cylinderCenter() + 0.5 * L * cylinderTangent();}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
+
+vec3 LTC_Evaluate(vec3 N, vec3 V, vec3 P, mat3 Minv)
 {
     // construct orthonormal basis around N
     vec3 T1, T2;
@@ -390,34 +468,18 @@ vec3 LTC_Evaluate(vec3 N, vec3 V, vec3 P)
 
     if (analytic) // analytic integration
     {
-        float Iline = R * I_ltc_line(p1, p2);
-        float Idisks = endCaps ? I_ltc_disks(p1, p2, R) : 0.0;
+        float Iline = R * I_ltc_line(p1, p2, Minv);
+        float Idisks = endCaps ? I_ltc_disks(p1, p2, R, Minv) : 0.0;
         return vec3(min(1.0, Iline + Idisks));
     }
     else // numerical integration
     {
-        float Icylinder = I_cylinder_numerical(p1, p2, R);
-        float Idisks = endCaps ? I_disks_numerical(p1, p2, R) : 0.0;
+        float Icylinder = I_cylinder_numerical(p1, p2, R, Minv);
+        float Idisks = endCaps ? I_disks_numerical(p1, p2, R, Minv) : 0.0;
         return vec3(Icylinder + Idisks);
     }
 }
 
-// Misc. helpers
-////////////////
-
-float saturate(float v)
-{
-    return clamp(v, 0.0, 1.0);
-}
-
-vec3 PowVec3(vec3 v, float p)
-{
-    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
-}
-
-const float gamma = 2.2;
-vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
-
 out vec4 FragColor;
 
 // Main
@@ -446,34 +508,28 @@ void main()
             vec3 V = -ray.dir;
 
             float ndotv = saturate(dot(N, V));
-            vec2 uv = vec2(roughness, sqrt(1.0 - ndotv));
-            uv = uv*LUT_SCALE + LUT_BIAS;
+            vec2 uv = LTC_Coords(roughness, ndotv);
 
             vec4 t1 = texture(ltc_1, uv);
             vec4 t2 = texture(ltc_2, uv);
 
-            Minv = mat3(
-                vec3(t1.x, 0, t1.y),
-                vec3(  0,  1,    0),
-                vec3(t1.z, 0, t1.w)
-            );
+            mat3 Minv = LTC_Matrix(t1);
 
-            vec3 spec = LTC_Evaluate(N, V, pos);
+            vec3 spec = LTC_Evaluate(N, V, pos, Minv);
             // BRDF shadowing and Fresnel
             spec *= scol*t2.x + (1.0 - scol)*t2.y;
 
-            Minv = mat3(1);
-            vec3 diff = LTC_Evaluate(N, V, pos);
+            vec3 diff = LTC_Evaluate(N, V, pos, mat3(1));
 
             col  = lcol*(spec + dcol*diff);
-            col /= 2.0*PI;
+            col /= 2.0*pi;
         }
 
         float distToCylinder;
-        if (RayCylinderIntersect(ray, distToCylinder))
+        if (RayCylinderIntersect(ray, cylinderP1(), cylinderP2(), R, endCaps, distToCylinder))
             if ((distToCylinder < distToFloor) || !hitFloor)
                 col = lcol;
     }
 
     FragColor = vec4(col, 1.0);
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
+// generated by fit/tools/shaderGen from src/ltc_quad.fs and the kernels it includes, edit those instead
+
 // bind roughness   {label:"Roughness", default:0.25, min:0.01, max:1, step:0.001}
 // bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
 // bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
@@ -29,81 +31,25 @@ uniform mat4  view;
 uniform vec2  resolution;
 uniform int   sampleCount;
 
-const float LUT_SIZE  = 64.0;
-const float LUT_SCALE = (LUT_SIZE - 1.0)/LUT_SIZE;
-const float LUT_BIAS  = 0.5/LUT_SIZE;
-
-const float pi = 3.14159265;
-
-// Tracing and intersection
-///////////////////////////
-
-struct Ray
-{
-    vec3 origin;
-    vec3 dir;
-};
+// Kernels shared by the demos and the C++ code (fit/ltc_kernels.h)
+// written in the common subset of GLSL ES 3.00 and C++ described in fit/glsl.h
 
-struct Rect
-{
-    vec3  center;
-    vec3  dirx;
-    vec3  diry;
-    float halfx;
-    float halfy;
+#ifndef LTC_KERNELS_CPP
+#define OUT(T) out T
+#define INOUT(T) inout T
+#define OUT_ARRAY(T) out T
+#define INOUT_ARRAY(T) inout T
+#endif
 
-    vec4  plane;
-};
+const float pi = 3.14159265f;
 
-bool RayPlaneIntersect(Ray ray, vec4 plane, out float t)
-{
-    t = -dot(plane, vec4(ray.origin, 1.0))/dot(plane.xyz, ray.dir);
-    return t > 0.0;
-}
+const float LUT_SIZE  = 64.0f;
+const float LUT_SCALE = (LUT_SIZE - 1.0f)/LUT_SIZE;
+const float LUT_BIAS  = 0.5f/LUT_SIZE;
 
-bool RayRectIntersect(Ray ray, Rect rect, out float t)
-{
-    bool intersect = RayPlaneIntersect(ray, rect.plane, t);
-    if (intersect)
-    {
-        vec3 pos  = ray.origin + ray.dir*t;
-        vec3 lpos = pos - rect.center;
-
-        float x = dot(lpos, rect.dirx);
-        float y = dot(lpos, rect.diry);
-
-        if (abs(x) > rect.halfx || abs(y) > rect.halfy)
-            intersect = false;
-    }
-
-    return intersect;
-}
-
-// Camera functions
+// Matrix functions
 ///////////////////
 
-Ray GenerateCameraRay()
-{
-    Ray ray;
-
-    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
-
-    ray.dir = normalize(vec3(xy, 2.0));
-
-    float focalDistance = 2.0;
-    float ft = focalDistance/ray.dir.z;
-    vec3 pFocus = ray.dir*ft;
-
-    ray.origin = vec3(0);
-    ray.dir    = normalize(pFocus - ray.origin);
-
-    // Apply camera transform
-    ray.origin = (view*vec4(ray.origin, 1)).xyz;
-    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
-
-    return ray;
-}
-
 vec3 mul(mat3 m, vec3 v)
 {
     return m * v;
@@ -137,19 +83,62 @@ vec3 rotation_yz(vec3 v, float ay, float az)
     return rotation_z(rotation_y(v, ay), az);
 }
 
-// Linearly Transformed Cosines
-///////////////////////////////
+mat3 mat3_from_columns(vec3 c0, vec3 c1, vec3 c2)
+{
+    mat3 m = mat3(c0, c1, c2);
+    return m;
+}
+
+float sqr(float x) { return x*x; }
+
+// Table lookups
+////////////////
+
+// texture coordinates of the fitted tables for (roughness, cos(theta))
+vec2 LTC_Coords(float roughness, float ndotv)
+{
+    vec2 uv = vec2(roughness, sqrt(1.0f - ndotv));
+    return uv*LUT_SCALE + LUT_BIAS;
+}
+
+// inverse LTC matrix from the first table
+mat3 LTC_Matrix(vec4 t1)
+{
+    return mat3(
+        vec3(t1.x, 0, t1.y),
+        vec3(   0, 1,    0),
+        vec3(t1.z, 0, t1.w)
+    );
+}
+
+// Misc. helpers
+////////////////
+
+float saturate(float v)
+{
+    return clamp(v, 0.0f, 1.0f);
+}
+
+vec3 PowVec3(vec3 v, float p)
+{
+    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
+}
+
+const float gamma = 2.2f;
+vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
+// Polygonal lights
+// requires ltc_common.glsl
 
 vec3 IntegrateEdgeVec(vec3 v1, vec3 v2)
 {
     float x = dot(v1, v2);
     float y = abs(x);
 
-    float a = 0.8543985 + (0.4965155 + 0.0145206*y)*y;
-    float b = 3.4175940 + (4.1616724 + y)*y;
+    float a = 0.8543985f + (0.4965155f + 0.0145206f*y)*y;
+    float b = 3.4175940f + (4.1616724f + y)*y;
     float v = a / b;
 
-    float theta_sintheta = (x > 0.0) ? v : 0.5*inversesqrt(max(1.0 - x*x, 1e-7)) - v;
+    float theta_sintheta = (x > 0.0f) ? v : 0.5f*inversesqrt(max(1.0f - x*x, 1e-7f)) - v;
 
     return cross(v1, v2)*theta_sintheta;
 }
@@ -159,14 +148,14 @@ float IntegrateEdge(vec3 v1, vec3 v2)
     return IntegrateEdgeVec(v1, v2).z;
 }
 
-void ClipQuadToHorizon(inout vec3 L[5], out int n)
+void ClipQuadToHorizon(INOUT_ARRAY(vec3) L[5], OUT(int) n)
 {
     // detect clipping config
     int config = 0;
-    if (L[0].z > 0.0) config += 1;
-    if (L[1].z > 0.0) config += 2;
-    if (L[2].z > 0.0) config += 4;
-    if (L[3].z > 0.0) config += 8;
+    if (L[0].z > 0.0f) config += 1;
+    if (L[1].z > 0.0f) config += 2;
+    if (L[2].z > 0.0f) config += 4;
+    if (L[3].z > 0.0f) config += 8;
 
     // clip
     n = 0;
@@ -270,9 +259,10 @@ void ClipQuadToHorizon(inout vec3 L[5], out int n)
         L[4] = L[0];
 }
 
-
-vec3 LTC_Evaluate(
-    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided)
+// integral of the LTC lobe Minv over a quad light, clipped to the horizon or with the clipless approximation
+// (horizon-clipped sphere tabulated in the w component of ltc_2)
+vec3 LTC_EvaluateQuad(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, bool clipless, sampler2D ltc_2)
 {
     // construct orthonormal basis around N
     vec3 T1, T2;
@@ -290,20 +280,20 @@ vec3 LTC_Evaluate(
     L[3] = mul(Minv, points[3] - P);
 
     // integrate
-    float sum = 0.0;
+    float sum = 0.0f;
 
     if (clipless)
     {
-        vec3 dir = points[0].xyz - P;
+        vec3 dir = points[0] - P;
         vec3 lightNormal = cross(points[1] - points[0], points[3] - points[0]);
-        bool behind = (dot(dir, lightNormal) < 0.0);
+        bool behind = (dot(dir, lightNormal) < 0.0f);
 
         L[0] = normalize(L[0]);
         L[1] = normalize(L[1]);
         L[2] = normalize(L[2]);
         L[3] = normalize(L[3]);
 
-        vec3 vsum = vec3(0.0);
+        vec3 vsum = vec3(0.0f);
 
         vsum += IntegrateEdgeVec(L[0], L[1]);
         vsum += IntegrateEdgeVec(L[1], L[2]);
@@ -316,7 +306,7 @@ vec3 LTC_Evaluate(
         if (behind)
             z = -z;
 
-        vec2 uv = vec2(z*0.5 + 0.5, len);
+        vec2 uv = vec2(z*0.5f + 0.5f, len);
         uv = uv*LUT_SCALE + LUT_BIAS;
 
         float scale = texture(ltc_2, uv).w;
@@ -324,7 +314,7 @@ vec3 LTC_Evaluate(
         sum = len*scale;
 
         if (behind && !twoSided)
-            sum = 0.0;
+            sum = 0.0f;
     }
     else
     {
@@ -349,13 +339,195 @@ vec3 LTC_Evaluate(
         if (n == 5)
             sum += IntegrateEdge(L[4], L[0]);
 
-        sum = twoSided ? abs(sum) : max(0.0, sum);
+        sum = twoSided ? abs(sum) : max(0.0f, sum);
     }
 
     vec3 Lo_i = vec3(sum, sum, sum);
 
     return Lo_i;
 }
+// Ray intersection with the light shapes
+// requires ltc_common.glsl
+// the functions return the nearest intersection at t > 0, the reference of the packets of fit/ltc_ray.h
+
+struct Ray
+{
+    vec3 origin;
+    vec3 dir;
+};
+
+bool RayPlaneIntersect(Ray ray, vec4 plane, OUT(float) t)
+{
+    t = -dot(plane, vec4(ray.origin, 1.0f))/dot(vec3(plane.x, plane.y, plane.z), ray.dir);
+    return t > 0.0f;
+}
+
+// roots of a t^2 + b t + c, t0 = t1 when the discriminant is 0
+bool SolveQuadratic(float a, float b, float c, OUT(float) t0, OUT(float) t1)
+{
+    float d = b*b - 4.0f*a*c;
+    if (d < 0.0f)
+        return false;
+
+    // stable form, without the cancellation of -b + sqrt(d)
+    float q = b < 0.0f ? -0.5f*(b - sqrt(d)) : -0.5f*(b + sqrt(d));
+    t0 = min(q/a, c/q);
+    t1 = max(q/a, c/q);
+    return true;
+}
+
+// rectangle of half sizes halfx and halfy along the orthonormal dirx and diry
+bool RayRectIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return abs(x) <= halfx && abs(y) <= halfy;
+}
+
+// ellipse of half axes halfx and halfy along the orthonormal dirx and diry, disks have halfx = halfy
+bool RayDiskIntersect(Ray ray, vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy, OUT(float) t)
+{
+    vec3 normal = cross(dirx, diry);
+    if (!RayPlaneIntersect(ray, vec4(normal, -dot(normal, center)), t))
+        return false;
+
+    vec3 lpos = ray.origin + ray.dir*t - center;
+    float x = dot(lpos, dirx);
+    float y = dot(lpos, diry);
+
+    return sqr(x/halfx) + sqr(y/halfy) <= 1.0f;
+}
+
+bool RaySphereIntersect(Ray ray, vec3 center, float R, OUT(float) t)
+{
+    vec3 o = ray.origin - center;
+
+    float t0, t1;
+    if (!SolveQuadratic(dot(ray.dir, ray.dir), 2.0f*dot(ray.dir, o), dot(o, o) - R*R, t0, t1))
+        return false;
+
+    t = t0 > 0.0f ? t0 : t1;
+    return t > 0.0f;
+}
+
+// cylinder of axis p1 p2 and radius R, closed by disks with endCaps
+bool RayCylinderIntersect(Ray ray, vec3 p1, vec3 p2, float R, bool endCaps, OUT(float) t)
+{
+    float len = length(p2 - p1);
+    vec3 axis = (p2 - p1)/len;
+
+    // ray along the axis (s) and orthogonal to it (op + t dp)
+    vec3 o = ray.origin - p1;
+    float os = dot(o, axis);
+    float ds = dot(ray.dir, axis);
+    vec3 op = o - axis*os;
+    vec3 dp = ray.dir - axis*ds;
+
+    bool hit = false;
+
+    float t0, t1;
+    if (SolveQuadratic(dot(dp, dp), 2.0f*dot(dp, op), dot(op, op) - R*R, t0, t1))
+    {
+        float s0 = os + t0*ds;
+        float s1 = os + t1*ds;
+        if (t0 > 0.0f && s0 >= 0.0f && s0 <= len)
+        {
+            t = t0;
+            hit = true;
+        }
+        else if (t1 > 0.0f && s1 >= 0.0f && s1 <= len)
+        {
+            t = t1;
+            hit = true;
+        }
+    }
+
+    if (endCaps && abs(ds) > 1e-7f)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            float tc = ((i == 0 ? 0.0f : len) - os)/ds;
+            vec3 q = op + tc*dp;
+            if (tc > 0.0f && dot(q, q) <= R*R && (!hit || tc < t))
+            {
+                t = tc;
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+// capsule of axis p1 p2 and radius R: the open cylinder and the spheres at both ends
+bool RayCapsuleIntersect(Ray ray, vec3 p1, vec3 p2, float R, OUT(float) t)
+{
+    bool hit = RayCylinderIntersect(ray, p1, p2, R, false, t);
+
+    float ts;
+    if (RaySphereIntersect(ray, p1, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+    if (RaySphereIntersect(ray, p2, R, ts) && (!hit || ts < t))
+    {
+        t = ts;
+        hit = true;
+    }
+
+    return hit;
+}
+
+// Tracing and intersection
+///////////////////////////
+
+struct Rect
+{
+    vec3  center;
+    vec3  dirx;
+    vec3  diry;
+    float halfx;
+    float halfy;
+
+    vec4  plane;
+};
+
+bool RayRectIntersect(Ray ray, Rect rect, OUT(float) t)
+{
+    return RayRectIntersect(ray, rect.center, rect.dirx, rect.diry, rect.halfx, rect.halfy, t);
+}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
 
 // Scene helpers
 ////////////////
@@ -384,22 +556,6 @@ void InitRectPoints(Rect rect, out vec3 points[4])
     points[3] = rect.center - ex + ey;
 }
 
-// Misc. helpers
-////////////////
-
-float saturate(float v)
-{
-    return clamp(v, 0.0, 1.0);
-}
-
-vec3 PowVec3(vec3 v, float p)
-{
-    return vec3(pow(v.x, p), pow(v.y, p), pow(v.z, p));
-}
-
-const float gamma = 2.2;
-vec3 ToLinear(vec3 v) { return PowVec3(v, gamma); }
-
 out vec4 FragColor;
 
 void main()
@@ -430,23 +586,18 @@ void main()
         vec3 V = -ray.dir;
 
         float ndotv = saturate(dot(N, V));
-        vec2 uv = vec2(roughness, sqrt(1.0 - ndotv));
-        uv = uv*LUT_SCALE + LUT_BIAS;
+        vec2 uv = LTC_Coords(roughness, ndotv);
 
         vec4 t1 = texture(ltc_1, uv);
         vec4 t2 = texture(ltc_2, uv);
 
-        mat3 Minv = mat3(
-            vec3(t1.x, 0, t1.y),
-            vec3(  0,  1,    0),
-            vec3(t1.z, 0, t1.w)
-        );
+        mat3 Minv = LTC_Matrix(t1);
 
-        vec3 spec = LTC_Evaluate(N, V, pos, Minv, points, twoSided);
+        vec3 spec = LTC_EvaluateQuad(N, V, pos, Minv, points, twoSided, clipless, ltc_2);
         // BRDF shadowing and Fresnel
         spec *= scol*t2.x + (1.0 - scol)*t2.y;
 
-        vec3 diff = LTC_Evaluate(N, V, pos, mat3(1), points, twoSided);
+        vec3 diff = LTC_EvaluateQuad(N, V, pos, mat3(1), points, twoSided, clipless, ltc_2);
 
         col = lcol*(spec + dcol*diff);
     }
@@ -457,4 +608,4 @@ void main()
             col = lcol;
 
     FragColor = vec4(col, 1.0);
-}
\ No newline at end of file
+}
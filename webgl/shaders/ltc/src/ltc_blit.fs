@@ -0,0 +1,23 @@
+uniform vec2 resolution;
+
+uniform sampler2D tex;
+
+#include "../kernels/ltc_common.glsl"
+#include "../kernels/ltc_tonemap.glsl"
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 pos = gl_FragCoord.xy/resolution;
+
+    vec4 col = texture(tex, pos);
+
+    // Rescale by number of samples
+    col /= col.w;
+
+    col.rgb = aces_fitted(col.rgb);
+    col.rgb = ToSRGB(col.rgb);
+
+    FragColor = vec4(col);
+}
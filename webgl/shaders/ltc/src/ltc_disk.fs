@@ -0,0 +1,313 @@
+// bind roughness   {label:"Roughness", default:0.25, min:0.001, max:1, step:0.001}
+// bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
+// bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
+// bind intensity   {label:"Light Intensity", default:4, min:0, max:10}
+// bind width       {label:"Width",  default: 8, min:0.1, max:15, step:0.1}
+// bind height      {label:"Height", default: 8, min:0.1, max:15, step:0.1}
+// bind roty        {label:"Rotation Y", default: 0, min:0, max:1, step:0.001}
+// bind rotz        {label:"Rotation Z", default: 0, min:0, max:1, step:0.001}
+// bind twoSided    {label:"Two-sided", default:false}
+// bind groundTruth {label:"Ground Truth", default:false}
+
+uniform float roughness;
+uniform vec3  dcolor;
+uniform vec3  scolor;
+
+uniform float intensity;
+uniform float width;
+uniform float height;
+uniform float roty;
+uniform float rotz;
+
+uniform bool groundTruth;
+
+uniform bool twoSided;
+
+uniform sampler2D ltc_1;
+uniform sampler2D ltc_2;
+
+uniform mat4  view;
+uniform vec2  resolution;
+uniform int   sampleCount;
+
+const int   NUM_SAMPLES = 1;
+const float NO_HIT = 1e9;
+
+#include "../kernels/ltc_common.glsl"
+#include "../kernels/ltc_disk.glsl"
+#include "../kernels/ltc_ray.glsl"
+
+// Tracing and intersection
+///////////////////////////
+
+struct Disk
+{
+    vec3  center;
+    vec3  dirx;
+    vec3  diry;
+    float halfx;
+    float halfy;
+
+    vec4  plane;
+};
+
+// distances to the floor and the disk, NO_HIT when they are missed
+float RayPlaneDistance(Ray ray, vec4 plane)
+{
+    float t;
+    return RayPlaneIntersect(ray, plane, t) ? t : NO_HIT;
+}
+
+float RayDiskDistance(Ray ray, Disk disk)
+{
+    float t;
+    return RayDiskIntersect(ray, disk.center, disk.dirx, disk.diry, disk.halfx, disk.halfy, t) ? t : NO_HIT;
+}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
+
+// Sample generation
+////////////////////
+
+float Halton(int index, float base)
+{
+    float result = 0.0;
+    float f = 1.0/base;
+    float i = float(index);
+    for (int x = 0; x < 8; x++)
+    {
+        if (i <= 0.0) break;
+
+        result += f*mod(i, base);
+        i = floor(i/base);
+        f = f/base;
+    }
+
+    return result;
+}
+
+void Halton2D(out vec2 s[NUM_SAMPLES], int offset)
+{
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        s[i].x = Halton(i + offset, 2.0);
+        s[i].y = Halton(i + offset, 3.0);
+    }
+}
+
+// TODO: replace this
+float rand(vec2 co)
+{
+    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+// Scene helpers
+////////////////
+
+Disk InitDisk(vec3 center, vec3 dirx, vec3 diry, float halfx, float halfy)
+{
+    Disk disk;
+
+    disk.center = center;
+    disk.dirx   = dirx;
+    disk.diry   = diry;
+    disk.halfx  = halfx;
+    disk.halfy  = halfy;
+
+    vec3 diskNormal = cross(disk.dirx, disk.diry);
+    disk.plane = vec4(diskNormal, -dot(diskNormal, disk.center));
+
+    return disk;
+}
+
+void InitDiskPoints(Disk disk, out vec3 points[4])
+{
+    vec3 ex = disk.halfx*disk.dirx;
+    vec3 ey = disk.halfy*disk.diry;
+
+    points[0] = disk.center - ex - ey;
+    points[1] = disk.center + ex - ey;
+    points[2] = disk.center + ex + ey;
+    points[3] = disk.center - ex + ey;
+}
+
+// Linearly Transformed Cosines
+///////////////////////////////
+
+vec3 LTC_Evaluate(
+    vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], bool twoSided, float u1, float u2)
+{
+    vec3 C, V1, V2, V3;
+    float E1, E2;
+    if (!LTC_DiskEllipse(N, V, P, Minv, points, twoSided, C, V1, V2, V3, E1, E2))
+        return vec3(0.0);
+
+    float spec = LTC_DiskFormFactor(C, V1, V2, V3, E1, E2, ltc_2);
+
+    if (groundTruth)
+    {
+        spec = 0.0;
+
+        float diskArea = pi*E1*E2;
+
+        // light sample
+        {
+            // random point on ellipse
+            float rad = sqrt(u1);
+            float phi = 2.0*pi*u2;
+            float x = E1*rad*cos(phi);
+            float y = E2*rad*sin(phi);
+
+            vec3 p = x*V1 + y*V2 + C;
+            vec3 v = normalize(p);
+
+            float c2 = max(dot(V3, v), 0.0);
+            float solidAngle = max(c2/dot(p, p), 1e-7);
+            float pdfLight = 1.0/solidAngle/diskArea;
+
+            float cosTheta = max(v.z, 0.0);
+            float brdf = 1.0/pi;
+            float pdfBRDF = cosTheta/pi;
+
+            if (cosTheta > 0.0)
+                spec += brdf*cosTheta/(pdfBRDF + pdfLight);
+        }
+
+        // BRDF sample
+        {
+            // generate a cosine-distributed direction
+            float rad = sqrt(u1);
+            float phi = 2.0*pi*u2;
+            float x = rad*cos(phi);
+            float y = rad*sin(phi);
+            vec3 dir = vec3(x, y, sqrt(1.0 - u1));
+
+            Ray ray;
+            ray.origin = vec3(0, 0, 0);
+            ray.dir = dir;
+
+            Disk disk = InitDisk(C, V1, V2, E1, E2);
+
+            vec3 diskNormal = V3;
+            disk.plane = vec4(diskNormal, -dot(diskNormal, disk.center));
+
+            float distToDisk = RayDiskDistance(ray, disk);
+            bool  intersect  = distToDisk != NO_HIT;
+
+            float cosTheta = max(dir.z, 0.0);
+            float brdf = 1.0/pi;
+            float pdfBRDF = cosTheta/pi;
+
+            float pdfLight = 0.0;
+            if (intersect)
+            {
+                vec3 p = distToDisk*ray.dir;
+                vec3 v = normalize(p);
+                float c2 = max(dot(V3, v), 0.0);
+                float solidAngle = max(c2/dot(p, p), 1e-7);
+                pdfLight = 1.0/solidAngle/diskArea;
+            }
+
+            if (intersect)
+                spec += brdf*cosTheta/(pdfBRDF + pdfLight);
+        }
+    }
+
+    return vec3(spec, spec, spec);
+}
+
+out vec4 FragColor;
+
+void main()
+{
+    float ay = 2.0*pi*roty;
+    float az = 2.0*pi*rotz;
+
+    Disk disk = InitDisk(
+        vec3(0, 6, 32),
+        rotation_yz(vec3(1, 0, 0), ay, az),
+        rotation_yz(vec3(0, 1, 0), ay, az),
+        0.5*width,
+        0.5*height
+    );
+
+    vec3 points[4];
+    InitDiskPoints(disk, points);
+
+    vec4 floorPlane = vec4(0, 1, 0, 0);
+
+    vec3 lcol = vec3(intensity);
+    vec3 dcol = ToLinear(dcolor);
+    vec3 scol = ToLinear(scolor);
+
+    vec3 col = vec3(0);
+
+    Ray ray = GenerateCameraRay();
+
+    float dist = RayPlaneDistance(ray, floorPlane);
+
+    vec2 seq[NUM_SAMPLES];
+    Halton2D(seq, sampleCount);
+
+    float u1 = rand(gl_FragCoord.xy*0.01);
+    float u2 = rand(gl_FragCoord.yx*0.01);
+
+    u1 = fract(u1 + seq[0].x);
+    u2 = fract(u2 + seq[0].y);
+
+    if (dist != NO_HIT)
+    {
+        // Clamp distance to some sane maximum to prevent instability
+        dist = min(dist, 10000.0);
+
+        vec3 pos = ray.origin + dist*ray.dir;
+
+        vec3 N = floorPlane.xyz;
+        vec3 V = -ray.dir;
+
+        float ndotv = saturate(dot(N, V));
+        vec2 uv = LTC_Coords(roughness, ndotv);
+
+        vec4 t1 = texture(ltc_1, uv);
+        vec4 t2 = texture(ltc_2, uv);
+
+        mat3 Minv = LTC_Matrix(t1);
+
+        vec3 spec = LTC_Evaluate(N, V, pos, Minv, points, twoSided, u1, u2);
+        // BRDF shadowing and Fresnel
+        spec *= scol*t2.x + (1.0 - scol)*t2.y;
+
+        vec3 diff = LTC_Evaluate(N, V, pos, mat3(1), points, twoSided, u1, u2);
+
+        col = lcol*(spec + dcol*diff);
+    }
+
+    float distToDisk = RayDiskDistance(ray, disk);
+    if (distToDisk < dist)
+        col = lcol;
+
+    FragColor = vec4(col, 1.0);
+}
@@ -0,0 +1,149 @@
+// bind roughness   {label:"Roughness", default:0.2, min:0.01, max:1, step:0.001}
+// bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
+// bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
+// bind intensity   {label:"Light Intensity", default:100, min:0, max:100, step:1}
+// bind L           {label:"Length", default: 10, min:0.1, max:15, step:0.1}
+// bind R           {label:"Radius", default: 0.2, min:0.05, max:1, step:0.01}
+
+// bind roty        {label:"Rotation Y", default: 0, min:0, max:1, step:0.001}
+// bind rotz        {label:"Rotation Z", default: 0, min:0, max:1, step:0.001}
+
+// bind analytic    {label:"Analytic", default:true}
+// bind endCaps     {label:"End Caps", default:false}
+
+uniform float roughness;
+uniform vec3  dcolor;
+uniform vec3  scolor;
+
+uniform float intensity;
+uniform float L;
+uniform float R;
+
+uniform bool analytic;
+uniform bool endCaps;
+
+uniform sampler2D ltc_1;
+uniform sampler2D ltc_2;
+
+uniform float roty;
+uniform float rotz;
+
+uniform mat4  view;
+uniform vec2  resolution;
+
+#include "../kernels/ltc_common.glsl"
+#include "../kernels/ltc_line.glsl"
+#include "../kernels/ltc_ray.glsl"
+
+// Cylinder helpers
+////////////////
+
+vec3 cylinderCenter()  {return vec3(0, 6, 32);}
+vec3 cylinderTangent() {return rotation_yz(vec3(1, 0, 0), roty * 2.0*pi, rotz * 2.0*pi);}
+vec3 cylinderP1()      {return cylinderCenter() - 0.5 * L * cylinderTangent();}
+vec3 cylinderP2()      {return cylinderCenter() + 0.5 * L * cylinderTangent();}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
+
+vec3 LTC_Evaluate(vec3 N, vec3 V, vec3 P, mat3 Minv)
+{
+    // construct orthonormal basis around N
+    vec3 T1, T2;
+    T1 = normalize(V - N*dot(V, N));
+    T2 = cross(N, T1);
+
+    mat3 B = transpose(mat3(T1, T2, N));
+
+    vec3 p1 = mul(B, cylinderP1() - P);
+    vec3 p2 = mul(B, cylinderP2() - P);
+
+    if (analytic) // analytic integration
+    {
+        float Iline = R * I_ltc_line(p1, p2, Minv);
+        float Idisks = endCaps ? I_ltc_disks(p1, p2, R, Minv) : 0.0;
+        return vec3(min(1.0, Iline + Idisks));
+    }
+    else // numerical integration
+    {
+        float Icylinder = I_cylinder_numerical(p1, p2, R, Minv);
+        float Idisks = endCaps ? I_disks_numerical(p1, p2, R, Minv) : 0.0;
+        return vec3(Icylinder + Idisks);
+    }
+}
+
+out vec4 FragColor;
+
+// Main
+////////////////
+
+void main()
+{
+    vec4 floorPlane = vec4(0, 1, 0, 0);
+
+    vec3 lcol = vec3(intensity);
+    vec3 dcol = ToLinear(dcolor);
+    vec3 scol = ToLinear(scolor);
+
+    vec3 col = vec3(0);
+
+    {
+        Ray ray = GenerateCameraRay();
+
+        float distToFloor;
+        bool hitFloor = RayPlaneIntersect(ray, floorPlane, distToFloor);
+        if (hitFloor)
+        {
+            vec3 pos = ray.origin + ray.dir*distToFloor;
+
+            vec3 N = floorPlane.xyz;
+            vec3 V = -ray.dir;
+
+            float ndotv = saturate(dot(N, V));
+            vec2 uv = LTC_Coords(roughness, ndotv);
+
+            vec4 t1 = texture(ltc_1, uv);
+            vec4 t2 = texture(ltc_2, uv);
+
+            mat3 Minv = LTC_Matrix(t1);
+
+            vec3 spec = LTC_Evaluate(N, V, pos, Minv);
+            // BRDF shadowing and Fresnel
+            spec *= scol*t2.x + (1.0 - scol)*t2.y;
+
+            vec3 diff = LTC_Evaluate(N, V, pos, mat3(1));
+
+            col  = lcol*(spec + dcol*diff);
+            col /= 2.0*pi;
+        }
+
+        float distToCylinder;
+        if (RayCylinderIntersect(ray, cylinderP1(), cylinderP2(), R, endCaps, distToCylinder))
+            if ((distToCylinder < distToFloor) || !hitFloor)
+                col = lcol;
+    }
+
+    FragColor = vec4(col, 1.0);
+}
\ No newline at end of file
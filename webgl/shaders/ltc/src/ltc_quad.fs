@@ -0,0 +1,159 @@
+// bind roughness   {label:"Roughness", default:0.25, min:0.01, max:1, step:0.001}
+// bind dcolor      {label:"Diffuse Color",  r:1.0, g:1.0, b:1.0}
+// bind scolor      {label:"Specular Color", r:0.23, g:0.23, b:0.23}
+// bind intensity   {label:"Light Intensity", default:4, min:0, max:10}
+// bind width       {label:"Width",  default: 8, min:0.1, max:15, step:0.1}
+// bind height      {label:"Height", default: 8, min:0.1, max:15, step:0.1}
+// bind roty        {label:"Rotation Y", default: 0, min:0, max:1, step:0.001}
+// bind rotz        {label:"Rotation Z", default: 0, min:0, max:1, step:0.001}
+// bind twoSided    {label:"Two-sided", default:false}
+// bind clipless    {label:"Clipless Approximation", default:false}
+
+uniform float roughness;
+uniform vec3  dcolor;
+uniform vec3  scolor;
+
+uniform float intensity;
+uniform float width;
+uniform float height;
+uniform float roty;
+uniform float rotz;
+
+uniform bool twoSided;
+uniform bool clipless;
+
+uniform sampler2D ltc_1;
+uniform sampler2D ltc_2;
+
+uniform mat4  view;
+uniform vec2  resolution;
+uniform int   sampleCount;
+
+#include "../kernels/ltc_common.glsl"
+#include "../kernels/ltc_polygon.glsl"
+#include "../kernels/ltc_ray.glsl"
+
+// Tracing and intersection
+///////////////////////////
+
+struct Rect
+{
+    vec3  center;
+    vec3  dirx;
+    vec3  diry;
+    float halfx;
+    float halfy;
+
+    vec4  plane;
+};
+
+bool RayRectIntersect(Ray ray, Rect rect, OUT(float) t)
+{
+    return RayRectIntersect(ray, rect.center, rect.dirx, rect.diry, rect.halfx, rect.halfy, t);
+}
+
+// Camera functions
+///////////////////
+
+Ray GenerateCameraRay()
+{
+    Ray ray;
+
+    vec2 xy = 2.0*gl_FragCoord.xy/resolution - vec2(1.0);
+
+    ray.dir = normalize(vec3(xy, 2.0));
+
+    float focalDistance = 2.0;
+    float ft = focalDistance/ray.dir.z;
+    vec3 pFocus = ray.dir*ft;
+
+    ray.origin = vec3(0);
+    ray.dir    = normalize(pFocus - ray.origin);
+
+    // Apply camera transform
+    ray.origin = (view*vec4(ray.origin, 1)).xyz;
+    ray.dir    = (view*vec4(ray.dir,    0)).xyz;
+
+    return ray;
+}
+
+// Scene helpers
+////////////////
+
+void InitRect(out Rect rect)
+{
+    rect.dirx = rotation_yz(vec3(1, 0, 0), roty*2.0*pi, rotz*2.0*pi);
+    rect.diry = rotation_yz(vec3(0, 1, 0), roty*2.0*pi, rotz*2.0*pi);
+
+    rect.center = vec3(0, 6, 32);
+    rect.halfx  = 0.5*width;
+    rect.halfy  = 0.5*height;
+
+    vec3 rectNormal = cross(rect.dirx, rect.diry);
+    rect.plane = vec4(rectNormal, -dot(rectNormal, rect.center));
+}
+
+void InitRectPoints(Rect rect, out vec3 points[4])
+{
+    vec3 ex = rect.halfx*rect.dirx;
+    vec3 ey = rect.halfy*rect.diry;
+
+    points[0] = rect.center - ex - ey;
+    points[1] = rect.center + ex - ey;
+    points[2] = rect.center + ex + ey;
+    points[3] = rect.center - ex + ey;
+}
+
+out vec4 FragColor;
+
+void main()
+{
+    Rect rect;
+    InitRect(rect);
+
+    vec3 points[4];
+    InitRectPoints(rect, points);
+
+    vec4 floorPlane = vec4(0, 1, 0, 0);
+
+    vec3 lcol = vec3(intensity);
+    vec3 dcol = ToLinear(dcolor);
+    vec3 scol = ToLinear(scolor);
+
+    vec3 col = vec3(0);
+
+    Ray ray = GenerateCameraRay();
+
+    float distToFloor;
+    bool hitFloor = RayPlaneIntersect(ray, floorPlane, distToFloor);
+    if (hitFloor)
+    {
+        vec3 pos = ray.origin + ray.dir*distToFloor;
+
+        vec3 N = floorPlane.xyz;
+        vec3 V = -ray.dir;
+
+        float ndotv = saturate(dot(N, V));
+        vec2 uv = LTC_Coords(roughness, ndotv);
+
+        vec4 t1 = texture(ltc_1, uv);
+        vec4 t2 = texture(ltc_2, uv);
+
+        mat3 Minv = LTC_Matrix(t1);
+
+        vec3 spec = LTC_EvaluateQuad(N, V, pos, Minv, points, twoSided, clipless, ltc_2);
+        // BRDF shadowing and Fresnel
+        spec *= scol*t2.x + (1.0 - scol)*t2.y;
+
+        vec3 diff = LTC_EvaluateQuad(N, V, pos, mat3(1), points, twoSided, clipless, ltc_2);
+
+        col = lcol*(spec + dcol*diff);
+    }
+
+    float distToRect;
+    if (RayRectIntersect(ray, rect, distToRect))
+        if ((distToRect < distToFloor) || !hitFloor)
+            col = lcol;
+
+    FragColor = vec4(col, 1.0);
+}
\ No newline at end of file